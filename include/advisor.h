@@ -0,0 +1,51 @@
+#ifndef ADVISOR_H
+#define ADVISOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "bot.h"
+#include "game.h"
+#include "perfect_clear.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+#define BOT_ADVISOR_DEFAULT_TIME_BUDGET (250 * NANOSECONDS_PER_MILLISECOND)  // Per piece. It runs off the render thread, so it can take many frames.
+
+typedef struct {
+    Placement placement;
+    uint64_t elapsed;           // Nanoseconds since the search for this snapshot started.
+    uint32_t snapshot_id;       // What update_bot_advisor_game returned for the game this is about.
+    uint8_t completed_depth;
+    bool has_placement;         // False if the snapshot had nowhere to go.
+    bool is_final;              // The search for this snapshot is over, nothing deeper is coming.
+} BotAdvice;
+
+typedef struct BotAdvisor BotAdvisor;  // Opaque: a Bot on its own thread, with a mailbox each way.
+
+BotAdvisor* create_bot_advisor(BotSettings settings);                          // Starts the search thread. settings.time_budget is per piece.
+void        destroy_bot_advisor(BotAdvisor* advisor);
+uint32_t    update_bot_advisor_game(BotAdvisor* advisor, const Game* game);   // Call from one thread, as often as wanted. Sends a snapshot only when a new piece spawned (or the game was reset, rewound or held), and returns the id of the newest snapshot.
+bool        get_bot_advice(BotAdvisor* advisor, BotAdvice* out_advice);     // Same thread as above. The newest advice for any snapshot, so check its snapshot_id. False if there is none yet. Never waits.
+
+typedef struct {
+    PerfectClearSolution solution;  // Only filled in when status is PERFECT_CLEAR_FOUND.
+    PerfectClearStats stats;
+    uint32_t snapshot_id;           // What update_perfect_clear_advisor_game returned for the game this is about.
+    PerfectClearStatus status;
+} PerfectClearAdvice;
+
+typedef struct PerfectClearAdvisor PerfectClearAdvisor; // Opaque: a PerfectClearSolver on its own thread, with a mailbox each way.
+
+PerfectClearAdvisor* create_perfect_clear_advisor(PerfectClearSettings settings);   // Starts the solving thread. settings.time_budget is per snapshot.
+void        destroy_perfect_clear_advisor(PerfectClearAdvisor* advisor);
+uint32_t    update_perfect_clear_advisor_game(PerfectClearAdvisor* advisor, const Game* game); // Like update_bot_advisor_game, but also sends a snapshot when the board changes. Cancels the solve of the one before.
+bool        get_perfect_clear_advice(PerfectClearAdvisor* advisor, PerfectClearAdvice* out_advice); // Like get_bot_advice. Only sent once a solve is over.
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // ADVISOR_H
@@ -0,0 +1,143 @@
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+/**
+    Memory for the searches, sized once up front so nothing calls malloc while one runs. Both kinds are one block of pages, which
+    can be huge pages (2 MiB on x86-64) to save TLB misses on big node arrays. Explicit huge pages need the system to have some
+    reserved (vm.nr_hugepages on Linux, SeLockMemoryPrivilege on Windows); without them Linux still gets transparent huge pages
+    if it allows them, and anything else gets normal pages. Neither kind is thread safe: give each thread its own, or lock.
+*/
+#define ALLOCATOR_HUGE_PAGE_SIZE    (2 * 1024 * 1024)
+#define POOL_NULL_INDEX             UINT32_MAX
+
+typedef struct {
+    size_t capacity;                // Bytes
+    size_t used;                    // Bytes, right now.
+    size_t high_water;              // Most bytes in use at once.
+    uint64_t allocation_count;
+    uint64_t failed_count;          // Allocations that didn't fit.
+    uint64_t reset_count;
+    double allocations_per_second;  // Since init.
+    bool is_huge_page_backed;       // Explicit huge pages. Transparent ones can't be told apart from normal pages.
+} AllocatorStats;
+
+// Bump allocator, freed all at once by a reset, for memory that lives as long as a move or a ply. Allocations of one type one
+// after another are back to back, so they can be walked as an array from the first one.
+typedef struct {
+    uint8_t* base;                  // Page aligned.
+    size_t capacity;
+    size_t used;
+    size_t high_water;              // Updated at resets and by get_arena_stats, so allocating stays a compare and an add.
+    uint64_t allocation_count;
+    uint64_t failed_count;
+    uint64_t reset_count;
+    uint64_t init_time;             // Nanoseconds
+    size_t mapped_size;             // capacity rounded up to whole pages.
+    bool is_huge_page_backed;
+} Arena;
+
+bool            init_arena(Arena* arena, size_t capacity, bool use_huge_pages);    // False if the pages couldn't be had.
+void            release_arena(Arena* arena);
+AllocatorStats  get_arena_stats(const Arena* arena);
+
+// 0 if it doesn't fit. alignment is a power of two, at most the page size.
+static inline void* allocate_from_arena(Arena* arena, size_t size, size_t alignment) {
+    const size_t offset = (arena->used + alignment - 1) & ~(alignment - 1);
+    if (offset > arena->capacity || size > arena->capacity - offset)
+    {
+        arena->failed_count++;
+        return 0;
+    }
+    arena->used = offset + size;
+    arena->allocation_count++;
+    return arena->base + offset;
+}
+
+static inline size_t get_arena_mark(const Arena* arena) {
+    return arena->used;
+}
+
+// Frees everything allocated since mark was taken.
+static inline void reset_arena_to_mark(Arena* arena, size_t mark) {
+    if (arena->used > arena->high_water) arena->high_water = arena->used;
+    arena->used = mark;
+}
+
+static inline void reset_arena(Arena* arena) {
+    reset_arena_to_mark(arena, 0);
+    arena->reset_count++;
+}
+
+// Fixed size items, like tree nodes or Game snapshots, taken and given back in any order. The items are one array, so an index
+// works as well as a pointer and fits in 4 bytes. Free items are never written to; the free list is a separate stack of indices.
+typedef struct {
+    uint8_t* items;                 // item_capacity items of item_size bytes. Page aligned.
+    uint32_t* free_indices;         // A stack, the next item to take on top.
+    size_t item_size;
+    uint32_t item_capacity;
+    uint32_t free_count;
+    uint32_t high_water;            // Most items taken at once.
+    uint64_t allocation_count;
+    uint64_t failed_count;
+    uint64_t reset_count;
+    uint64_t init_time;             // Nanoseconds
+    size_t mapped_size;
+    bool is_huge_page_backed;
+} Pool;
+
+bool            init_pool(Pool* pool, size_t item_size, uint32_t item_capacity, bool use_huge_pages); // Items come out in index order from a fresh pool.
+void            release_pool(Pool* pool);
+void            reset_pool(Pool* pool);                                                                 // Gives back every item at once.
+AllocatorStats  get_pool_stats(const Pool* pool);
+
+static inline void* get_pool_item(const Pool* pool, uint32_t index) {
+    return pool->items + index * pool->item_size;
+}
+
+static inline uint32_t get_pool_item_index(const Pool* pool, const void* item) {
+    return (uint32_t)(((const uint8_t*)item - pool->items) / pool->item_size);
+}
+
+static inline uint32_t get_pool_taken_count(const Pool* pool) {
+    return pool->item_capacity - pool->free_count;
+}
+
+// POOL_NULL_INDEX when every item is taken. The item holds whatever it held when it was given back.
+static inline uint32_t take_pool_index(Pool* pool) {
+    if (!pool->free_count)
+    {
+        pool->failed_count++;
+        return POOL_NULL_INDEX;
+    }
+    const uint32_t index = pool->free_indices[--pool->free_count];
+    if (get_pool_taken_count(pool) > pool->high_water) pool->high_water = get_pool_taken_count(pool);
+    pool->allocation_count++;
+    return index;
+}
+
+static inline void give_pool_index(Pool* pool, uint32_t index) {
+    pool->free_indices[pool->free_count++] = index;
+}
+
+static inline void* take_pool_item(Pool* pool) { // 0 when every item is taken.
+    const uint32_t index = take_pool_index(pool);
+    return (index == POOL_NULL_INDEX) ? 0 : get_pool_item(pool, index);
+}
+
+static inline void give_pool_item(Pool* pool, void* item) {
+    give_pool_index(pool, get_pool_item_index(pool, item));
+}
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // ALLOCATOR_H
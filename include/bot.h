@@ -0,0 +1,80 @@
+#ifndef BOT_H
+#define BOT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "allocator.h"
+#include "clock.h"
+#include "game.h"
+#include "opening_book.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+#define BOT_MAX_DEPTH               (1 + PIECE_PREVIEW_COUNT)   // Controlled piece plus the visible queue.
+#define BOT_DEFAULT_BEAM_WIDTH      96
+#define BOT_DEFAULT_THREAD_COUNT    4
+#define BOT_DEFAULT_TIME_BUDGET     (8 * NANOSECONDS_PER_MILLISECOND)
+#define BOT_CONTROLLER_STUCK_TICKS  8                           // Ticks without progress before the controller gives up and drops where it is.
+
+// Weights for the board heuristic. Heights are in cells, line clears use the 1/3/5/8 ratio of the scoring in on_controlled_piece_place.
+typedef struct {
+    float aggregate_height;
+    float max_height;
+    float holes;
+    float covered_cells;    // Filled cells stacked above holes.
+    float bumpiness;
+    float line_clears;
+    float combo;
+} BotWeights;
+
+typedef struct {
+    BotWeights weights;
+    uint64_t time_budget;   // Nanoseconds per search. Plies that don't finish in time are thrown away.
+    uint16_t beam_width;
+    uint8_t depth;          // Plies to search, at most BOT_MAX_DEPTH.
+    uint8_t thread_count;   // Including the calling thread.
+    bool use_huge_pages;    // For the node arenas, about 1 MiB per thread at the default beam width. See allocator.h.
+    const OpeningBook* opening_book; // Optional, not owned. A position found in it is played without searching.
+} BotSettings;
+
+typedef struct {
+    uint64_t elapsed;       // Nanoseconds
+    uint32_t evaluated_nodes;
+    uint8_t completed_depth;
+    bool is_from_book;      // The placement came from the opening book. completed_depth is then the book search's.
+} BotSearchStats;
+
+typedef struct Bot Bot;     // Opaque: owns the thread pool and per thread node arenas.
+typedef bool (*BotPlyCallback)(void* user_data, Placement best, uint8_t completed_depth); // Return false to stop after this ply.
+
+BotSettings get_default_bot_settings();
+Bot*        create_bot(BotSettings settings);                                                                   // Everything the search needs is allocated here, never during a search.
+void        destroy_bot(Bot* bot);
+bool        search_bot_placement(Bot* bot, const Game* game, Placement* out_placement, BotSearchStats* optional_out_stats); // False if no placement is possible.
+bool        search_bot_placement_anytime(Bot* bot, const Game* game, BotPlyCallback optional_on_ply, void* user_data, Placement* out_placement, BotSearchStats* optional_out_stats); // Same, reporting the best placement so far after every ply.
+void        cancel_bot_search(Bot* bot);                                                                        // Safe from any thread. The ply being expanded is dropped as if out of time. A search that starts after this is not cancelled.
+AllocatorStats get_bot_node_stats(const Bot* bot);                                                              // Every thread's node arena added up. A reset is a ply.
+
+// Turns a Placement into ACTION_BIT_FLAGS one tick at a time, releasing keys in between since tick only acts on fresh presses.
+typedef struct {
+    Placement target;
+    uint32_t target_placed_piece_count; // Game.placed_piece_count when the target was set, so a stale target is noticed.
+    uint8_t last_pos_x;
+    uint8_t last_rotation;
+    uint8_t stuck_ticks;
+    bool has_target;
+    ACTION_BIT_FLAGS previous_action_bit_flags;
+} BotController;
+
+bool                needs_bot_controller_target(const BotController* controller, const Game* game);
+void                set_bot_controller_target(BotController* controller, const Game* game, Placement target);
+ACTION_BIT_FLAGS    get_bot_controller_action_bit_flags(BotController* controller, const Game* game);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // BOT_H
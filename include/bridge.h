@@ -0,0 +1,89 @@
+#ifndef BRIDGE_H
+#define BRIDGE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "env.h"
+#include "game.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+/**
+    A game hosted in a named shared memory segment, for bots in other processes and languages. The host publishes a BridgeState
+    every tick and waits for the action that answers it, so a round trip is two cache line handoffs instead of two syscalls.
+    The segment is plain little endian memory at fixed offsets, so a client only needs shm_open and mmap (or OpenFileMapping and
+    MapViewOfFile) and 32 bit atomics. Offsets are from the start of the segment, each part on its own cache line.
+      0    header: magic, abi_version, segment_size, action_ring_size (u32 each), then host_status (u32, BRIDGE_HOST_*).
+      64   state: sequence (u32), client_sleeping (u32), then the BridgeState. A seqlock: the host makes sequence odd, writes the
+           state, then makes it even again. A reader copies the state between two reads of an even, equal sequence, else retries.
+      192  action_head (u32), host_sleeping (u32). Written by the client only, the number of actions it has ever sent.
+      256  action_tail (u32). Written by the host only, the number of actions it has taken.
+      320  action ring: action_ring_size BridgeActions. An SPSC ring: the client writes actions[head % size] while head - tail < size,
+           then stores head + 1 with release order. The host reads while tail != head.
+    Sleeping is optional. A side that wants to block sets its *_sleeping word, checks the word it waits on once more, and sleeps on
+    it (a shared futex on Linux), and whoever changes that word wakes it when the sleeping word is set. Spinning instead costs a core
+    per side and saves the wakeup.
+*/
+#define BRIDGE_ABI_VERSION              1
+#define BRIDGE_MAGIC                    0x5A544252u // "RBTZ" in memory.
+#define BRIDGE_ACTION_RING_SIZE         64          // A power of two.
+#define BRIDGE_OFFSET_HEADER            0
+#define BRIDGE_OFFSET_STATE_SEQUENCE    64
+#define BRIDGE_OFFSET_CLIENT_SLEEPING   68
+#define BRIDGE_OFFSET_STATE             72
+#define BRIDGE_OFFSET_ACTION_HEAD       192
+#define BRIDGE_OFFSET_HOST_SLEEPING     196
+#define BRIDGE_OFFSET_ACTION_TAIL       256
+#define BRIDGE_OFFSET_ACTIONS           320
+#define BRIDGE_SEGMENT_SIZE             (BRIDGE_OFFSET_ACTIONS + BRIDGE_ACTION_RING_SIZE * 16)
+
+#define BRIDGE_HOST_STARTING            0
+#define BRIDGE_HOST_RUNNING             1
+#define BRIDGE_HOST_STOPPED             2
+
+#define BRIDGE_SPIN_FOREVER             UINT32_MAX  // spin_count that never sleeps.
+#define BRIDGE_DEFAULT_SPIN_COUNT       4096        // Polls before sleeping, some tens of microseconds.
+#define BRIDGE_WAIT_FOREVER             UINT64_MAX
+
+// 120 bytes, no pointers.
+typedef struct {
+    uint64_t tick;                  // Ticks since the host started. The action answering this state carries it back.
+    EnvObservation observation;     // The same 96 bytes env_step writes (see env.h).
+    uint32_t score;
+    uint32_t placed_piece_count;
+    uint32_t game_index;            // Counts games the host has started. tick keeps counting across them.
+    uint16_t lines_cleared;
+    uint8_t is_game_over;           // The last state of a game. It is answered like any other.
+    uint8_t reserved;
+} BridgeState;
+
+// 16 bytes.
+typedef struct {
+    uint64_t tick;                  // BridgeState.tick this answers.
+    ACTION_BIT_FLAGS action_bit_flags;
+    uint8_t reserved[7];
+} BridgeAction;
+
+typedef struct Bridge Bridge;       // Opaque: one side of a mapped segment.
+
+// Host.
+Bridge* create_bridge_host(const char* name, uint32_t spin_count);                     // Creates the segment, replacing one left behind under name. name is a single path component, like "zetris".
+void    publish_bridge_state(Bridge* bridge, const Game* game, uint64_t tick, uint32_t game_index);
+bool    wait_bridge_action(Bridge* bridge, uint64_t tick, ACTION_BIT_FLAGS* out_action_bit_flags, uint64_t timeout_nanoseconds); // The first action for tick, skipping any other. False on timeout.
+void    stop_bridge_host(Bridge* bridge);                                               // Tells the client there is nothing more, and wakes it.
+
+// Client.
+Bridge* open_bridge_client(const char* name, uint32_t spin_count);                     // 0 if there is no segment, or it has another ABI version.
+bool    wait_bridge_state(Bridge* bridge, uint64_t after_tick, BridgeState* out_state, uint64_t timeout_nanoseconds); // The newest state past after_tick (UINT64_MAX for any). False on timeout or once the host stopped.
+bool    send_bridge_action(Bridge* bridge, uint64_t tick, ACTION_BIT_FLAGS action_bit_flags); // False if the ring is full.
+
+void    destroy_bridge(Bridge* bridge);                                                 // Unmaps. The host also removes the name.
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // BRIDGE_H
@@ -0,0 +1,19 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+#define NANOSECONDS_PER_SECOND      1000000000ULL
+#define NANOSECONDS_PER_MILLISECOND 1000000ULL
+
+uint64_t get_monotonic_nanoseconds(void); // Monotonic, so only differences between two calls mean anything.
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // CLOCK_H
@@ -0,0 +1,57 @@
+#ifndef CODEC_H
+#define CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "game.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+/**
+    Encoded game state, always against a previous state. A keyframe is encoded against an all zero Game, so it is just a delta that changes everything.
+    varint      field mask, CODEC_FIELD_* bits for what differs from the previous state. Only those fields follow, in bit order.
+    Varints are LEB128. Counters that only ever move a little (score, lines, placed pieces) are zigzag varints of the difference.
+    The board is every row from the first one with cells to row_count, as runs: a varint of the run length times two, plus one for a copy.
+    A copy is followed by a zigzag varint of where the run starts in the previous board, relative to where it lands, so line clears and
+    garbage are a copy with an offset instead of every row again. A literal is followed by its rows, each the cells in (column_count + 7) / 8
+    bytes and then the type of every set cell, 3 bits each from the lowest column up, padded to a byte.
+    A state is self delimiting, so states can go back to back.
+*/
+#ifdef ZETRIS_WIDE_ROWS
+#define CODEC_MAX_ENCODED_SIZE  2304    // A keyframe of a full 60 by 64 board is under 2200 bytes.
+#else
+#define CODEC_MAX_ENCODED_SIZE  768     // A keyframe of a full 32 by 32 board is under 720 bytes.
+#endif // ZETRIS_WIDE_ROWS
+
+#define CODEC_FIELD_PIECE       0x0001  // type, rotation, on_ground, pos_x, pos_y, moves, controlled_piece_ground_y, and cells if they aren't the rotation's.
+#define CODEC_FIELD_TIMER       0x0002
+#define CODEC_FIELD_VELOCITY    0x0004
+#define CODEC_FIELD_ACTIONS     0x0008  // previous_action_bit_flags
+#define CODEC_FIELD_BOARD       0x0010
+#define CODEC_FIELD_PLACED      0x0020
+#define CODEC_FIELD_QUEUE_INDEX 0x0040
+#define CODEC_FIELD_HOLD        0x0080  // Held type and can_hold_piece.
+#define CODEC_FIELD_SCORE       0x0100
+#define CODEC_FIELD_LINES       0x0200  // lines_cleared, cleared_lines_last_piece, combo_count and level_index.
+#define CODEC_FIELD_QUEUE       0x0400
+#define CODEC_FIELD_RANDOM      0x0800
+#define CODEC_FIELD_SETTINGS    0x1000
+#define CODEC_FIELD_HANDLING    0x2000
+#define CODEC_FIELD_DIMENSIONS  0x4000  // row_count, column_count and ceiling.
+#define CODEC_FIELD_ALL         0x7FFF
+// The first seven fields are the ones that change tick to tick, so a tick's mask fits in one byte.
+
+// Round trips are exact for every field, as long as cells past row_count are empty and type planes are only set where cells are, which the game always keeps.
+size_t  encode_game_state(const Game* game, const Game* previous, uint8_t* out);                               // previous 0 for a keyframe. out needs CODEC_MAX_ENCODED_SIZE bytes. Returns the bytes written.
+size_t  decode_game_state(const uint8_t* data, size_t size, const Game* previous, Game* out_game);             // previous must be what the state was encoded against, and may be out_game. Returns the bytes read, 0 if malformed.
+size_t  encode_game_states(const Game* games, uint32_t count, const Game* previous, uint8_t* out, size_t capacity); // Each against the one before it, the first against previous. 0 if they don't fit.
+size_t  decode_game_states(const uint8_t* data, size_t size, const Game* previous, Game* out_games, uint32_t count);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // CODEC_H
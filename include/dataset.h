@@ -0,0 +1,130 @@
+#ifndef DATASET_H
+#define DATASET_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "game.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+/**
+    Dataset layout, every integer little endian. Rows are split into chunks, and a chunk stores each column on its own,
+    so a trainer that wants three columns only decodes three columns.
+    Header
+    0   4   magic "ZDST"
+    4   2   version
+    6   2   column_count
+    8   4   chunk_rows, the most rows a chunk holds
+    12  4   reserved, zero
+    16  48  column widths in bytes, column_count of them, the rest zero
+    64      chunks, back to back
+    Chunk
+    0   4   row_count
+    4   4   checksum, 32 bit FNV-1a of everything after the chunk header
+    8   8   per column: codec (1 byte), 3 reserved, encoded size (4 bytes)
+    ...     encoded columns in column order
+    Index, right after the last chunk: per chunk 8 byte file offset, 8 byte first row, 4 byte chunk size, 4 byte row count
+    Footer, the last 32 bytes
+    0   8   index offset
+    8   8   chunk_count
+    16  8   row_count
+    24  4   magic "ZIDX"
+    28  4   reserved, zero
+    A column's values are fixed width, so value i of a decoded column is at i * width.
+*/
+#define DATASET_MAGIC                   "ZDST"
+#define DATASET_INDEX_MAGIC             "ZIDX"
+#define DATASET_VERSION                 1
+#define DATASET_HEADER_SIZE             64
+#define DATASET_MAX_COLUMN_COUNT        48
+#define DATASET_CHUNK_HEADER_SIZE       8
+#define DATASET_COLUMN_HEADER_SIZE      8
+#define DATASET_INDEX_ENTRY_SIZE        24
+#define DATASET_FOOTER_SIZE             32
+#define DATASET_DEFAULT_CHUNK_ROWS      16384   // About 3 MiB of raw rows, so every producer holds one chunk and the queue a few.
+#define DATASET_DEFAULT_QUEUE_CAPACITY  16      // Encoded chunks waiting for the writing thread. Producers wait when it is full.
+#define DATASET_BOARD_ROW_COUNT         32      // Fixed, so files are the same whatever PlayfieldRow the build has.
+
+typedef enum {
+    DATASET_CODEC_RAW,
+    DATASET_CODEC_SHUFFLED_RUNS     // Byte i of every value together, then runs of the same byte collapsed. Boards are mostly zero bytes.
+} DatasetCodec;
+
+typedef enum {
+    DATASET_COLUMN_GAME_ID,             // 8, unique per game within a dataset.
+    DATASET_COLUMN_PIECE_INDEX,         // 4, Game.placed_piece_count when the piece spawned.
+    DATASET_COLUMN_BOARD,               // 4 per row, DATASET_BOARD_ROW_COUNT rows top first, bit x is column x. Rows past the playfield are zero. Bigger boards are cut to the top left 32 by 32.
+    DATASET_COLUMN_CURRENT,             // 1, PieceType.
+    DATASET_COLUMN_HOLD,                // 1, PieceType, 0 when nothing is held.
+    DATASET_COLUMN_QUEUE,               // 1 per piece, PIECE_PREVIEW_COUNT PieceTypes nearest first.
+    DATASET_COLUMN_CAN_HOLD,            // 1
+    DATASET_COLUMN_COMBO,               // 1, Game.combo_count.
+    DATASET_COLUMN_LEVEL,               // 1, Game.level_index.
+    DATASET_COLUMN_PLACEMENT_TYPE,      // 1, the chosen Placement from here on.
+    DATASET_COLUMN_PLACEMENT_X,         // 1
+    DATASET_COLUMN_PLACEMENT_Y,         // 1
+    DATASET_COLUMN_PLACEMENT_ROTATION,  // 1
+    DATASET_COLUMN_PLACEMENT_HOLD,      // 1
+    DATASET_COLUMN_LINES_CLEARED,       // 1, by this placement. The outcome of it from here on.
+    DATASET_COLUMN_SCORE_GAINED,        // 4
+    DATASET_COLUMN_GAME_SCORE,          // 8, at the end of the game.
+    DATASET_COLUMN_GAME_LINES,          // 4
+    DATASET_COLUMN_GAME_PIECES,         // 4
+    DATASET_COLUMN_GAME_OVER,           // 1, 0 if the game was cut off instead of topping out.
+    DATASET_COLUMN_COUNT
+} DatasetColumn;
+
+typedef struct {
+    uint64_t game_id;
+    uint32_t piece_index;
+    uint32_t board[DATASET_BOARD_ROW_COUNT];
+    uint8_t current;
+    uint8_t hold;
+    uint8_t queue[PIECE_PREVIEW_COUNT];
+    uint8_t can_hold;
+    uint8_t combo_count;
+    uint8_t level_index;
+    Placement placement;
+    uint8_t lines_cleared;
+    uint32_t score_gained;
+    uint64_t game_score;
+    uint32_t game_lines;
+    uint32_t game_pieces;
+    uint8_t game_over;
+} DatasetRow;
+
+typedef struct DatasetWriter DatasetWriter;     // Opaque: the file, the bounded chunk queue, and the thread writing it.
+typedef struct DatasetProducer DatasetProducer; // Opaque: one chunk being filled. One per producing thread.
+typedef struct DatasetReader DatasetReader;     // Opaque: a mapped dataset file.
+
+extern const uint8_t DATASET_COLUMN_WIDTHS[DATASET_COLUMN_COUNT];
+const char*         get_dataset_column_name(DatasetColumn column);
+void                set_dataset_row_state(DatasetRow* row, uint64_t game_id, const Game* game); // Everything about the game a placement is chosen from.
+
+DatasetWriter*      create_dataset_writer(const char* path, uint32_t chunk_rows, uint32_t queue_capacity); // 0 for the defaults.
+bool                close_dataset_writer(DatasetWriter* writer);                                // Destroy every producer first. Writes the index, false if any write failed.
+DatasetProducer*    create_dataset_producer(DatasetWriter* writer);
+bool                append_dataset_row(DatasetProducer* producer, const DatasetRow* row);      // Encodes full chunks on the calling thread, then queues them, waiting while the queue is full.
+bool                destroy_dataset_producer(DatasetProducer* producer);                        // Queues what is left.
+
+DatasetReader*      open_dataset(const char* path);                                             // 0 if the header, footer or index don't check out.
+void                close_dataset(DatasetReader* reader);
+uint64_t            get_dataset_row_count(const DatasetReader* reader);
+uint32_t            get_dataset_chunk_count(const DatasetReader* reader);
+uint32_t            get_dataset_chunk_rows(const DatasetReader* reader);                        // Most rows in any chunk, for sizing decode buffers.
+bool                get_dataset_chunk(const DatasetReader* reader, uint32_t chunk_index, uint64_t* out_first_row, uint32_t* out_row_count);
+bool                find_dataset_chunk(const DatasetReader* reader, uint64_t row_index, uint32_t* out_chunk_index, uint32_t* out_row_in_chunk); // Binary search of the index.
+bool                get_dataset_column_sizes(const DatasetReader* reader, uint32_t chunk_index, DatasetColumn column, size_t* out_encoded_size, size_t* out_decoded_size);
+bool                decode_dataset_column(const DatasetReader* reader, uint32_t chunk_index, DatasetColumn column, uint8_t* out_values); // row_count * width bytes. Thread safe, the reader is never written.
+bool                check_dataset_chunk(const DatasetReader* reader, uint32_t chunk_index);     // Compares the checksum. Decoding doesn't, so a trainer pays for it once, not every epoch.
+bool                decode_dataset_rows(const DatasetReader* reader, uint32_t chunk_index, DatasetRow* out_rows); // Every column of a chunk, row_count rows.
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // DATASET_H
@@ -0,0 +1,63 @@
+#ifndef ENV_H
+#define ENV_H
+
+#include <stdint.h>
+
+#include "game.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+// Symbols exported from the libzetris shared library. Everything else in the library is hidden.
+#if defined(_WIN32)
+    #if defined(ZETRIS_BUILD_SHARED)
+        #define ZETRIS_API __declspec(dllexport)
+    #elif defined(ZETRIS_USE_SHARED)
+        #define ZETRIS_API __declspec(dllimport)
+    #else
+        #define ZETRIS_API
+    #endif
+#else
+    #define ZETRIS_API __attribute__((visibility("default")))
+#endif
+
+#define ENV_ABI_VERSION             1                   // Bump whenever EnvObservation or a signature below changes.
+#define ENV_TICK_DELTA_TIME         (1.0 / 60.0)        // Every env step is exactly one tick of this length, so runs are reproducible from a seed.
+#define ENV_OBSERVATION_ROW_COUNT   DEFAULT_ROW_COUNT
+
+// Fixed layout written straight into the caller's buffer. 96 bytes, no pointers, no padding the caller has to guess.
+typedef struct {
+    uint32_t rows[ENV_OBSERVATION_ROW_COUNT];   // 80 bytes, bit x of row y is the locked cell at column x (no COLUMN_OFFSET).
+    uint8_t piece_type;                         // 1 byte, PieceType of the controlled piece.
+    uint8_t piece_rotation;                     // 1 byte, 0-3 (0, R, 2, L).
+    uint8_t piece_x;                            // 1 byte, raw Piece.pos_x (includes COLUMN_OFFSET).
+    uint8_t piece_y;                            // 1 byte
+    uint8_t ghost_y;                            // 1 byte
+    uint8_t held_type;                          // 1 byte, 0 when nothing is held.
+    uint8_t can_hold;                           // 1 byte
+    uint8_t combo_count;                        // 1 byte
+    uint8_t level_index;                        // 1 byte
+    uint8_t queue[PIECE_PREVIEW_COUNT];         // 5 bytes, PieceType of the next pieces, nearest first.
+    uint8_t reserved[2];                        // 2 bytes
+} EnvObservation;
+
+typedef struct EnvBatch EnvBatch;               // Opaque, so the Game layout can change without breaking trainers.
+
+ZETRIS_API uint32_t  env_abi_version(void);
+ZETRIS_API EnvBatch* env_create(uint32_t env_count, uint64_t seed);                     // One allocation for the whole batch. Returns 0 on failure.
+ZETRIS_API void      env_destroy(EnvBatch* envs);
+ZETRIS_API uint32_t  env_count(const EnvBatch* envs);
+ZETRIS_API void      env_reset(EnvBatch* envs, EnvObservation* out_obs);                // Starts every game over with a fresh seed and writes env_count observations.
+// Steps games [0, n) by one tick each. Finished games are reset with a fresh seed, and out_obs then holds the first observation of the new game.
+// All output buffers are owned by the caller and must hold at least n elements. Nothing is allocated or copied besides the outputs.
+ZETRIS_API void      env_step(EnvBatch* envs, const ACTION_BIT_FLAGS* actions, uint32_t n, EnvObservation* out_obs, float* out_reward, uint8_t* out_done);
+
+// Not exported. The other ways of driving the core from outside (see bridge.h) publish the same layout.
+void                 write_env_observation(const Game* game, EnvObservation* out_obs);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // ENV_H
@@ -0,0 +1,90 @@
+#ifndef FINESSE_H
+#define FINESSE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "game.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+#define FINESSE_MAX_INPUTS          32  // Longer paths are treated as unreachable. Real ones are a handful.
+#define FINESSE_MAX_REPLANS         4   // Per piece, before the controller gives up and drops where it is.
+
+// One key press. DAS and soft drop are held until they have nothing left to do, and count once, like a player holding the key.
+typedef enum {
+    FINESSE_TAP_LEFT,
+    FINESSE_TAP_RIGHT,
+    FINESSE_DAS_LEFT,               // Until the wall or stack.
+    FINESSE_DAS_RIGHT,
+    FINESSE_ROTATE_CLOCKWISE,
+    FINESSE_ROTATE_COUNTER,
+    FINESSE_SOFT_DROP,              // Until the ground.
+    FINESSE_HOLD,
+    FINESSE_HARD_DROP,
+    FINESSE_INPUT_COUNT
+} FinesseInput;
+
+// Where the piece should be after an input. Same coordinates as Piece.
+typedef struct {
+    uint8_t pos_x;
+    uint8_t pos_y;
+    uint8_t rotation;
+} FinesseState;
+
+typedef struct {
+    uint8_t inputs[FINESSE_MAX_INPUTS];         // FinesseInput, ending with FINESSE_HARD_DROP.
+    FinesseState states[FINESSE_MAX_INPUTS];    // After each input, so a driver can tell when gravity or a kick took the piece elsewhere.
+    uint8_t input_count;
+    uint8_t key_count;                          // What finesse counts: every input but hold and the hard drop.
+    bool is_from_table;
+} FinessePath;
+
+typedef struct FinessePlanner FinessePlanner;   // Opaque: the empty board tables and the search scratch. One per thread.
+
+FinessePlanner* create_finesse_planner();                                                   // Builds the tables, one search per target on an empty default sized board.
+void            destroy_finesse_planner(FinessePlanner* planner);
+bool            find_finesse_path(FinessePlanner* planner, const Game* game, Placement target, FinessePath* out_path); // Fewest inputs from where the controlled piece is now, without soft drops if it can be done without. A lookup when the rows it moves through at spawn are empty, a search over (x, y, rotation) with the real kicks otherwise. Any rotation covering the same cells counts. False if unreachable.
+uint32_t        get_finesse_action_stream(FinessePlanner* planner, const Game* game, Placement target, double delta_time, ACTION_BIT_FLAGS* out_action_bit_flags, uint32_t capacity); // Ticks a copy of game with a FinesseController until the piece locks. Returns the ticks written, 0 if it didn't lock on target or ran out of room.
+const char*     get_finesse_input_name(FinesseInput input);
+
+// Plays a FinessePath through tick, one press per tick, releasing a key for a tick before it is pressed again. Replans when the piece isn't where the path expects.
+typedef struct {
+    FinessePath path;
+    Placement target;
+    uint32_t target_placed_piece_count; // Game.placed_piece_count when the target was set, so a stale target is noticed.
+    uint8_t next_input;
+    uint8_t replan_count;
+    bool is_input_held;                 // The DAS or soft drop at next_input is down.
+    bool has_target;
+} FinesseController;
+
+bool                needs_finesse_controller_target(const FinesseController* controller, const Game* game);
+bool                set_finesse_controller_target(FinesseController* controller, FinessePlanner* planner, const Game* game, Placement target); // False if the target can't be reached, the controller then hard drops.
+ACTION_BIT_FLAGS    get_finesse_controller_action_bit_flags(FinesseController* controller, FinessePlanner* planner, const Game* game);
+
+// Counts a player's presses for each piece and compares them with the fewest that would have placed it there.
+typedef struct {
+    Game spawn;                         // The game when the current piece spawned (or came out of hold).
+    FinesseState last_state;            // Where the piece was after the previous tick.
+    uint32_t piece_count;               // Pieces judged.
+    uint32_t fault_count;               // Pieces that took more presses than needed.
+    uint32_t extra_key_count;
+    uint8_t key_count;                  // Presses for the current piece so far.
+    uint8_t last_key_count;             // The last judged piece.
+    uint8_t last_optimal_key_count;
+    bool is_last_fault;
+    bool is_tracking;
+    ACTION_BIT_FLAGS previous_action_bit_flags;
+} FinesseTracker;
+
+void    reset_finesse_tracker(FinesseTracker* tracker, const Game* game);
+bool    track_finesse(FinesseTracker* tracker, FinessePlanner* planner, ACTION_BIT_FLAGS action_bit_flags, const Game* game); // Call after every tick with what it was given. True when a piece locked and was judged.
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // FINESSE_H
@@ -34,22 +34,43 @@ extern "C" {
 #define LOCK_DELAY                  0.5f
 #define MAX_MOVES_BEFORE_LOCK       10
 
-#define HORIZONTAL_VELOCITY         10.0f
-#define VERTICAL_VELOCITY           5.0f
+#define DEFAULT_DAS                 0.1f    // Seconds. Together with DEFAULT_ARR, the 10 cells a second the game always moved at.
+#define DEFAULT_ARR                 0.1f    // Seconds.
+#define DEFAULT_SOFT_DROP_FACTOR    4.0f    // About the old gravity plus 5 cells a second at level 1.
+#define ARR_INSTANT                 0.0f    // Auto shift goes straight to the wall or stack.
+#define SOFT_DROP_INSTANT           0.0f    // Soft drop goes straight to the ground without locking.
+#define MAX_DAS                     10.0f   // Seconds. The MAX_ handling values are what is_handling_valid lets replays and encoded states carry.
+#define MAX_ARR                     10.0f   // Seconds.
+#define MAX_SOFT_DROP_FACTOR        1000.0f // 25 cells a tick at level 1 and 60 Hz, far past any soft drop worth having.
 
 #define PIECE_SPAWN_ROW_OFFSET      1
 
+#define MAX_DROP_PLACEMENT_COUNT    (2 * PIECE_ROTATION_STATES * (MAX_COLUMN_COUNT + COLUMN_OFFSET)) // Two pieces (with hold), every rotation, every column.
+
 #define LEVEL_COUNT                 20
 
+#define PIECE_QUEUE_LENGTH          (PIECE_COUNT * 2)   // Two bags, so there is always at least a full bag visible ahead of the current piece.
+#define PIECE_PREVIEW_COUNT         5
+
 #define SIGN(val) \
     ( (val < 0) ? -1 : 1 )
 
+// How held inputs turn into movement. Part of the game, since it changes what the same inputs do.
+typedef struct {
+    float das;                  // Delayed auto shift: seconds a move is held after the first cell before it repeats.
+    float arr;                  // Auto repeat rate: seconds between repeated cells. ARR_INSTANT for all of them at once.
+    float soft_drop_factor;     // Gravity multiplier while soft dropping. SOFT_DROP_INSTANT to drop to the ground at once.
+} Handling;
+
 typedef struct {
     uint64_t score;
+    uint64_t random_state;
     PieceData* held_piece;
-    PieceData* piece_queue[PIECE_COUNT];
+    PieceData* piece_queue[PIECE_QUEUE_LENGTH];
     Piece controlled_piece;
     Playfield playfield;
+    Handling handling;
+    uint32_t placed_piece_count;            // Pieces locked this round. Lets observers notice a new piece without hooking the game.
     uint8_t controlled_piece_ground_y; // TODO: this could go in the controlled_piece...
     uint8_t level_index;
     uint8_t piece_queue_index;
@@ -60,23 +81,45 @@ typedef struct {
     ACTION_BIT_FLAGS previous_action_bit_flags;
 } Game;
 
+// Where a piece locks. pos_x and pos_y use the same coordinates as Piece.
+typedef struct {
+    PieceType type;
+    uint8_t pos_x;
+    uint8_t pos_y;
+    uint8_t rotation;
+    bool use_hold;          // Hold first, then place the piece that comes out.
+} Placement;
+
 // Game loop functions
 Game        get_default_initialized_game();                                             // Returns a game struct which uses defaults from define macros.
+Game        get_seeded_initialized_game(uint64_t seed);                                 // Same as above, but the piece queue is fully determined by the seed.
+Game        get_sized_initialized_game(uint64_t seed, uint8_t row_count, uint8_t column_count); // Same as above on a board of another size, clamped to MAX_ROW_COUNT and MAX_COLUMN_COUNT.
+Handling    get_default_handling();
+bool        is_handling_valid(Handling handling);                                       // Every value finite and from 0 to its MAX_ bound.
 void        tick(Game* game, double delta_time, ACTION_BIT_FLAGS action_bit_flags);     // Call this every tick, with delta time since last tick, and the actions that were processed.
 bool        is_game_over(Game* game);                                                   // Condition to check if game is over (cells above line).
 void        reset_game(Game* game);                                                     // Reset the game data that is only tied to a round.
 
+// Placement level functions. For search and rollouts that only care where pieces lock, not how they got there frame by frame.
+bool        is_placement_valid(const Game* game, Placement placement);                 // Right piece (after hold if asked), inside the playfield, not colliding, and resting on something.
+bool        attempt_apply_placement(Game* game, Placement placement);                  // Holds if asked, then locks, clears, scores and advances the queue and level exactly like tick would. Nothing changes if invalid.
+void        apply_drop_placement(Game* game, Placement placement);                     // The same without the is_placement_valid check, for placements already known valid (from get_drop_placements on this game, say) on a board a game reached: no empty row under the stack.
+uint16_t    get_drop_placements(const Game* game, bool include_hold, Placement* out_placements); // Every placement reached by rotating at spawn, sliding along the spawn row and dropping. Writes at most MAX_DROP_PLACEMENT_COUNT.
+
 // Game logic functions
 bool	    are_playfield_piece_cells_colliding(Playfield* playfield, PieceCells piece_cells, PieceSize piece_size, uint8_t pos_x, uint8_t pos_y);
 bool        are_piece_cells_on_playfield_ground(Playfield* playfield, PieceCells piece_cells, PieceSize piece_size, uint8_t pos_x, uint8_t pos_y);
 bool        attempt_rotate_piece(Playfield* playfield, Piece* piece, bool clockwise);
 uint8_t     attempt_move_piece_until_collision(Playfield* playfield, Piece* piece, int8_t x_direction, int8_t y_direction, uint8_t distance);           // Intended to be used for one axis at a time.
+uint8_t     get_playfield_piece_cells_shift_distance(const Playfield* playfield, PieceCells piece_cells, PieceSize piece_size, uint8_t pos_x, uint8_t pos_y, int8_t x_direction); // Free cells to the wall or stack, with a ctz or clz per piece row instead of a collision check per cell.
 uint8_t     get_playfield_piece_cells_hard_drop_y(Playfield* playfield, PieceCells piece_cells, PieceSize piece_size, uint8_t pos_x, uint8_t pos_y);
-void        lock_piece_cells_in_playfield(Playfield* playfield, PieceCells piece_cells, PieceSize piece_size, uint8_t pos_x, uint8_t pos_y);
+void        lock_piece_cells_in_playfield(Playfield* playfield, PieceCells piece_cells, PieceSize piece_size, PieceType piece_type, uint8_t pos_x, uint8_t pos_y);
 void        reset_controlled_piece(Game* game, PieceData* optional_piece_data);
 void        on_controlled_piece_place(Game* game);
+void        update_level(Game* game);                                                   // Moves to the next level once enough lines are cleared.
 PieceData*  pop_piece_queue(Game* game);
 PieceData*  top_piece_queue(Game* game);
+PieceData*  peek_piece_queue(const Game* game, uint8_t offset);                        // Offset 0 is the same as top. Always valid for offsets up to PIECE_COUNT.
 
 // TODO: put the decreased lock delay inside levels?
 typedef struct {
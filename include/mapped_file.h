@@ -0,0 +1,29 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+// A file mapped read only. The page cache holds the bytes, so files larger than RAM work and several processes share one copy.
+typedef struct {
+    const uint8_t* data;    // 0 for an empty file.
+    size_t size;
+#if defined(_WIN32)
+    void* file;
+    void* mapping;
+#endif // _WIN32
+} MappedFile;
+
+bool    map_file(const char* path, bool is_sequential, MappedFile* out_file);  // is_sequential hints that it is read front to back once, instead of at random.
+void    unmap_file(MappedFile* file);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // MAPPED_FILE_H
@@ -0,0 +1,59 @@
+#ifndef MCTS_H
+#define MCTS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "allocator.h"
+#include "clock.h"
+#include "game.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+#define MCTS_MAX_TREE_DEPTH             PIECE_PREVIEW_COUNT         // Deepest ply whose piece (and the one hold would bring out) is still in the preview.
+#define MCTS_DEFAULT_TIME_BUDGET        (8 * NANOSECONDS_PER_MILLISECOND)
+#define MCTS_DEFAULT_THREAD_COUNT       4
+#define MCTS_DEFAULT_NODE_CAPACITY      (1 << 18)
+#define MCTS_DEFAULT_ROLLOUT_DEPTH      8
+#define MCTS_DEFAULT_EXPLORATION        0.5f
+#define MCTS_DEFAULT_VIRTUAL_LOSS       3
+#define MCTS_DEFAULT_ROLLOUT_EPSILON    0.1f
+#define MCTS_DEFAULT_MAX_CHILDREN       8
+
+typedef struct {
+    uint64_t time_budget;       // Nanoseconds per search.
+    uint32_t max_rollouts;      // Stop early after this many rollouts, 0 for no limit.
+    uint32_t node_capacity;     // Size of the node pool. Expansion stops (and leaves keep rolling out) once it is used up.
+    float exploration;          // UCT constant, applied to values normalized to [0, 1] by the range seen this search.
+    float rollout_epsilon;      // Chance a rollout picks a random placement instead of the greedy one.
+    uint8_t rollout_depth;      // Pieces played past the tree by the rollout policy.
+    uint8_t max_children;       // Placements kept per node, the best by the rollout policy's evaluation.
+    uint8_t thread_count;       // Including the calling thread.
+    uint8_t virtual_loss;       // Visits added to a node while a thread is below it, so threads spread out.
+    bool use_huge_pages;        // For the node pool, about 10 MiB at the default capacity. See allocator.h.
+} MctsSettings;
+
+typedef struct {
+    uint64_t elapsed;           // Nanoseconds
+    uint32_t rollouts;
+    uint32_t reused_visits;     // Root visits carried over from the previous search.
+    uint32_t tree_node_count;
+    double rollouts_per_second;
+} MctsSearchStats;
+
+typedef struct Mcts Mcts;       // Opaque: owns the node pool, the tree and the thread pool.
+
+MctsSettings    get_default_mcts_settings();
+Mcts*           create_mcts(MctsSettings settings);                                                                     // Everything the search needs is allocated here, never during a search.
+void            destroy_mcts(Mcts* mcts);
+bool            search_mcts_placement(Mcts* mcts, const Game* game, Placement* out_placement, MctsSearchStats* optional_out_stats); // False if no placement is possible.
+void            advance_mcts(Mcts* mcts, Placement played);                                                            // Keeps the subtree under played for the next search and returns the rest to the pool.
+AllocatorStats  get_mcts_node_stats(const Mcts* mcts);                                                                  // Between searches.
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // MCTS_H
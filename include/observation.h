@@ -0,0 +1,46 @@
+#ifndef OBSERVATION_H
+#define OBSERVATION_H
+
+#include <stdint.h>
+
+#include "env.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+#define OBSERVATION_PLANE_BIT_FLAGS     uint8_t
+#define OBSERVATION_PLANE_BOARD         0b00000001      // Locked cells.
+#define OBSERVATION_PLANE_ACTIVE        0b00000010      // Controlled piece at its current position.
+#define OBSERVATION_PLANE_GHOST         0b00000100      // Controlled piece at its hard drop position.
+#define OBSERVATION_PLANES_ALL          0b00000111
+
+#define OBSERVATION_PLANE_COUNT         3
+#define OBSERVATION_PLANE_HEIGHT        ENV_OBSERVATION_ROW_COUNT
+#define OBSERVATION_PLANE_WIDTH         DEFAULT_COLUMN_COUNT
+#define OBSERVATION_PLANE_CELL_COUNT    (OBSERVATION_PLANE_HEIGHT * OBSERVATION_PLANE_WIDTH)
+
+#define OBSERVATION_PIECE_SLOT_COUNT    (1 + PIECE_PREVIEW_COUNT)                   // Held piece first, then the queue nearest first.
+#define OBSERVATION_ONE_HOT_SIZE        (OBSERVATION_PIECE_SLOT_COUNT * PIECE_COUNT) // An empty slot (nothing held) is all zeros.
+
+typedef enum {
+    OBSERVATION_LAYOUT_NCHW,
+    OBSERVATION_LAYOUT_NHWC
+} ObservationLayout;
+
+typedef enum {
+    OBSERVATION_DTYPE_UINT8,
+    OBSERVATION_DTYPE_FLOAT32
+} ObservationDType;
+
+// Expands the bitrows of n observations into planes of 0/1, written straight into out.
+// Channels are the set bits of plane_bit_flags in the order board, active, ghost. out must hold n * channels * OBSERVATION_PLANE_CELL_COUNT elements of dtype.
+ZETRIS_API void encode_observation_planes(const EnvObservation* obs, uint32_t n, OBSERVATION_PLANE_BIT_FLAGS plane_bit_flags, ObservationLayout layout, ObservationDType dtype, void* out);
+// Writes the held piece and the queue as one-hot vectors. out must hold n * OBSERVATION_ONE_HOT_SIZE elements of dtype.
+ZETRIS_API void encode_observation_one_hot(const EnvObservation* obs, uint32_t n, ObservationDType dtype, void* out);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // OBSERVATION_H
@@ -0,0 +1,74 @@
+#ifndef OPENING_BOOK_H
+#define OPENING_BOOK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "game.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+/**
+    Placements searched ahead of time for the first pieces of a game, where the board is nearly empty and the same positions come
+    up in every game. A position is keyed by everything the bot's search reads: the board, the controlled and held pieces, the
+    visible queue, whether hold is allowed and the combo. The file is an open addressed hash table used straight from the mapping,
+    so opening one reads the header and nothing else, and a lookup is a hash of the position and usually one cache line.
+    Layout, every integer little endian.
+    Header
+    0   4   magic "ZBOK"
+    4   2   version
+    6   1   bits per PlayfieldRow of the build that made it, since the key hashes rows as they are
+    7   1   plies, placements searched from the start of each game
+    8   4   slot_count, a power of two
+    12  4   entry_count
+    16  2   beam width of the searches
+    18  1   depth of the searches
+    19  13  reserved, zero
+    32      slots, slot_count of them
+    Slot
+    0   8   key, 0 for an empty slot
+    8   1   PieceType
+    9   1   pos_x
+    10  1   pos_y
+    11  1   rotation
+    12  1   use_hold
+    13  1   plies the search completed
+    14  2   reserved, zero
+    A key sits in slot key % slot_count or the next empty one after it, wrapping around.
+*/
+#define OPENING_BOOK_MAGIC          "ZBOK"
+#define OPENING_BOOK_VERSION        1
+#define OPENING_BOOK_HEADER_SIZE    32
+#define OPENING_BOOK_SLOT_SIZE      16
+#define OPENING_BOOK_MAX_PLIES      PIECE_COUNT     // The first bag. Past it the visible queue reaches into the third bag.
+
+typedef struct {
+    uint64_t key;
+    Placement placement;
+    uint8_t completed_depth;
+} OpeningBookEntry;
+
+typedef struct {
+    uint32_t slot_count;
+    uint32_t entry_count;
+    uint16_t beam_width;
+    uint8_t depth;
+    uint8_t plies;
+} OpeningBookInfo;
+
+typedef struct OpeningBook OpeningBook;    // Opaque: a mapped book file.
+
+uint64_t        get_opening_book_key(const Game* game);                                     // Never 0.
+bool            write_opening_book(const char* path, const OpeningBookEntry* entries, uint32_t entry_count, uint8_t plies, uint16_t beam_width, uint8_t depth); // Keys have to be unique. The table is kept at most half full.
+OpeningBook*    open_opening_book(const char* path);                                        // 0 if the file is missing, or its header doesn't check out or is from a build with other rows.
+void            close_opening_book(OpeningBook* book);
+OpeningBookInfo get_opening_book_info(const OpeningBook* book);
+bool            find_opening_book_placement(const OpeningBook* book, const Game* game, Placement* out_placement, uint8_t* optional_out_completed_depth); // Thread safe, the book is never written.
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // OPENING_BOOK_H
@@ -0,0 +1,75 @@
+#ifndef PERFECT_CLEAR_H
+#define PERFECT_CLEAR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "clock.h"
+#include "game.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+/**
+    Finds placements that empty the board (a perfect clear) with the pieces the game shows, or proves there are none.
+    The bottom lines the clear is over are packed into one 64 bit word, a bit per cell, so a position is a word and its line
+    clears, checks and memo key are a few shifts and popcounts. Pieces move the way tick moves them: sliding, soft dropping to the
+    ground and rotating with the SRS kicks (WALL_KICKS_TSZJL, WALL_KICKS_I), so tucks and spins count.
+    A position is given up on without trying its pieces when:
+        - the known pieces run out before the empty cells do,
+        - a filled column walls off empty cells that aren't a multiple of 4,
+        - the empty cells in even and odd columns differ by more than the pieces can make up. I changes the difference by 0 or
+          4, T by 0 or 2, J and L always by 2, the rest not at all. Line clears take a row of each, so they never change it.
+    Positions with no clear are remembered by their packed word, which is exact, so a proof of none is a proof.
+    The placements of the first piece are shared out between threads, and the first of them with a clear wins whatever the thread
+    count, so the answer is always the same.
+*/
+#define PERFECT_CLEAR_MAX_CELLS             56                      // Height times columns. Leaves the memo key room for the height and the held piece.
+#define PERFECT_CLEAR_MAX_HEIGHT            6
+#define PERFECT_CLEAR_MAX_PIECES            (2 + PIECE_COUNT)       // Held, controlled, and the queue peek_piece_queue can see.
+#define PERFECT_CLEAR_DEFAULT_TIME_BUDGET   (50 * NANOSECONDS_PER_MILLISECOND)
+#define PERFECT_CLEAR_DEFAULT_THREAD_COUNT  4
+#define PERFECT_CLEAR_DEFAULT_MEMO_SIZE     (1 << 16)               // Entries, 8 bytes each. A power of two.
+
+typedef enum {
+    PERFECT_CLEAR_FOUND,
+    PERFECT_CLEAR_IMPOSSIBLE,   // Not within max_pieces and max_height, with the pieces in view.
+    PERFECT_CLEAR_TIMED_OUT     // Or cancelled. Nothing was found, nor proven.
+} PerfectClearStatus;
+
+typedef struct {
+    uint64_t time_budget;       // Nanoseconds per solve.
+    uint32_t memo_size;         // Positions with no clear remembered, lossy. Cleared for every height tried, so kept small.
+    uint8_t max_pieces;         // At most PERFECT_CLEAR_MAX_PIECES.
+    uint8_t max_height;         // Lines, at most PERFECT_CLEAR_MAX_HEIGHT. Lower ones are tried first.
+    uint8_t queue_length;       // Pieces of the queue used, at most PIECE_COUNT. PIECE_PREVIEW_COUNT for what a player sees.
+    uint8_t thread_count;       // Including the calling thread.
+} PerfectClearSettings;
+
+typedef struct {
+    Placement placements[PERFECT_CLEAR_MAX_PIECES]; // In order, each for the game as the ones before it left it. Apply with attempt_apply_placement.
+    uint8_t placement_count;
+    uint8_t height;             // Lines cleared, including the ones already on the board.
+} PerfectClearSolution;
+
+typedef struct {
+    uint64_t elapsed;           // Nanoseconds
+    uint64_t visited_nodes;
+    uint64_t pruned_nodes;      // Given up on by the checks above.
+    uint64_t memo_hits;
+} PerfectClearStats;
+
+typedef struct PerfectClearSolver PerfectClearSolver; // Opaque: owns the memo, per thread scratch and the thread pool.
+
+PerfectClearSettings    get_default_perfect_clear_settings();
+PerfectClearSolver*     create_perfect_clear_solver(PerfectClearSettings settings);         // Everything a solve needs is allocated here, never during one.
+void                    destroy_perfect_clear_solver(PerfectClearSolver* solver);
+PerfectClearStatus      solve_perfect_clear(PerfectClearSolver* solver, const Game* game, PerfectClearSolution* out_solution, PerfectClearStats* optional_out_stats); // out_solution is only written when one is found.
+void                    cancel_perfect_clear_search(PerfectClearSolver* solver);           // Safe from any thread. A solve that starts after this is not cancelled.
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // PERFECT_CLEAR_H
@@ -81,8 +81,10 @@ extern const PieceData Z_DATA;
 extern const PieceData J_DATA;
 extern const PieceData L_DATA;
 extern const PieceData* ALL_PIECE_DATA[PIECE_COUNT];
+extern const PieceCells PIECE_ROTATION_CELLS[PIECE_COUNT + 1][PIECE_ROTATION_STATES]; // Indexed by PieceType (0 is empty) and rotation. Same as rotating the PieceData cells clockwise that many times.
 
 const PieceData* get_piece_data(PieceType piece_type);
+uint8_t          get_piece_unique_rotation_count(PieceType piece_type); // Rotations that cover different cells once dropped: O has 1, I, S and Z have 2, the rest 4.
 
 typedef struct {                                        // Piece entity (container for data, transform, and lock components)
     const PieceRotationWallKicks* rotation_wall_kicks;  // 4-8 bytes
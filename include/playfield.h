@@ -14,14 +14,25 @@ extern "C" {
 #define DEFAULT_CEILING             4
 // Limits
 #define COLUMN_OFFSET               2
+#ifdef ZETRIS_WIDE_ROWS
+// Big boards (the ZETRIS_WIDE_ROWS CMake option). Collision works on 64 bit masks with COLUMN_OFFSET wall bits on either side.
+#define MAX_ROW_COUNT               64
+#define MAX_COLUMN_COUNT            (64 - 2 * COLUMN_OFFSET)
+typedef uint64_t PlayfieldRow;
+#else
 #define MAX_ROW_COUNT               32
 #define MAX_COLUMN_COUNT            32
+typedef uint32_t PlayfieldRow;      // Bit x is column x (no COLUMN_OFFSET).
+#endif // ZETRIS_WIDE_ROWS
+#define CELL_TYPE_PLANE_COUNT       3   // Bits per cell type, enough for every PieceType.
 
-typedef uint32_t PlayfieldCells[MAX_ROW_COUNT];
+typedef PlayfieldRow PlayfieldCells[MAX_ROW_COUNT];
 
 // Contains the locked/static cells in the playfield, as well as some "boundaries."
+// Collision only ever reads cells. The type of each locked cell is kept bit sliced across type_planes, for renderers.
 typedef struct {
-    PlayfieldCells cells;       // 4 * MAX_ROW_COLUMN_COUNT bytes
+    PlayfieldCells cells;                               // sizeof(PlayfieldRow) * MAX_ROW_COUNT bytes
+    PlayfieldCells type_planes[CELL_TYPE_PLANE_COUNT];  // sizeof(PlayfieldRow) * MAX_ROW_COUNT * CELL_TYPE_PLANE_COUNT bytes. Bit i of a cell's type is in type_planes[i].
     uint32_t lines_cleared;     // 4 bytes
     uint8_t row_count;          // 1 byte
     uint8_t column_count;       // 1 byte
@@ -31,8 +42,13 @@ typedef struct {
 bool    is_outside_bounds(const Playfield* playfield, const uint8_t, const uint8_t pos_y);                    // If position is outside bounds.
 bool    is_playfield_cell(const Playfield* playfield, const uint8_t pos_x, const uint8_t pos_y);              // Checks if cell or empty.
 bool    are_cells_above_ceiling(const Playfield* playfield);                                      // Determines if cells in the playfield are above the ceiling.
-bool    attempt_add_playfield_cell_at(Playfield* playfield, uint8_t pos_x, uint8_t pos_y);  // Write bit (cell) in playfield
+bool    attempt_add_playfield_cell_at(Playfield* playfield, uint8_t pos_x, uint8_t pos_y, uint8_t cell_type);  // Write bit (cell) in playfield
+void    set_playfield_row_cell_types(Playfield* playfield, uint8_t pos_y, PlayfieldRow row_mask, uint8_t cell_type); // Sets the type of every cell of row pos_y in row_mask (playfield bits, no COLUMN_OFFSET).
+uint8_t get_playfield_cell_type(const Playfield* playfield, uint8_t pos_x, uint8_t pos_y);  // 0 if empty, outside bounds, or not from a piece (garbage).
+PlayfieldRow get_playfield_full_row(const Playfield* playfield);                             // Every column set, what a filled line looks like.
 uint8_t clear_filled_lines(Playfield* playfield, uint8_t bottom_offset);                    // Starts from bottom and moves up to clear rows. Returns the number of rows it cleared for given playfield.
+uint8_t clear_filled_piece_rows(Playfield* playfield, uint8_t pos_y, uint8_t size);       // The same when only rows pos_y to pos_y + size can have filled, the rows of a piece that just locked, on a board a game reached (no empty row under the stack).
+float   evaluate_playfield_rows(const PlayfieldRow* rows, uint8_t top_row, uint8_t row_count, uint8_t column_count); // Greedy board value of row masks (no COLUMN_OFFSET) from top_row down: -0.51 aggregate height, -0.36 holes, -0.18 bumpiness.
 
 #ifdef __cplusplus
 }
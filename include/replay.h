@@ -0,0 +1,99 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "game.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+/**
+    Replay layout, every integer little endian. Replays can be concatenated back to back, the header says how long each one is.
+    0   4   magic "ZRPL"
+    4   2   version
+    6   1   setting_bit_flags
+    7   1   tick_rate, ticks per second. Every tick is exactly 1 / tick_rate long.
+    8   8   seed for get_seeded_initialized_game
+    16  4   tick_count
+    20  4   checkpoint_interval, ticks between state hashes.
+    24  8   claimed score
+    32  4   claimed lines_cleared
+    36  1   claimed level_index
+    37  3   reserved, zero
+    40  4   handling.das, float bits
+    44  4   handling.arr, float bits
+    48  4   handling.soft_drop_factor, float bits
+    52  4   reserved, zero
+    56      ACTION_BIT_FLAGS for every tick, one byte each.
+    ...     8 byte state hash after every checkpoint_interval ticks, tick_count / checkpoint_interval of them.
+*/
+#define REPLAY_MAGIC                        "ZRPL"
+#define REPLAY_VERSION                      2       // 2 added handling.
+#define REPLAY_HEADER_SIZE                  56
+#define REPLAY_DEFAULT_TICK_RATE            60
+#define REPLAY_DEFAULT_CHECKPOINT_INTERVAL  60                  // One hash a second, so a divergence is pinned to within a second.
+#define REPLAY_MAX_TICK_COUNT               (24 * 60 * 60 * 60) // A day at 60 ticks a second. Anything longer is treated as garbage.
+
+typedef struct {
+    uint64_t seed;
+    uint64_t score;
+    Handling handling;
+    uint32_t tick_count;
+    uint32_t checkpoint_interval;
+    uint32_t lines_cleared;
+    uint8_t level_index;
+    uint8_t tick_rate;
+    SETTING_BIT_FLAGS setting_bit_flags;
+} ReplayHeader;
+
+typedef enum {
+    REPLAY_VALID,
+    REPLAY_BAD_HEADER,
+    REPLAY_TRUNCATED,               // Header says more bytes than there are.
+    REPLAY_CHECKPOINT_MISMATCH,     // A state hash differs. divergence_tick is that checkpoint, the previous one still matched.
+    REPLAY_ENDED_EARLY,             // Game over before the log ran out.
+    REPLAY_RESULT_MISMATCH          // Every checkpoint matched, but the claimed score, lines or level didn't.
+} ReplayVerdict;
+
+typedef struct {
+    ReplayVerdict verdict;
+    uint32_t divergence_tick;       // Tick the problem was found on.
+    uint32_t simulated_ticks;
+    uint64_t score;                 // What the simulation ended with.
+    uint32_t lines_cleared;
+    uint8_t level_index;
+} ReplayVerification;
+
+// Records a game played with fixed length ticks. The action log grows as needed, everything else is fixed size.
+typedef struct {
+    Game game;
+    ReplayHeader header;
+    double delta_time;
+    uint8_t* actions;
+    uint64_t* checkpoints;
+    uint32_t action_capacity;
+} ReplayRecorder;
+
+uint64_t            hash_game_state(const Game* game);                                     // Everything tick decides from the inputs, floats left out so the hash doesn't depend on how a compiler rounds.
+Game                get_replay_initialized_game(const ReplayHeader* header);
+const char*         get_replay_verdict_name(ReplayVerdict verdict);
+
+bool                begin_replay_recording(ReplayRecorder* recorder, uint64_t seed, SETTING_BIT_FLAGS setting_bit_flags, Handling handling, uint8_t tick_rate);
+bool                tick_replay_recording(ReplayRecorder* recorder, ACTION_BIT_FLAGS action_bit_flags); // Ticks recorder->game and logs it. False once the game is over, out of memory, or at REPLAY_MAX_TICK_COUNT.
+size_t              get_replay_size(const ReplayHeader* header);
+bool                write_replay(const ReplayRecorder* recorder, FILE* file);
+void                end_replay_recording(ReplayRecorder* recorder);
+
+bool                read_replay_header(const uint8_t* data, size_t size, ReplayHeader* out_header); // Checks magic, version and limits (handling within is_handling_valid), not that the body is all there.
+ReplayVerification  verify_replay(const uint8_t* data, size_t size);                        // Re-simulates through tick and compares every checkpoint, then the claimed results.
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // REPLAY_H
@@ -0,0 +1,43 @@
+#ifndef REWIND_H
+#define REWIND_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "game.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+#define REWIND_DEFAULT_KEYFRAME_INTERVAL    16                      // Pieces between full copies of the game. Restores replay at most this many board deltas.
+#define REWIND_DEFAULT_TICK_CAPACITY        (10 * 60 * 60)          // Ten minutes at 60 ticks a second.
+#define REWIND_DEFAULT_DELTA_CAPACITY       8192                    // Ten minutes at over thirteen pieces a second, faster than the bot plays.
+#define REWIND_DEFAULT_ROW_CAPACITY         (REWIND_DEFAULT_DELTA_CAPACITY * 8)
+
+typedef struct {
+    uint32_t keyframe_interval;
+    uint32_t tick_capacity;     // Ticks kept. Older ones are overwritten, so memory never grows.
+    uint32_t delta_capacity;    // Board deltas kept (one per lock, plus holds that refill a bag).
+    uint32_t row_capacity;      // Changed rows kept across all board deltas.
+} RewindSettings;
+
+typedef struct RewindRing RewindRing;   // Opaque: every buffer is allocated once in create_rewind_ring.
+
+RewindSettings  get_default_rewind_settings();
+RewindRing*     create_rewind_ring(RewindSettings settings);
+void            destroy_rewind_ring(RewindRing* ring);
+size_t          get_rewind_ring_memory_size(const RewindRing* ring);                       // Bytes allocated, which is all it will ever use.
+void            clear_rewind_ring(RewindRing* ring);
+uint32_t        record_rewind_tick(RewindRing* ring, const Game* game);                    // Call after every tick. Returns the index of the recorded tick. A game that was reset clears the ring first.
+bool            get_rewind_tick_range(const RewindRing* ring, uint32_t* out_oldest, uint32_t* out_newest); // Ticks that can still be restored. False if nothing is recorded.
+bool            restore_rewind_tick(const RewindRing* ring, uint32_t tick_index, Game* out_game);
+bool            find_rewind_piece_tick(const RewindRing* ring, uint32_t placed_piece_count, uint32_t* out_tick_index); // First tick where Game.placed_piece_count had this value, so the piece after it had just spawned.
+void            truncate_rewind_ring(RewindRing* ring, uint32_t tick_index);              // Forgets everything recorded after tick_index, so play can go on from a restored tick.
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // REWIND_H
@@ -0,0 +1,88 @@
+#ifndef ROLLBACK_H
+#define ROLLBACK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "versus.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+#define ROLLBACK_TICK_DELTA_TIME        (1.0 / 60.0)    // Fixed, so both sides simulate the same ticks from the same inputs.
+#define ROLLBACK_MAX_FRAMES             16              // Frames a side may run ahead of the last remote input it has. Past this it stalls.
+#define ROLLBACK_MAX_INPUT_DELAY        8
+#define ROLLBACK_DEFAULT_INPUT_DELAY    2               // Frames before a local input takes effect, which hides that much latency without rolling back.
+#define ROLLBACK_INPUT_RING_SIZE        32              // Covers ROLLBACK_MAX_FRAMES plus ROLLBACK_MAX_INPUT_DELAY. A power of two.
+#define ROLLBACK_MAX_PACKET_INPUTS      ROLLBACK_INPUT_RING_SIZE
+#define LOOPBACK_CAPACITY               256             // Packets in flight.
+
+// Every local input the remote hasn't acknowledged, each time, so a lost packet is covered by the next one.
+typedef struct {
+    uint32_t first_frame;                               // Frame of inputs[0].
+    uint32_t ack_frame;                                 // The sender has every input of the receiver before this frame.
+    uint8_t input_count;
+    ACTION_BIT_FLAGS inputs[ROLLBACK_MAX_PACKET_INPUTS];
+} RollbackPacket;
+
+typedef struct {
+    uint64_t frame_count;
+    uint64_t rollback_count;
+    uint64_t resimulated_frame_count;
+    uint64_t misprediction_count;                       // Remote inputs that turned out different from what was simulated.
+    uint64_t stall_count;                               // advance calls that held back: too far ahead of the remote, or no local input yet.
+    uint32_t max_rollback_frames;
+} RollbackStats;
+
+// One side of a match. The match is copied whole before every frame (about 1.6 KiB), and a rollback is a copy back and stepping
+// forward again, so resimulating ROLLBACK_MAX_FRAMES costs as many versus steps. Fixed size, nothing allocates.
+typedef struct {
+    VersusMatch match;                                  // At the start of frame.
+    VersusMatch saved[ROLLBACK_MAX_FRAMES];             // saved[f % ROLLBACK_MAX_FRAMES] is the match at the start of frame f.
+    ACTION_BIT_FLAGS inputs[VERSUS_PLAYER_COUNT][ROLLBACK_INPUT_RING_SIZE]; // By frame % ROLLBACK_INPUT_RING_SIZE. Remote ones are predictions until received.
+    uint32_t received_frames[ROLLBACK_INPUT_RING_SIZE]; // Frame + 1 of the remote input held in that slot, 0 if none arrived.
+    uint32_t frame;                                     // Next frame to simulate.
+    uint32_t local_frame;                               // Next frame a local input goes to. frame + input_delay once running.
+    uint32_t confirmed_frame;                           // Every remote input before this has arrived.
+    uint32_t acked_frame;                               // The remote has every local input before this.
+    uint32_t rollback_frame;                            // Earliest frame simulated with a wrong prediction, or UINT32_MAX.
+    uint8_t local_player;
+    uint8_t input_delay;
+    RollbackStats stats;
+} RollbackSession;
+
+void    init_rollback_session(RollbackSession* session, uint64_t seed, uint8_t local_player, uint8_t input_delay); // Both sides pass the same seed.
+void    add_rollback_local_input(RollbackSession* session, ACTION_BIT_FLAGS action_bit_flags);   // Once per advanced frame, before advance_rollback_frame. It takes effect input_delay frames later.
+void    write_rollback_packet(const RollbackSession* session, RollbackPacket* out_packet);
+void    receive_rollback_packet(RollbackSession* session, const RollbackPacket* packet);        // Any order, duplicates and stale packets are fine.
+bool    advance_rollback_frame(RollbackSession* session);                                       // Rolls back and resimulates if a prediction was wrong, then steps one frame. False if it stalled.
+bool    settle_rollback_session(RollbackSession* session);                                      // Rolls back and resimulates without stepping. True if it had to.
+
+// A fake network between two sessions in one process: latency, jitter (which reorders packets) and loss, from a seed.
+typedef struct {
+    RollbackPacket packet;
+    uint64_t deliver_time;                              // Microseconds.
+    uint8_t to_player;
+} LoopbackPacket;
+
+typedef struct {
+    LoopbackPacket packets[LOOPBACK_CAPACITY];
+    uint32_t count;
+    uint32_t latency;                                   // One way, microseconds.
+    uint32_t jitter;                                    // Up to this much more, microseconds.
+    uint8_t loss_percent;
+    uint64_t random_state;
+    uint64_t sent_count;
+    uint64_t dropped_count;
+} LoopbackLink;
+
+void    init_loopback_link(LoopbackLink* link, uint64_t seed, uint32_t latency, uint32_t jitter, uint8_t loss_percent);
+void    send_loopback_packet(LoopbackLink* link, uint8_t to_player, const RollbackPacket* packet, uint64_t now); // Dropped if lost or the link is full.
+bool    receive_loopback_packet(LoopbackLink* link, uint8_t player, uint64_t now, RollbackPacket* out_packet);  // The next packet for player due by now.
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // ROLLBACK_H
@@ -0,0 +1,54 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+/**
+    A timeline of what every thread was doing, for frame hitches that counters average away. Every thread that records gets its
+    own ring of the last TRACE_RING_SIZE events, so recording takes no lock and the rings always hold the latest stretch of time.
+    Written out as Chrome trace_event JSON: open it in chrome://tracing or https://ui.perfetto.dev.
+    Off, a trace point is a relaxed load and a branch, so they stay compiled in. On, one costs a clock read and three stores.
+    Names must outlive the trace, in practice string literals, and are written out as they are.
+*/
+#define TRACE_RING_SIZE             8192            // Events per thread, 24 bytes each. A power of two.
+#define TRACE_ENVIRONMENT_VARIABLE  "ZETRIS_TRACE"  // A path to trace to, see install_trace_dumps.
+
+typedef enum {
+    TRACE_PHASE_BEGIN = 'B',
+    TRACE_PHASE_END = 'E',
+    TRACE_PHASE_INSTANT = 'i'
+} TracePhase;
+
+extern atomic_bool trace_enabled;
+
+static inline bool is_trace_enabled(void) {
+    return atomic_load_explicit(&trace_enabled, memory_order_relaxed);
+}
+
+#define TRACE_BEGIN(name)   do { if (is_trace_enabled()) record_trace_event(name, TRACE_PHASE_BEGIN); } while (0)
+#define TRACE_END(name)     do { if (is_trace_enabled()) record_trace_event(name, TRACE_PHASE_END); } while (0)
+#define TRACE_INSTANT(name) do { if (is_trace_enabled()) record_trace_event(name, TRACE_PHASE_INSTANT); } while (0)
+
+void    record_trace_event(const char* name, TracePhase phase);    // Use the macros, which skip this while tracing is off.
+void    set_trace_enabled(bool is_enabled);                         // From any thread. Rings keep what they have while off.
+void    set_trace_thread_name(const char* name);                    // Names the calling thread's track.
+bool    write_trace(const char* path);                              // Every ring as it is now. Threads can keep recording meanwhile.
+
+// For leaving it in a build people play. The trace goes to ZETRIS_TRACE if it is set, which also turns tracing on, else to
+// optional_default_path (0 for nowhere). It is written at exit if anything was recorded, and whenever SIGUSR1 arrives (Ctrl+Break
+// on Windows) or request_trace_dump is called, at the next poll_trace_dump. True if ZETRIS_TRACE turned tracing on.
+bool    install_trace_dumps(const char* optional_default_path);
+void    request_trace_dump(void);                                   // Safe in a signal handler.
+bool    poll_trace_dump(void);                                      // Writes the trace if a dump was requested. Once a frame or a work item, from any thread. True if it wrote.
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // TRACE_H
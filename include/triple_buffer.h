@@ -0,0 +1,54 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+#define TRIPLE_BUFFER_FRESH 4   // Set on the middle index when the writer published and the reader hasn't taken it yet.
+
+/**
+    One writer, one reader, newest value wins. The slots themselves are the user's, three of anything indexed by back and front.
+    The writer fills its back slot and swaps it with the middle one, the reader swaps its front slot with the middle one when
+    something fresh is there. Each side only ever touches its own slot, and the swaps are single atomic exchanges, so neither
+    side waits for the other.
+*/
+typedef struct {
+    atomic_uint middle;
+    uint8_t back;       // Writer's.
+    uint8_t front;      // Reader's.
+} TripleBuffer;
+
+static inline void init_triple_buffer(TripleBuffer* buffer)
+{
+    buffer->back = 0;
+    atomic_init(&buffer->middle, 1);
+    buffer->front = 2;
+}
+
+static inline void publish_triple_buffer(TripleBuffer* buffer)
+{
+    buffer->back = atomic_exchange_explicit(&buffer->middle, buffer->back | TRIPLE_BUFFER_FRESH, memory_order_acq_rel) & ~TRIPLE_BUFFER_FRESH;
+}
+
+static inline bool is_triple_buffer_fresh(TripleBuffer* buffer)
+{
+    return atomic_load_explicit(&buffer->middle, memory_order_acquire) & TRIPLE_BUFFER_FRESH;
+}
+
+static inline bool acquire_triple_buffer(TripleBuffer* buffer)
+{
+    if (!is_triple_buffer_fresh(buffer)) return false;
+    buffer->front = atomic_exchange_explicit(&buffer->middle, buffer->front, memory_order_acq_rel) & ~TRIPLE_BUFFER_FRESH;
+    return true;
+}
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // TRIPLE_BUFFER_H
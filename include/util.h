@@ -5,25 +5,115 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+#include "playfield.h"
+
+// Bit counting helpers for the bitboard code. Results are undefined for 0 where noted, same as the builtins.
+static inline uint8_t count_set_bits(uint32_t value) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    return (uint8_t)__popcnt(value);
+#elif defined(__POPCNT__) || defined(__ARM_NEON)
+    return (uint8_t)__builtin_popcount(value);
+#else
+    // Without a popcount instruction the builtin becomes a library call, this is quicker: https://graphics.stanford.edu/~seander/bithacks.html#CountBitsSetParallel
+    value = value - ((value >> 1) & 0x55555555U);
+    value = (value & 0x33333333U) + ((value >> 2) & 0x33333333U);
+    return (uint8_t)((((value + (value >> 4)) & 0x0F0F0F0FU) * 0x01010101U) >> 24);
+#endif
+}
+
+static inline uint8_t count_set_bits_64(uint64_t value) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    return (uint8_t)__popcnt64(value);
+#elif defined(__POPCNT__) || defined(__ARM_NEON)
+    return (uint8_t)__builtin_popcountll(value);
+#else
+    value = value - ((value >> 1) & 0x5555555555555555ULL);
+    value = (value & 0x3333333333333333ULL) + ((value >> 2) & 0x3333333333333333ULL);
+    return (uint8_t)((((value + (value >> 4)) & 0x0F0F0F0F0F0F0F0FULL) * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+static inline uint8_t count_trailing_zeros(uint32_t value) { // Undefined for 0.
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward(&index, value);
+    return (uint8_t)index;
+#else
+    return (uint8_t)__builtin_ctz(value);
+#endif
+}
+
+static inline uint8_t count_trailing_zeros_64(uint64_t value) { // Undefined for 0.
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return (uint8_t)index;
+#else
+    return (uint8_t)__builtin_ctzll(value);
+#endif
+}
+
+static inline uint8_t count_leading_zeros_64(uint64_t value) { // Undefined for 0.
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return (uint8_t)(63 - index);
+#else
+    return (uint8_t)__builtin_clzll(value);
+#endif
+}
+
+// The same for a PlayfieldRow, at whatever width the build gave it.
+static inline uint8_t count_row_set_bits(PlayfieldRow row) {
+#ifdef ZETRIS_WIDE_ROWS
+    return count_set_bits_64(row);
+#else
+    return count_set_bits(row);
+#endif
+}
+
+static inline uint8_t count_row_trailing_zeros(PlayfieldRow row) { // Undefined for 0.
+#ifdef ZETRIS_WIDE_ROWS
+    return count_trailing_zeros_64(row);
+#else
+    return count_trailing_zeros(row);
+#endif
+}
+
+// SplitMix64: https://prng.di.unimi.it/splitmix64.c
+// Small, fast, and a single 64 bit word of state, so every Game can carry its own generator and be replayed from a seed.
+static inline uint64_t next_random(uint64_t* state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
 // This is not my code: https://stackoverflow.com/questions/6127503/shuffle-array-in-c
-// TODO: malloc really is not necessary since I am always using this for the same reason.
-static inline void shuffle(void *array, size_t n, size_t size) {
-    char* tmp = malloc(size * sizeof(char)); // This had to change as the source I believe was using 
+// Swaps through a small stack buffer instead of a malloc'd one, since this runs every bag refill, env_step included.
+static inline void shuffle(void *array, size_t n, size_t size, uint64_t* random_state) {
+    char tmp[16];
     char *arr = array;
     size_t stride = size * sizeof(char);
 
     if (n > 1) {
         size_t i;
         for (i = 0; i < n - 1; ++i) {
-            size_t rnd = (size_t) rand();
-            size_t j = i + rnd / (RAND_MAX / (n - i) + 1);
+            size_t j = i + (size_t)(next_random(random_state) % (n - i)); // Was rand(), but that is shared by every game in the process.
+            if (j == i) continue; // memcpy onto itself is undefined.
 
-            memcpy(tmp, arr + j * stride, size);
-            memcpy(arr + j * stride, arr + i * stride, size);
-            memcpy(arr + i * stride, tmp, size);
+            for (size_t k = 0; k < size; k += sizeof(tmp)) {
+                const size_t chunk = (size - k < sizeof(tmp)) ? size - k : sizeof(tmp);
+                memcpy(tmp, arr + j * stride + k, chunk);
+                memcpy(arr + j * stride + k, arr + i * stride + k, chunk);
+                memcpy(arr + i * stride + k, tmp, chunk);
+            }
         }
     }
-    free(tmp); // Of course need to free memory
 }
 
 #endif //UTIL_H
@@ -0,0 +1,65 @@
+#ifndef VERSUS_H
+#define VERSUS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "game.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+#define VERSUS_PLAYER_COUNT             2
+#define VERSUS_NO_WINNER                0xFF    // Still running, or both players topped out on the same step.
+#define GARBAGE_QUEUE_CAPACITY          16      // Attacks waiting to land. Past this, new ones merge into the newest.
+#define GARBAGE_MAX_LINES_PER_PIECE     8       // Most garbage rows inserted after one piece. The rest keeps waiting.
+#define GARBAGE_PERFECT_CLEAR_BONUS     10
+
+// One attack: lines rows, all with the hole in the same column.
+typedef struct {
+    uint8_t lines;
+    uint8_t hole_x;     // Playfield column, no COLUMN_OFFSET.
+} GarbageBatch;
+
+// Fixed size ring, so sending, cancelling and inserting never allocate.
+typedef struct {
+    GarbageBatch batches[GARBAGE_QUEUE_CAPACITY];
+    uint16_t pending_lines;
+    uint8_t head;
+    uint8_t count;
+} GarbageQueue;
+
+typedef struct {
+    Game game;
+    GarbageQueue incoming;
+    uint32_t last_placed_piece_count;   // To notice a lock after a tick.
+    uint32_t last_lines_cleared;
+    uint32_t lines_sent;
+    uint32_t lines_received;            // Garbage rows actually inserted.
+    bool topped_out;                    // Garbage pushed cells out the top or into the spawned piece.
+} VersusPlayer;
+
+typedef struct {
+    VersusPlayer players[VERSUS_PLAYER_COUNT];
+    uint64_t random_state;              // Garbage hole columns. Separate from the games, so holes don't change anyone's pieces.
+    uint32_t step_count;
+    uint8_t winner;                     // Player index, or VERSUS_NO_WINNER.
+    bool is_over;
+} VersusMatch;
+
+void        init_versus_match(VersusMatch* match, uint64_t seed);                  // Each game gets its own piece sequence, all from seed.
+uint8_t     get_garbage_attack(uint8_t cleared_lines, uint8_t combo_count, bool is_perfect_clear); // Lines sent for a lock that cleared cleared_lines, combo_count being Game.combo_count after it.
+void        push_garbage(GarbageQueue* queue, uint8_t lines, uint8_t hole_x);
+uint8_t     cancel_garbage(GarbageQueue* queue, uint8_t lines);                    // Cancels pending lines, oldest first. Returns the lines left over to send.
+bool        insert_garbage_rows(Playfield* playfield, uint8_t lines, uint8_t hole_x); // Shifts rows up and fills the bottom. False if cells were pushed out the top.
+
+void        step_versus_match(VersusMatch* match, const ACTION_BIT_FLAGS action_bit_flags[VERSUS_PLAYER_COUNT], double delta_time); // One tick for both players, then garbage for whoever locked.
+bool        apply_versus_placement(VersusMatch* match, uint8_t player_index, Placement placement); // Placement level, for bots. False if invalid or the match is over.
+uint32_t    step_versus_matches(VersusMatch* matches, uint32_t match_count, const ACTION_BIT_FLAGS* action_bit_flags, double delta_time); // VERSUS_PLAYER_COUNT actions per match. Finished matches are skipped. Returns how many are still running.
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // VERSUS_H
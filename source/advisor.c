@@ -0,0 +1,309 @@
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include <time.h>
+
+#include "advisor.h"
+#include "clock.h"
+#include "trace.h"
+#include "triple_buffer.h"
+
+#define ADVISOR_IDLE_POLL_INTERVAL  (2 * NANOSECONDS_PER_MILLISECOND)   // Longest a snapshot waits when its wakeup was skipped.
+
+typedef struct {
+    Game game;
+    uint32_t id;
+} AdvisorSnapshot;
+
+struct BotAdvisor {
+    Bot* bot;
+    thrd_t thread;
+    AdvisorSnapshot snapshots[3];   // Caller to search thread.
+    TripleBuffer snapshot_slots;
+    BotAdvice advice[3];            // Search thread to caller.
+    TripleBuffer advice_slots;
+    // Search thread only.
+    uint64_t search_start;
+    uint32_t search_id;
+    // Caller only: what the last snapshot spawned, to notice the next piece.
+    uint64_t last_random_state;
+    uint32_t last_placed_piece_count;
+    uint32_t last_id;
+    PieceType last_type;
+    PieceType last_held_type;
+    bool last_can_hold_piece;
+    bool has_advice;
+    // Only for the search thread to sleep on. The caller only ever tries the mutex, so it never waits on it.
+    mtx_t mutex;
+    cnd_t posted;
+    atomic_bool quit;
+};
+
+// Sleeps on posted until a snapshot is waiting. False once the advisor is quitting.
+static bool wait_for_advisor_snapshot(mtx_t* mutex, cnd_t* posted, atomic_bool* quit, TripleBuffer* snapshot_slots)
+{
+    mtx_lock(mutex);
+    while (!atomic_load_explicit(quit, memory_order_relaxed) && !is_triple_buffer_fresh(snapshot_slots))
+    {
+        struct timespec deadline;
+        timespec_get(&deadline, TIME_UTC);
+        const uint64_t nanoseconds = (uint64_t)deadline.tv_nsec + ADVISOR_IDLE_POLL_INTERVAL;
+        deadline.tv_sec += (time_t)(nanoseconds / NANOSECONDS_PER_SECOND);
+        deadline.tv_nsec = (long)(nanoseconds % NANOSECONDS_PER_SECOND);
+        cnd_timedwait(posted, mutex, &deadline);
+    }
+    mtx_unlock(mutex);
+    return !atomic_load_explicit(quit, memory_order_relaxed);
+}
+
+// Wakes the thread for a snapshot just published, without ever waiting on it.
+static void signal_advisor_snapshot(mtx_t* mutex, cnd_t* posted)
+{
+    // Holding the mutex means the other thread is not between its check and its wait, so the signal can't be missed.
+    // If it holds it instead, it is about to check or just checked, and the poll interval covers the second case.
+    if (mtx_trylock(mutex) == thrd_success)
+    {
+        cnd_signal(posted);
+        mtx_unlock(mutex);
+    }
+}
+
+static void publish_advice(BotAdvisor* advisor, Placement placement, uint8_t completed_depth, bool has_placement, bool is_final)
+{
+    advisor->advice[advisor->advice_slots.back] = (BotAdvice){
+        .placement = placement,
+        .elapsed = get_monotonic_nanoseconds() - advisor->search_start,
+        .snapshot_id = advisor->search_id,
+        .completed_depth = completed_depth,
+        .has_placement = has_placement,
+        .is_final = is_final
+    };
+    publish_triple_buffer(&advisor->advice_slots);
+}
+
+// Every ply is sent as soon as it is done, and the search gives up as soon as a newer snapshot is waiting.
+static bool on_advisor_ply(void* user_data, Placement best, uint8_t completed_depth)
+{
+    BotAdvisor* advisor = user_data;
+    if (is_triple_buffer_fresh(&advisor->snapshot_slots)) return false;
+    publish_advice(advisor, best, completed_depth, true, false);
+    return true;
+}
+
+static int run_bot_advisor(void* arg)
+{
+    BotAdvisor* advisor = arg;
+    set_trace_thread_name("advisor");
+    for (;;)
+    {
+        if (!wait_for_advisor_snapshot(&advisor->mutex, &advisor->posted, &advisor->quit, &advisor->snapshot_slots)) return 0;
+
+        acquire_triple_buffer(&advisor->snapshot_slots);
+        const AdvisorSnapshot* snapshot = &advisor->snapshots[advisor->snapshot_slots.front];
+        advisor->search_start = get_monotonic_nanoseconds();
+        advisor->search_id = snapshot->id;
+        Placement placement = { 0 };
+        BotSearchStats stats;
+        const bool found = search_bot_placement_anytime(advisor->bot, &snapshot->game, on_advisor_ply, advisor, &placement, &stats);
+        // A search cut short by a newer snapshot has nothing left worth saying.
+        if (!is_triple_buffer_fresh(&advisor->snapshot_slots))
+        {
+            publish_advice(advisor, placement, stats.completed_depth, found, true);
+        }
+    }
+}
+
+BotAdvisor* create_bot_advisor(BotSettings settings)
+{
+    BotAdvisor* advisor = calloc(1, sizeof(BotAdvisor));
+    if (!advisor) return 0;
+    advisor->bot = create_bot(settings);
+    if (!advisor->bot)
+    {
+        free(advisor);
+        return 0;
+    }
+    init_triple_buffer(&advisor->snapshot_slots);
+    init_triple_buffer(&advisor->advice_slots);
+    atomic_init(&advisor->quit, false);
+    const bool has_mutex = mtx_init(&advisor->mutex, mtx_plain) == thrd_success;
+    const bool has_posted = has_mutex && cnd_init(&advisor->posted) == thrd_success;
+    if (!has_posted || thrd_create(&advisor->thread, run_bot_advisor, advisor) != thrd_success)
+    {
+        if (has_posted) cnd_destroy(&advisor->posted);
+        if (has_mutex) mtx_destroy(&advisor->mutex);
+        destroy_bot(advisor->bot);
+        free(advisor);
+        return 0;
+    }
+    return advisor;
+}
+
+void destroy_bot_advisor(BotAdvisor* advisor)
+{
+    if (!advisor) return;
+    atomic_store_explicit(&advisor->quit, true, memory_order_relaxed);
+    cancel_bot_search(advisor->bot);
+    mtx_lock(&advisor->mutex);
+    cnd_signal(&advisor->posted);
+    mtx_unlock(&advisor->mutex);
+    thrd_join(advisor->thread, 0);
+    cnd_destroy(&advisor->posted);
+    mtx_destroy(&advisor->mutex);
+    destroy_bot(advisor->bot);
+    free(advisor);
+}
+
+uint32_t update_bot_advisor_game(BotAdvisor* advisor, const Game* game)
+{
+    // Every spawn changes one of these: a lock adds to placed_piece_count, a hold clears can_hold_piece,
+    // and a reset or rewind to the same count still lands on another piece, hold or bag.
+    const PieceType held_type = (game->held_piece) ? game->held_piece->type : 0;
+    if (advisor->last_id &&
+        game->placed_piece_count == advisor->last_placed_piece_count &&
+        game->can_hold_piece == advisor->last_can_hold_piece &&
+        game->controlled_piece.type == advisor->last_type &&
+        held_type == advisor->last_held_type &&
+        game->random_state == advisor->last_random_state)
+    {
+        return advisor->last_id;
+    }
+    advisor->last_placed_piece_count = game->placed_piece_count;
+    advisor->last_can_hold_piece = game->can_hold_piece;
+    advisor->last_type = game->controlled_piece.type;
+    advisor->last_held_type = held_type;
+    advisor->last_random_state = game->random_state;
+    advisor->last_id++;
+
+    // Cancelled before publishing: the other way round, the search thread could already be on the new snapshot,
+    // and the cancel would kill that search instead. A search that starts in between stops at its first ply.
+    cancel_bot_search(advisor->bot);
+    AdvisorSnapshot* snapshot = &advisor->snapshots[advisor->snapshot_slots.back];
+    snapshot->game = *game;
+    snapshot->id = advisor->last_id;
+    publish_triple_buffer(&advisor->snapshot_slots);
+    signal_advisor_snapshot(&advisor->mutex, &advisor->posted);
+    return advisor->last_id;
+}
+
+bool get_bot_advice(BotAdvisor* advisor, BotAdvice* out_advice)
+{
+    advisor->has_advice |= acquire_triple_buffer(&advisor->advice_slots);
+    if (!advisor->has_advice) return false;
+    *out_advice = advisor->advice[advisor->advice_slots.front];
+    return true;
+}
+
+struct PerfectClearAdvisor {
+    PerfectClearSolver* solver;
+    thrd_t thread;
+    AdvisorSnapshot snapshots[3];   // Caller to solving thread.
+    TripleBuffer snapshot_slots;
+    PerfectClearAdvice advice[3];   // Solving thread to caller.
+    TripleBuffer advice_slots;
+    // Caller only: the game of the last snapshot, to notice the next piece or a board change.
+    Game last_game;
+    uint32_t last_id;
+    bool has_advice;
+    // Only for the solving thread to sleep on, like BotAdvisor's.
+    mtx_t mutex;
+    cnd_t posted;
+    atomic_bool quit;
+};
+
+static int run_perfect_clear_advisor(void* arg)
+{
+    PerfectClearAdvisor* advisor = arg;
+    set_trace_thread_name("pc advisor");
+    for (;;)
+    {
+        if (!wait_for_advisor_snapshot(&advisor->mutex, &advisor->posted, &advisor->quit, &advisor->snapshot_slots)) return 0;
+        acquire_triple_buffer(&advisor->snapshot_slots);
+        const AdvisorSnapshot* snapshot = &advisor->snapshots[advisor->snapshot_slots.front];
+        PerfectClearAdvice* advice = &advisor->advice[advisor->advice_slots.back];
+        advice->status = solve_perfect_clear(advisor->solver, &snapshot->game, &advice->solution, &advice->stats);
+        advice->snapshot_id = snapshot->id;
+        // A solve cancelled for a newer snapshot proved nothing.
+        if (!is_triple_buffer_fresh(&advisor->snapshot_slots))
+        {
+            publish_triple_buffer(&advisor->advice_slots);
+        }
+    }
+}
+
+PerfectClearAdvisor* create_perfect_clear_advisor(PerfectClearSettings settings)
+{
+    PerfectClearAdvisor* advisor = calloc(1, sizeof(PerfectClearAdvisor));
+    if (!advisor) return 0;
+    advisor->solver = create_perfect_clear_solver(settings);
+    if (!advisor->solver)
+    {
+        free(advisor);
+        return 0;
+    }
+    init_triple_buffer(&advisor->snapshot_slots);
+    init_triple_buffer(&advisor->advice_slots);
+    atomic_init(&advisor->quit, false);
+    const bool has_mutex = mtx_init(&advisor->mutex, mtx_plain) == thrd_success;
+    const bool has_posted = has_mutex && cnd_init(&advisor->posted) == thrd_success;
+    if (!has_posted || thrd_create(&advisor->thread, run_perfect_clear_advisor, advisor) != thrd_success)
+    {
+        if (has_posted) cnd_destroy(&advisor->posted);
+        if (has_mutex) mtx_destroy(&advisor->mutex);
+        destroy_perfect_clear_solver(advisor->solver);
+        free(advisor);
+        return 0;
+    }
+    return advisor;
+}
+
+void destroy_perfect_clear_advisor(PerfectClearAdvisor* advisor)
+{
+    if (!advisor) return;
+    atomic_store_explicit(&advisor->quit, true, memory_order_relaxed);
+    cancel_perfect_clear_search(advisor->solver);
+    mtx_lock(&advisor->mutex);
+    cnd_signal(&advisor->posted);
+    mtx_unlock(&advisor->mutex);
+    thrd_join(advisor->thread, 0);
+    cnd_destroy(&advisor->posted);
+    mtx_destroy(&advisor->mutex);
+    destroy_perfect_clear_solver(advisor->solver);
+    free(advisor);
+}
+
+uint32_t update_perfect_clear_advisor_game(PerfectClearAdvisor* advisor, const Game* game)
+{
+    // A clear only depends on the pieces and the board, not on where the piece is falling.
+    const Game* last = &advisor->last_game;
+    if (advisor->last_id &&
+        game->controlled_piece.type == last->controlled_piece.type &&
+        game->held_piece == last->held_piece &&
+        game->can_hold_piece == last->can_hold_piece &&
+        game->placed_piece_count == last->placed_piece_count &&
+        memcmp(game->playfield.cells, last->playfield.cells, sizeof(PlayfieldCells)) == 0)
+    {
+        return advisor->last_id;
+    }
+    advisor->last_game = *game;
+    advisor->last_id++;
+
+    // Cancelled before publishing, for the same reason as update_bot_advisor_game. A solve that starts in between isn't cancelled,
+    // so the newer snapshot can wait up to a time budget, and the older one's answer is dropped.
+    cancel_perfect_clear_search(advisor->solver);
+    AdvisorSnapshot* snapshot = &advisor->snapshots[advisor->snapshot_slots.back];
+    snapshot->game = *game;
+    snapshot->id = advisor->last_id;
+    publish_triple_buffer(&advisor->snapshot_slots);
+    signal_advisor_snapshot(&advisor->mutex, &advisor->posted);
+    return advisor->last_id;
+}
+
+bool get_perfect_clear_advice(PerfectClearAdvisor* advisor, PerfectClearAdvice* out_advice)
+{
+    advisor->has_advice |= acquire_triple_buffer(&advisor->advice_slots);
+    if (!advisor->has_advice) return false;
+    *out_advice = advisor->advice[advisor->advice_slots.front];
+    return true;
+}
@@ -0,0 +1,165 @@
+#if !defined(_WIN32)
+#define _DEFAULT_SOURCE // MAP_ANONYMOUS and MAP_HUGETLB, which strict C17 hides.
+#endif // _WIN32
+
+#include <string.h>
+
+#include "allocator.h"
+#include "clock.h"
+
+// Page functions. Both return zeroed memory, so pages are only backed once something touches them.
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+static void* map_pages(size_t* size, bool use_huge_pages, bool* out_is_huge_page_backed)
+{
+    *out_is_huge_page_backed = false;
+    const size_t large_page_size = GetLargePageMinimum();
+    if (use_huge_pages && large_page_size)
+    {
+        const size_t huge_size = (*size + large_page_size - 1) & ~(large_page_size - 1);
+        void* pages = VirtualAlloc(0, huge_size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        if (pages)
+        {
+            *size = huge_size;
+            *out_is_huge_page_backed = true;
+            return pages;
+        }
+    }
+    return VirtualAlloc(0, *size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+}
+
+static void unmap_pages(void* pages, size_t size)
+{
+    (void)size;
+    VirtualFree(pages, 0, MEM_RELEASE);
+}
+#else
+#include <sys/mman.h>
+
+static void* map_pages(size_t* size, bool use_huge_pages, bool* out_is_huge_page_backed)
+{
+    *out_is_huge_page_backed = false;
+    void* pages = MAP_FAILED;
+    if (use_huge_pages)
+    {
+        const size_t huge_size = (*size + ALLOCATOR_HUGE_PAGE_SIZE - 1) & ~(size_t)(ALLOCATOR_HUGE_PAGE_SIZE - 1);
+#if defined(MAP_HUGETLB)
+        pages = mmap(0, huge_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        *out_is_huge_page_backed = pages != MAP_FAILED;
+#endif // MAP_HUGETLB
+        if (pages == MAP_FAILED)
+        {
+            pages = mmap(0, huge_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#if defined(MADV_HUGEPAGE)
+            if (pages != MAP_FAILED) madvise(pages, huge_size, MADV_HUGEPAGE);
+#endif // MADV_HUGEPAGE
+        }
+        if (pages != MAP_FAILED) *size = huge_size;
+    }
+    else
+    {
+        pages = mmap(0, *size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+    return (pages == MAP_FAILED) ? 0 : pages;
+}
+
+static void unmap_pages(void* pages, size_t size)
+{
+    munmap(pages, size);
+}
+#endif // _WIN32
+
+static double get_allocations_per_second(uint64_t allocation_count, uint64_t init_time)
+{
+    const uint64_t elapsed = get_monotonic_nanoseconds() - init_time;
+    return elapsed ? allocation_count * (double)NANOSECONDS_PER_SECOND / elapsed : 0.0;
+}
+
+// Arena functions.
+
+bool init_arena(Arena* arena, size_t capacity, bool use_huge_pages)
+{
+    memset(arena, 0, sizeof(Arena));
+    size_t mapped_size = capacity ? capacity : 1;
+    arena->base = map_pages(&mapped_size, use_huge_pages, &arena->is_huge_page_backed);
+    if (!arena->base) return false;
+    arena->capacity = capacity;
+    arena->mapped_size = mapped_size;
+    arena->init_time = get_monotonic_nanoseconds();
+    return true;
+}
+
+void release_arena(Arena* arena)
+{
+    if (arena->base) unmap_pages(arena->base, arena->mapped_size);
+    memset(arena, 0, sizeof(Arena));
+}
+
+AllocatorStats get_arena_stats(const Arena* arena)
+{
+    return (AllocatorStats){
+        .capacity = arena->capacity,
+        .used = arena->used,
+        .high_water = (arena->used > arena->high_water) ? arena->used : arena->high_water,
+        .allocation_count = arena->allocation_count,
+        .failed_count = arena->failed_count,
+        .reset_count = arena->reset_count,
+        .allocations_per_second = get_allocations_per_second(arena->allocation_count, arena->init_time),
+        .is_huge_page_backed = arena->is_huge_page_backed
+    };
+}
+
+// Pool functions.
+
+bool init_pool(Pool* pool, size_t item_size, uint32_t item_capacity, bool use_huge_pages)
+{
+    memset(pool, 0, sizeof(Pool));
+    if (!item_size) item_size = 1;
+    // Items first so they start on the page boundary, the free stack after them.
+    const size_t items_size = ((item_size * item_capacity + sizeof(uint32_t) - 1) / sizeof(uint32_t)) * sizeof(uint32_t);
+    size_t mapped_size = items_size + item_capacity * sizeof(uint32_t);
+    if (!mapped_size) mapped_size = 1;
+    pool->items = map_pages(&mapped_size, use_huge_pages, &pool->is_huge_page_backed);
+    if (!pool->items) return false;
+    pool->free_indices = (uint32_t*)(pool->items + items_size);
+    pool->item_size = item_size;
+    pool->item_capacity = item_capacity;
+    pool->mapped_size = mapped_size;
+    reset_pool(pool);
+    pool->reset_count = 0;
+    pool->init_time = get_monotonic_nanoseconds();
+    return true;
+}
+
+void release_pool(Pool* pool)
+{
+    if (pool->items) unmap_pages(pool->items, pool->mapped_size);
+    memset(pool, 0, sizeof(Pool));
+}
+
+void reset_pool(Pool* pool)
+{
+    for (uint32_t i = 0; i < pool->item_capacity; i++)
+    {
+        pool->free_indices[i] = pool->item_capacity - 1 - i;
+    }
+    pool->free_count = pool->item_capacity;
+    pool->reset_count++;
+}
+
+AllocatorStats get_pool_stats(const Pool* pool)
+{
+    return (AllocatorStats){
+        .capacity = pool->item_size * pool->item_capacity,
+        .used = pool->item_size * get_pool_taken_count(pool),
+        .high_water = pool->item_size * pool->high_water,
+        .allocation_count = pool->allocation_count,
+        .failed_count = pool->failed_count,
+        .reset_count = pool->reset_count,
+        .allocations_per_second = get_allocations_per_second(pool->allocation_count, pool->init_time),
+        .is_huge_page_backed = pool->is_huge_page_backed
+    };
+}
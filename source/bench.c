@@ -0,0 +1,2021 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+#include "allocator.h"
+#include "bot.h"
+#include "bridge.h"
+#include "clock.h"
+#include "codec.h"
+#include "env.h"
+#include "finesse.h"
+#include "game.h"
+#include "mcts.h"
+#include "observation.h"
+#include "opening_book.h"
+#include "perfect_clear.h"
+#include "rewind.h"
+#include "rollback.h"
+#include "trace.h"
+#include "util.h"
+#include "versus.h"
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif // _WIN32
+
+#define BENCH_TICK_DELTA_TIME         (1.0 / 60.0)
+#define BENCH_MAX_TICKS_PER_PIECE     600
+#define BENCH_PLACEMENT_TARGET        100    // How many times faster than ticking a piece a placement was asked to be.
+#define BENCH_CODEC_MAX_PIECES        300    // Per player and versus match.
+#define BENCH_FINESSE_MAX_TICKS       600
+#define BENCH_FINESSE_EVERY_PLACEMENT 10     // Every this many pieces, every resting placement is planned too, tucks included.
+#define BENCH_BRIDGE_NAME             "zetris-bench"
+#define BENCH_BRIDGE_TIMEOUT          (5 * NANOSECONDS_PER_SECOND)
+#define BENCH_FRAME_MICROSECONDS      16667
+#define BENCH_ROLLBACK_DEPTH          8      // Frames resimulated by the timed worst case.
+#define BENCH_BOARD_PASSES            5
+#define BENCH_SNAPSHOTS_PER_MOVE      64     // Game copies a search might keep per move.
+#define BENCH_BOOK_EXTRA_PIECES       2      // Pieces played past a book's plies, to see it miss.
+#define BENCH_BOOK_PROBE_REPEATS      100    // Lookups of each hit timed on their own, with the position hot, like zetris-book --info.
+#define BENCH_PC_LINES                4      // Setups are built inside these bottom lines.
+#define BENCH_ENV_ACTION_ROWS         256    // Steps of random actions generated up front and cycled through while timing.
+#define BENCH_PC_SETUP_TRIES          200    // Random setups tried for each one kept.
+
+typedef enum {
+    PLACEMENT_PATH_ATTEMPT,
+    PLACEMENT_PATH_DROP,
+    PLACEMENT_PATH_HARD_DROP,
+    PLACEMENT_PATH_LOCK_DELAY,
+    PLACEMENT_PATH_COUNT
+} PlacementPath;
+
+// Plays one piece through tick with the bot controller. Returns the ticks it took, or 0 if the piece never locked. Without a
+// hard drop the piece is soft dropped where the controller would have dropped it, and locks once the lock delay runs out.
+static uint32_t tick_until_placed(Game* game, BotController* controller, Placement placement, bool is_hard_dropped, Placement* out_reached)
+{
+    set_bot_controller_target(controller, game, placement);
+    const uint32_t placed_piece_count = game->placed_piece_count;
+    for (uint32_t ticks = 1; ticks <= BENCH_MAX_TICKS_PER_PIECE; ticks++)
+    {
+        // Where the piece would lock if this tick locks it.
+        out_reached->type = game->controlled_piece.type;
+        out_reached->pos_x = game->controlled_piece.pos_x;
+        out_reached->rotation = game->controlled_piece.rotation;
+        out_reached->pos_y = get_playfield_piece_cells_hard_drop_y(&game->playfield, game->controlled_piece.cells, game->controlled_piece.size, game->controlled_piece.pos_x, game->controlled_piece.pos_y);
+        ACTION_BIT_FLAGS action_bit_flags = get_bot_controller_action_bit_flags(controller, game);
+        if (!is_hard_dropped && (action_bit_flags & ACTION_HARD_DROP))
+        {
+            action_bit_flags = (action_bit_flags & ~ACTION_HARD_DROP) | ACTION_SOFT_DROP;
+        }
+        tick(game, BENCH_TICK_DELTA_TIME, action_bit_flags);
+        if (game->placed_piece_count != placed_piece_count) return ticks;
+    }
+    return 0;
+}
+
+// Everything a placement is supposed to decide. Piece timers and velocities are frame physics, so they are left out.
+static bool are_placement_results_equal(const Game* a, const Game* b)
+{
+    return memcmp(a->playfield.cells, b->playfield.cells, sizeof(PlayfieldCells)) == 0 &&
+        memcmp(a->playfield.type_planes, b->playfield.type_planes, sizeof(a->playfield.type_planes)) == 0 &&
+        a->playfield.lines_cleared == b->playfield.lines_cleared &&
+        a->score == b->score &&
+        a->random_state == b->random_state &&
+        a->held_piece == b->held_piece &&
+        memcmp(a->piece_queue, b->piece_queue, sizeof(a->piece_queue)) == 0 &&
+        a->piece_queue_index == b->piece_queue_index &&
+        a->placed_piece_count == b->placed_piece_count &&
+        a->controlled_piece.type == b->controlled_piece.type &&
+        a->level_index == b->level_index &&
+        a->combo_count == b->combo_count &&
+        a->cleared_lines_last_piece == b->cleared_lines_last_piece &&
+        a->can_hold_piece == b->can_hold_piece;
+}
+
+static bool is_placement_reached(Placement placement, Placement reached)
+{
+    return reached.pos_x == placement.pos_x && reached.pos_y == placement.pos_y && reached.rotation == placement.rotation && reached.type == placement.type;
+}
+
+// Replays the recorded pieces of every game through one of the four paths. Returns the ticks it took, for the tick paths.
+static uint64_t replay_placements(const Placement* placements, const uint32_t* placement_counts, uint32_t game_count, uint32_t pieces_per_game,
+    PlacementPath path, uint64_t* checksum)
+{
+    uint64_t ticks = 0;
+    for (uint32_t g = 0; g < game_count; g++)
+    {
+        Game game = get_seeded_initialized_game(g + 1);
+        game.handling.soft_drop_factor = SOFT_DROP_INSTANT;
+        BotController controller = { 0 };
+        const Placement* game_placements = &placements[(size_t)g * pieces_per_game];
+        Placement reached;
+        switch (path)
+        {
+        case PLACEMENT_PATH_ATTEMPT:
+            for (uint32_t i = 0; i < placement_counts[g]; i++) attempt_apply_placement(&game, game_placements[i]);
+            break;
+        case PLACEMENT_PATH_DROP:
+            for (uint32_t i = 0; i < placement_counts[g]; i++) apply_drop_placement(&game, game_placements[i]);
+            break;
+        case PLACEMENT_PATH_HARD_DROP:
+        case PLACEMENT_PATH_LOCK_DELAY:
+            for (uint32_t i = 0; i < placement_counts[g]; i++)
+            {
+                ticks += tick_until_placed(&game, &controller, game_placements[i], path == PLACEMENT_PATH_HARD_DROP, &reached);
+            }
+            break;
+        }
+        *checksum += game.score;
+    }
+    return ticks;
+}
+
+// Checks attempt_apply_placement and apply_drop_placement against tick for every piece of bot played games, then times all of them
+// on the same pieces. Tick plays each piece twice: hard dropped, its fastest path, and soft dropped into the lock delay, the way a
+// piece falls without a hard drop (with an instant soft drop, the fewest ticks that takes).
+static int run_placement_benchmark(uint32_t game_count, uint32_t pieces_per_game, uint32_t repetitions)
+{
+    BotSettings settings = get_default_bot_settings();
+    settings.beam_width = 16;
+    settings.depth = 2;
+    settings.thread_count = 1;
+    Bot* bot = create_bot(settings);
+    Placement* placements = malloc((size_t)game_count * pieces_per_game * sizeof(Placement));
+    uint32_t* placement_counts = calloc(game_count, sizeof(uint32_t));
+    if (!bot || !placements || !placement_counts)
+    {
+        free(placement_counts);
+        free(placements);
+        destroy_bot(bot);
+        return 1;
+    }
+
+    uint64_t compared = 0;
+    uint64_t unreached = 0;
+    uint64_t mismatches = 0;
+    uint64_t placed = 0;
+    for (uint32_t g = 0; g < game_count; g++)
+    {
+        Placement* game_placements = &placements[(size_t)g * pieces_per_game];
+        Game game = get_seeded_initialized_game(g + 1);
+        game.handling.soft_drop_factor = SOFT_DROP_INSTANT;
+        while (placement_counts[g] < pieces_per_game && !is_game_over(&game))
+        {
+            Placement placement;
+            if (!search_bot_placement(bot, &game, &placement, 0)) break;
+            Game dropped = game;
+            Game hard_dropped = game;
+            Game lock_delayed = game;
+            if (!attempt_apply_placement(&game, placement))
+            {
+                printf("placement rejected: game %u piece %u\n", g, placement_counts[g]);
+                mismatches++;
+                break;
+            }
+            game_placements[placement_counts[g]++] = placement;
+            apply_drop_placement(&dropped, placement);
+            if (!are_placement_results_equal(&game, &dropped))
+            {
+                printf("apply_drop_placement mismatch: game %u piece %u\n", g, placement_counts[g] - 1);
+                mismatches++;
+            }
+            BotController controller = { 0 };
+            Placement reached;
+            Placement reached_lock_delayed;
+            if (!tick_until_placed(&hard_dropped, &controller, placement, true, &reached) || !is_placement_reached(placement, reached) ||
+                !tick_until_placed(&lock_delayed, &(BotController){ 0 }, placement, false, &reached_lock_delayed) || !is_placement_reached(placement, reached_lock_delayed))
+            {
+                unreached++; // The controller couldn't steer there (gravity or kicks), so there is nothing to compare.
+                continue;
+            }
+            compared++;
+            if (!are_placement_results_equal(&game, &hard_dropped) || !are_placement_results_equal(&game, &lock_delayed))
+            {
+                printf("tick mismatch: game %u piece %u\n", g, placement_counts[g] - 1);
+                mismatches++;
+            }
+        }
+        placed += placement_counts[g];
+    }
+
+    // Replay the recorded pieces every way. Every path ends on the same scores, so the checksum comes back to zero, and it keeps
+    // the compiler from dropping the work. The paths take turns each repetition and keep their fastest, so a slow spell of the
+    // machine lands on all of them rather than on whichever was running through it.
+    uint64_t nanoseconds[PLACEMENT_PATH_COUNT];
+    uint64_t ticks[PLACEMENT_PATH_COUNT] = { 0 };
+    uint64_t path_checksums[PLACEMENT_PATH_COUNT] = { 0 };
+    for (uint8_t path = 0; path < PLACEMENT_PATH_COUNT; path++) nanoseconds[path] = UINT64_MAX;
+    for (uint32_t r = 0; r < repetitions; r++)
+    {
+        for (uint8_t path = 0; path < PLACEMENT_PATH_COUNT; path++)
+        {
+            const uint64_t start = get_monotonic_nanoseconds();
+            ticks[path] = replay_placements(placements, placement_counts, game_count, pieces_per_game, (PlacementPath)path, &path_checksums[path]);
+            const uint64_t elapsed = get_monotonic_nanoseconds() - start;
+            if (elapsed < nanoseconds[path]) nanoseconds[path] = elapsed;
+        }
+    }
+    uint64_t checksum = 0;
+    for (uint8_t path = 0; path < PLACEMENT_PATH_COUNT; path++)
+    {
+        checksum += (path % 2) ? path_checksums[path] : 0 - path_checksums[path];
+    }
+    const double pieces = (double)placed;
+
+    printf("placement: %llu pieces, %llu compared with tick, %llu unreachable by the controller, %llu mismatches%s\n",
+        (unsigned long long)placed, (unsigned long long)compared, (unsigned long long)unreached, (unsigned long long)mismatches,
+        checksum ? ", replay scores differ" : "");
+    printf("placement: attempt_apply_placement %.1f ns/piece, apply_drop_placement %.1f ns/piece\n",
+        nanoseconds[PLACEMENT_PATH_ATTEMPT] / pieces, nanoseconds[PLACEMENT_PATH_DROP] / pieces);
+    printf("placement: tick %.1f ns/piece, %.1f ticks/piece with instant inputs and hard drop\n",
+        nanoseconds[PLACEMENT_PATH_HARD_DROP] / pieces, ticks[PLACEMENT_PATH_HARD_DROP] / pieces);
+    printf("placement: tick %.1f ns/piece, %.1f ticks/piece soft dropped into the lock delay\n",
+        nanoseconds[PLACEMENT_PATH_LOCK_DELAY] / pieces, ticks[PLACEMENT_PATH_LOCK_DELAY] / pieces);
+    // Judged on apply_drop_placement, what search and rollouts call on the placements get_drop_placements gives them, against the
+    // lock delay path, the dozens of ticks a piece takes without a hard drop. Reported rather than failed on: the ratio swings with
+    // the machine, the equivalence doesn't.
+    const double speedup = (double)nanoseconds[PLACEMENT_PATH_LOCK_DELAY] / nanoseconds[PLACEMENT_PATH_DROP];
+    printf("placement: apply_drop_placement %.1fx faster than the lock delay path (%s the %ux target), %.1fx faster than the hard drop path\n",
+        speedup, (speedup >= BENCH_PLACEMENT_TARGET) ? "meeting" : "short of", BENCH_PLACEMENT_TARGET,
+        (double)nanoseconds[PLACEMENT_PATH_HARD_DROP] / nanoseconds[PLACEMENT_PATH_DROP]);
+    printf("placement: attempt_apply_placement %.1fx faster than the lock delay path, %.1fx faster than the hard drop path\n",
+        (double)nanoseconds[PLACEMENT_PATH_LOCK_DELAY] / nanoseconds[PLACEMENT_PATH_ATTEMPT],
+        (double)nanoseconds[PLACEMENT_PATH_HARD_DROP] / nanoseconds[PLACEMENT_PATH_ATTEMPT]);
+
+    free(placement_counts);
+    free(placements);
+    destroy_bot(bot);
+    return (mismatches || checksum) ? 1 : 0;
+}
+
+// Plays seeded games with the MCTS player, reusing its tree between pieces, and reports rollout throughput and how the games went.
+static int run_mcts_benchmark(uint32_t game_count, uint32_t pieces_per_game, uint64_t time_budget, uint8_t thread_count)
+{
+    MctsSettings settings = get_default_mcts_settings();
+    settings.time_budget = time_budget;
+    settings.thread_count = thread_count;
+    Mcts* mcts = create_mcts(settings);
+    if (!mcts) return 1;
+
+    uint64_t rollouts = 0;
+    uint64_t reused_visits = 0;
+    uint64_t search_nanoseconds = 0;
+    uint64_t searches = 0;
+    uint64_t total_score = 0;
+    uint64_t total_lines = 0;
+    uint32_t max_tree_node_count = 0;
+    uint32_t topped_out = 0;
+    for (uint32_t g = 0; g < game_count; g++)
+    {
+        Game game = get_seeded_initialized_game(g + 1);
+        uint32_t pieces = 0;
+        while (pieces < pieces_per_game && !is_game_over(&game))
+        {
+            Placement placement;
+            MctsSearchStats stats;
+            if (!search_mcts_placement(mcts, &game, &placement, &stats) || !attempt_apply_placement(&game, placement)) break;
+            advance_mcts(mcts, placement);
+            rollouts += stats.rollouts;
+            reused_visits += stats.reused_visits;
+            search_nanoseconds += stats.elapsed;
+            if (stats.tree_node_count > max_tree_node_count) max_tree_node_count = stats.tree_node_count;
+            searches++;
+            pieces++;
+        }
+        topped_out += (pieces < pieces_per_game);
+        total_score += game.score;
+        total_lines += game.playfield.lines_cleared;
+        printf("mcts: game %u, %u pieces, %u lines, score %llu\n", g, pieces, game.playfield.lines_cleared, (unsigned long long)game.score);
+    }
+
+    printf("mcts: %u threads, %.1f ms per search, %llu searches\n", thread_count, (double)time_budget / NANOSECONDS_PER_MILLISECOND, (unsigned long long)searches);
+    printf("mcts: %.0f rollouts/s, %.0f rollouts per search, %.0f visits per search reused from the previous tree, %u nodes at most\n",
+        rollouts * (double)NANOSECONDS_PER_SECOND / search_nanoseconds, (double)rollouts / searches, (double)reused_visits / searches, max_tree_node_count);
+    printf("mcts: %.1f average score, %.1f average lines, %u of %u games topped out\n",
+        (double)total_score / game_count, (double)total_lines / game_count, topped_out, game_count);
+    destroy_mcts(mcts);
+    return 0;
+}
+
+// Every field of the game, piece physics included, since a rewound game has to carry on exactly as the original did.
+static bool are_games_equal(const Game* a, const Game* b)
+{
+    const Piece* pa = &a->controlled_piece;
+    const Piece* pb = &b->controlled_piece;
+    return are_placement_results_equal(a, b) &&
+        a->setting_bit_flags == b->setting_bit_flags &&
+        a->previous_action_bit_flags == b->previous_action_bit_flags &&
+        a->controlled_piece_ground_y == b->controlled_piece_ground_y &&
+        a->playfield.row_count == b->playfield.row_count &&
+        a->playfield.column_count == b->playfield.column_count &&
+        a->playfield.ceiling == b->playfield.ceiling &&
+        a->handling.das == b->handling.das && a->handling.arr == b->handling.arr && a->handling.soft_drop_factor == b->handling.soft_drop_factor &&
+        pa->rotation_wall_kicks == pb->rotation_wall_kicks &&
+        pa->velo_x == pb->velo_x && pa->velo_y == pb->velo_y && pa->timer == pb->timer &&
+        pa->cells == pb->cells && pa->size == pb->size && pa->rotation == pb->rotation &&
+        pa->pos_x == pb->pos_x && pa->pos_y == pb->pos_y && pa->moves == pb->moves && pa->on_ground == pb->on_ground;
+}
+
+// Records a bot played session tick by tick, then restores every tick still in the ring and checks it against the original.
+static int run_rewind_benchmark(uint32_t minutes, uint32_t restore_samples)
+{
+    const uint32_t tick_count = minutes * 60 * 60;
+    BotSettings bot_settings = get_default_bot_settings();
+    bot_settings.beam_width = 16;
+    bot_settings.depth = 2;
+    bot_settings.thread_count = 1;
+    Bot* bot = create_bot(bot_settings);
+    RewindRing* ring = create_rewind_ring(get_default_rewind_settings());
+    Game* games = malloc((size_t)tick_count * sizeof(Game));
+    if (!bot || !ring || !games) return 1;
+
+    Game game = get_seeded_initialized_game(1);
+    BotController controller = { 0 };
+    uint64_t record_nanoseconds = 0;
+    uint32_t recorded = 0;
+    while (recorded < tick_count && !is_game_over(&game))
+    {
+        if (needs_bot_controller_target(&controller, &game))
+        {
+            Placement placement;
+            if (search_bot_placement(bot, &game, &placement, 0)) set_bot_controller_target(&controller, &game, placement);
+        }
+        tick(&game, BENCH_TICK_DELTA_TIME, get_bot_controller_action_bit_flags(&controller, &game));
+        games[recorded] = game;
+        const uint64_t start = get_monotonic_nanoseconds();
+        record_rewind_tick(ring, &game);
+        record_nanoseconds += get_monotonic_nanoseconds() - start;
+        recorded++;
+    }
+
+    uint32_t oldest = 0;
+    uint32_t newest = 0;
+    uint64_t mismatches = 0;
+    get_rewind_tick_range(ring, &oldest, &newest);
+    for (uint32_t t = oldest; t <= newest && recorded; t++)
+    {
+        Game restored;
+        if (!restore_rewind_tick(ring, t, &restored) || !are_games_equal(&restored, &games[t]))
+        {
+            if (!mismatches) printf("rewind: first mismatch at tick %u\n", t);
+            mismatches++;
+        }
+    }
+
+    // Every piece start the ring still has should be found, and be the tick the count changed on.
+    uint64_t piece_mismatches = 0;
+    for (uint32_t count = games[oldest].placed_piece_count + 1; recorded && count <= games[newest].placed_piece_count; count++)
+    {
+        uint32_t t;
+        if (!find_rewind_piece_tick(ring, count, &t) || games[t].placed_piece_count != count || games[t - 1].placed_piece_count != count - 1) piece_mismatches++;
+    }
+
+    uint64_t random_state = 1;
+    uint64_t checksum = 0;
+    const uint64_t start = get_monotonic_nanoseconds();
+    for (uint32_t i = 0; i < restore_samples; i++)
+    {
+        Game restored;
+        restore_rewind_tick(ring, oldest + (uint32_t)(next_random(&random_state) % (newest - oldest + 1)), &restored);
+        checksum += restored.controlled_piece.pos_x;
+    }
+    const uint64_t restore_nanoseconds = get_monotonic_nanoseconds() - start;
+
+    printf("rewind: %u ticks (%.1f minutes), %u pieces, ticks %u to %u restorable, %llu mismatches, %llu piece lookups wrong\n",
+        recorded, recorded / 3600.0, game.placed_piece_count, oldest, newest, (unsigned long long)mismatches, (unsigned long long)piece_mismatches);
+    printf("rewind: %.1f ns to record a tick, %.2f us to restore one (checksum %llu)\n",
+        (double)record_nanoseconds / recorded, restore_nanoseconds / 1000.0 / restore_samples, (unsigned long long)checksum);
+    printf("rewind: %.2f MiB for the ring, %.2f MiB as a Game per tick\n",
+        get_rewind_ring_memory_size(ring) / (1024.0 * 1024.0), (double)recorded * sizeof(Game) / (1024.0 * 1024.0));
+
+    free(games);
+    destroy_rewind_ring(ring);
+    destroy_bot(bot);
+    return (mismatches || piece_mismatches) ? 1 : 0;
+}
+
+// Times the versus layer on its own: garbage insertion, batched tick level steps, and placement level bot matches.
+static int run_versus_benchmark(uint32_t match_count, uint32_t max_pieces)
+{
+    // Garbage insertion on a half full board.
+    Playfield playfield = get_seeded_initialized_game(1).playfield;
+    uint64_t random_state = 1;
+    const uint32_t insert_count = 1000000;
+    uint64_t checksum = 0;
+    uint64_t start = get_monotonic_nanoseconds();
+    for (uint32_t i = 0; i < insert_count; i++)
+    {
+        if (i % (DEFAULT_ROW_COUNT / 2) == 0) memset(playfield.cells, 0, sizeof(playfield.cells));
+        insert_garbage_rows(&playfield, 1 + (i & 1), (uint8_t)(next_random(&random_state) % DEFAULT_COLUMN_COUNT));
+        checksum += playfield.cells[DEFAULT_ROW_COUNT - 1];
+    }
+    const double insert_nanoseconds = (double)(get_monotonic_nanoseconds() - start) / insert_count;
+
+    // Tick level: a batch of matches stepped with random inputs.
+    const uint32_t batch_count = 1024;
+    const uint32_t batch_ticks = 600;
+    VersusMatch* matches = malloc(batch_count * sizeof(VersusMatch));
+    ACTION_BIT_FLAGS* actions = malloc(batch_count * VERSUS_PLAYER_COUNT * sizeof(ACTION_BIT_FLAGS));
+    if (!matches || !actions)
+    {
+        free(matches);
+        free(actions);
+        return 1;
+    }
+    for (uint32_t m = 0; m < batch_count; m++)
+    {
+        init_versus_match(&matches[m], m + 1);
+    }
+    uint64_t match_ticks = 0;
+    start = get_monotonic_nanoseconds();
+    for (uint32_t t = 0; t < batch_ticks; t++)
+    {
+        for (uint32_t i = 0; i < batch_count * VERSUS_PLAYER_COUNT; i++)
+        {
+            actions[i] = (ACTION_BIT_FLAGS)(next_random(&random_state) & ~ACTION_PAUSE);
+        }
+        match_ticks += step_versus_matches(matches, batch_count, actions, BENCH_TICK_DELTA_TIME);
+    }
+    const double step_seconds = (double)(get_monotonic_nanoseconds() - start) / NANOSECONDS_PER_SECOND;
+    free(actions);
+
+    // Placement level: bot against bot, taking turns piece by piece.
+    BotSettings bot_settings = get_default_bot_settings();
+    bot_settings.beam_width = 16;
+    bot_settings.depth = 2;
+    bot_settings.thread_count = 1;
+    Bot* bot = create_bot(bot_settings);
+    if (!bot)
+    {
+        free(matches);
+        return 1;
+    }
+    uint64_t pieces = 0;
+    uint64_t lines_sent = 0;
+    uint64_t lines_received = 0;
+    uint64_t apply_nanoseconds = 0;
+    uint32_t wins[VERSUS_PLAYER_COUNT + 1] = { 0 };  // Last is draws and unfinished.
+    for (uint32_t m = 0; m < match_count; m++)
+    {
+        VersusMatch* match = &matches[m % batch_count];
+        init_versus_match(match, 1000 + m);
+        for (uint32_t i = 0; i < max_pieces * VERSUS_PLAYER_COUNT && !match->is_over; i++)
+        {
+            const uint8_t player = i % VERSUS_PLAYER_COUNT;
+            Placement placement;
+            if (!search_bot_placement(bot, &match->players[player].game, &placement, 0)) break;
+            const uint64_t apply_start = get_monotonic_nanoseconds();
+            apply_versus_placement(match, player, placement);
+            apply_nanoseconds += get_monotonic_nanoseconds() - apply_start;
+            pieces++;
+        }
+        wins[(match->winner == VERSUS_NO_WINNER) ? VERSUS_PLAYER_COUNT : match->winner]++;
+        for (uint8_t p = 0; p < VERSUS_PLAYER_COUNT; p++)
+        {
+            lines_sent += match->players[p].lines_sent;
+            lines_received += match->players[p].lines_received;
+        }
+    }
+    destroy_bot(bot);
+    free(matches);
+
+    printf("versus: insert_garbage_rows %.1f ns (checksum %llu)\n", insert_nanoseconds, (unsigned long long)checksum);
+    printf("versus: %u matches stepped %u ticks with random inputs, %.0f match ticks/s\n", batch_count, batch_ticks, match_ticks / step_seconds);
+    printf("versus: %u bot matches, %.1f pieces each, %llu lines sent, %llu garbage rows landed, wins %u / %u, %u draws or unfinished\n",
+        match_count, (double)pieces / match_count, (unsigned long long)lines_sent, (unsigned long long)lines_received, wins[0], wins[1], wins[VERSUS_PLAYER_COUNT]);
+    printf("versus: apply_versus_placement %.1f ns/piece\n", pieces ? (double)apply_nanoseconds / pieces : 0.0);
+    // Matches where no garbage lands or nobody ever wins aren't exercising the versus layer, whatever their timings say.
+    if (!lines_received || !(wins[0] + wins[1]))
+    {
+        printf("versus: bot matches need garbage that lands and a winner, raise the matches or pieces\n");
+        return 1;
+    }
+    return 0;
+}
+
+// Board sizes the board benchmark compares, clamped to what the build allows. The first is the one the others are measured against.
+static const uint8_t BENCH_BOARD_SIZES[][2] = { { DEFAULT_ROW_COUNT, DEFAULT_COLUMN_COUNT }, { 40, 40 }, { 64, 40 }, { MAX_ROW_COUNT, MAX_COLUMN_COUNT } };
+
+// Times the row kernels (collision, hard drop, and lock and clear through attempt_apply_placement) on standard and big boards.
+// Games are placement level with a greedy policy, every piece as deep as it goes, and the boards they leave behind are what the kernels run on.
+static int run_board_benchmark(uint32_t pieces_per_size)
+{
+    const uint32_t board_count = 1024;
+    Playfield* boards = malloc(board_count * sizeof(Playfield));
+    Placement* placements = malloc(MAX_DROP_PLACEMENT_COUNT * sizeof(Placement));
+    if (!boards || !placements || !pieces_per_size)
+    {
+        free(boards);
+        free(placements);
+        return 1;
+    }
+    printf("board: %u pieces per size, %zu byte Game, %zu bit rows\n", pieces_per_size, sizeof(Game), 8 * sizeof(PlayfieldRow));
+    double baseline[3] = { 0.0 };
+    uint8_t measured[sizeof(BENCH_BOARD_SIZES) / sizeof(BENCH_BOARD_SIZES[0])][2] = { { 0 } };
+    for (uint32_t s = 0; s < sizeof(BENCH_BOARD_SIZES) / sizeof(BENCH_BOARD_SIZES[0]); s++)
+    {
+        Game game = get_sized_initialized_game(s + 1, BENCH_BOARD_SIZES[s][0], BENCH_BOARD_SIZES[s][1]);
+        bool is_repeat = false;
+        for (uint32_t i = 0; i < s; i++)
+        {
+            is_repeat |= measured[i][0] == game.playfield.row_count && measured[i][1] == game.playfield.column_count;
+        }
+        if (is_repeat) continue; // Clamped to a size already measured.
+        measured[s][0] = game.playfield.row_count;
+        measured[s][1] = game.playfield.column_count;
+
+        uint64_t enumerate_nanoseconds = 0;
+        uint64_t apply_nanoseconds = 0;
+        uint64_t candidate_count = 0;
+        uint32_t game_count = 1;
+        uint64_t lines = 0;
+        for (uint32_t p = 0; p < pieces_per_size; p++)
+        {
+            boards[p % board_count] = game.playfield;
+            uint64_t start = get_monotonic_nanoseconds();
+            const uint16_t count = get_drop_placements(&game, true, placements);
+            enumerate_nanoseconds += get_monotonic_nanoseconds() - start;
+            candidate_count += count;
+            uint16_t chosen = 0;
+            for (uint16_t i = 1; i < count; i++)
+            {
+                if (placements[i].pos_y > placements[chosen].pos_y) chosen = i;
+            }
+            const uint32_t lines_before = game.playfield.lines_cleared;
+            start = get_monotonic_nanoseconds();
+            const bool is_applied = count && attempt_apply_placement(&game, placements[chosen]);
+            apply_nanoseconds += get_monotonic_nanoseconds() - start;
+            lines += game.playfield.lines_cleared - lines_before;
+            if (!is_applied || is_game_over(&game))
+            {
+                reset_game(&game);
+                game_count++;
+            }
+        }
+
+        // Every piece in every rotation at every column of the spawn row, collided and dropped on the boards the games left.
+        // Each pass is timed whole, since a clock read costs more than a collision check, and the fastest of a few is kept.
+        const uint32_t used_boards = (pieces_per_size < board_count) ? pieces_per_size : board_count;
+        uint64_t checks = 0;
+        uint64_t checksum = 0;
+        uint64_t collide_nanoseconds = UINT64_MAX;
+        uint64_t drop_nanoseconds = UINT64_MAX;
+        for (uint32_t pass = 0; pass < BENCH_BOARD_PASSES; pass++)
+        {
+            checks = 0;
+            uint64_t start = get_monotonic_nanoseconds();
+            for (uint32_t b = 0; b < used_boards; b++)
+            {
+                for (PieceType type = I_TYPE; type <= L_TYPE; type++)
+                {
+                    for (uint8_t rotation = 0; rotation < PIECE_ROTATION_STATES; rotation++)
+                    {
+                        for (uint8_t x = 0; x < boards[b].column_count + COLUMN_OFFSET; x++)
+                        {
+                            checksum += are_playfield_piece_cells_colliding(&boards[b], PIECE_ROTATION_CELLS[type][rotation], get_piece_data(type)->size, x, PIECE_SPAWN_ROW_OFFSET);
+                        }
+                        checks += boards[b].column_count + COLUMN_OFFSET;
+                    }
+                }
+            }
+            uint64_t elapsed = get_monotonic_nanoseconds() - start;
+            if (elapsed < collide_nanoseconds) collide_nanoseconds = elapsed;
+            start = get_monotonic_nanoseconds();
+            for (uint32_t b = 0; b < used_boards; b++)
+            {
+                for (PieceType type = I_TYPE; type <= L_TYPE; type++)
+                {
+                    for (uint8_t rotation = 0; rotation < PIECE_ROTATION_STATES; rotation++)
+                    {
+                        for (uint8_t x = 0; x < boards[b].column_count + COLUMN_OFFSET; x++)
+                        {
+                            checksum += get_playfield_piece_cells_hard_drop_y(&boards[b], PIECE_ROTATION_CELLS[type][rotation], get_piece_data(type)->size, x, PIECE_SPAWN_ROW_OFFSET);
+                        }
+                    }
+                }
+            }
+            elapsed = get_monotonic_nanoseconds() - start;
+            if (elapsed < drop_nanoseconds) drop_nanoseconds = elapsed;
+        }
+
+        const double collide = (double)collide_nanoseconds / checks;
+        const double drop = (double)drop_nanoseconds / checks;
+        const double apply = (double)apply_nanoseconds / pieces_per_size;
+        if (s == 0)
+        {
+            baseline[0] = collide;
+            baseline[1] = drop;
+            baseline[2] = apply;
+        }
+        printf("board: %2u x %-2u  collide %5.1f ns (%.2fx), hard drop %6.1f ns (%.2fx), apply %6.1f ns/piece (%.2fx), placements %6.1f ns each, %5.1f a piece\n",
+            game.playfield.column_count, game.playfield.row_count, collide, collide / baseline[0], drop, drop / baseline[1], apply, apply / baseline[2],
+            candidate_count ? (double)enumerate_nanoseconds / candidate_count : 0.0, (double)candidate_count / pieces_per_size);
+        printf("board: %2u x %-2u  %u games, %llu lines, checksum %llu\n",
+            game.playfield.column_count, game.playfield.row_count, game_count, (unsigned long long)lines, (unsigned long long)checksum);
+    }
+    free(boards);
+    free(placements);
+    return 0;
+}
+
+// "N ns per <what>", or "no <what>" when there was nothing to time, so an empty average never reads as free.
+static const char* format_average_nanoseconds(char* buffer, size_t size, uint64_t nanoseconds, uint64_t count, const char* singular, const char* plural)
+{
+    if (count)  snprintf(buffer, size, "%.0f ns per %s", (double)nanoseconds / count, singular);
+    else        snprintf(buffer, size, "no %s", plural);
+    return buffer;
+}
+
+// Steers every piece of bot played games with finesse paths through tick, checks each lands where the bot asked,
+// and compares presses and ticks with the BotController, which turns and moves at the same time and never tucks.
+static int run_finesse_benchmark(uint32_t game_count, uint32_t pieces_per_game)
+{
+    BotSettings bot_settings = get_default_bot_settings();
+    bot_settings.beam_width = 16;
+    bot_settings.depth = 2;
+    bot_settings.thread_count = 1;
+    Bot* bot = create_bot(bot_settings);
+    const uint64_t create_start = get_monotonic_nanoseconds();
+    FinessePlanner* planner = create_finesse_planner();
+    const uint64_t create_nanoseconds = get_monotonic_nanoseconds() - create_start;
+    if (!bot || !planner)
+    {
+        destroy_bot(bot);
+        destroy_finesse_planner(planner);
+        return 1;
+    }
+
+    uint64_t pieces = 0;
+    uint64_t table_pieces = 0;
+    uint64_t table_nanoseconds = 0;
+    uint64_t search_nanoseconds = 0;
+    uint64_t keys = 0;
+    uint64_t finesse_ticks = 0;
+    uint64_t controller_pieces = 0;
+    uint64_t controller_ticks = 0;
+    uint64_t controller_ticks_same_pieces = 0;
+    uint64_t unreached = 0;
+    uint64_t mismatches = 0;
+    uint64_t every_placements = 0;
+    uint64_t every_found = 0;
+    uint64_t every_table = 0;
+    uint64_t every_table_nanoseconds = 0;
+    uint64_t every_search_nanoseconds = 0;
+    ACTION_BIT_FLAGS stream[BENCH_FINESSE_MAX_TICKS];
+    for (uint32_t g = 0; g < game_count; g++)
+    {
+        Game game = get_seeded_initialized_game(g + 1);
+        for (uint32_t i = 0; i < pieces_per_game && !is_game_over(&game); i++)
+        {
+            Placement placement;
+            if (!search_bot_placement(bot, &game, &placement, 0)) break;
+            if (i % BENCH_FINESSE_EVERY_PLACEMENT == 0)
+            {
+                for (uint8_t rotation = 0; rotation < PIECE_ROTATION_STATES; rotation++)
+                {
+                    for (uint8_t x = 0; x < game.playfield.column_count + COLUMN_OFFSET; x++)
+                    {
+                        for (uint8_t y = 0; y < game.playfield.row_count; y++)
+                        {
+                            const Placement every = { game.controlled_piece.type, x, y, rotation, false };
+                            if (!is_placement_valid(&game, every)) continue;
+                            FinessePath path;
+                            const uint64_t start = get_monotonic_nanoseconds();
+                            const bool is_found = find_finesse_path(planner, &game, every, &path);
+                            const uint64_t elapsed = get_monotonic_nanoseconds() - start;
+                            every_placements++;
+                            every_found += is_found;
+                            every_table += is_found && path.is_from_table;
+                            if (is_found && path.is_from_table)     every_table_nanoseconds += elapsed;
+                            else                                    every_search_nanoseconds += elapsed;
+                        }
+                    }
+                }
+            }
+            Game expected = game;
+            attempt_apply_placement(&expected, placement);
+
+            FinessePath path;
+            const uint64_t start = get_monotonic_nanoseconds();
+            const bool is_found = find_finesse_path(planner, &game, placement, &path);
+            const uint64_t elapsed = get_monotonic_nanoseconds() - start;
+            const uint32_t tick_count = is_found ? get_finesse_action_stream(planner, &game, placement, BENCH_TICK_DELTA_TIME, stream, BENCH_FINESSE_MAX_TICKS) : 0;
+            if (!tick_count)
+            {
+                unreached++;
+                game = expected;
+                continue;
+            }
+            if (path.is_from_table)
+            {
+                table_pieces++;
+                table_nanoseconds += elapsed;
+            }
+            else
+            {
+                search_nanoseconds += elapsed;
+            }
+            pieces++;
+            keys += path.key_count;
+            finesse_ticks += tick_count;
+
+            Game controlled = game;
+            BotController controller = { 0 };
+            Placement reached;
+            const uint32_t ticks = tick_until_placed(&controlled, &controller, placement, true, &reached);
+            if (ticks && are_placement_results_equal(&controlled, &expected))
+            {
+                controller_pieces++;
+                controller_ticks += ticks;
+                controller_ticks_same_pieces += tick_count;
+            }
+
+            for (uint32_t t = 0; t < tick_count; t++)
+            {
+                tick(&game, BENCH_TICK_DELTA_TIME, stream[t]);
+            }
+            if (!are_placement_results_equal(&game, &expected))
+            {
+                if (!mismatches) printf("finesse: game %u piece %u locked somewhere else\n", g, i);
+                mismatches++;
+                game = expected;
+            }
+        }
+    }
+    destroy_finesse_planner(planner);
+    destroy_bot(bot);
+
+    const uint64_t search_pieces = pieces - table_pieces;
+    printf("finesse: tables built in %.2f ms\n", create_nanoseconds / 1e6);
+    printf("finesse: %llu pieces, %llu from the tables (%.1f%%), %llu unreachable, %llu mismatches\n",
+        (unsigned long long)pieces, (unsigned long long)table_pieces, pieces ? 100.0 * table_pieces / pieces : 0.0,
+        (unsigned long long)unreached, (unsigned long long)mismatches);
+    char lookup_text[64];
+    char search_text[64];
+    printf("finesse: %s, %s\n",
+        format_average_nanoseconds(lookup_text, sizeof(lookup_text), table_nanoseconds, table_pieces, "table lookup", "table lookups"),
+        format_average_nanoseconds(search_text, sizeof(search_text), search_nanoseconds, search_pieces, "search", "searches"));
+    printf("finesse: %.2f presses and %.1f ticks per piece. BotController %.1f ticks per piece on the %llu pieces it also reached (finesse %.1f)\n",
+        pieces ? (double)keys / pieces : 0.0, pieces ? (double)finesse_ticks / pieces : 0.0,
+        controller_pieces ? (double)controller_ticks / controller_pieces : 0.0, (unsigned long long)controller_pieces,
+        controller_pieces ? (double)controller_ticks_same_pieces / controller_pieces : 0.0);
+    printf("finesse: every resting placement, %llu planned, %llu reachable, %llu from the tables. %s, %s\n",
+        (unsigned long long)every_placements, (unsigned long long)every_found, (unsigned long long)every_table,
+        format_average_nanoseconds(lookup_text, sizeof(lookup_text), every_table_nanoseconds, every_table, "lookup", "lookups"),
+        format_average_nanoseconds(search_text, sizeof(search_text), every_search_nanoseconds, every_placements - every_table, "search", "searches"));
+    return (mismatches || unreached) ? 1 : 0;
+}
+
+// Encodes a corpus in runs of keyframe_interval states, each run starting from a keyframe, then decodes it back and checks every state.
+static bool measure_codec(const char* name, const Game* games, uint32_t count, uint32_t keyframe_interval, uint32_t repetitions)
+{
+    const size_t capacity = (size_t)keyframe_interval * CODEC_MAX_ENCODED_SIZE;
+    uint8_t* data = malloc(((size_t)count / keyframe_interval + 1) * capacity);
+    size_t* offsets = malloc(((size_t)count / keyframe_interval + 2) * sizeof(size_t));
+    Game* decoded = malloc((size_t)count * sizeof(Game));
+    if (!data || !offsets || !decoded)
+    {
+        free(data);
+        free(offsets);
+        free(decoded);
+        return false;
+    }
+
+    uint32_t run_count = 0;
+    uint64_t start = get_monotonic_nanoseconds();
+    for (uint32_t r = 0; r < repetitions; r++)
+    {
+        size_t size = 0;
+        run_count = 0;
+        for (uint32_t i = 0; i < count; i += keyframe_interval)
+        {
+            offsets[run_count++] = size;
+            const uint32_t run = (count - i < keyframe_interval) ? count - i : keyframe_interval;
+            size += encode_game_states(&games[i], run, 0, &data[size], capacity);
+        }
+        offsets[run_count] = size;
+    }
+    const double encode_nanoseconds = (double)(get_monotonic_nanoseconds() - start) / repetitions / count;
+
+    bool is_malformed = false;
+    start = get_monotonic_nanoseconds();
+    for (uint32_t r = 0; r < repetitions; r++)
+    {
+        for (uint32_t j = 0; j < run_count; j++)
+        {
+            const uint32_t i = j * keyframe_interval;
+            const uint32_t run = (count - i < keyframe_interval) ? count - i : keyframe_interval;
+            is_malformed |= decode_game_states(&data[offsets[j]], offsets[j + 1] - offsets[j], 0, &decoded[i], run) != offsets[j + 1] - offsets[j];
+        }
+    }
+    const double decode_nanoseconds = (double)(get_monotonic_nanoseconds() - start) / repetitions / count;
+
+    uint32_t mismatches = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (!are_games_equal(&games[i], &decoded[i]))
+        {
+            if (!mismatches) printf("codec: %s, first mismatch at state %u\n", name, i);
+            mismatches++;
+        }
+    }
+    const double bytes = (double)offsets[run_count] / count;
+    printf("codec: %-6s keyframe every %-4u %7.1f bytes/state (%5.1fx), encode %6.1f ns, decode %6.1f ns (%6.0f MB/s of Game)%s\n",
+        name, keyframe_interval, bytes, sizeof(Game) / bytes, encode_nanoseconds, decode_nanoseconds,
+        sizeof(Game) / decode_nanoseconds * 1000.0, (is_malformed || mismatches) ? ", ROUND TRIP FAILED" : "");
+    free(data);
+    free(offsets);
+    free(decoded);
+    return !is_malformed && !mismatches;
+}
+
+// Builds corpora of real states, every tick of a bot session and every piece of bot versus matches (garbage included), and measures the codec on them.
+static int run_codec_benchmark(uint32_t minutes, uint32_t match_count)
+{
+    BotSettings bot_settings = get_default_bot_settings();
+    bot_settings.beam_width = 16;
+    bot_settings.depth = 2;
+    bot_settings.thread_count = 1;
+    Bot* bot = create_bot(bot_settings);
+    const uint32_t tick_capacity = minutes * 60 * 60;
+    const uint32_t piece_capacity = match_count * VERSUS_PLAYER_COUNT * BENCH_CODEC_MAX_PIECES;
+    Game* ticks = malloc((size_t)tick_capacity * sizeof(Game));
+    Game* pieces = malloc((size_t)piece_capacity * sizeof(Game));
+    if (!bot || !ticks || !pieces)
+    {
+        destroy_bot(bot);
+        free(ticks);
+        free(pieces);
+        return 1;
+    }
+
+    uint32_t tick_count = 0;
+    Game game = get_seeded_initialized_game(1);
+    BotController controller = { 0 };
+    while (tick_count < tick_capacity && !is_game_over(&game))
+    {
+        if (needs_bot_controller_target(&controller, &game))
+        {
+            Placement placement;
+            if (search_bot_placement(bot, &game, &placement, 0)) set_bot_controller_target(&controller, &game, placement);
+        }
+        tick(&game, BENCH_TICK_DELTA_TIME, get_bot_controller_action_bit_flags(&controller, &game));
+        ticks[tick_count++] = game;
+    }
+
+    // Each player's states go back to back, so only the first of each game is a big change.
+    uint32_t piece_count = 0;
+    for (uint32_t m = 0; m < match_count; m++)
+    {
+        VersusMatch match;
+        init_versus_match(&match, 1000 + m);
+        uint32_t counts[VERSUS_PLAYER_COUNT] = { 0 };
+        for (uint32_t i = 0; i < BENCH_CODEC_MAX_PIECES * VERSUS_PLAYER_COUNT && !match.is_over; i++)
+        {
+            const uint8_t player = i % VERSUS_PLAYER_COUNT;
+            Placement placement;
+            if (!search_bot_placement(bot, &match.players[player].game, &placement, 0)) break;
+            apply_versus_placement(&match, player, placement);
+            pieces[piece_count + player * BENCH_CODEC_MAX_PIECES + counts[player]++] = match.players[player].game;
+        }
+        memmove(&pieces[piece_count + counts[0]], &pieces[piece_count + BENCH_CODEC_MAX_PIECES], counts[1] * sizeof(Game));
+        piece_count += counts[0] + counts[1];
+    }
+    destroy_bot(bot);
+
+    printf("codec: %u ticks of one bot game, %u pieces of %u versus matches, sizeof(Game) %zu bytes\n", tick_count, piece_count, match_count, sizeof(Game));
+    bool is_exact = true;
+    is_exact &= measure_codec("pieces", pieces, piece_count, 1, 20);
+    is_exact &= measure_codec("pieces", pieces, piece_count, 64, 20);
+    is_exact &= measure_codec("ticks", ticks, tick_count, 1, 5);
+    is_exact &= measure_codec("ticks", ticks, tick_count, 64, 5);
+    is_exact &= measure_codec("ticks", ticks, tick_count, 1024, 5);
+    free(ticks);
+    free(pieces);
+    return is_exact ? 0 : 1;
+}
+
+static int compare_nanoseconds(const void* a, const void* b)
+{
+    const uint64_t x = *(const uint64_t*)a;
+    const uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static void print_latencies(const char* mode, const char* name, uint64_t* samples, uint32_t count)
+{
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < count; i++) total += samples[i];
+    qsort(samples, count, sizeof(uint64_t), compare_nanoseconds);
+    printf("%s: %-28s p50 %7.2f us, p99 %8.2f us, max %9.2f us, mean %7.2f us\n", mode, name,
+        samples[count / 2] / 1e3, samples[count * 99 / 100] / 1e3, samples[count - 1] / 1e3, (double)total / count / 1e3);
+}
+
+// The other side of the bridge, on a thread with its own mapping, so every handoff goes through the segment like it would from another process.
+static int run_bridge_bench_client(void* argument)
+{
+    Bridge* client = open_bridge_client(BENCH_BRIDGE_NAME, *(const uint32_t*)argument);
+    if (!client) return 1;
+    BridgeState state;
+    uint64_t tick = UINT64_MAX;
+    while (wait_bridge_state(client, tick, &state, BENCH_BRIDGE_TIMEOUT))
+    {
+        tick = state.tick;
+        send_bridge_action(client, tick, (tick % 2) ? 0 : ACTION_HARD_DROP);
+    }
+    destroy_bridge(client);
+    return 0;
+}
+
+// Lockstep ticks through the bridge, timed from publishing a state to having its action.
+static bool measure_bridge(const char* name, uint32_t spin_count, uint32_t tick_count, uint64_t* samples)
+{
+    Bridge* host = create_bridge_host(BENCH_BRIDGE_NAME, spin_count);
+    thrd_t thread;
+    if (!host) return false;
+    if (thrd_create(&thread, run_bridge_bench_client, &spin_count) != thrd_success)
+    {
+        destroy_bridge(host);
+        return false;
+    }
+    Game game = get_seeded_initialized_game(1);
+    uint32_t game_index = 0;
+    uint32_t count = 0;
+    for (uint64_t t = 0; t <= tick_count; t++)
+    {
+        const uint64_t start = get_monotonic_nanoseconds();
+        publish_bridge_state(host, &game, t, game_index);
+        ACTION_BIT_FLAGS action_bit_flags;
+        if (!wait_bridge_action(host, t, &action_bit_flags, BENCH_BRIDGE_TIMEOUT)) break;
+        if (t) samples[count++] = get_monotonic_nanoseconds() - start; // The first one waits for the client to map the segment.
+        tick(&game, BENCH_TICK_DELTA_TIME, action_bit_flags);
+        if (is_game_over(&game)) game = get_seeded_initialized_game(++game_index + 1);
+    }
+    stop_bridge_host(host);
+    thrd_join(thread, 0);
+    destroy_bridge(host);
+    if (count != tick_count) return false;
+    print_latencies("bridge", name, samples, count);
+    return true;
+}
+
+#if !defined(_WIN32)
+static int run_pipe_bench_client(void* argument)
+{
+    const int* pipes = argument;
+    BridgeState state;
+    BridgeAction action = { 0 };
+    while (read(pipes[0], &state, sizeof(state)) == (ssize_t)sizeof(state))
+    {
+        action.tick = state.tick;
+        if (write(pipes[3], &action, sizeof(action)) != (ssize_t)sizeof(action)) break;
+    }
+    return 0;
+}
+
+// The same exchange over two pipes, for what a stdio or socket bot protocol costs at best.
+static bool measure_pipes(uint32_t tick_count, uint64_t* samples)
+{
+    int pipes[4];
+    thrd_t thread;
+    if (pipe(&pipes[0]) != 0) return false;
+    if (pipe(&pipes[2]) != 0 || thrd_create(&thread, run_pipe_bench_client, pipes) != thrd_success)
+    {
+        close(pipes[0]);
+        close(pipes[1]);
+        return false;
+    }
+    BridgeState state = { 0 };
+    BridgeAction action;
+    uint32_t count = 0;
+    for (uint64_t t = 0; t <= tick_count; t++)
+    {
+        const uint64_t start = get_monotonic_nanoseconds();
+        state.tick = t;
+        if (write(pipes[1], &state, sizeof(state)) != (ssize_t)sizeof(state) || read(pipes[2], &action, sizeof(action)) != (ssize_t)sizeof(action)) break;
+        if (t) samples[count++] = get_monotonic_nanoseconds() - start;
+    }
+    close(pipes[1]); // The client's read sees the end and it returns.
+    thrd_join(thread, 0);
+    close(pipes[0]);
+    close(pipes[2]);
+    close(pipes[3]);
+    if (count != tick_count) return false;
+    print_latencies("bridge", "pipes (baseline)", samples, count);
+    return true;
+}
+#endif // _WIN32
+
+static int run_bridge_benchmark(uint32_t tick_count)
+{
+    uint64_t* samples = malloc((size_t)(tick_count ? tick_count : 1) * sizeof(uint64_t));
+    if (!samples || !tick_count)
+    {
+        free(samples);
+        return 1;
+    }
+    printf("bridge: %u lockstep ticks each, publish to action received\n", tick_count);
+    bool is_ok = measure_bridge("spin", BRIDGE_SPIN_FOREVER, tick_count, samples) &&
+        measure_bridge("spin then sleep (default)", BRIDGE_DEFAULT_SPIN_COUNT, tick_count, samples) &&
+        measure_bridge("sleep", 0, tick_count, samples);
+#if !defined(_WIN32)
+    is_ok = is_ok && measure_pipes(tick_count, samples);
+#endif // _WIN32
+    free(samples);
+    if (!is_ok) printf("bridge: a round trip timed out or the segment couldn't be created\n");
+    return is_ok ? 0 : 1;
+}
+
+static bool are_versus_matches_equal(const VersusMatch* a, const VersusMatch* b)
+{
+    for (uint8_t i = 0; i < VERSUS_PLAYER_COUNT; i++)
+    {
+        const VersusPlayer* pa = &a->players[i];
+        const VersusPlayer* pb = &b->players[i];
+        if (!are_games_equal(&pa->game, &pb->game) ||
+            pa->incoming.pending_lines != pb->incoming.pending_lines || pa->incoming.count != pb->incoming.count ||
+            pa->lines_sent != pb->lines_sent || pa->lines_received != pb->lines_received || pa->topped_out != pb->topped_out) return false;
+    }
+    return a->random_state == b->random_state && a->step_count == b->step_count && a->winner == b->winner && a->is_over == b->is_over;
+}
+
+// Two rollback sessions over a loopback link with latency, jitter and loss, fed the inputs of a bot match played straight through.
+// Both must end on exactly that match. Every advance is timed, and so is a rollback of BENCH_ROLLBACK_DEPTH frames.
+static int run_rollback_benchmark(uint32_t frame_count, uint32_t latency_ms, uint32_t jitter_ms, uint8_t loss_percent, uint8_t input_delay)
+{
+    // The reference: bots playing through tick, one BotController each, with every input logged.
+    BotSettings bot_settings = get_default_bot_settings();
+    bot_settings.beam_width = 8;
+    bot_settings.depth = 1;
+    bot_settings.thread_count = 1;
+    Bot* bot = create_bot(bot_settings);
+    ACTION_BIT_FLAGS* inputs = calloc((size_t)frame_count * VERSUS_PLAYER_COUNT, sizeof(ACTION_BIT_FLAGS));
+    RollbackSession* sessions = malloc((VERSUS_PLAYER_COUNT + 2) * sizeof(RollbackSession)); // And a snapshot and scratch for the timed rollback.
+    LoopbackLink* link = malloc(sizeof(LoopbackLink));
+    uint64_t* samples = malloc((size_t)frame_count * VERSUS_PLAYER_COUNT * sizeof(uint64_t));
+    if (!bot || !inputs || !sessions || !link || !samples || !frame_count)
+    {
+        destroy_bot(bot);
+        free(inputs);
+        free(sessions);
+        free(link);
+        free(samples);
+        return 1;
+    }
+    const uint64_t seed = 7;
+    VersusMatch reference;
+    init_versus_match(&reference, seed);
+    BotController controllers[VERSUS_PLAYER_COUNT] = { 0 };
+    // Nothing is pressed before the input delay runs out, the same as in a session.
+    for (uint32_t f = 0; f < frame_count && !reference.is_over; f++)
+    {
+        ACTION_BIT_FLAGS* frame_inputs = &inputs[(size_t)f * VERSUS_PLAYER_COUNT];
+        for (uint8_t i = 0; i < VERSUS_PLAYER_COUNT && f >= input_delay; i++)
+        {
+            const Game* game = &reference.players[i].game;
+            Placement placement;
+            if (needs_bot_controller_target(&controllers[i], game) && search_bot_placement(bot, game, &placement, 0))
+            {
+                set_bot_controller_target(&controllers[i], game, placement);
+            }
+            frame_inputs[i] = get_bot_controller_action_bit_flags(&controllers[i], game);
+        }
+        step_versus_match(&reference, frame_inputs, ROLLBACK_TICK_DELTA_TIME);
+    }
+    destroy_bot(bot);
+
+    init_loopback_link(link, seed, latency_ms * 1000, jitter_ms * 1000, loss_percent);
+    for (uint8_t i = 0; i < VERSUS_PLAYER_COUNT; i++)
+    {
+        init_rollback_session(&sessions[i], seed, i, input_delay);
+    }
+    // Every frame each side takes what arrived, adds its input, advances (or stalls) and sends.
+    RollbackSession* snapshot = &sessions[VERSUS_PLAYER_COUNT];
+    RollbackSession* scratch = &sessions[VERSUS_PLAYER_COUNT + 1];
+    const uint32_t snapshot_frame = reference.step_count / 2; // While the match is still going, so every resimulated frame does real work.
+    bool has_snapshot = false;
+    uint32_t sample_count = 0;
+    uint64_t now = 0;
+    uint64_t wall_frames = 0;
+    const uint32_t simulated_frames = reference.step_count; // Past the end of the match a frame steps nothing, so it isn't timed.
+    while (sessions[0].frame < simulated_frames || sessions[1].frame < simulated_frames ||
+        sessions[0].confirmed_frame < simulated_frames || sessions[1].confirmed_frame < simulated_frames)
+    {
+        for (uint8_t i = 0; i < VERSUS_PLAYER_COUNT; i++)
+        {
+            RollbackSession* session = &sessions[i];
+            RollbackPacket packet;
+            while (receive_loopback_packet(link, i, now, &packet)) receive_rollback_packet(session, &packet);
+            if (session->frame < simulated_frames)
+            {
+                const uint32_t input_frame = session->frame + session->input_delay;
+                add_rollback_local_input(session, (input_frame < frame_count) ? inputs[(size_t)input_frame * VERSUS_PLAYER_COUNT + i] : 0);
+                const uint64_t start = get_monotonic_nanoseconds();
+                if (advance_rollback_frame(session)) samples[sample_count++] = get_monotonic_nanoseconds() - start;
+                if (!i && session->frame == snapshot_frame && snapshot_frame >= BENCH_ROLLBACK_DEPTH)
+                {
+                    memcpy(snapshot, session, sizeof(RollbackSession));
+                    has_snapshot = true;
+                }
+            }
+            write_rollback_packet(session, &packet);
+            send_loopback_packet(link, (i + 1) % VERSUS_PLAYER_COUNT, &packet, now);
+        }
+        now += BENCH_FRAME_MICROSECONDS;
+        wall_frames++;
+    }
+
+    bool is_equal = true;
+    for (uint8_t i = 0; i < VERSUS_PLAYER_COUNT; i++)
+    {
+        settle_rollback_session(&sessions[i]);
+        is_equal &= are_versus_matches_equal(&sessions[i].match, &reference);
+    }
+
+    // The worst case a frame has to absorb: restore a save and resimulate BENCH_ROLLBACK_DEPTH frames, from the middle of the match.
+    const uint32_t repetitions = 20000;
+    double rollback_microseconds = 0.0;
+    if (has_snapshot)
+    {
+        const uint64_t start = get_monotonic_nanoseconds();
+        for (uint32_t r = 0; r < repetitions; r++)
+        {
+            memcpy(scratch, snapshot, sizeof(RollbackSession));
+            scratch->rollback_frame = scratch->frame - BENCH_ROLLBACK_DEPTH;
+            settle_rollback_session(scratch);
+        }
+        const uint64_t copy_start = get_monotonic_nanoseconds();
+        for (uint32_t r = 0; r < repetitions; r++)
+        {
+            memcpy(scratch, snapshot, sizeof(RollbackSession)); // Only there to reset scratch, so it is taken back out.
+        }
+        const uint64_t copy_nanoseconds = get_monotonic_nanoseconds() - copy_start;
+        rollback_microseconds = ((double)(copy_start - start) - (double)copy_nanoseconds) / repetitions / 1e3;
+    }
+
+    printf("rollback: a %u frame match (of at most %u), %u ms latency, %u ms jitter, %u%% loss, %u frame input delay, %zu byte session\n",
+        simulated_frames, frame_count, latency_ms, jitter_ms, loss_percent, input_delay, sizeof(RollbackSession));
+    for (uint8_t i = 0; i < VERSUS_PLAYER_COUNT; i++)
+    {
+        const RollbackStats* stats = &sessions[i].stats;
+        printf("rollback: player %u: %llu rollbacks (%.1f frames on average, %u at most), %llu mispredictions, %llu stalled frames\n", i,
+            (unsigned long long)stats->rollback_count, stats->rollback_count ? (double)stats->resimulated_frame_count / stats->rollback_count : 0.0,
+            stats->max_rollback_frames, (unsigned long long)stats->misprediction_count, (unsigned long long)stats->stall_count);
+    }
+    printf("rollback: %llu packets sent, %llu lost, %llu wall frames to play and confirm it all\n",
+        (unsigned long long)link->sent_count, (unsigned long long)link->dropped_count, (unsigned long long)wall_frames);
+    if (sample_count) print_latencies("rollback", "advance", samples, sample_count);
+    printf("rollback: restoring and resimulating %u frames takes %.2f us, %.3f%% of a 60 Hz frame\n",
+        BENCH_ROLLBACK_DEPTH, rollback_microseconds, rollback_microseconds / BENCH_FRAME_MICROSECONDS * 100.0);
+    printf("rollback: both sides %s the match played straight through\n", is_equal ? "ended on" : "DIVERGED from");
+    free(inputs);
+    free(sessions);
+    free(link);
+    free(samples);
+    return is_equal ? 0 : 1;
+}
+
+static void print_allocator_stats(const char* name, AllocatorStats stats)
+{
+    printf("alloc: %-10s %8.1f KiB high water of %8.1f KiB, %.2e allocations/s, %llu failed, %s pages\n", name,
+        stats.high_water / 1024.0, stats.capacity / 1024.0, stats.allocations_per_second, (unsigned long long)stats.failed_count,
+        stats.is_huge_page_backed ? "huge" : "normal (or transparent huge)");
+}
+
+// Game snapshots taken and dropped every move, through malloc and through the allocators, then the searches on their own memory.
+static int run_allocator_benchmark(uint32_t move_count, bool use_huge_pages)
+{
+    Game base = get_seeded_initialized_game(1);
+    Game* snapshots[BENCH_SNAPSHOTS_PER_MOVE];
+    uint64_t checksum = 0;
+
+    uint64_t start = get_monotonic_nanoseconds();
+    for (uint32_t m = 0; m < move_count; m++)
+    {
+        base.score = m;
+        for (uint32_t i = 0; i < BENCH_SNAPSHOTS_PER_MOVE; i++)
+        {
+            snapshots[i] = malloc(sizeof(Game));
+            if (!snapshots[i]) return 1;
+            *snapshots[i] = base;
+        }
+        for (uint32_t i = 0; i < BENCH_SNAPSHOTS_PER_MOVE; i++)
+        {
+            checksum += snapshots[i]->score;
+            free(snapshots[i]);
+        }
+    }
+    const uint64_t malloc_elapsed = get_monotonic_nanoseconds() - start;
+
+    Pool pool;
+    if (!init_pool(&pool, sizeof(Game), BENCH_SNAPSHOTS_PER_MOVE, use_huge_pages)) return 1;
+    start = get_monotonic_nanoseconds();
+    for (uint32_t m = 0; m < move_count; m++)
+    {
+        base.score = m;
+        for (uint32_t i = 0; i < BENCH_SNAPSHOTS_PER_MOVE; i++)
+        {
+            snapshots[i] = take_pool_item(&pool);
+            *snapshots[i] = base;
+        }
+        for (uint32_t i = 0; i < BENCH_SNAPSHOTS_PER_MOVE; i++)
+        {
+            checksum += snapshots[i]->score;
+            give_pool_item(&pool, snapshots[i]);
+        }
+    }
+    const uint64_t pool_elapsed = get_monotonic_nanoseconds() - start;
+
+    Arena arena;
+    if (!init_arena(&arena, BENCH_SNAPSHOTS_PER_MOVE * sizeof(Game), use_huge_pages)) return 1;
+    start = get_monotonic_nanoseconds();
+    for (uint32_t m = 0; m < move_count; m++)
+    {
+        base.score = m;
+        for (uint32_t i = 0; i < BENCH_SNAPSHOTS_PER_MOVE; i++)
+        {
+            snapshots[i] = allocate_from_arena(&arena, sizeof(Game), _Alignof(Game));
+            *snapshots[i] = base;
+        }
+        for (uint32_t i = 0; i < BENCH_SNAPSHOTS_PER_MOVE; i++)
+        {
+            checksum += snapshots[i]->score;
+        }
+        reset_arena(&arena);
+    }
+    const uint64_t arena_elapsed = get_monotonic_nanoseconds() - start;
+
+    const double snapshot_count = (double)move_count * BENCH_SNAPSHOTS_PER_MOVE;
+    printf("alloc: %u moves of %u Game snapshots (%zu bytes each), checksum %llu\n", move_count, BENCH_SNAPSHOTS_PER_MOVE, sizeof(Game), (unsigned long long)checksum);
+    printf("alloc: malloc %6.1f ns, pool %6.1f ns, arena %6.1f ns per snapshot, copy included\n",
+        malloc_elapsed / snapshot_count, pool_elapsed / snapshot_count, arena_elapsed / snapshot_count);
+    print_allocator_stats("pool", get_pool_stats(&pool));
+    print_allocator_stats("arena", get_arena_stats(&arena));
+    release_arena(&arena);
+    release_pool(&pool);
+
+    // The bag refill every seventh piece, rollouts included.
+    PieceData* bag[PIECE_COUNT];
+    memcpy(bag, base.piece_queue, sizeof(bag));
+    uint64_t random_state = 1;
+    start = get_monotonic_nanoseconds();
+    for (uint32_t m = 0; m < move_count; m++)
+    {
+        shuffle(bag, PIECE_COUNT, sizeof(PieceData*), &random_state);
+        checksum += bag[0]->type;
+    }
+    printf("alloc: shuffle %.1f ns per bag, checksum %llu\n", (double)(get_monotonic_nanoseconds() - start) / move_count, (unsigned long long)checksum);
+
+    BotSettings bot_settings = get_default_bot_settings();
+    bot_settings.use_huge_pages = use_huge_pages;
+    MctsSettings mcts_settings = get_default_mcts_settings();
+    mcts_settings.use_huge_pages = use_huge_pages;
+    mcts_settings.time_budget = 2 * NANOSECONDS_PER_MILLISECOND;
+    Bot* bot = create_bot(bot_settings);
+    Mcts* mcts = create_mcts(mcts_settings);
+    if (!bot || !mcts) return 1;
+    Game game = get_seeded_initialized_game(1);
+    uint64_t search_nanoseconds = 0;
+    uint32_t searches = 0;
+    for (; searches < 50 && !is_game_over(&game); searches++)
+    {
+        Placement placement;
+        BotSearchStats stats;
+        if (!search_bot_placement(bot, &game, &placement, &stats) || !attempt_apply_placement(&game, placement)) break;
+        search_nanoseconds += stats.elapsed;
+    }
+    game = get_seeded_initialized_game(1);
+    for (uint32_t i = 0; i < 20 && !is_game_over(&game); i++)
+    {
+        Placement placement;
+        if (!search_mcts_placement(mcts, &game, &placement, 0) || !attempt_apply_placement(&game, placement)) break;
+        advance_mcts(mcts, placement);
+    }
+    printf("alloc: bot %.2f ms per search over %u searches, %s huge pages\n", searches ? search_nanoseconds / 1e6 / searches : 0.0, searches,
+        use_huge_pages ? "with" : "without");
+    print_allocator_stats("bot nodes", get_bot_node_stats(bot));
+    print_allocator_stats("mcts nodes", get_mcts_node_stats(mcts));
+    destroy_mcts(mcts);
+    destroy_bot(bot);
+    return 0;
+}
+
+// What a trace point costs off and on, in a loop and inside tick, then a traced bot search on every thread written out.
+static int run_trace_benchmark(uint32_t point_count, const char* path)
+{
+    set_trace_enabled(false);
+    uint64_t start = get_monotonic_nanoseconds();
+    for (uint32_t i = 0; i < point_count; i++)
+    {
+        TRACE_BEGIN("bench");
+        TRACE_END("bench");
+    }
+    const uint64_t off_elapsed = get_monotonic_nanoseconds() - start;
+    set_trace_enabled(true);
+    start = get_monotonic_nanoseconds();
+    for (uint32_t i = 0; i < point_count; i++)
+    {
+        TRACE_BEGIN("bench");
+        TRACE_END("bench");
+    }
+    const uint64_t on_elapsed = get_monotonic_nanoseconds() - start;
+    printf("trace: a trace point takes %.2f ns off, %.2f ns on\n", off_elapsed / (2.0 * point_count), on_elapsed / (2.0 * point_count));
+
+    // The same ticks both ways: instant inputs, so every other tick locks a piece.
+    uint64_t tick_elapsed[2];
+    uint64_t checksum = 0;
+    for (uint8_t pass = 0; pass < 2; pass++)
+    {
+        set_trace_enabled(pass == 1);
+        Game game = get_seeded_initialized_game(1);
+        start = get_monotonic_nanoseconds();
+        for (uint32_t i = 0; i < point_count; i++)
+        {
+            if (is_game_over(&game)) reset_game(&game);
+            tick(&game, BENCH_TICK_DELTA_TIME, (i & 1) ? ACTION_HARD_DROP : 0);
+        }
+        tick_elapsed[pass] = get_monotonic_nanoseconds() - start;
+        checksum += game.placed_piece_count;
+    }
+    printf("trace: tick %.1f ns off, %.1f ns on, checksum %llu\n", (double)tick_elapsed[0] / point_count, (double)tick_elapsed[1] / point_count,
+        (unsigned long long)checksum);
+
+    BotSettings settings = get_default_bot_settings();
+    Bot* bot = create_bot(settings);
+    if (!bot) return 1;
+    set_trace_thread_name("bench");
+    Game game = get_seeded_initialized_game(1);
+    for (uint32_t i = 0; i < 20 && !is_game_over(&game); i++)
+    {
+        Placement placement;
+        if (!search_bot_placement(bot, &game, &placement, 0) || !attempt_apply_placement(&game, placement)) break;
+    }
+    set_trace_enabled(false);
+    start = get_monotonic_nanoseconds();
+    const bool written = write_trace(path);
+    printf("trace: wrote %s in %.2f ms%s\n", path, (get_monotonic_nanoseconds() - start) / 1e6, written ? "" : ", WRITE FAILED");
+    destroy_bot(bot);
+    return written ? 0 : 1;
+}
+
+// Seeded games played by a bot with the book and one without, both set up like the book's searches. Every book hit is searched
+// too, so the book is checked against what it replaces.
+static int run_book_benchmark(const char* path, uint32_t game_count)
+{
+    OpeningBook* book = open_opening_book(path);
+    if (!book)
+    {
+        printf("book: %s is not an opening book for this build\n", path);
+        return 1;
+    }
+    const OpeningBookInfo info = get_opening_book_info(book);
+    BotSettings settings = get_default_bot_settings();
+    settings.beam_width = info.beam_width;
+    settings.depth = info.depth;
+    settings.thread_count = 1;
+    settings.time_budget = 60 * NANOSECONDS_PER_SECOND;
+    Bot* searching_bot = create_bot(settings);
+    settings.opening_book = book;
+    Bot* book_bot = create_bot(settings);
+    if (!searching_bot || !book_bot)
+    {
+        destroy_bot(book_bot);
+        destroy_bot(searching_bot);
+        close_opening_book(book);
+        return 1;
+    }
+
+    uint32_t hit_counts[OPENING_BOOK_MAX_PLIES + BENCH_BOOK_EXTRA_PIECES] = { 0 };
+    uint32_t agreed_count = 0;
+    uint32_t hit_count = 0;
+    uint64_t book_elapsed = 0;
+    uint64_t search_elapsed = 0;
+    uint64_t probe_elapsed = 0;
+    const uint8_t piece_count = info.plies + BENCH_BOOK_EXTRA_PIECES;
+    for (uint32_t g = 0; g < game_count; g++)
+    {
+        Game game = get_seeded_initialized_game(g + 1);
+        for (uint8_t p = 0; p < piece_count && !is_game_over(&game); p++)
+        {
+            Placement placement;
+            BotSearchStats stats;
+            if (!search_bot_placement(book_bot, &game, &placement, &stats)) break;
+            if (stats.is_from_book)
+            {
+                Placement searched;
+                BotSearchStats search_stats;
+                search_bot_placement(searching_bot, &game, &searched, &search_stats);
+                agreed_count += memcmp(&placement, &searched, sizeof(Placement)) == 0;
+                book_elapsed += stats.elapsed;
+                search_elapsed += search_stats.elapsed;
+                Placement probed;
+                const uint64_t probe_start = get_monotonic_nanoseconds();
+                for (uint32_t r = 0; r < BENCH_BOOK_PROBE_REPEATS; r++)
+                {
+                    find_opening_book_placement(book, &game, &probed, 0);
+                }
+                probe_elapsed += get_monotonic_nanoseconds() - probe_start;
+                hit_counts[p]++;
+                hit_count++;
+            }
+            if (!attempt_apply_placement(&game, placement)) break;
+        }
+    }
+    printf("book: %u positions, %u plies, beam %u, depth %u, %u games\n", info.entry_count, info.plies, info.beam_width, info.depth, game_count);
+    printf("book: hits by piece:");
+    for (uint8_t p = 0; p < piece_count; p++)
+    {
+        printf(" %u", hit_counts[p]);
+    }
+    printf("\nbook: %u of %u hits the same as searching\n", agreed_count, hit_count);
+    if (hit_count)
+    {
+        // A hit is the bot's first touch of the position: the probe cold, page faults included, and the placement check.
+        printf("book: %.2f us a hit through the bot, %.1f ns a lookup on its own with the position in cache, against %.2f ms a search\n",
+            book_elapsed / 1e3 / hit_count, (double)probe_elapsed / ((uint64_t)hit_count * BENCH_BOOK_PROBE_REPEATS), search_elapsed / 1e6 / hit_count);
+    }
+    destroy_bot(book_bot);
+    destroy_bot(searching_bot);
+    close_opening_book(book);
+    return (agreed_count == hit_count) ? 0 : 1;
+}
+
+// Whether every cell is in the bottom lines and every column is filled from the floor up, like a perfect clear opener.
+static bool is_perfect_clear_setup(const Playfield* playfield, uint8_t lines)
+{
+    PlayfieldRow below = get_playfield_full_row(playfield);
+    for (uint8_t y = playfield->row_count; y-- > 0;)
+    {
+        const PlayfieldRow row = playfield->cells[y];
+        if (row && y < playfield->row_count - lines) return false;
+        if (row & ~below) return false;
+        below = row;
+    }
+    return true;
+}
+
+// Drops piece_count pieces at random places that keep the board a setup without clearing a line. False if it paints itself into a corner.
+static bool drop_perfect_clear_setup(Game* game, uint8_t piece_count, uint64_t* random_state)
+{
+    Placement placements[MAX_DROP_PLACEMENT_COUNT];
+    for (uint8_t p = 0; p < piece_count; p++)
+    {
+        const uint16_t count = get_drop_placements(game, true, placements);
+        bool is_placed = false;
+        for (uint16_t tries = 0; tries < count && !is_placed; tries++)
+        {
+            Game next = *game;
+            if (!attempt_apply_placement(&next, placements[next_random(random_state) % count]) || next.cleared_lines_last_piece ||
+                !is_perfect_clear_setup(&next.playfield, BENCH_PC_LINES))
+            {
+                continue;
+            }
+            *game = next;
+            is_placed = true;
+        }
+        if (!is_placed) return false;
+    }
+    return true;
+}
+
+// Random setups are nearly always dead ends, so only ones the oracle, which sees the whole next bag, can clear are kept.
+static bool make_perfect_clear_setup(Game* game, uint64_t seed, uint8_t piece_count, PerfectClearSolver* oracle, uint64_t* random_state)
+{
+    for (uint32_t tries = 0; tries < BENCH_PC_SETUP_TRIES; tries++)
+    {
+        *game = get_seeded_initialized_game(seed);
+        PerfectClearSolution solution;
+        if (drop_perfect_clear_setup(game, piece_count, random_state) && solve_perfect_clear(oracle, game, &solution, 0) == PERFECT_CLEAR_FOUND) return true;
+    }
+    return false;
+}
+
+static bool is_perfect_clear_solution(Game game, const PerfectClearSolution* solution)
+{
+    for (uint8_t i = 0; i < solution->placement_count; i++)
+    {
+        if (!attempt_apply_placement(&game, solution->placements[i])) return false;
+    }
+    for (uint8_t y = 0; y < game.playfield.row_count; y++)
+    {
+        if (game.playfield.cells[y]) return false;
+    }
+    return true;
+}
+
+// Random 4 line setups with 3 to 6 pieces placed that can be cleared, solved with the pieces a player sees (which isn't always
+// enough). Each is solved again on one thread, which has to give the same answer, and every answer is played out on the game to
+// check it empties the board.
+static int run_perfect_clear_benchmark(uint32_t setup_count, uint64_t time_budget, uint8_t thread_count)
+{
+    PerfectClearSettings settings = get_default_perfect_clear_settings();
+    settings.time_budget = time_budget;
+    settings.thread_count = thread_count;
+    PerfectClearSolver* solver = create_perfect_clear_solver(settings);
+    settings.thread_count = 1;
+    PerfectClearSolver* single_solver = create_perfect_clear_solver(settings);
+    settings.queue_length = PIECE_COUNT;
+    settings.time_budget = 10 * NANOSECONDS_PER_SECOND;
+    PerfectClearSolver* oracle = create_perfect_clear_solver(settings);
+    if (!solver || !single_solver || !oracle)
+    {
+        destroy_perfect_clear_solver(solver);
+        destroy_perfect_clear_solver(single_solver);
+        destroy_perfect_clear_solver(oracle);
+        return 1;
+    }
+
+    uint32_t status_counts[PERFECT_CLEAR_TIMED_OUT + 1] = { 0 };
+    uint32_t invalid_count = 0;
+    uint32_t disagreed_count = 0;
+    uint32_t compared_count = 0;
+    uint32_t skipped_count = 0;
+    uint64_t elapsed = 0;
+    uint64_t max_elapsed = 0;
+    uint64_t found_elapsed = 0;
+    uint64_t visited_nodes = 0;
+    uint64_t pruned_nodes = 0;
+    uint64_t memo_hits = 0;
+    uint64_t random_state = 1;
+    for (uint32_t s = 0; s < setup_count; s++)
+    {
+        Game game;
+        if (!make_perfect_clear_setup(&game, s + 1, (uint8_t)(3 + s % 4), oracle, &random_state))
+        {
+            skipped_count++;
+            continue;
+        }
+        PerfectClearSolution solution;
+        PerfectClearStats stats;
+        const PerfectClearStatus status = solve_perfect_clear(solver, &game, &solution, &stats);
+        status_counts[status]++;
+        elapsed += stats.elapsed;
+        if (stats.elapsed > max_elapsed) max_elapsed = stats.elapsed;
+        visited_nodes += stats.visited_nodes;
+        pruned_nodes += stats.pruned_nodes;
+        memo_hits += stats.memo_hits;
+        if (status == PERFECT_CLEAR_FOUND)
+        {
+            found_elapsed += stats.elapsed;
+            invalid_count += !is_perfect_clear_solution(game, &solution);
+        }
+
+        PerfectClearSolution single_solution;
+        const PerfectClearStatus single_status = solve_perfect_clear(single_solver, &game, &single_solution, 0);
+        if (status == PERFECT_CLEAR_TIMED_OUT || single_status == PERFECT_CLEAR_TIMED_OUT) continue;
+        compared_count++;
+        disagreed_count += status != single_status || (status == PERFECT_CLEAR_FOUND &&
+            (solution.placement_count != single_solution.placement_count ||
+             memcmp(solution.placements, single_solution.placements, solution.placement_count * sizeof(Placement)) != 0));
+    }
+    const uint32_t solved_count = setup_count - skipped_count;
+    printf("pc: %u setups in %u lines (%u skipped), %u ms budget, %u threads\n", solved_count, BENCH_PC_LINES, skipped_count,
+        (uint32_t)(time_budget / NANOSECONDS_PER_MILLISECOND), thread_count);
+    printf("pc: %u found, %u impossible, %u timed out, %.2f ms mean, %.2f ms mean when found, %.2f ms max\n",
+        status_counts[PERFECT_CLEAR_FOUND], status_counts[PERFECT_CLEAR_IMPOSSIBLE], status_counts[PERFECT_CLEAR_TIMED_OUT],
+        solved_count ? elapsed / 1e6 / solved_count : 0.0, status_counts[PERFECT_CLEAR_FOUND] ? found_elapsed / 1e6 / status_counts[PERFECT_CLEAR_FOUND] : 0.0,
+        max_elapsed / 1e6);
+    printf("pc: %llu nodes, %.0f%% pruned, %llu memo hits, %.0f nodes/s\n", (unsigned long long)visited_nodes,
+        visited_nodes ? 100.0 * pruned_nodes / visited_nodes : 0.0, (unsigned long long)memo_hits, elapsed ? visited_nodes / (elapsed / 1e9) : 0.0);
+    printf("pc: %u invalid solutions, %u of %u differ on one thread\n", invalid_count, disagreed_count, compared_count);
+    destroy_perfect_clear_solver(oracle);
+    destroy_perfect_clear_solver(single_solver);
+    destroy_perfect_clear_solver(solver);
+    return (invalid_count == 0 && disagreed_count == 0) ? 0 : 1;
+}
+
+// Random presses for an env, with a hard drop one step in eight so games end and get reset often.
+static ACTION_BIT_FLAGS get_random_env_action(uint64_t* random_state)
+{
+    const uint64_t value = next_random(random_state);
+    return (ACTION_BIT_FLAGS)((value & ~(uint64_t)(ACTION_HARD_DROP | ACTION_PAUSE)) | ((value >> 8) % 8 == 0 ? ACTION_HARD_DROP : 0));
+}
+
+// Steps a batch of envs through env_step with random presses and checks every step against plain tick on games started from the
+// same seeds, the ones given to games reset after a game over included: observation, reward and done. Then times env_step alone
+// and the same steps through tick alone, so the wrapper's cost shows.
+static int run_env_benchmark(uint32_t env_count, uint32_t step_count)
+{
+    const uint64_t seed = 1;
+    EnvBatch* envs = env_create(env_count, seed);
+    Game* games = malloc((size_t)env_count * sizeof(Game));
+    ACTION_BIT_FLAGS* actions = malloc((size_t)BENCH_ENV_ACTION_ROWS * env_count * sizeof(ACTION_BIT_FLAGS));
+    EnvObservation* observations = malloc((size_t)env_count * sizeof(EnvObservation));
+    float* rewards = malloc((size_t)env_count * sizeof(float));
+    uint8_t* dones = malloc((size_t)env_count);
+    if (!envs || !games || !actions || !observations || !rewards || !dones)
+    {
+        env_destroy(envs);
+        free(games);
+        free(actions);
+        free(observations);
+        free(rewards);
+        free(dones);
+        printf("env: out of memory\n");
+        return 1;
+    }
+    uint64_t random_state = seed;
+    for (size_t i = 0; i < (size_t)BENCH_ENV_ACTION_ROWS * env_count; i++)
+    {
+        actions[i] = get_random_env_action(&random_state);
+    }
+
+    // The reference draws seeds the way env.c does: one per game, in index order, at creation and then at every reset.
+    uint64_t seed_state = seed;
+    for (uint32_t i = 0; i < env_count; i++)
+    {
+        games[i] = get_seeded_initialized_game(next_random(&seed_state));
+        games[i].controlled_piece_ground_y = get_playfield_piece_cells_hard_drop_y(&games[i].playfield, games[i].controlled_piece.cells,
+            games[i].controlled_piece.size, games[i].controlled_piece.pos_x, games[i].controlled_piece.pos_y);
+    }
+    uint64_t mismatch_count = 0;
+    uint64_t reset_count = 0;
+    for (uint32_t step = 0; step < step_count; step++)
+    {
+        const ACTION_BIT_FLAGS* step_actions = &actions[(size_t)(step % BENCH_ENV_ACTION_ROWS) * env_count];
+        env_step(envs, step_actions, env_count, observations, rewards, dones);
+        for (uint32_t i = 0; i < env_count; i++)
+        {
+            Game* game = &games[i];
+            const uint64_t previous_score = game->score;
+            tick(game, ENV_TICK_DELTA_TIME, step_actions[i] & ~ACTION_PAUSE);
+            const float reward = (float)(game->score - previous_score);
+            const bool done = is_game_over(game);
+            if (done)
+            {
+                *game = get_seeded_initialized_game(next_random(&seed_state));
+                game->controlled_piece_ground_y = get_playfield_piece_cells_hard_drop_y(&game->playfield, game->controlled_piece.cells,
+                    game->controlled_piece.size, game->controlled_piece.pos_x, game->controlled_piece.pos_y);
+                reset_count++;
+            }
+            EnvObservation expected;
+            write_env_observation(game, &expected);
+            if (memcmp(&expected, &observations[i], sizeof(EnvObservation)) != 0 || reward != rewards[i] || done != dones[i])
+            {
+                if (mismatch_count < 5) printf("env: mismatch at step %u, env %u\n", step, i);
+                mismatch_count++;
+            }
+        }
+    }
+    printf("env: %u envs, %u steps, %llu resets, %llu mismatches with tick\n", env_count, step_count,
+        (unsigned long long)reset_count, (unsigned long long)mismatch_count);
+
+    // Timed from the same seeds, env_step on its own and then the reference's tick and reset loop without the observation.
+    env_destroy(envs);
+    envs = env_create(env_count, seed);
+    if (!envs)
+    {
+        free(games);
+        free(actions);
+        free(observations);
+        free(rewards);
+        free(dones);
+        printf("env: out of memory\n");
+        return 1;
+    }
+    uint64_t start = get_monotonic_nanoseconds();
+    for (uint32_t step = 0; step < step_count; step++)
+    {
+        env_step(envs, &actions[(size_t)(step % BENCH_ENV_ACTION_ROWS) * env_count], env_count, observations, rewards, dones);
+    }
+    const uint64_t env_nanoseconds = get_monotonic_nanoseconds() - start;
+    seed_state = seed;
+    for (uint32_t i = 0; i < env_count; i++)
+    {
+        games[i] = get_seeded_initialized_game(next_random(&seed_state));
+    }
+    start = get_monotonic_nanoseconds();
+    for (uint32_t step = 0; step < step_count; step++)
+    {
+        const ACTION_BIT_FLAGS* step_actions = &actions[(size_t)(step % BENCH_ENV_ACTION_ROWS) * env_count];
+        for (uint32_t i = 0; i < env_count; i++)
+        {
+            tick(&games[i], ENV_TICK_DELTA_TIME, step_actions[i]);
+            if (is_game_over(&games[i])) games[i] = get_seeded_initialized_game(next_random(&seed_state));
+        }
+    }
+    const uint64_t tick_nanoseconds = get_monotonic_nanoseconds() - start;
+    const double env_steps = (double)env_count * step_count;
+    printf("env: env_step %.1f ns per env step, %.0f env steps/s\n", env_nanoseconds / env_steps, env_steps / (env_nanoseconds / 1e9));
+    printf("env: tick and reset alone %.1f ns per step, %.0f steps/s\n", tick_nanoseconds / env_steps, env_steps / (tick_nanoseconds / 1e9));
+
+    env_destroy(envs);
+    free(games);
+    free(actions);
+    free(observations);
+    free(rewards);
+    free(dones);
+    // Without resets the seeds games get after a game over were never checked.
+    if (!reset_count)
+    {
+        printf("env: no game ended, raise the steps\n");
+        return 1;
+    }
+    return mismatch_count ? 1 : 0;
+}
+
+// Element at index of an encoder output, as a float whatever the dtype.
+static void set_observation_element(void* out, ObservationDType dtype, size_t index, uint8_t value)
+{
+    if (dtype == OBSERVATION_DTYPE_FLOAT32) ((float*)out)[index] = (float)value;
+    else                                    ((uint8_t*)out)[index] = value;
+}
+
+// Whether the piece of obs covers cell x, y when it sits at row pos_y, read cell by cell from PIECE_ROTATION_CELLS.
+static uint8_t is_observation_piece_cell(const EnvObservation* obs, uint8_t pos_y, int x, int y)
+{
+    const PieceCells cells = PIECE_ROTATION_CELLS[obs->piece_type <= PIECE_COUNT ? obs->piece_type : 0][obs->piece_rotation & (PIECE_ROTATION_STATES - 1)];
+    const int piece_x = x - ((int)obs->piece_x - COLUMN_OFFSET);
+    const int piece_y = y - pos_y;
+    if (piece_x < 0 || piece_x >= PIECE_MAX_SIZE || piece_y < 0 || piece_y >= PIECE_MAX_SIZE) return 0;
+    return (cells >> (PIECE_MAX_SIZE * piece_y + piece_x)) & 1;
+}
+
+// encode_observation_planes one element at a time, straight from the definitions in observation.h.
+static void encode_reference_observation_planes(const EnvObservation* obs, uint32_t n, OBSERVATION_PLANE_BIT_FLAGS plane_bit_flags, ObservationLayout layout, ObservationDType dtype, void* out)
+{
+    const uint8_t channel_count = count_set_bits(plane_bit_flags & OBSERVATION_PLANES_ALL);
+    for (uint32_t i = 0; i < n; i++)
+    {
+        uint8_t c = 0;
+        for (uint8_t plane = 0; plane < OBSERVATION_PLANE_COUNT; plane++)
+        {
+            if (!(plane_bit_flags & (1U << plane))) continue;
+            for (int y = 0; y < OBSERVATION_PLANE_HEIGHT; y++)
+            {
+                for (int x = 0; x < OBSERVATION_PLANE_WIDTH; x++)
+                {
+                    uint8_t value;
+                    if (plane == 0)      value = (obs[i].rows[y] >> x) & 1;
+                    else if (plane == 1) value = is_observation_piece_cell(&obs[i], obs[i].piece_y, x, y);
+                    else                 value = is_observation_piece_cell(&obs[i], obs[i].ghost_y, x, y);
+                    const size_t cell = (size_t)y * OBSERVATION_PLANE_WIDTH + x;
+                    const size_t index = (layout == OBSERVATION_LAYOUT_NCHW) ? ((size_t)i * channel_count + c) * OBSERVATION_PLANE_CELL_COUNT + cell
+                                                                              : ((size_t)i * OBSERVATION_PLANE_CELL_COUNT + cell) * channel_count + c;
+                    set_observation_element(out, dtype, index, value);
+                }
+            }
+            c++;
+        }
+    }
+}
+
+static void encode_reference_observation_one_hot(const EnvObservation* obs, uint32_t n, ObservationDType dtype, void* out)
+{
+    for (uint32_t i = 0; i < n; i++)
+    {
+        for (uint8_t slot = 0; slot < OBSERVATION_PIECE_SLOT_COUNT; slot++)
+        {
+            const uint8_t type = (slot == 0) ? obs[i].held_type : obs[i].queue[slot - 1];
+            for (uint8_t t = 1; t <= PIECE_COUNT; t++)
+            {
+                set_observation_element(out, dtype, (size_t)i * OBSERVATION_ONE_HOT_SIZE + slot * PIECE_COUNT + (t - 1), type == t);
+            }
+        }
+    }
+}
+
+// One encoder configuration: a plane set, or 0 for the one-hot encoder.
+typedef struct {
+    OBSERVATION_PLANE_BIT_FLAGS plane_bit_flags;
+    ObservationLayout layout;
+    ObservationDType dtype;
+} BenchObservationEncoding;
+
+static size_t get_observation_encoding_size(BenchObservationEncoding encoding)
+{
+    const size_t elements = (encoding.plane_bit_flags) ? (size_t)count_set_bits(encoding.plane_bit_flags) * OBSERVATION_PLANE_CELL_COUNT : OBSERVATION_ONE_HOT_SIZE;
+    return elements * ((encoding.dtype == OBSERVATION_DTYPE_FLOAT32) ? sizeof(float) : sizeof(uint8_t));
+}
+
+static void encode_bench_observations(BenchObservationEncoding encoding, bool is_reference, const EnvObservation* obs, uint32_t n, void* out)
+{
+    if (encoding.plane_bit_flags && is_reference) encode_reference_observation_planes(obs, n, encoding.plane_bit_flags, encoding.layout, encoding.dtype, out);
+    else if (encoding.plane_bit_flags)            encode_observation_planes(obs, n, encoding.plane_bit_flags, encoding.layout, encoding.dtype, out);
+    else if (is_reference)                        encode_reference_observation_one_hot(obs, n, encoding.dtype, out);
+    else                                          encode_observation_one_hot(obs, n, encoding.dtype, out);
+}
+
+// Nanoseconds to encode every step's batch of the corpus, the way a trainer encodes what each env_step gave it.
+static uint64_t time_bench_observations(BenchObservationEncoding encoding, bool is_reference, const EnvObservation* corpus, uint32_t env_count, uint32_t step_count, void* out)
+{
+    const uint64_t start = get_monotonic_nanoseconds();
+    for (uint32_t step = 0; step < step_count; step++)
+    {
+        encode_bench_observations(encoding, is_reference, &corpus[(size_t)step * env_count], env_count, out);
+    }
+    return get_monotonic_nanoseconds() - start;
+}
+
+// Records the observations env_step gives a batch of envs played with random presses, then checks both encoders against a
+// scalar reference on every one, for every plane set, layout and dtype, and times them on the whole set of planes.
+static int run_observation_benchmark(uint32_t env_count, uint32_t step_count)
+{
+    EnvBatch* envs = env_create(env_count, 1);
+    EnvObservation* corpus = malloc((size_t)env_count * step_count * sizeof(EnvObservation));
+    ACTION_BIT_FLAGS* actions = malloc(env_count * sizeof(ACTION_BIT_FLAGS));
+    float* rewards = malloc(env_count * sizeof(float));
+    uint8_t* dones = malloc(env_count);
+    const size_t out_size = (size_t)env_count * OBSERVATION_PLANE_COUNT * OBSERVATION_PLANE_CELL_COUNT * sizeof(float);
+    uint8_t* out = malloc(out_size);
+    uint8_t* expected = malloc(out_size);
+    if (!envs || !corpus || !actions || !rewards || !dones || !out || !expected)
+    {
+        env_destroy(envs);
+        free(corpus);
+        free(actions);
+        free(rewards);
+        free(dones);
+        free(out);
+        free(expected);
+        printf("observation: out of memory\n");
+        return 1;
+    }
+    uint64_t random_state = 1;
+    for (uint32_t step = 0; step < step_count; step++)
+    {
+        for (uint32_t i = 0; i < env_count; i++)
+        {
+            actions[i] = get_random_env_action(&random_state);
+        }
+        env_step(envs, actions, env_count, &corpus[(size_t)step * env_count], rewards, dones);
+    }
+    env_destroy(envs);
+    free(actions);
+    free(rewards);
+    free(dones);
+
+    static const char* const LAYOUT_NAMES[] = { "NCHW", "NHWC" };
+    static const char* const DTYPE_NAMES[] = { "uint8", "float" };
+    uint32_t checked_count = 0;
+    uint32_t mismatch_count = 0;
+    for (uint8_t dtype = OBSERVATION_DTYPE_UINT8; dtype <= OBSERVATION_DTYPE_FLOAT32; dtype++)
+    {
+        for (uint8_t layout = OBSERVATION_LAYOUT_NCHW; layout <= OBSERVATION_LAYOUT_NHWC; layout++)
+        {
+            // Plane set 0 stands for the one-hot encoder, which has no layout, so it is only checked once per dtype.
+            for (OBSERVATION_PLANE_BIT_FLAGS flags = (layout == OBSERVATION_LAYOUT_NCHW) ? 0 : 1; flags <= OBSERVATION_PLANES_ALL; flags++)
+            {
+                const BenchObservationEncoding encoding = { flags, (ObservationLayout)layout, (ObservationDType)dtype };
+                const size_t size = get_observation_encoding_size(encoding) * env_count;
+                for (uint32_t step = 0; step < step_count; step++)
+                {
+                    // Filled differently first, so an element either side skips shows up.
+                    memset(out, 0xA5, size);
+                    memset(expected, 0x5A, size);
+                    encode_bench_observations(encoding, false, &corpus[(size_t)step * env_count], env_count, out);
+                    encode_bench_observations(encoding, true, &corpus[(size_t)step * env_count], env_count, expected);
+                    if (memcmp(out, expected, size) != 0)
+                    {
+                        if (mismatch_count < 5) printf("observation: mismatch with planes %u, %s, %s at step %u\n", flags, LAYOUT_NAMES[layout], DTYPE_NAMES[dtype], step);
+                        mismatch_count++;
+                    }
+                    checked_count++;
+                }
+            }
+        }
+    }
+    printf("observation: %u envs, %u steps of env_step observations, %u batches checked against the scalar reference, %u mismatches\n",
+        env_count, step_count, checked_count, mismatch_count);
+
+    const double observation_count = (double)env_count * step_count;
+    for (uint8_t dtype = OBSERVATION_DTYPE_UINT8; dtype <= OBSERVATION_DTYPE_FLOAT32; dtype++)
+    {
+        for (uint8_t layout = OBSERVATION_LAYOUT_NCHW; layout <= OBSERVATION_LAYOUT_NHWC; layout++)
+        {
+            const BenchObservationEncoding encoding = { OBSERVATION_PLANES_ALL, (ObservationLayout)layout, (ObservationDType)dtype };
+            const uint64_t nanoseconds = time_bench_observations(encoding, false, corpus, env_count, step_count, out);
+            const uint64_t reference_nanoseconds = time_bench_observations(encoding, true, corpus, env_count, step_count, expected);
+            printf("observation: planes %s %-5s %6.1f ns per observation, %5.2f GB/s out, %5.1fx the scalar reference\n",
+                LAYOUT_NAMES[layout], DTYPE_NAMES[dtype], nanoseconds / observation_count,
+                observation_count * get_observation_encoding_size(encoding) / nanoseconds, (double)reference_nanoseconds / nanoseconds);
+        }
+        const BenchObservationEncoding encoding = { 0, OBSERVATION_LAYOUT_NCHW, (ObservationDType)dtype };
+        const uint64_t nanoseconds = time_bench_observations(encoding, false, corpus, env_count, step_count, out);
+        const uint64_t reference_nanoseconds = time_bench_observations(encoding, true, corpus, env_count, step_count, expected);
+        printf("observation: one-hot     %-5s %6.1f ns per observation, %5.2f GB/s out, %5.1fx the scalar reference\n",
+            DTYPE_NAMES[dtype], nanoseconds / observation_count, observation_count * get_observation_encoding_size(encoding) / nanoseconds,
+            (double)reference_nanoseconds / nanoseconds);
+    }
+    free(corpus);
+    free(out);
+    free(expected);
+    return mismatch_count ? 1 : 0;
+}
+
+int main(int argc, char* argv[])
+{
+    install_trace_dumps(0);
+    const char* mode = (argc > 1) ? argv[1] : "placement";
+    if (strcmp(mode, "placement") == 0)
+    {
+        const uint32_t game_count = (argc > 2) ? (uint32_t)strtoul(argv[2], 0, 10) : 20;
+        const uint32_t pieces_per_game = (argc > 3) ? (uint32_t)strtoul(argv[3], 0, 10) : 500;
+        const uint32_t repetitions = (argc > 4) ? (uint32_t)strtoul(argv[4], 0, 10) : 20;
+        return run_placement_benchmark(game_count, pieces_per_game, repetitions);
+    }
+    if (strcmp(mode, "mcts") == 0)
+    {
+        const uint32_t game_count = (argc > 2) ? (uint32_t)strtoul(argv[2], 0, 10) : 4;
+        const uint32_t pieces_per_game = (argc > 3) ? (uint32_t)strtoul(argv[3], 0, 10) : 200;
+        const uint64_t time_budget = (argc > 4) ? strtoull(argv[4], 0, 10) * NANOSECONDS_PER_MILLISECOND : MCTS_DEFAULT_TIME_BUDGET;
+        const uint8_t thread_count = (argc > 5) ? (uint8_t)strtoul(argv[5], 0, 10) : MCTS_DEFAULT_THREAD_COUNT;
+        return run_mcts_benchmark(game_count, pieces_per_game, time_budget, thread_count);
+    }
+    if (strcmp(mode, "rewind") == 0)
+    {
+        const uint32_t minutes = (argc > 2) ? (uint32_t)strtoul(argv[2], 0, 10) : 10;
+        const uint32_t restore_samples = (argc > 3) ? (uint32_t)strtoul(argv[3], 0, 10) : 100000;
+        return run_rewind_benchmark(minutes, restore_samples);
+    }
+    if (strcmp(mode, "versus") == 0)
+    {
+        const uint32_t match_count = (argc > 2) ? (uint32_t)strtoul(argv[2], 0, 10) : 50;
+        const uint32_t max_pieces = (argc > 3) ? (uint32_t)strtoul(argv[3], 0, 10) : 300;
+        return run_versus_benchmark(match_count, max_pieces);
+    }
+    if (strcmp(mode, "board") == 0)
+    {
+        const uint32_t pieces_per_size = (argc > 2) ? (uint32_t)strtoul(argv[2], 0, 10) : 20000;
+        return run_board_benchmark(pieces_per_size);
+    }
+    if (strcmp(mode, "finesse") == 0)
+    {
+        const uint32_t game_count = (argc > 2) ? (uint32_t)strtoul(argv[2], 0, 10) : 20;
+        const uint32_t pieces_per_game = (argc > 3) ? (uint32_t)strtoul(argv[3], 0, 10) : 500;
+        return run_finesse_benchmark(game_count, pieces_per_game);
+    }
+    if (strcmp(mode, "bridge") == 0)
+    {
+        const uint32_t tick_count = (argc > 2) ? (uint32_t)strtoul(argv[2], 0, 10) : 100000;
+        return run_bridge_benchmark(tick_count);
+    }
+    if (strcmp(mode, "rollback") == 0)
+    {
+        const uint32_t frame_count = (argc > 2) ? (uint32_t)strtoul(argv[2], 0, 10) : 3600; // A minute, or until the match is decided.
+        const uint32_t latency_ms = (argc > 3) ? (uint32_t)strtoul(argv[3], 0, 10) : 50;
+        const uint32_t jitter_ms = (argc > 4) ? (uint32_t)strtoul(argv[4], 0, 10) : 20;
+        const uint8_t loss_percent = (argc > 5) ? (uint8_t)strtoul(argv[5], 0, 10) : 2;
+        const uint8_t input_delay = (argc > 6) ? (uint8_t)strtoul(argv[6], 0, 10) : ROLLBACK_DEFAULT_INPUT_DELAY;
+        return run_rollback_benchmark(frame_count, latency_ms, jitter_ms, loss_percent, input_delay);
+    }
+    if (strcmp(mode, "codec") == 0)
+    {
+        const uint32_t minutes = (argc > 2) ? (uint32_t)strtoul(argv[2], 0, 10) : 5;
+        const uint32_t match_count = (argc > 3) ? (uint32_t)strtoul(argv[3], 0, 10) : 20;
+        return run_codec_benchmark(minutes, match_count);
+    }
+    if (strcmp(mode, "alloc") == 0)
+    {
+        const uint32_t move_count = (argc > 2) ? (uint32_t)strtoul(argv[2], 0, 10) : 100000;
+        const bool use_huge_pages = (argc > 3) && strcmp(argv[3], "huge") == 0;
+        return run_allocator_benchmark(move_count, use_huge_pages);
+    }
+    if (strcmp(mode, "trace") == 0)
+    {
+        const uint32_t point_count = (argc > 2) ? (uint32_t)strtoul(argv[2], 0, 10) : 1000000;
+        return run_trace_benchmark(point_count, (argc > 3) ? argv[3] : "zetris_bench_trace.json");
+    }
+    if (strcmp(mode, "book") == 0 && argc > 2)
+    {
+        const uint32_t game_count = (argc > 3) ? (uint32_t)strtoul(argv[3], 0, 10) : 200;
+        return run_book_benchmark(argv[2], game_count);
+    }
+    if (strcmp(mode, "pc") == 0)
+    {
+        const uint32_t setup_count = (argc > 2) ? (uint32_t)strtoul(argv[2], 0, 10) : 200;
+        const uint64_t time_budget = (argc > 3) ? strtoull(argv[3], 0, 10) * NANOSECONDS_PER_MILLISECOND : PERFECT_CLEAR_DEFAULT_TIME_BUDGET;
+        const uint8_t thread_count = (argc > 4) ? (uint8_t)strtoul(argv[4], 0, 10) : PERFECT_CLEAR_DEFAULT_THREAD_COUNT;
+        return run_perfect_clear_benchmark(setup_count, time_budget, thread_count);
+    }
+    if (strcmp(mode, "env") == 0)
+    {
+        const uint32_t env_count = (argc > 2) ? (uint32_t)strtoul(argv[2], 0, 10) : 256;
+        const uint32_t step_count = (argc > 3) ? (uint32_t)strtoul(argv[3], 0, 10) : 2000;
+        return run_env_benchmark(env_count, step_count);
+    }
+    if (strcmp(mode, "observation") == 0)
+    {
+        const uint32_t env_count = (argc > 2) ? (uint32_t)strtoul(argv[2], 0, 10) : 64;
+        const uint32_t step_count = (argc > 3) ? (uint32_t)strtoul(argv[3], 0, 10) : 500;
+        return run_observation_benchmark(env_count, step_count);
+    }
+    printf("usage: zetris-bench [placement [games] [pieces] [repetitions]]\n");
+    printf("       zetris-bench mcts [games] [pieces] [milliseconds per search] [threads]\n");
+    printf("       zetris-bench rewind [minutes] [restores]\n");
+    printf("       zetris-bench versus [matches] [pieces per player]\n");
+    printf("       zetris-bench codec [minutes] [matches]\n");
+    printf("       zetris-bench board [pieces per size]\n");
+    printf("       zetris-bench finesse [games] [pieces]\n");
+    printf("       zetris-bench bridge [ticks]\n");
+    printf("       zetris-bench rollback [max frames] [latency ms] [jitter ms] [loss %%] [input delay]\n");
+    printf("       zetris-bench alloc [moves] [huge]\n");
+    printf("       zetris-bench trace [trace points] [output path]\n");
+    printf("       zetris-bench book <book> [games]\n");
+    printf("       zetris-bench pc [setups] [milliseconds per solve] [threads]\n");
+    printf("       zetris-bench env [envs] [steps]\n");
+    printf("       zetris-bench observation [envs] [steps]\n");
+    return 1;
+}
@@ -0,0 +1,279 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+#include "bot.h"
+#include "clock.h"
+#include "opening_book.h"
+#include "trace.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif // _WIN32
+
+#define BOOK_MAX_THREADS        256
+#define BOOK_DEFAULT_PLIES      3
+#define BOOK_PERMUTATION_COUNT  5040                            // 7!, every order of the first bag.
+#define BOOK_SEARCH_TIME_BUDGET (60 * NANOSECONDS_PER_SECOND)   // Every ply finishes, so the book is the same on any machine.
+
+typedef struct {
+    BotSettings settings;
+    uint8_t plies;
+    atomic_uint next_permutation;
+} BookContext;
+
+typedef struct {
+    thrd_t thread;
+    BookContext* context;
+    Bot* bot;
+    OpeningBookEntry* entries;
+    uint32_t entry_count;
+    uint32_t entry_capacity;
+    bool failed;
+} BookWorker;
+
+static uint32_t get_processor_count(void)
+{
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (uint32_t)info.dwNumberOfProcessors;
+#else
+    const long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return (count > 0) ? (uint32_t)count : 1;
+#endif // _WIN32
+}
+
+// A new game whose first bag comes out in the given order, one of BOOK_PERMUTATION_COUNT. The second bag is filled in as it comes into view.
+static Game get_permutation_game(uint32_t permutation)
+{
+    Game game = get_seeded_initialized_game(permutation + 1);
+    PieceData* remaining[PIECE_COUNT];
+    memcpy(remaining, ALL_PIECE_DATA, sizeof(remaining));
+    for (uint8_t i = 0; i < PIECE_COUNT; i++)
+    {
+        const uint8_t left = PIECE_COUNT - i;
+        game.piece_queue[i] = remaining[permutation % left];
+        remaining[permutation % left] = remaining[left - 1];
+        permutation /= left;
+    }
+    game.piece_queue_index = 0;
+    reset_controlled_piece(&game, pop_piece_queue(&game));
+    return game;
+}
+
+static void add_book_entry(BookWorker* worker, OpeningBookEntry entry)
+{
+    if (worker->entry_count == worker->entry_capacity)
+    {
+        const uint32_t capacity = (worker->entry_capacity) ? 2 * worker->entry_capacity : 1024;
+        OpeningBookEntry* entries = realloc(worker->entries, capacity * sizeof(OpeningBookEntry));
+        if (!entries)
+        {
+            worker->failed = true;
+            return;
+        }
+        worker->entries = entries;
+        worker->entry_capacity = capacity;
+    }
+    worker->entries[worker->entry_count++] = entry;
+}
+
+// Searches the position and follows the placement. Whenever another piece of the second bag comes into view, every piece the bag
+// still has is tried in that slot, so the book holds every queue the bot can be shown on the way.
+static void explore_book_position(BookWorker* worker, const Game* game, uint8_t ply, uint8_t second_bag_count)
+{
+    if (ply >= worker->context->plies || worker->failed) return;
+    const uint8_t last_visible = game->piece_queue_index + PIECE_PREVIEW_COUNT - 1;
+    if (last_visible >= PIECE_COUNT + second_bag_count)
+    {
+        uint8_t taken_types = 0;
+        for (uint8_t i = 0; i < second_bag_count; i++)
+        {
+            taken_types |= 1 << game->piece_queue[PIECE_COUNT + i]->type;
+        }
+        for (uint8_t type = I_TYPE; type <= L_TYPE; type++)
+        {
+            if (taken_types & (1 << type)) continue;
+            Game next = *game;
+            next.piece_queue[PIECE_COUNT + second_bag_count] = (PieceData*)get_piece_data((PieceType)type);
+            explore_book_position(worker, &next, ply, second_bag_count + 1);
+        }
+        return;
+    }
+    Placement placement;
+    BotSearchStats stats;
+    if (!search_bot_placement(worker->bot, game, &placement, &stats)) return;
+    add_book_entry(worker, (OpeningBookEntry){ get_opening_book_key(game), placement, stats.completed_depth });
+    Game next = *game;
+    if (!attempt_apply_placement(&next, placement) || is_game_over(&next)) return;
+    explore_book_position(worker, &next, ply + 1, second_bag_count);
+}
+
+static int run_book_worker(void* arg)
+{
+    BookWorker* worker = arg;
+    set_trace_thread_name("book worker");
+    uint32_t permutation;
+    while (!worker->failed && (permutation = atomic_fetch_add_explicit(&worker->context->next_permutation, 1, memory_order_relaxed)) < BOOK_PERMUTATION_COUNT)
+    {
+        poll_trace_dump(); // The main thread only joins, so a SIGUSR1 is answered here.
+        const Game game = get_permutation_game(permutation);
+        explore_book_position(worker, &game, 0, 0);
+    }
+    return 0;
+}
+
+static int compare_book_entries(const void* a, const void* b)
+{
+    const uint64_t key_a = ((const OpeningBookEntry*)a)->key;
+    const uint64_t key_b = ((const OpeningBookEntry*)b)->key;
+    return (key_a > key_b) - (key_a < key_b);
+}
+
+static int generate_book(const char* path, uint8_t plies, uint16_t beam_width, uint32_t thread_count)
+{
+    static BookWorker workers[BOOK_MAX_THREADS];
+    static BookContext context;
+    context.settings = get_default_bot_settings();
+    context.settings.beam_width = beam_width;
+    context.settings.time_budget = BOOK_SEARCH_TIME_BUDGET;
+    context.settings.thread_count = 1; // One bot per thread: searches are deterministic on one thread, so a position always gets the same entry.
+    context.plies = plies;
+    atomic_init(&context.next_permutation, 0);
+    const uint64_t start = get_monotonic_nanoseconds();
+    bool failed = false;
+    for (uint32_t i = 0; i < thread_count; i++)
+    {
+        workers[i].context = &context;
+        workers[i].bot = create_bot(context.settings);
+        failed |= !workers[i].bot;
+    }
+    uint32_t started_count = 0;
+    while (!failed && started_count < thread_count && thrd_create(&workers[started_count].thread, run_book_worker, &workers[started_count]) == thrd_success)
+    {
+        started_count++;
+    }
+    if (!failed && started_count < thread_count)
+    {
+        fprintf(stderr, "zetris-book: couldn't start %u of %u worker threads\n", thread_count - started_count, thread_count);
+        atomic_store(&context.next_permutation, BOOK_PERMUTATION_COUNT); // The workers that did start stop after their current bag.
+        failed = true;
+    }
+    uint32_t entry_count = 0;
+    for (uint32_t i = 0; i < started_count; i++)
+    {
+        thrd_join(workers[i].thread, 0);
+        failed |= workers[i].failed;
+        entry_count += workers[i].entry_count;
+    }
+    const uint32_t search_count = entry_count;
+
+    // Different games can reach the same position, which searches to the same placement, so only one of each is kept.
+    OpeningBookEntry* entries = (failed) ? 0 : malloc((entry_count ? entry_count : 1) * sizeof(OpeningBookEntry));
+    if (entries)
+    {
+        entry_count = 0;
+        for (uint32_t i = 0; i < thread_count; i++)
+        {
+            memcpy(&entries[entry_count], workers[i].entries, workers[i].entry_count * sizeof(OpeningBookEntry));
+            entry_count += workers[i].entry_count;
+        }
+        qsort(entries, entry_count, sizeof(OpeningBookEntry), compare_book_entries);
+        uint32_t unique_count = 0;
+        for (uint32_t i = 0; i < entry_count; i++)
+        {
+            if (!unique_count || entries[i].key != entries[unique_count - 1].key) entries[unique_count++] = entries[i];
+        }
+        entry_count = unique_count;
+    }
+    const bool written = entries && write_opening_book(path, entries, entry_count, plies, beam_width, context.settings.depth);
+    const double seconds = (double)(get_monotonic_nanoseconds() - start) / NANOSECONDS_PER_SECOND;
+    printf("zetris-book: %u plies, %u searches, %u positions, beam %u, %u threads, %.2f s, %.1f searches/s%s\n",
+        plies, search_count, entry_count, beam_width, thread_count, seconds, search_count / seconds, written ? "" : ", WRITE FAILED");
+    free(entries);
+    for (uint32_t i = 0; i < thread_count; i++)
+    {
+        destroy_bot(workers[i].bot);
+        free(workers[i].entries);
+    }
+    return written ? 0 : 1;
+}
+
+// Looks up the first position of every first bag, which a book of any plies has, and times the lookups.
+static int print_book_info(const char* path)
+{
+    const uint64_t open_start = get_monotonic_nanoseconds();
+    OpeningBook* book = open_opening_book(path);
+    const uint64_t open_elapsed = get_monotonic_nanoseconds() - open_start;
+    if (!book)
+    {
+        fprintf(stderr, "zetris-book: %s is not an opening book for this build\n", path);
+        return 1;
+    }
+    const OpeningBookInfo info = get_opening_book_info(book);
+    static Game games[BOOK_PERMUTATION_COUNT];
+    for (uint32_t i = 0; i < BOOK_PERMUTATION_COUNT; i++)
+    {
+        games[i] = get_permutation_game(i);
+    }
+    // Each position looked up over and over, the way a bot looks up the game it is about to search: hot in the cache.
+    uint32_t found_count = 0;
+    uint32_t valid_count = 0;
+    const uint32_t repetitions = 100;
+    const uint64_t start = get_monotonic_nanoseconds();
+    for (uint32_t i = 0; i < BOOK_PERMUTATION_COUNT; i++)
+    {
+        Placement placement;
+        bool is_found = false;
+        for (uint32_t r = 0; r < repetitions; r++)
+        {
+            is_found = find_opening_book_placement(book, &games[i], &placement, 0);
+        }
+        found_count += is_found;
+        valid_count += is_found && is_placement_valid(&games[i], placement);
+    }
+    const double lookup_nanoseconds = (double)(get_monotonic_nanoseconds() - start) / (repetitions * BOOK_PERMUTATION_COUNT);
+    printf("%s: %u positions in %u slots (%.0f%% full), %u plies, beam %u, depth %u\n", path, info.entry_count, info.slot_count,
+        100.0 * info.entry_count / info.slot_count, info.plies, info.beam_width, info.depth);
+    printf("  opened in %.1f us, first placements found for %u of %u bags, %u valid, %.1f ns a lookup\n", open_elapsed / 1e3,
+        found_count, BOOK_PERMUTATION_COUNT, valid_count, lookup_nanoseconds);
+    close_opening_book(book);
+    return (found_count == BOOK_PERMUTATION_COUNT && valid_count == BOOK_PERMUTATION_COUNT) ? 0 : 1;
+}
+
+int main(int argc, char* argv[])
+{
+    install_trace_dumps(0);
+    if (argc > 2 && strcmp(argv[1], "--info") == 0)
+    {
+        return print_book_info(argv[2]);
+    }
+
+    int first_argument = 1;
+    uint32_t thread_count = get_processor_count();
+    if (argc > 2 && strcmp(argv[1], "--threads") == 0)
+    {
+        thread_count = (uint32_t)strtoul(argv[2], 0, 10);
+        first_argument = 3;
+    }
+    if (thread_count == 0) thread_count = 1;
+    if (thread_count > BOOK_MAX_THREADS) thread_count = BOOK_MAX_THREADS;
+    if (first_argument >= argc)
+    {
+        printf("usage: zetris-book [--threads count] <book> [plies] [beam width]\n");
+        printf("       zetris-book --info <book>\n");
+        return 1;
+    }
+    uint8_t plies = (first_argument + 1 < argc) ? (uint8_t)strtoul(argv[first_argument + 1], 0, 10) : BOOK_DEFAULT_PLIES;
+    if (plies == 0) plies = 1;
+    if (plies > OPENING_BOOK_MAX_PLIES) plies = OPENING_BOOK_MAX_PLIES;
+    uint16_t beam_width = (first_argument + 2 < argc) ? (uint16_t)strtoul(argv[first_argument + 2], 0, 10) : BOT_DEFAULT_BEAM_WIDTH;
+    if (beam_width == 0) beam_width = 1;
+    return generate_book(argv[first_argument], plies, beam_width, thread_count);
+}
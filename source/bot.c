@@ -0,0 +1,704 @@
+#include <math.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+#include "bot.h"
+#include "trace.h"
+#include "util.h"
+
+#define BOT_MAX_CHILDREN_PER_NODE   (2 * PIECE_ROTATION_STATES * (MAX_COLUMN_COUNT + COLUMN_OFFSET)) // Two pieces to pick from (with hold), every rotation, every column.
+#define BOT_PARENTS_PER_GRAB        2
+
+// Line clear rewards in the same ratio as the scoring in on_controlled_piece_place (100, 300, 500, 800).
+static const float LINE_CLEAR_UNITS[PIECE_MAX_SIZE + 1] = { 0.0f, 1.0f, 3.0f, 5.0f, 8.0f };
+
+typedef struct {
+    PlayfieldCells cells;   // sizeof(PlayfieldRow) * MAX_ROW_COUNT bytes
+    float reward;           // 4 bytes, line clear rewards gathered on the way here.
+    float evaluation;       // 4 bytes, reward plus the heuristic of cells. This is what the beam keeps the best of.
+    Placement first;        // Placement at the root that leads here.
+    uint8_t held_type;      // 1 byte, 0 when nothing is held.
+    uint8_t sequence_index; // 1 byte, next piece of the sequence that has not come out of the queue.
+    uint8_t combo_count;    // 1 byte
+} BotNode;
+
+// A piece that can be placed from a node, and what the node looks like after.
+typedef struct {
+    PieceType type;
+    uint8_t held_type;
+    uint8_t sequence_index;
+    bool use_hold;
+} BotOption;
+
+typedef struct {
+    thrd_t thread;
+    Bot* bot;
+    Arena arena;            // Children of the ply being expanded, back to back. Reset every ply.
+    uint32_t node_count;
+    uint32_t evaluated_nodes;
+} BotWorker;
+
+struct Bot {
+    BotSettings settings;
+    Arena memory;           // The workers, the beam and the candidates.
+    BotWorker* workers;     // Worker 0 is whoever calls search_bot_placement.
+    BotNode* beam;
+    BotNode** candidates;
+    uint32_t candidate_capacity;
+    // The ply being expanded.
+    const BotNode* parents;
+    uint32_t parent_count;
+    uint8_t ply;
+    uint64_t deadline;
+    atomic_uint next_parent;
+    atomic_bool out_of_time;
+    // The game being searched.
+    PieceType sequence[BOT_MAX_DEPTH];
+    uint8_t sequence_length;
+    uint8_t row_count;
+    uint8_t column_count;
+    uint8_t ceiling;
+    bool can_hold;
+    bool root_can_hold;
+    // Thread pool.
+    mtx_t mutex;
+    cnd_t job_ready;
+    cnd_t job_done;
+    uint32_t job_generation;
+    uint8_t busy_workers;
+    bool quit;
+};
+
+BotSettings get_default_bot_settings()
+{
+    BotSettings settings = {
+        .weights = {
+            .aggregate_height = -0.5f,
+            .max_height = -0.3f,
+            .holes = -4.0f,
+            .covered_cells = -0.5f,
+            .bumpiness = -0.25f,
+            .line_clears = 1.5f,
+            .combo = 0.5f
+        },
+        .time_budget = BOT_DEFAULT_TIME_BUDGET,
+        .beam_width = BOT_DEFAULT_BEAM_WIDTH,
+        .depth = BOT_MAX_DEPTH,
+        .thread_count = BOT_DEFAULT_THREAD_COUNT
+    };
+    return settings;
+}
+
+// Piece rows shifted to a playfield column, one mask per row. False if a cell would be outside the walls.
+static inline bool get_piece_row_masks(const PieceCells cells, const int column, const uint8_t column_count, PlayfieldRow out_rows[PIECE_MAX_SIZE])
+{
+    const uint64_t field_mask = (1ULL << column_count) - 1;
+    for (uint8_t y = 0; y < PIECE_MAX_SIZE; y++)
+    {
+        uint64_t row = (cells >> (PIECE_MAX_SIZE * y)) & 0xF; // 64 bits, so a piece one past the widest board shifts out cleanly and fails the mask.
+        if (column < 0)
+        {
+            if (row & ((1U << -column) - 1)) return false;
+            row >>= -column;
+        }
+        else
+        {
+            row <<= column;
+        }
+        if (row & ~field_mask) return false;
+        out_rows[y] = (PlayfieldRow)row;
+    }
+    return true;
+}
+
+static inline bool are_piece_rows_colliding(const PlayfieldCells cells, const PlayfieldRow piece_rows[PIECE_MAX_SIZE], const uint8_t pos_y, const uint8_t row_count)
+{
+    for (uint8_t y = 0; y < PIECE_MAX_SIZE; y++)
+    {
+        if (piece_rows[y] && (pos_y + y >= row_count || (cells[pos_y + y] & piece_rows[y]))) return true;
+    }
+    return false;
+}
+
+// Same as clear_filled_lines, without needing a whole Playfield.
+static inline uint8_t clear_filled_rows(PlayfieldCells cells, const uint8_t row_count, const uint8_t column_count, const uint8_t bottom)
+{
+    const PlayfieldRow mask = (PlayfieldRow)((1ULL << column_count) - 1);
+    uint8_t rows_cleared = 0;
+    for (uint8_t y = (bottom > row_count) ? row_count : bottom; y > 0; y--)
+    {
+        if (cells[y - 1] == mask)
+        {
+            rows_cleared++;
+        }
+        else if (rows_cleared)
+        {
+            cells[y - 1 + rows_cleared] = cells[y - 1];
+            cells[y - 1] = 0;
+        }
+    }
+    return rows_cleared;
+}
+
+static float evaluate_cells(const BotWeights* weights, const PlayfieldCells cells, const uint8_t row_count, const uint8_t column_count)
+{
+    const PlayfieldRow field_mask = (PlayfieldRow)((1ULL << column_count) - 1);
+    uint8_t heights[MAX_COLUMN_COUNT] = { 0 };
+    PlayfieldRow covered_above[MAX_ROW_COUNT];
+    PlayfieldRow covered = 0;
+    uint32_t holes = 0;
+    uint8_t top_row = 0;
+    while (top_row < row_count && !cells[top_row]) top_row++; // Empty rows above the stack add nothing to any term.
+    for (uint8_t y = top_row; y < row_count; y++)
+    {
+        const PlayfieldRow row = cells[y];
+        covered_above[y] = covered;
+        holes += count_row_set_bits(covered & ~row & field_mask);
+        PlayfieldRow new_columns = row & ~covered;
+        while (new_columns)
+        {
+            heights[count_row_trailing_zeros(new_columns)] = row_count - y;
+            new_columns &= new_columns - 1;
+        }
+        covered |= row;
+    }
+
+    uint32_t covered_cells = 0;
+    PlayfieldRow hole_below = 0;
+    for (uint8_t y = row_count; y > top_row; y--)
+    {
+        const PlayfieldRow row = cells[y - 1];
+        covered_cells += count_row_set_bits(row & hole_below);
+        hole_below |= ~row & covered_above[y - 1] & field_mask;
+    }
+
+    uint32_t aggregate_height = 0;
+    uint32_t bumpiness = 0;
+    uint8_t max_height = 0;
+    for (uint8_t x = 0; x < column_count; x++)
+    {
+        aggregate_height += heights[x];
+        if (heights[x] > max_height) max_height = heights[x];
+        if (x + 1 < column_count) bumpiness += abs((int)heights[x] - (int)heights[x + 1]);
+    }
+
+    return weights->aggregate_height * aggregate_height
+        + weights->max_height * max_height
+        + weights->holes * holes
+        + weights->covered_cells * covered_cells
+        + weights->bumpiness * bumpiness;
+}
+
+static inline void add_child(BotWorker* worker, const BotNode* parent, const BotOption* option, const PlayfieldRow piece_rows[PIECE_MAX_SIZE], const uint8_t pos_x, const uint8_t pos_y, const uint8_t rotation)
+{
+    Bot* bot = worker->bot;
+    BotNode* child = allocate_from_arena(&worker->arena, sizeof(BotNode), _Alignof(BotNode));
+    if (!child) return; // expand_parents leaves room for a whole grab, so this never happens.
+    worker->node_count++;
+    memcpy(child->cells, parent->cells, bot->row_count * sizeof(PlayfieldRow));
+    const PlayfieldRow full_row = (PlayfieldRow)((1ULL << bot->column_count) - 1);
+    bool any_full_row = false;
+    for (uint8_t y = 0; y < PIECE_MAX_SIZE && pos_y + y < bot->row_count; y++)
+    {
+        child->cells[pos_y + y] |= piece_rows[y];
+        any_full_row |= (child->cells[pos_y + y] == full_row);
+    }
+    const uint8_t cleared = any_full_row ? clear_filled_rows(child->cells, bot->row_count, bot->column_count, pos_y + PIECE_MAX_SIZE) : 0;
+    child->held_type = option->held_type;
+    child->sequence_index = option->sequence_index;
+    child->combo_count = cleared ? parent->combo_count + 1 : 0;
+    child->reward = parent->reward + bot->settings.weights.line_clears * LINE_CLEAR_UNITS[cleared] + (cleared ? bot->settings.weights.combo * parent->combo_count : 0.0f);
+    if (bot->ply == 0)
+    {
+        child->first = (Placement){ option->type, pos_x, pos_y, rotation, option->use_hold };
+    }
+    else
+    {
+        child->first = parent->first;
+    }
+
+    bool above_ceiling = false;
+    for (uint8_t y = 0; y < bot->ceiling; y++)
+    {
+        above_ceiling |= (child->cells[y] != 0);
+    }
+    child->evaluation = above_ceiling ? -INFINITY : child->reward + evaluate_cells(&bot->settings.weights, child->cells, bot->row_count, bot->column_count);
+}
+
+static void expand_option(BotWorker* worker, const BotNode* parent, const BotOption* option, const uint8_t drop_start_y)
+{
+    const Bot* bot = worker->bot;
+    const PieceSize size = get_piece_data(option->type)->size;
+    const uint8_t spawn_x = (bot->column_count / 2) - (size / 2) + COLUMN_OFFSET; // Same as reset_controlled_piece.
+    const uint8_t spawn_y = PIECE_SPAWN_ROW_OFFSET;
+    for (uint8_t rotation = 0; rotation < get_piece_unique_rotation_count(option->type); rotation++)
+    {
+        const PieceCells cells = PIECE_ROTATION_CELLS[option->type][rotation];
+        PlayfieldRow piece_rows[PIECE_MAX_SIZE];
+        if (!get_piece_row_masks(cells, spawn_x - COLUMN_OFFSET, bot->column_count, piece_rows) ||
+            are_piece_rows_colliding(parent->cells, piece_rows, spawn_y, bot->row_count))
+        {
+            continue;
+        }
+        // Sweep out from spawn along the spawn row, so every column kept is one the piece can actually slide to.
+        for (int8_t direction = -1; direction <= 1; direction += 2)
+        {
+            for (int pos_x = (direction < 0) ? spawn_x : spawn_x + 1; pos_x >= 0; pos_x += direction)
+            {
+                if (!get_piece_row_masks(cells, pos_x - COLUMN_OFFSET, bot->column_count, piece_rows) ||
+                    are_piece_rows_colliding(parent->cells, piece_rows, spawn_y, bot->row_count))
+                {
+                    break;
+                }
+                uint8_t pos_y = (drop_start_y > spawn_y) ? drop_start_y : spawn_y;
+                while (!are_piece_rows_colliding(parent->cells, piece_rows, pos_y + 1, bot->row_count))
+                {
+                    pos_y++;
+                }
+                add_child(worker, parent, option, piece_rows, (uint8_t)pos_x, pos_y, rotation);
+            }
+        }
+    }
+}
+
+static void expand_node(BotWorker* worker, const BotNode* parent)
+{
+    const Bot* bot = worker->bot;
+    const uint8_t index = parent->sequence_index;
+    if (index >= bot->sequence_length) return;
+
+    // Nothing can collide above the stack, so drops start just over it instead of at spawn.
+    uint8_t top_row = 0;
+    while (top_row < bot->row_count && !parent->cells[top_row]) top_row++;
+    const uint8_t drop_start_y = (top_row > PIECE_MAX_SIZE) ? top_row - PIECE_MAX_SIZE : 0;
+
+    BotOption option = { bot->sequence[index], parent->held_type, index + 1, false };
+    expand_option(worker, parent, &option, drop_start_y);
+
+    if (bot->can_hold && (bot->ply > 0 || bot->root_can_hold))
+    {
+        if (parent->held_type)
+        {
+            if (parent->held_type != bot->sequence[index]) // Swapping a piece for the same type changes nothing.
+            {
+                option = (BotOption){ (PieceType)parent->held_type, (uint8_t)bot->sequence[index], index + 1, true };
+                expand_option(worker, parent, &option, drop_start_y);
+            }
+        }
+        else if (index + 1 < bot->sequence_length)
+        {
+            option = (BotOption){ bot->sequence[index + 1], (uint8_t)bot->sequence[index], index + 2, true };
+            expand_option(worker, parent, &option, drop_start_y);
+        }
+    }
+}
+
+static void expand_parents(BotWorker* worker)
+{
+    TRACE_BEGIN("bot expand");
+    Bot* bot = worker->bot;
+    reset_arena(&worker->arena);
+    worker->node_count = 0;
+    while (worker->arena.capacity - get_arena_mark(&worker->arena) >= BOT_PARENTS_PER_GRAB * BOT_MAX_CHILDREN_PER_NODE * sizeof(BotNode) &&
+           !atomic_load_explicit(&bot->out_of_time, memory_order_relaxed))
+    {
+        const uint32_t first = atomic_fetch_add_explicit(&bot->next_parent, BOT_PARENTS_PER_GRAB, memory_order_relaxed);
+        if (first >= bot->parent_count) break;
+        const uint32_t last = (first + BOT_PARENTS_PER_GRAB < bot->parent_count) ? first + BOT_PARENTS_PER_GRAB : bot->parent_count;
+        for (uint32_t i = first; i < last; i++)
+        {
+            expand_node(worker, &bot->parents[i]);
+        }
+        if (bot->ply > 0 && get_monotonic_nanoseconds() > bot->deadline) // The first ply always finishes, so there is always an answer.
+        {
+            atomic_store_explicit(&bot->out_of_time, true, memory_order_relaxed);
+        }
+    }
+    worker->evaluated_nodes += worker->node_count;
+    TRACE_END("bot expand");
+}
+
+static int run_bot_worker(void* arg)
+{
+    BotWorker* worker = arg;
+    Bot* bot = worker->bot;
+    uint32_t seen_generation = 0;
+    set_trace_thread_name("bot worker");
+    for (;;)
+    {
+        mtx_lock(&bot->mutex);
+        while (!bot->quit && bot->job_generation == seen_generation)
+        {
+            cnd_wait(&bot->job_ready, &bot->mutex);
+        }
+        if (bot->quit)
+        {
+            mtx_unlock(&bot->mutex);
+            return 0;
+        }
+        seen_generation = bot->job_generation;
+        mtx_unlock(&bot->mutex);
+
+        expand_parents(worker);
+
+        mtx_lock(&bot->mutex);
+        if (--bot->busy_workers == 0) cnd_signal(&bot->job_done);
+        mtx_unlock(&bot->mutex);
+    }
+}
+
+static void expand_ply(Bot* bot)
+{
+    atomic_store_explicit(&bot->next_parent, 0, memory_order_relaxed);
+    mtx_lock(&bot->mutex);
+    bot->busy_workers = bot->settings.thread_count - 1;
+    bot->job_generation++;
+    cnd_broadcast(&bot->job_ready);
+    mtx_unlock(&bot->mutex);
+
+    expand_parents(&bot->workers[0]);
+
+    mtx_lock(&bot->mutex);
+    while (bot->busy_workers)
+    {
+        cnd_wait(&bot->job_done, &bot->mutex);
+    }
+    mtx_unlock(&bot->mutex);
+}
+
+// Partially sorts so the best keep candidates are at the front (in no particular order). Quickselect with a Hoare partition.
+static void select_best_candidates(BotNode** candidates, const uint32_t count, const uint32_t keep)
+{
+    int64_t left = 0;
+    int64_t right = (int64_t)count - 1;
+    const int64_t target = (int64_t)keep - 1;
+    while (left < right)
+    {
+        const float pivot = candidates[left + (right - left) / 2]->evaluation;
+        int64_t i = left;
+        int64_t j = right;
+        while (i <= j)
+        {
+            while (candidates[i]->evaluation > pivot) i++;
+            while (candidates[j]->evaluation < pivot) j--;
+            if (i <= j)
+            {
+                BotNode* swap = candidates[i];
+                candidates[i++] = candidates[j];
+                candidates[j--] = swap;
+            }
+        }
+        if (target <= j)        right = j;
+        else if (target >= i)   left = i;
+        else                    break;
+    }
+}
+
+// Everything create_bot allocates, once every worker has its arena.
+static void free_bot_memory(Bot* bot)
+{
+    for (uint8_t i = 0; i < bot->settings.thread_count; i++)
+    {
+        release_arena(&bot->workers[i].arena);
+    }
+    release_arena(&bot->memory);
+    free(bot);
+}
+
+static bool init_bot_sync(Bot* bot)
+{
+    if (mtx_init(&bot->mutex, mtx_plain) != thrd_success) return false;
+    if (cnd_init(&bot->job_ready) != thrd_success)
+    {
+        mtx_destroy(&bot->mutex);
+        return false;
+    }
+    if (cnd_init(&bot->job_done) != thrd_success)
+    {
+        cnd_destroy(&bot->job_ready);
+        mtx_destroy(&bot->mutex);
+        return false;
+    }
+    return true;
+}
+
+static void destroy_bot_sync(Bot* bot)
+{
+    cnd_destroy(&bot->job_done);
+    cnd_destroy(&bot->job_ready);
+    mtx_destroy(&bot->mutex);
+}
+
+// Joins workers 1 to started_count - 1. Worker 0 is the calling thread.
+static void stop_bot_workers(Bot* bot, uint8_t started_count)
+{
+    mtx_lock(&bot->mutex);
+    bot->quit = true;
+    cnd_broadcast(&bot->job_ready);
+    mtx_unlock(&bot->mutex);
+    for (uint8_t i = 1; i < started_count; i++)
+    {
+        thrd_join(bot->workers[i].thread, 0);
+    }
+}
+
+Bot* create_bot(BotSettings settings)
+{
+    if (settings.thread_count == 0) settings.thread_count = 1;
+    if (settings.beam_width == 0) settings.beam_width = 1;
+    if (settings.depth == 0 || settings.depth > BOT_MAX_DEPTH) settings.depth = BOT_MAX_DEPTH;
+
+    Bot* bot = calloc(1, sizeof(Bot));
+    if (!bot) return 0;
+    bot->settings = settings;
+
+    // Every worker can take its share of the beam plus one grab, so together they can always take all of it.
+    const uint32_t grabs_per_worker = (settings.beam_width / settings.thread_count + BOT_PARENTS_PER_GRAB) / BOT_PARENTS_PER_GRAB + 1;
+    const uint32_t arena_capacity = grabs_per_worker * BOT_PARENTS_PER_GRAB * BOT_MAX_CHILDREN_PER_NODE;
+    bot->candidate_capacity = arena_capacity * settings.thread_count;
+    const size_t memory_size = settings.thread_count * sizeof(BotWorker) + settings.beam_width * sizeof(BotNode) +
+        bot->candidate_capacity * sizeof(BotNode*) + 2 * _Alignof(max_align_t);
+    if (!init_arena(&bot->memory, memory_size, false))
+    {
+        free(bot);
+        return 0;
+    }
+    bot->workers = allocate_from_arena(&bot->memory, settings.thread_count * sizeof(BotWorker), _Alignof(BotWorker));
+    bot->beam = allocate_from_arena(&bot->memory, settings.beam_width * sizeof(BotNode), _Alignof(BotNode));
+    bot->candidates = allocate_from_arena(&bot->memory, bot->candidate_capacity * sizeof(BotNode*), _Alignof(BotNode*));
+    for (uint8_t i = 0; i < settings.thread_count; i++)
+    {
+        if (!init_arena(&bot->workers[i].arena, arena_capacity * sizeof(BotNode), settings.use_huge_pages))
+        {
+            while (i-- > 0) release_arena(&bot->workers[i].arena);
+            release_arena(&bot->memory);
+            free(bot);
+            return 0;
+        }
+    }
+
+    if (!init_bot_sync(bot))
+    {
+        free_bot_memory(bot);
+        return 0;
+    }
+    for (uint8_t i = 0; i < settings.thread_count; i++)
+    {
+        BotWorker* worker = &bot->workers[i];
+        worker->bot = bot;
+        if (i > 0 && thrd_create(&worker->thread, run_bot_worker, worker) != thrd_success)
+        {
+            stop_bot_workers(bot, i);
+            destroy_bot_sync(bot);
+            free_bot_memory(bot);
+            return 0;
+        }
+    }
+    return bot;
+}
+
+void destroy_bot(Bot* bot)
+{
+    if (!bot) return;
+    stop_bot_workers(bot, bot->settings.thread_count);
+    destroy_bot_sync(bot);
+    free_bot_memory(bot);
+}
+
+static const BotNode* get_best_beam_node(const Bot* bot)
+{
+    const BotNode* best = &bot->beam[0];
+    for (uint32_t i = 1; i < bot->parent_count; i++)
+    {
+        if (bot->beam[i].evaluation > best->evaluation) best = &bot->beam[i];
+    }
+    return best;
+}
+
+bool search_bot_placement(Bot* bot, const Game* game, Placement* out_placement, BotSearchStats* optional_out_stats)
+{
+    return search_bot_placement_anytime(bot, game, 0, 0, out_placement, optional_out_stats);
+}
+
+void cancel_bot_search(Bot* bot)
+{
+    atomic_store_explicit(&bot->out_of_time, true, memory_order_relaxed);
+}
+
+AllocatorStats get_bot_node_stats(const Bot* bot)
+{
+    AllocatorStats total = get_arena_stats(&bot->workers[0].arena);
+    for (uint8_t i = 1; i < bot->settings.thread_count; i++)
+    {
+        const AllocatorStats stats = get_arena_stats(&bot->workers[i].arena);
+        total.capacity += stats.capacity;
+        total.used += stats.used;
+        total.high_water += stats.high_water;
+        total.allocation_count += stats.allocation_count;
+        total.failed_count += stats.failed_count;
+        total.reset_count += stats.reset_count;
+        total.allocations_per_second += stats.allocations_per_second;
+        total.is_huge_page_backed = total.is_huge_page_backed && stats.is_huge_page_backed;
+    }
+    return total;
+}
+
+bool search_bot_placement_anytime(Bot* bot, const Game* game, BotPlyCallback optional_on_ply, void* user_data, Placement* out_placement, BotSearchStats* optional_out_stats)
+{
+    TRACE_BEGIN("bot search");
+    const uint64_t start = get_monotonic_nanoseconds();
+    Placement book_placement;
+    uint8_t book_depth = 0;
+    // Checked against the game, so a book made for other rules can't play an impossible move.
+    if (bot->settings.opening_book && find_opening_book_placement(bot->settings.opening_book, game, &book_placement, &book_depth) &&
+        is_placement_valid(game, book_placement))
+    {
+        *out_placement = book_placement;
+        if (optional_out_stats)
+        {
+            *optional_out_stats = (BotSearchStats){ .elapsed = get_monotonic_nanoseconds() - start, .completed_depth = book_depth, .is_from_book = true };
+        }
+        TRACE_END("bot search");
+        return true;
+    }
+    bot->deadline = start + bot->settings.time_budget;
+    atomic_store_explicit(&bot->out_of_time, false, memory_order_relaxed);
+    bot->row_count = game->playfield.row_count;
+    bot->column_count = game->playfield.column_count;
+    bot->ceiling = game->playfield.ceiling;
+    bot->can_hold = game->setting_bit_flags & SETTING_CAN_HOLD;
+    bot->root_can_hold = game->can_hold_piece;
+    bot->sequence[0] = game->controlled_piece.type;
+    for (uint8_t i = 1; i < BOT_MAX_DEPTH; i++)
+    {
+        bot->sequence[i] = peek_piece_queue(game, i - 1)->type;
+    }
+    bot->sequence_length = BOT_MAX_DEPTH;
+    for (uint8_t i = 0; i < bot->settings.thread_count; i++)
+    {
+        bot->workers[i].evaluated_nodes = 0;
+    }
+
+    BotNode* root = &bot->beam[0];
+    memcpy(root->cells, game->playfield.cells, sizeof(PlayfieldCells));
+    root->reward = 0.0f;
+    root->evaluation = 0.0f;
+    root->held_type = (game->held_piece) ? (uint8_t)game->held_piece->type : 0;
+    root->sequence_index = 0;
+    root->combo_count = game->combo_count;
+    bot->parents = bot->beam;
+    bot->parent_count = 1;
+
+    uint8_t completed_depth = 0;
+    for (bot->ply = 0; bot->ply < bot->settings.depth; bot->ply++)
+    {
+        expand_ply(bot);
+        if (atomic_load_explicit(&bot->out_of_time, memory_order_relaxed)) break;
+
+        uint32_t candidate_count = 0;
+        for (uint8_t i = 0; i < bot->settings.thread_count; i++)
+        {
+            BotNode* children = (BotNode*)bot->workers[i].arena.base;
+            for (uint32_t j = 0; j < bot->workers[i].node_count; j++)
+            {
+                bot->candidates[candidate_count++] = &children[j];
+            }
+        }
+        if (!candidate_count) break;
+        const uint32_t keep = (candidate_count < bot->settings.beam_width) ? candidate_count : bot->settings.beam_width;
+        if (candidate_count > keep) select_best_candidates(bot->candidates, candidate_count, keep);
+        for (uint32_t i = 0; i < keep; i++)
+        {
+            bot->beam[i] = *bot->candidates[i];
+        }
+        bot->parent_count = keep;
+        completed_depth++;
+        if (optional_on_ply && !optional_on_ply(user_data, get_best_beam_node(bot)->first, completed_depth)) break;
+    }
+
+    bool found = false;
+    if (completed_depth)
+    {
+        *out_placement = get_best_beam_node(bot)->first;
+        found = true;
+    }
+
+    if (optional_out_stats)
+    {
+        optional_out_stats->elapsed = get_monotonic_nanoseconds() - start;
+        optional_out_stats->evaluated_nodes = 0;
+        for (uint8_t i = 0; i < bot->settings.thread_count; i++)
+        {
+            optional_out_stats->evaluated_nodes += bot->workers[i].evaluated_nodes;
+        }
+        optional_out_stats->completed_depth = completed_depth;
+        optional_out_stats->is_from_book = false;
+    }
+    TRACE_END("bot search");
+    return found;
+}
+
+bool needs_bot_controller_target(const BotController* controller, const Game* game)
+{
+    return !controller->has_target || controller->target_placed_piece_count != game->placed_piece_count;
+}
+
+void set_bot_controller_target(BotController* controller, const Game* game, Placement target)
+{
+    controller->target = target;
+    controller->target_placed_piece_count = game->placed_piece_count;
+    controller->last_pos_x = game->controlled_piece.pos_x;
+    controller->last_rotation = game->controlled_piece.rotation;
+    controller->stuck_ticks = 0;
+    controller->has_target = true;
+}
+
+ACTION_BIT_FLAGS get_bot_controller_action_bit_flags(BotController* controller, const Game* game)
+{
+    if (needs_bot_controller_target(controller, game))
+    {
+        controller->previous_action_bit_flags = 0;
+        return 0;
+    }
+
+    const Piece* piece = &game->controlled_piece;
+    const Placement* target = &controller->target;
+    if (piece->pos_x == controller->last_pos_x && piece->rotation == controller->last_rotation)
+    {
+        controller->stuck_ticks++;
+    }
+    else
+    {
+        controller->stuck_ticks = 0;
+    }
+    controller->last_pos_x = piece->pos_x;
+    controller->last_rotation = piece->rotation;
+
+    // A key only counts on the tick it goes down, so anything pressed last tick is released for this one.
+    const ACTION_BIT_FLAGS previous = controller->previous_action_bit_flags;
+    ACTION_BIT_FLAGS action_bit_flags = 0;
+    if (target->use_hold && piece->type != target->type && game->can_hold_piece)
+    {
+        action_bit_flags |= ACTION_HOLD_PIECE & ~previous;
+    }
+    else if ((piece->rotation == target->rotation && piece->pos_x == target->pos_x) || controller->stuck_ticks >= BOT_CONTROLLER_STUCK_TICKS)
+    {
+        action_bit_flags |= ACTION_HARD_DROP & ~previous;
+    }
+    else
+    {
+        if (piece->rotation != target->rotation)
+        {
+            const bool clockwise = ((target->rotation - piece->rotation) & (PIECE_ROTATION_STATES - 1)) != PIECE_ROTATION_STATES - 1;
+            action_bit_flags |= (clockwise ? ACTION_ROTATE_CLOCKWISE : ACTION_ROTATE_COUNTER) & ~previous;
+        }
+        if (piece->pos_x != target->pos_x)
+        {
+            action_bit_flags |= ((piece->pos_x < target->pos_x) ? ACTION_MOVE_RIGHT : ACTION_MOVE_LEFT) & ~previous;
+        }
+    }
+    controller->previous_action_bit_flags = action_bit_flags;
+    return action_bit_flags;
+}
@@ -0,0 +1,371 @@
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+#include "bridge.h"
+#include "clock.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#endif // __linux__
+#endif // _WIN32
+
+#define BRIDGE_MAX_NAME_LENGTH      64
+#define BRIDGE_SPINS_PER_YIELD      1024    // Spinning forever on a machine with fewer cores than spinners still lets the other side run.
+#define BRIDGE_POLL_NANOSECONDS     50000   // How long a wait sleeps between polls where there is no futex.
+
+// The layout in bridge.h, checked below. Only 32 bit atomics, which every language with shared memory has.
+typedef struct {
+    uint32_t magic;
+    uint32_t abi_version;
+    uint32_t segment_size;
+    uint32_t action_ring_size;
+    atomic_uint host_status;
+    uint8_t header_padding[44];
+    atomic_uint state_sequence;
+    atomic_uint client_sleeping;
+    BridgeState state;
+    atomic_uint action_head;
+    atomic_uint host_sleeping;
+    uint8_t head_padding[56];
+    atomic_uint action_tail;
+    uint8_t tail_padding[60];
+    BridgeAction actions[BRIDGE_ACTION_RING_SIZE];
+} BridgeSegment;
+
+_Static_assert(sizeof(atomic_uint) == 4, "The segment's atomics are plain 32 bit words to other languages.");
+_Static_assert(sizeof(BridgeState) == 120 && sizeof(BridgeAction) == 16, "BridgeState and BridgeAction are part of the segment layout.");
+_Static_assert(offsetof(BridgeSegment, state_sequence) == BRIDGE_OFFSET_STATE_SEQUENCE, "Segment layout");
+_Static_assert(offsetof(BridgeSegment, client_sleeping) == BRIDGE_OFFSET_CLIENT_SLEEPING, "Segment layout");
+_Static_assert(offsetof(BridgeSegment, state) == BRIDGE_OFFSET_STATE, "Segment layout");
+_Static_assert(offsetof(BridgeSegment, action_head) == BRIDGE_OFFSET_ACTION_HEAD, "Segment layout");
+_Static_assert(offsetof(BridgeSegment, host_sleeping) == BRIDGE_OFFSET_HOST_SLEEPING, "Segment layout");
+_Static_assert(offsetof(BridgeSegment, action_tail) == BRIDGE_OFFSET_ACTION_TAIL, "Segment layout");
+_Static_assert(offsetof(BridgeSegment, actions) == BRIDGE_OFFSET_ACTIONS, "Segment layout");
+_Static_assert(sizeof(BridgeSegment) == BRIDGE_SEGMENT_SIZE, "Segment layout");
+_Static_assert((BRIDGE_ACTION_RING_SIZE & (BRIDGE_ACTION_RING_SIZE - 1)) == 0, "The ring indexes with a mask.");
+
+struct Bridge {
+    BridgeSegment* segment;
+    uint32_t spin_count;
+    uint32_t spins_per_yield;
+    bool is_host;
+    char name[BRIDGE_MAX_NAME_LENGTH + 8];
+#if defined(_WIN32)
+    HANDLE mapping;
+#endif // _WIN32
+};
+
+static inline void relax_cpu()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    YieldProcessor();
+#elif defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+static uint32_t get_processor_count(void)
+{
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (uint32_t)info.dwNumberOfProcessors;
+#else
+    const long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return (count > 0) ? (uint32_t)count : 1;
+#endif // _WIN32
+}
+
+// Segment mapping.
+
+#if defined(_WIN32)
+static bool map_bridge_segment(Bridge* bridge, bool is_create)
+{
+    bridge->mapping = is_create ?
+        CreateFileMappingA(INVALID_HANDLE_VALUE, 0, PAGE_READWRITE, 0, BRIDGE_SEGMENT_SIZE, bridge->name) :
+        OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, bridge->name);
+    if (!bridge->mapping) return false;
+    bridge->segment = MapViewOfFile(bridge->mapping, FILE_MAP_ALL_ACCESS, 0, 0, BRIDGE_SEGMENT_SIZE);
+    if (bridge->segment) return true;
+    CloseHandle(bridge->mapping);
+    return false;
+}
+
+static void unmap_bridge_segment(Bridge* bridge)
+{
+    UnmapViewOfFile(bridge->segment);
+    CloseHandle(bridge->mapping); // The name goes with the last handle.
+}
+
+static void wait_on_word(atomic_uint* word, uint32_t seen, uint64_t timeout_nanoseconds)
+{
+    (void)word;
+    (void)seen;
+    (void)timeout_nanoseconds;
+    // WaitOnAddress doesn't reach across processes, so Windows polls.
+    thrd_sleep(&(struct timespec){ .tv_nsec = BRIDGE_POLL_NANOSECONDS }, 0);
+}
+
+static void wake_word(atomic_uint* word)
+{
+    (void)word;
+}
+#else
+static bool map_bridge_segment(Bridge* bridge, bool is_create)
+{
+    if (is_create) shm_unlink(bridge->name); // Whatever a host that crashed left behind.
+    const int descriptor = shm_open(bridge->name, is_create ? (O_RDWR | O_CREAT | O_EXCL) : O_RDWR, 0600);
+    struct stat status;
+    if (descriptor < 0) return false;
+    if ((is_create && ftruncate(descriptor, BRIDGE_SEGMENT_SIZE) != 0) ||
+        (!is_create && (fstat(descriptor, &status) != 0 || status.st_size < BRIDGE_SEGMENT_SIZE)))
+    {
+        close(descriptor);
+        if (is_create) shm_unlink(bridge->name);
+        return false;
+    }
+    void* data = mmap(0, BRIDGE_SEGMENT_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+    close(descriptor); // The mapping keeps the segment alive.
+    if (data == MAP_FAILED)
+    {
+        if (is_create) shm_unlink(bridge->name);
+        return false;
+    }
+    bridge->segment = data;
+    return true;
+}
+
+static void unmap_bridge_segment(Bridge* bridge)
+{
+    munmap(bridge->segment, BRIDGE_SEGMENT_SIZE);
+    if (bridge->is_host) shm_unlink(bridge->name);
+}
+
+#if defined(__linux__)
+// Shared futexes, not FUTEX_*_PRIVATE, since the other side is another process with its own mapping.
+static void wait_on_word(atomic_uint* word, uint32_t seen, uint64_t timeout_nanoseconds)
+{
+    const struct timespec timeout = {
+        .tv_sec = (time_t)(timeout_nanoseconds / NANOSECONDS_PER_SECOND),
+        .tv_nsec = (long)(timeout_nanoseconds % NANOSECONDS_PER_SECOND)
+    };
+    syscall(SYS_futex, (uint32_t*)word, FUTEX_WAIT, seen, &timeout, 0, 0);
+}
+
+static void wake_word(atomic_uint* word)
+{
+    syscall(SYS_futex, (uint32_t*)word, FUTEX_WAKE, INT_MAX, 0, 0, 0);
+}
+#else
+static void wait_on_word(atomic_uint* word, uint32_t seen, uint64_t timeout_nanoseconds)
+{
+    (void)word;
+    (void)seen;
+    (void)timeout_nanoseconds;
+    thrd_sleep(&(struct timespec){ .tv_nsec = BRIDGE_POLL_NANOSECONDS }, 0);
+}
+
+static void wake_word(atomic_uint* word)
+{
+    (void)word;
+}
+#endif // __linux__
+#endif // _WIN32
+
+// Until word differs from seen: spin_count polls, then sleeping on it. False at the deadline.
+static bool wait_for_word_change(const Bridge* bridge, atomic_uint* word, uint32_t seen, atomic_uint* sleeping, uint64_t deadline)
+{
+    for (uint32_t spin = 0; ; spin++)
+    {
+        if (atomic_load_explicit(word, memory_order_acquire) != seen) return true;
+        if (spin < bridge->spin_count && (spin % bridge->spins_per_yield) != bridge->spins_per_yield - 1)
+        {
+            relax_cpu();
+            continue;
+        }
+        const uint64_t now = get_monotonic_nanoseconds();
+        if (now >= deadline) return false;
+        if (spin < bridge->spin_count)
+        {
+            thrd_yield();
+            continue;
+        }
+        // Set before the last look, so whoever changes word after it sees this and wakes us.
+        atomic_store(sleeping, 1);
+        if (atomic_load(word) == seen) wait_on_word(word, seen, deadline - now);
+        atomic_store_explicit(sleeping, 0, memory_order_relaxed);
+    }
+}
+
+static inline uint64_t get_deadline(uint64_t timeout_nanoseconds)
+{
+    const uint64_t now = get_monotonic_nanoseconds();
+    return (timeout_nanoseconds > UINT64_MAX - now) ? UINT64_MAX : now + timeout_nanoseconds;
+}
+
+static Bridge* create_bridge(const char* name, uint32_t spin_count, bool is_host)
+{
+    if (!name || !*name || strlen(name) > BRIDGE_MAX_NAME_LENGTH || strchr(name, '/') || strchr(name, '\\')) return 0;
+    Bridge* bridge = calloc(1, sizeof(Bridge));
+    if (!bridge) return 0;
+    // With one processor the other side can't run while this one spins, so only a yield or a sleep lets it answer.
+    const bool is_alone = get_processor_count() == 1;
+    bridge->spin_count = (is_alone && spin_count != BRIDGE_SPIN_FOREVER) ? 0 : spin_count;
+    bridge->spins_per_yield = is_alone ? 1 : BRIDGE_SPINS_PER_YIELD;
+    bridge->is_host = is_host;
+#if defined(_WIN32)
+    snprintf(bridge->name, sizeof(bridge->name), "Local\\%s", name);
+#else
+    snprintf(bridge->name, sizeof(bridge->name), "/%s", name);
+#endif // _WIN32
+    if (map_bridge_segment(bridge, is_host)) return bridge;
+    free(bridge);
+    return 0;
+}
+
+void destroy_bridge(Bridge* bridge)
+{
+    if (!bridge) return;
+    if (bridge->is_host) stop_bridge_host(bridge);
+    unmap_bridge_segment(bridge);
+    free(bridge);
+}
+
+// Host.
+
+Bridge* create_bridge_host(const char* name, uint32_t spin_count)
+{
+    Bridge* bridge = create_bridge(name, spin_count, true);
+    if (!bridge) return 0;
+    BridgeSegment* segment = bridge->segment; // Fresh, so already zeroed.
+    segment->abi_version = BRIDGE_ABI_VERSION;
+    segment->segment_size = BRIDGE_SEGMENT_SIZE;
+    segment->action_ring_size = BRIDGE_ACTION_RING_SIZE;
+    atomic_thread_fence(memory_order_release);
+    segment->magic = BRIDGE_MAGIC; // Last, so a client that sees it sees the rest.
+    return bridge;
+}
+
+void publish_bridge_state(Bridge* bridge, const Game* game, uint64_t tick, uint32_t game_index)
+{
+    BridgeSegment* segment = bridge->segment;
+    BridgeState state = { 0 };
+    state.tick = tick;
+    write_env_observation(game, &state.observation);
+    state.score = game->score;
+    state.placed_piece_count = game->placed_piece_count;
+    state.game_index = game_index;
+    state.lines_cleared = game->playfield.lines_cleared;
+    state.is_game_over = is_game_over((Game*)game);
+
+    // Odd while writing. A reader that overlaps this sees the sequence move and copies again.
+    const uint32_t sequence = atomic_load_explicit(&segment->state_sequence, memory_order_relaxed);
+    atomic_store_explicit(&segment->state_sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy(&segment->state, &state, sizeof(BridgeState));
+    atomic_store_explicit(&segment->host_status, BRIDGE_HOST_RUNNING, memory_order_relaxed);
+    atomic_store(&segment->state_sequence, sequence + 2);
+    if (atomic_load(&segment->client_sleeping)) wake_word(&segment->state_sequence);
+}
+
+bool wait_bridge_action(Bridge* bridge, uint64_t tick, ACTION_BIT_FLAGS* out_action_bit_flags, uint64_t timeout_nanoseconds)
+{
+    BridgeSegment* segment = bridge->segment;
+    const uint64_t deadline = get_deadline(timeout_nanoseconds);
+    uint32_t tail = atomic_load_explicit(&segment->action_tail, memory_order_relaxed);
+    for (;;)
+    {
+        const uint32_t head = atomic_load_explicit(&segment->action_head, memory_order_acquire);
+        while (tail != head)
+        {
+            const BridgeAction action = segment->actions[tail % BRIDGE_ACTION_RING_SIZE];
+            atomic_store_explicit(&segment->action_tail, ++tail, memory_order_release);
+            if (action.tick != tick) continue; // Late answers to ticks that were already played, or a confused client.
+            *out_action_bit_flags = action.action_bit_flags;
+            return true;
+        }
+        if (!wait_for_word_change(bridge, &segment->action_head, head, &segment->host_sleeping, deadline)) return false;
+    }
+}
+
+void stop_bridge_host(Bridge* bridge)
+{
+    BridgeSegment* segment = bridge->segment;
+    if (atomic_load_explicit(&segment->host_status, memory_order_relaxed) == BRIDGE_HOST_STOPPED) return;
+    atomic_store_explicit(&segment->host_status, BRIDGE_HOST_STOPPED, memory_order_relaxed);
+    // An even step moves the sequence without touching the state, so a waiting client wakes and sees the status.
+    atomic_fetch_add(&segment->state_sequence, 2);
+    wake_word(&segment->state_sequence);
+}
+
+// Client.
+
+Bridge* open_bridge_client(const char* name, uint32_t spin_count)
+{
+    Bridge* bridge = create_bridge(name, spin_count, false);
+    if (!bridge) return 0;
+    const BridgeSegment* segment = bridge->segment;
+    const bool is_compatible = segment->magic == BRIDGE_MAGIC;
+    atomic_thread_fence(memory_order_acquire);
+    if (is_compatible && segment->abi_version == BRIDGE_ABI_VERSION && segment->segment_size == BRIDGE_SEGMENT_SIZE &&
+        segment->action_ring_size == BRIDGE_ACTION_RING_SIZE) return bridge;
+    destroy_bridge(bridge);
+    return 0;
+}
+
+bool wait_bridge_state(Bridge* bridge, uint64_t after_tick, BridgeState* out_state, uint64_t timeout_nanoseconds)
+{
+    BridgeSegment* segment = bridge->segment;
+    const uint64_t deadline = get_deadline(timeout_nanoseconds);
+    for (;;)
+    {
+        // The copy races with the host on purpose. It is only kept if the sequence didn't move while it was taken.
+        uint32_t sequence;
+        uint32_t status;
+        for (;;)
+        {
+            sequence = atomic_load_explicit(&segment->state_sequence, memory_order_acquire);
+            if (sequence & 1)
+            {
+                // Mid write. Bounded by the deadline too, in case the host died holding it.
+                if (!wait_for_word_change(bridge, &segment->state_sequence, sequence, &segment->client_sleeping, deadline)) return false;
+                continue;
+            }
+            status = atomic_load_explicit(&segment->host_status, memory_order_relaxed);
+            memcpy(out_state, &segment->state, sizeof(BridgeState));
+            atomic_thread_fence(memory_order_acquire);
+            if (atomic_load_explicit(&segment->state_sequence, memory_order_relaxed) == sequence) break;
+        }
+        if (status != BRIDGE_HOST_STARTING && (after_tick == UINT64_MAX || out_state->tick > after_tick)) return true;
+        if (status == BRIDGE_HOST_STOPPED) return false;
+        if (!wait_for_word_change(bridge, &segment->state_sequence, sequence, &segment->client_sleeping, deadline)) return false;
+    }
+}
+
+bool send_bridge_action(Bridge* bridge, uint64_t tick, ACTION_BIT_FLAGS action_bit_flags)
+{
+    BridgeSegment* segment = bridge->segment;
+    const uint32_t head = atomic_load_explicit(&segment->action_head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&segment->action_tail, memory_order_acquire) >= BRIDGE_ACTION_RING_SIZE) return false;
+    segment->actions[head % BRIDGE_ACTION_RING_SIZE] = (BridgeAction){ .tick = tick, .action_bit_flags = action_bit_flags };
+    atomic_store(&segment->action_head, head + 1);
+    if (atomic_load(&segment->host_sleeping)) wake_word(&segment->action_head);
+    return true;
+}
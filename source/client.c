@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <threads.h>
+
+#include "bridge.h"
+#include "clock.h"
+
+#define CLIENT_OPEN_ATTEMPTS        50                              // 100 ms apart, so a client started before the host waits five seconds for it.
+#define CLIENT_STATE_TIMEOUT        (10 * NANOSECONDS_PER_SECOND)
+
+// Reference client for zetris-serve. Everything a bot in another language has to do is here: map the segment, wait for a state,
+// answer it with the state's tick. The policy is deliberately simple: each piece goes towards the column with the lowest stack,
+// a tap at a time, then drops.
+typedef struct {
+    uint32_t placed_piece_count;    // Which piece the target is for.
+    uint32_t game_index;
+    uint8_t target_x;
+    uint8_t last_x;                 // pos_x when the last tap was pressed. Unchanged after it means the piece is blocked.
+    bool has_target;
+    ACTION_BIT_FLAGS previous_action_bit_flags;
+} ClientPolicy;
+
+static ACTION_BIT_FLAGS get_policy_action_bit_flags(ClientPolicy* policy, const BridgeState* state)
+{
+    const EnvObservation* observation = &state->observation;
+    if (!policy->has_target || policy->placed_piece_count != state->placed_piece_count || policy->game_index != state->game_index)
+    {
+        uint8_t lowest_column = 0;
+        uint8_t lowest_top = 0;
+        for (uint8_t x = 0; x < DEFAULT_COLUMN_COUNT; x++)
+        {
+            uint8_t top = 0;
+            while (top < ENV_OBSERVATION_ROW_COUNT && !(observation->rows[top] & (1u << x))) top++;
+            if (top > lowest_top)
+            {
+                lowest_top = top;
+                lowest_column = x;
+            }
+        }
+        policy->target_x = lowest_column + COLUMN_OFFSET - 1; // The piece's box, so its middle lands on the column.
+        policy->last_x = UINT8_MAX;
+        policy->placed_piece_count = state->placed_piece_count;
+        policy->game_index = state->game_index;
+        policy->has_target = true;
+    }
+
+    ACTION_BIT_FLAGS action_bit_flags = 0;
+    if (policy->previous_action_bit_flags)
+    {
+        action_bit_flags = 0; // tick only acts on fresh presses, so every press is released for a tick.
+    }
+    else if (observation->piece_x != policy->target_x && observation->piece_x != policy->last_x)
+    {
+        action_bit_flags = (observation->piece_x < policy->target_x) ? ACTION_MOVE_RIGHT : ACTION_MOVE_LEFT;
+        policy->last_x = observation->piece_x;
+    }
+    else
+    {
+        action_bit_flags = ACTION_HARD_DROP;
+    }
+    policy->previous_action_bit_flags = action_bit_flags;
+    return action_bit_flags;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        printf("usage: zetris-client <name> [spin count]\n");
+        return 1;
+    }
+    const uint32_t spin_count = (argc > 2) ? (uint32_t)strtoul(argv[2], 0, 10) : BRIDGE_DEFAULT_SPIN_COUNT;
+    Bridge* bridge = 0;
+    for (uint32_t attempt = 0; attempt < CLIENT_OPEN_ATTEMPTS && !bridge; attempt++)
+    {
+        bridge = open_bridge_client(argv[1], spin_count);
+        if (!bridge) thrd_sleep(&(struct timespec){ .tv_nsec = 100 * NANOSECONDS_PER_MILLISECOND }, 0);
+    }
+    if (!bridge)
+    {
+        printf("zetris-client: no host at %s (or it speaks another ABI version)\n", argv[1]);
+        return 1;
+    }
+
+    ClientPolicy policy = { 0 };
+    BridgeState state;
+    uint64_t tick = UINT64_MAX;
+    uint64_t answered = 0;
+    uint64_t waited = 0;
+    uint64_t sent_at = 0;
+    while (wait_bridge_state(bridge, tick, &state, CLIENT_STATE_TIMEOUT))
+    {
+        // From sending an action to seeing the next state: both handoffs plus the host's tick.
+        if (sent_at) waited += get_monotonic_nanoseconds() - sent_at;
+        tick = state.tick;
+        if (state.is_game_over) printf("game %u: score %u, %u lines\n", state.game_index, state.score, state.lines_cleared);
+        if (!send_bridge_action(bridge, tick, get_policy_action_bit_flags(&policy, &state))) break;
+        sent_at = get_monotonic_nanoseconds();
+        answered++;
+    }
+    destroy_bridge(bridge);
+    printf("zetris-client: answered %llu ticks, %.2f us from an action to the next state on average\n",
+        (unsigned long long)answered, answered > 1 ? waited / 1e3 / (answered - 1) : 0.0);
+    return 0;
+}
@@ -0,0 +1,24 @@
+#include "clock.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+uint64_t get_monotonic_nanoseconds(void)
+{
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    if (!frequency.QuadPart) QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)((counter.QuadPart / frequency.QuadPart) * NANOSECONDS_PER_SECOND + (counter.QuadPart % frequency.QuadPart) * NANOSECONDS_PER_SECOND / frequency.QuadPart);
+}
+#else
+#include <time.h>
+
+uint64_t get_monotonic_nanoseconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * NANOSECONDS_PER_SECOND + (uint64_t)now.tv_nsec;
+}
+#endif // _WIN32
@@ -0,0 +1,558 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "codec.h"
+#include "util.h"
+
+#define PIECE_ROTATION_SHIFT    3
+#define PIECE_ON_GROUND         0b00100000
+#define PIECE_IRREGULAR_CELLS   0b01000000  // cells aren't PIECE_ROTATION_CELLS[type][rotation], so they follow.
+#define HOLD_CAN_HOLD           0b00001000
+#define TYPE_MASK               0b00000111
+#define TYPE_BITS               3
+#define MAX_ROW_TYPE_BYTES      ((MAX_COLUMN_COUNT * TYPE_BITS + 7) / 8)
+#define KEYFRAME_FIELDS         (CODEC_FIELD_PIECE | CODEC_FIELD_QUEUE | CODEC_FIELD_DIMENSIONS) // Every game that can be played differs from an all zero one in these.
+
+static const Game ZERO_GAME;
+
+// One row of a board with its types, so rows compare and copy as a whole.
+typedef struct {
+    PlayfieldRow cells;
+    PlayfieldRow types[CELL_TYPE_PLANE_COUNT];
+} BoardRow;
+
+typedef struct {
+    const uint8_t* data;
+    const uint8_t* end;
+} CodecReader;
+
+static inline uint8_t get_type(const PieceData* piece_data)
+{
+    return (piece_data) ? (uint8_t)piece_data->type : 0;
+}
+
+static inline PieceData* get_type_data(uint8_t type)
+{
+    return (type) ? (PieceData*)get_piece_data((PieceType)type) : 0;
+}
+
+static inline uint64_t zigzag(uint64_t difference)
+{
+    return (difference << 1) ^ (0 - (difference >> 63));
+}
+
+static inline uint64_t unzigzag(uint64_t value)
+{
+    return (value >> 1) ^ (0 - (value & 1));
+}
+
+static inline bool are_floats_equal(float a, float b)
+{
+    return memcmp(&a, &b, sizeof(float)) == 0; // Bits, so -0 and NaNs survive.
+}
+
+static inline BoardRow get_board_row(const Playfield* playfield, uint8_t y)
+{
+    BoardRow row = { .cells = playfield->cells[y] };
+    for (uint8_t i = 0; i < CELL_TYPE_PLANE_COUNT; i++)
+    {
+        row.types[i] = playfield->type_planes[i][y];
+    }
+    return row;
+}
+
+static inline void set_board_row(Playfield* playfield, uint8_t y, const BoardRow* row)
+{
+    playfield->cells[y] = row->cells;
+    for (uint8_t i = 0; i < CELL_TYPE_PLANE_COUNT; i++)
+    {
+        playfield->type_planes[i][y] = row->types[i];
+    }
+}
+
+static inline bool are_board_rows_equal(const BoardRow* a, const BoardRow* b)
+{
+    return a->cells == b->cells && a->types[0] == b->types[0] && a->types[1] == b->types[1] && a->types[2] == b->types[2];
+}
+
+// Writing. out always has room, CODEC_MAX_ENCODED_SIZE covers the worst case.
+
+static inline uint8_t* write_varint(uint8_t* out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        *out++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = (uint8_t)value;
+    return out;
+}
+
+static inline uint8_t* write_bytes(uint8_t* out, const void* value, size_t size)
+{
+    memcpy(out, value, size);
+    return out + size;
+}
+
+static inline uint8_t* write_le(uint8_t* out, uint64_t value, uint8_t size)
+{
+    for (uint8_t i = 0; i < size; i++)
+    {
+        *out++ = (uint8_t)(value >> (8 * i));
+    }
+    return out;
+}
+
+static uint8_t* write_board_row(uint8_t* out, const BoardRow* row, uint8_t cell_bytes)
+{
+    out = write_le(out, row->cells, cell_bytes);
+    uint64_t bits = 0;
+    uint8_t bit_count = 0;
+    for (PlayfieldRow cells = row->cells; cells; cells &= cells - 1)
+    {
+        const uint8_t x = count_row_trailing_zeros(cells);
+        uint64_t type = 0;
+        for (uint8_t i = 0; i < CELL_TYPE_PLANE_COUNT; i++)
+        {
+            type |= (uint64_t)((row->types[i] >> x) & 1U) << i;
+        }
+        bits |= type << bit_count;
+        bit_count += TYPE_BITS;
+        if (bit_count >= 32)
+        {
+            out = write_le(out, (uint32_t)bits, 4);
+            bits >>= 32;
+            bit_count -= 32;
+        }
+    }
+    return write_le(out, (uint32_t)bits, (bit_count + 7) / 8);
+}
+
+// Longest run of rows from y on that the previous board already had somewhere. Ties go to the same rows, then the nearest.
+static uint8_t find_board_copy(const BoardRow* rows, const BoardRow* previous_rows, uint8_t row_count, uint8_t previous_row_count, uint8_t y, uint8_t* out_source)
+{
+    uint8_t best = 0;
+    for (uint8_t source = 0; source < previous_row_count; source++)
+    {
+        uint8_t length = 0;
+        while (y + length < row_count && source + length < previous_row_count && are_board_rows_equal(&rows[y + length], &previous_rows[source + length])) length++;
+        const bool is_better = length > best ||
+            (length == best && length && abs((int)source - y) < abs((int)*out_source - y));
+        if (is_better)
+        {
+            best = length;
+            *out_source = source;
+        }
+    }
+    return best;
+}
+
+static uint8_t* write_board(uint8_t* out, const Playfield* playfield, const Playfield* previous)
+{
+    BoardRow rows[MAX_ROW_COUNT];
+    BoardRow previous_rows[MAX_ROW_COUNT];
+    uint8_t first_row = playfield->row_count;
+    for (uint8_t y = 0; y < playfield->row_count; y++)
+    {
+        rows[y] = get_board_row(playfield, y);
+        if (first_row == playfield->row_count && (rows[y].cells | rows[y].types[0] | rows[y].types[1] | rows[y].types[2])) first_row = y;
+    }
+    for (uint8_t y = 0; y < previous->row_count; y++)
+    {
+        previous_rows[y] = get_board_row(previous, y);
+    }
+
+    const uint8_t cell_bytes = (playfield->column_count + 7) / 8;
+    out = write_varint(out, first_row);
+    uint8_t y = first_row;
+    while (y < playfield->row_count)
+    {
+        uint8_t source = 0;
+        uint8_t length = find_board_copy(rows, previous_rows, playfield->row_count, previous->row_count, y, &source);
+        if (length)
+        {
+            out = write_varint(out, ((uint64_t)length << 1) | 1);
+            out = write_varint(out, zigzag((uint64_t)((int64_t)source - y)));
+            y += length;
+            continue;
+        }
+        // Literal rows until one could be copied again.
+        uint8_t end = y + 1;
+        while (end < playfield->row_count && !find_board_copy(rows, previous_rows, playfield->row_count, previous->row_count, end, &source)) end++;
+        out = write_varint(out, (uint64_t)(end - y) << 1);
+        for (; y < end; y++)
+        {
+            out = write_board_row(out, &rows[y], cell_bytes);
+        }
+    }
+    return out;
+}
+
+static bool are_boards_equal(const Playfield* a, const Playfield* b)
+{
+    if (a->row_count != b->row_count) return false;
+    const size_t size = a->row_count * sizeof(PlayfieldRow);
+    if (memcmp(a->cells, b->cells, size) != 0) return false;
+    for (uint8_t i = 0; i < CELL_TYPE_PLANE_COUNT; i++)
+    {
+        if (memcmp(a->type_planes[i], b->type_planes[i], size) != 0) return false;
+    }
+    return true;
+}
+
+static uint16_t get_changed_fields(const Game* game, const Game* previous)
+{
+    const Piece* piece = &game->controlled_piece;
+    const Piece* last = &previous->controlled_piece;
+    uint16_t fields = 0;
+    if (piece->type != last->type || piece->rotation != last->rotation || piece->on_ground != last->on_ground ||
+        piece->pos_x != last->pos_x || piece->pos_y != last->pos_y || piece->moves != last->moves ||
+        piece->cells != last->cells || game->controlled_piece_ground_y != previous->controlled_piece_ground_y) fields |= CODEC_FIELD_PIECE;
+    if (!are_floats_equal(piece->timer, last->timer)) fields |= CODEC_FIELD_TIMER;
+    if (!are_floats_equal(piece->velo_x, last->velo_x) || !are_floats_equal(piece->velo_y, last->velo_y)) fields |= CODEC_FIELD_VELOCITY;
+    if (game->previous_action_bit_flags != previous->previous_action_bit_flags) fields |= CODEC_FIELD_ACTIONS;
+    if (!are_boards_equal(&game->playfield, &previous->playfield)) fields |= CODEC_FIELD_BOARD;
+    if (game->placed_piece_count != previous->placed_piece_count) fields |= CODEC_FIELD_PLACED;
+    if (game->piece_queue_index != previous->piece_queue_index) fields |= CODEC_FIELD_QUEUE_INDEX;
+    if (get_type(game->held_piece) != get_type(previous->held_piece) || game->can_hold_piece != previous->can_hold_piece) fields |= CODEC_FIELD_HOLD;
+    if (game->score != previous->score) fields |= CODEC_FIELD_SCORE;
+    if (game->playfield.lines_cleared != previous->playfield.lines_cleared || game->cleared_lines_last_piece != previous->cleared_lines_last_piece ||
+        game->combo_count != previous->combo_count || game->level_index != previous->level_index) fields |= CODEC_FIELD_LINES;
+    for (uint8_t i = 0; i < PIECE_QUEUE_LENGTH; i++)
+    {
+        if (get_type(game->piece_queue[i]) != get_type(previous->piece_queue[i])) fields |= CODEC_FIELD_QUEUE;
+    }
+    if (game->random_state != previous->random_state) fields |= CODEC_FIELD_RANDOM;
+    if (game->setting_bit_flags != previous->setting_bit_flags) fields |= CODEC_FIELD_SETTINGS;
+    if (!are_floats_equal(game->handling.das, previous->handling.das) || !are_floats_equal(game->handling.arr, previous->handling.arr) ||
+        !are_floats_equal(game->handling.soft_drop_factor, previous->handling.soft_drop_factor)) fields |= CODEC_FIELD_HANDLING;
+    if (game->playfield.column_count != previous->playfield.column_count || game->playfield.ceiling != previous->playfield.ceiling) fields |= CODEC_FIELD_DIMENSIONS;
+    // The row count decides which rows the board covers, so it comes first and the board has to follow it.
+    if (game->playfield.row_count != previous->playfield.row_count) fields |= CODEC_FIELD_DIMENSIONS | CODEC_FIELD_BOARD;
+    return fields;
+}
+
+size_t encode_game_state(const Game* game, const Game* previous, uint8_t* out)
+{
+    if (!previous) previous = &ZERO_GAME;
+    const uint8_t* start = out;
+    const uint16_t fields = get_changed_fields(game, previous);
+    out = write_varint(out, fields);
+    if (fields & CODEC_FIELD_DIMENSIONS)
+    {
+        *out++ = game->playfield.row_count;
+        *out++ = game->playfield.column_count;
+        *out++ = game->playfield.ceiling;
+    }
+    const Piece* piece = &game->controlled_piece;
+    if (fields & CODEC_FIELD_PIECE)
+    {
+        const bool is_irregular = piece->cells != PIECE_ROTATION_CELLS[piece->type][piece->rotation];
+        *out++ = (uint8_t)piece->type | (uint8_t)(piece->rotation << PIECE_ROTATION_SHIFT) | (piece->on_ground ? PIECE_ON_GROUND : 0) | (is_irregular ? PIECE_IRREGULAR_CELLS : 0);
+        *out++ = piece->pos_x;
+        *out++ = piece->pos_y;
+        *out++ = piece->moves;
+        *out++ = game->controlled_piece_ground_y;
+        if (is_irregular) out = write_le(out, piece->cells, sizeof(PieceCells));
+    }
+    if (fields & CODEC_FIELD_TIMER) out = write_bytes(out, &piece->timer, sizeof(float));
+    if (fields & CODEC_FIELD_VELOCITY)
+    {
+        out = write_bytes(out, &piece->velo_x, sizeof(float));
+        out = write_bytes(out, &piece->velo_y, sizeof(float));
+    }
+    if (fields & CODEC_FIELD_ACTIONS) *out++ = game->previous_action_bit_flags;
+    if (fields & CODEC_FIELD_BOARD) out = write_board(out, &game->playfield, &previous->playfield);
+    if (fields & CODEC_FIELD_PLACED) out = write_varint(out, zigzag((uint64_t)game->placed_piece_count - previous->placed_piece_count));
+    if (fields & CODEC_FIELD_QUEUE_INDEX) *out++ = game->piece_queue_index;
+    if (fields & CODEC_FIELD_HOLD) *out++ = get_type(game->held_piece) | (game->can_hold_piece ? HOLD_CAN_HOLD : 0);
+    if (fields & CODEC_FIELD_SCORE) out = write_varint(out, zigzag(game->score - previous->score));
+    if (fields & CODEC_FIELD_LINES)
+    {
+        out = write_varint(out, zigzag((uint64_t)game->playfield.lines_cleared - previous->playfield.lines_cleared));
+        *out++ = game->cleared_lines_last_piece;
+        *out++ = game->combo_count;
+        *out++ = game->level_index;
+    }
+    if (fields & CODEC_FIELD_QUEUE)
+    {
+        for (uint8_t i = 0; i < PIECE_QUEUE_LENGTH; i += 2)
+        {
+            *out++ = get_type(game->piece_queue[i]) | (uint8_t)(get_type(game->piece_queue[i + 1]) << 4);
+        }
+    }
+    if (fields & CODEC_FIELD_RANDOM) out = write_bytes(out, &game->random_state, sizeof(uint64_t));
+    if (fields & CODEC_FIELD_SETTINGS) *out++ = game->setting_bit_flags;
+    if (fields & CODEC_FIELD_HANDLING)
+    {
+        out = write_bytes(out, &game->handling.das, sizeof(float));
+        out = write_bytes(out, &game->handling.arr, sizeof(float));
+        out = write_bytes(out, &game->handling.soft_drop_factor, sizeof(float));
+    }
+    return (size_t)(out - start);
+}
+
+size_t encode_game_states(const Game* games, uint32_t count, const Game* previous, uint8_t* out, size_t capacity)
+{
+    uint8_t scratch[CODEC_MAX_ENCODED_SIZE];
+    size_t size = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const Game* last = (i) ? &games[i - 1] : previous;
+        if (capacity - size >= CODEC_MAX_ENCODED_SIZE)
+        {
+            size += encode_game_state(&games[i], last, &out[size]);
+            continue;
+        }
+        // Close to the end, so it goes through scratch in case this one is the worst case.
+        const size_t state_size = encode_game_state(&games[i], last, scratch);
+        if (state_size > capacity - size) return 0;
+        memcpy(&out[size], scratch, state_size);
+        size += state_size;
+    }
+    return size;
+}
+
+// Reading. Every read is checked, the data may have come over a network.
+
+static inline bool read_varint(CodecReader* reader, uint64_t* out_value)
+{
+    uint64_t value = 0;
+    for (uint8_t shift = 0; shift < 64 && reader->data < reader->end; shift += 7)
+    {
+        const uint8_t byte = *reader->data++;
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+        {
+            *out_value = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+static inline bool read_bytes(CodecReader* reader, void* out_value, size_t size)
+{
+    if ((size_t)(reader->end - reader->data) < size) return false;
+    memcpy(out_value, reader->data, size);
+    reader->data += size;
+    return true;
+}
+
+static inline bool read_le(CodecReader* reader, uint64_t* out_value, uint8_t size)
+{
+    if ((size_t)(reader->end - reader->data) < size) return false;
+    uint64_t value = 0;
+    for (uint8_t i = 0; i < size; i++)
+    {
+        value |= (uint64_t)reader->data[i] << (8 * i);
+    }
+    reader->data += size;
+    *out_value = value;
+    return true;
+}
+
+static bool read_board_row(CodecReader* reader, BoardRow* row, uint8_t cell_bytes, PlayfieldRow column_mask)
+{
+    uint64_t cells_value;
+    if (!read_le(reader, &cells_value, cell_bytes) || (cells_value & ~(uint64_t)column_mask)) return false;
+    row->cells = (PlayfieldRow)cells_value;
+    memset(row->types, 0, sizeof(row->types));
+    const uint8_t type_bytes = (count_row_set_bits(row->cells) * TYPE_BITS + 7) / 8;
+    uint8_t bytes[MAX_ROW_TYPE_BYTES + 1] = { 0 }; // One over, so a type straddling the last byte can read two.
+    if (!read_bytes(reader, bytes, type_bytes)) return false;
+    uint16_t bit = 0;
+    for (PlayfieldRow cells = row->cells; cells; cells &= cells - 1)
+    {
+        const uint32_t word = bytes[bit / 8] | ((uint32_t)bytes[bit / 8 + 1] << 8);
+        const uint32_t type = (word >> (bit % 8)) & TYPE_MASK;
+        const uint8_t x = count_row_trailing_zeros(cells);
+        for (uint8_t i = 0; i < CELL_TYPE_PLANE_COUNT; i++)
+        {
+            row->types[i] |= (PlayfieldRow)((type >> i) & 1U) << x;
+        }
+        bit += TYPE_BITS;
+    }
+    return true;
+}
+
+// previous and playfield are never the same, decode_game_state works on a copy.
+static bool read_board(CodecReader* reader, const Playfield* previous, Playfield* playfield)
+{
+    uint64_t first_row;
+    if (!read_varint(reader, &first_row) || first_row > playfield->row_count) return false;
+    BoardRow row = { 0 };
+    for (uint8_t y = 0; y < first_row; y++)
+    {
+        set_board_row(playfield, y, &row);
+    }
+
+    const uint8_t cell_bytes = (playfield->column_count + 7) / 8;
+    const PlayfieldRow column_mask = get_playfield_full_row(playfield);
+    uint8_t y = (uint8_t)first_row;
+    while (y < playfield->row_count)
+    {
+        uint64_t run;
+        if (!read_varint(reader, &run) || !(run >> 1) || (run >> 1) > (uint64_t)(playfield->row_count - y)) return false;
+        const uint8_t length = (uint8_t)(run >> 1);
+        if (run & 1)
+        {
+            uint64_t offset;
+            if (!read_varint(reader, &offset)) return false;
+            const int64_t source = (int64_t)y + (int64_t)unzigzag(offset);
+            if (source < 0 || source + length > previous->row_count) return false;
+            const size_t size = length * sizeof(PlayfieldRow);
+            memcpy(&playfield->cells[y], &previous->cells[source], size);
+            for (uint8_t i = 0; i < CELL_TYPE_PLANE_COUNT; i++)
+            {
+                memcpy(&playfield->type_planes[i][y], &previous->type_planes[i][source], size);
+            }
+            y += length;
+            continue;
+        }
+        for (const uint8_t end = y + length; y < end; y++)
+        {
+            if (!read_board_row(reader, &row, cell_bytes, column_mask)) return false;
+            set_board_row(playfield, y, &row);
+        }
+    }
+    return true; // Rows past row_count stay as they were, empty in any game.
+}
+
+// Every cell of the controlled piece inside the columns and rows, which tick's shifts and drops count on. It can overlap the stack
+// (a spawn at game over does), just never the walls or the floor.
+static bool is_piece_inside_playfield(const Piece* piece, const Playfield* playfield)
+{
+    if (piece->pos_x > 64 - PIECE_MAX_SIZE) return false;
+    const uint64_t columns = (((uint64_t)1 << playfield->column_count) - 1) << COLUMN_OFFSET;
+    for (uint8_t y = 0; y < PIECE_MAX_SIZE; y++)
+    {
+        const uint64_t row = (uint64_t)((piece->cells >> (PIECE_MAX_SIZE * y)) & 0xF) << piece->pos_x;
+        if (row && (piece->pos_y + y >= playfield->row_count || (row & ~columns))) return false;
+    }
+    return true;
+}
+
+// The floats tick divides by, adds to and casts, within what a game can hold between ticks: the handling is_handling_valid allows,
+// a lock timer under LOCK_DELAY (it locks on reaching it), DAS charge up to a DAS and a repeat, and less fall than the tallest
+// board. Written so NaN fails every comparison.
+static bool are_game_floats_valid(const Game* game)
+{
+    const Piece* piece = &game->controlled_piece;
+    return is_handling_valid(game->handling) && piece->timer >= 0.0f && piece->timer < LOCK_DELAY &&
+        piece->velo_x >= 0.0f && piece->velo_x <= MAX_DAS + MAX_ARR && piece->velo_y >= 0.0f && piece->velo_y <= MAX_ROW_COUNT;
+}
+
+// A game always has a controlled piece, so unlike the hold, type 0 is malformed here.
+static bool set_piece_type(Piece* piece, uint8_t type)
+{
+    if (type < I_TYPE || type > L_TYPE) return false;
+    const PieceData* piece_data = get_type_data(type);
+    piece->type = (PieceType)type;
+    piece->rotation_wall_kicks = piece_data->rotation_wall_kicks;
+    piece->size = piece_data->size;
+    return true;
+}
+
+size_t decode_game_state(const uint8_t* data, size_t size, const Game* previous, Game* out_game)
+{
+    if (!previous) previous = &ZERO_GAME;
+    CodecReader reader = { data, data + size };
+    uint64_t fields;
+    if (!read_varint(&reader, &fields) || (fields & ~(uint64_t)CODEC_FIELD_ALL)) return 0;
+    if (previous == &ZERO_GAME && (fields & KEYFRAME_FIELDS) != KEYFRAME_FIELDS) return 0;
+    // Decoded into a copy, so previous can be out_game and nothing is written if the state turns out malformed.
+    Game game = *previous;
+
+    if (fields & CODEC_FIELD_DIMENSIONS)
+    {
+        uint8_t dimensions[3];
+        // The bounds get_sized_initialized_game keeps to, so a piece always fits under the ceiling.
+        if (!read_bytes(&reader, dimensions, sizeof(dimensions)) || dimensions[0] > MAX_ROW_COUNT || dimensions[1] > MAX_COLUMN_COUNT ||
+            dimensions[1] < PIECE_MAX_SIZE || dimensions[2] + PIECE_MAX_SIZE > dimensions[0]) return 0;
+        game.playfield.row_count = dimensions[0];
+        game.playfield.column_count = dimensions[1];
+        game.playfield.ceiling = dimensions[2];
+    }
+    Piece* piece = &game.controlled_piece;
+    if (fields & CODEC_FIELD_PIECE)
+    {
+        uint8_t bytes[5];
+        if (!read_bytes(&reader, bytes, sizeof(bytes)) || !set_piece_type(piece, bytes[0] & TYPE_MASK)) return 0;
+        piece->rotation = (bytes[0] >> PIECE_ROTATION_SHIFT) & (PIECE_ROTATION_STATES - 1);
+        piece->on_ground = bytes[0] & PIECE_ON_GROUND;
+        piece->pos_x = bytes[1];
+        piece->pos_y = bytes[2];
+        piece->moves = bytes[3];
+        game.controlled_piece_ground_y = bytes[4];
+        uint64_t cells = PIECE_ROTATION_CELLS[piece->type][piece->rotation];
+        if ((bytes[0] & PIECE_IRREGULAR_CELLS) && !read_le(&reader, &cells, sizeof(PieceCells))) return 0;
+        piece->cells = (PieceCells)cells;
+    }
+    if ((fields & CODEC_FIELD_TIMER) && !read_bytes(&reader, &piece->timer, sizeof(float))) return 0;
+    if ((fields & CODEC_FIELD_VELOCITY) && !(read_bytes(&reader, &piece->velo_x, sizeof(float)) && read_bytes(&reader, &piece->velo_y, sizeof(float)))) return 0;
+    if ((fields & CODEC_FIELD_ACTIONS) && !read_bytes(&reader, &game.previous_action_bit_flags, 1)) return 0;
+    if ((fields & CODEC_FIELD_BOARD) && !read_board(&reader, &previous->playfield, &game.playfield)) return 0;
+    uint64_t value;
+    if (fields & CODEC_FIELD_PLACED)
+    {
+        if (!read_varint(&reader, &value)) return 0;
+        game.placed_piece_count += (uint32_t)unzigzag(value);
+    }
+    if (fields & CODEC_FIELD_QUEUE_INDEX)
+    {
+        if (!read_bytes(&reader, &game.piece_queue_index, 1) || game.piece_queue_index >= PIECE_QUEUE_LENGTH) return 0;
+    }
+    if (fields & CODEC_FIELD_HOLD)
+    {
+        uint8_t hold;
+        if (!read_bytes(&reader, &hold, 1) || (hold & TYPE_MASK) > PIECE_COUNT) return 0;
+        game.held_piece = get_type_data(hold & TYPE_MASK);
+        game.can_hold_piece = hold & HOLD_CAN_HOLD;
+    }
+    if (fields & CODEC_FIELD_SCORE)
+    {
+        if (!read_varint(&reader, &value)) return 0;
+        game.score += unzigzag(value);
+    }
+    if (fields & CODEC_FIELD_LINES)
+    {
+        uint8_t bytes[3];
+        if (!read_varint(&reader, &value) || !read_bytes(&reader, bytes, sizeof(bytes)) || bytes[2] >= LEVEL_COUNT) return 0;
+        game.playfield.lines_cleared += (uint32_t)unzigzag(value);
+        game.cleared_lines_last_piece = bytes[0];
+        game.combo_count = bytes[1];
+        game.level_index = bytes[2];
+    }
+    if (fields & CODEC_FIELD_QUEUE)
+    {
+        uint8_t types[PIECE_QUEUE_LENGTH / 2];
+        if (!read_bytes(&reader, types, sizeof(types))) return 0;
+        for (uint8_t i = 0; i < PIECE_QUEUE_LENGTH; i++)
+        {
+            const uint8_t type = (types[i / 2] >> (4 * (i & 1))) & 0x0F;
+            if (type < I_TYPE || type > L_TYPE) return 0; // Every slot of both bags always holds a piece.
+            game.piece_queue[i] = get_type_data(type);
+        }
+    }
+    if ((fields & CODEC_FIELD_RANDOM) && !read_bytes(&reader, &game.random_state, sizeof(uint64_t))) return 0;
+    if ((fields & CODEC_FIELD_SETTINGS) && !read_bytes(&reader, &game.setting_bit_flags, 1)) return 0;
+    if ((fields & CODEC_FIELD_HANDLING) && !(read_bytes(&reader, &game.handling.das, sizeof(float)) &&
+        read_bytes(&reader, &game.handling.arr, sizeof(float)) && read_bytes(&reader, &game.handling.soft_drop_factor, sizeof(float)))) return 0;
+    if (!is_piece_inside_playfield(&game.controlled_piece, &game.playfield)) return 0; // Either side may have moved, the piece or the board size.
+    if (!are_game_floats_valid(&game)) return 0;
+    *out_game = game;
+    return (size_t)(reader.data - data);
+}
+
+size_t decode_game_states(const uint8_t* data, size_t size, const Game* previous, Game* out_games, uint32_t count)
+{
+    size_t offset = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const size_t state_size = decode_game_state(&data[offset], size - offset, (i) ? &out_games[i - 1] : previous, &out_games[i]);
+        if (!state_size) return 0;
+        offset += state_size;
+    }
+    return offset;
+}
@@ -0,0 +1,692 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+#include "dataset.h"
+#include "mapped_file.h"
+#include "trace.h"
+
+#define RUN_MIN_LENGTH      3       // Shorter repeats stay literals, a run costs two bytes.
+#define RUN_MAX_LENGTH      (127 + RUN_MIN_LENGTH)
+#define LITERAL_MAX_LENGTH  128
+#define FNV32_OFFSET_BASIS  0x811C9DC5U
+#define FNV32_PRIME         0x01000193U
+
+const uint8_t DATASET_COLUMN_WIDTHS[DATASET_COLUMN_COUNT] = {
+    [DATASET_COLUMN_GAME_ID] = 8,
+    [DATASET_COLUMN_PIECE_INDEX] = 4,
+    [DATASET_COLUMN_BOARD] = 4 * DATASET_BOARD_ROW_COUNT,
+    [DATASET_COLUMN_CURRENT] = 1,
+    [DATASET_COLUMN_HOLD] = 1,
+    [DATASET_COLUMN_QUEUE] = PIECE_PREVIEW_COUNT,
+    [DATASET_COLUMN_CAN_HOLD] = 1,
+    [DATASET_COLUMN_COMBO] = 1,
+    [DATASET_COLUMN_LEVEL] = 1,
+    [DATASET_COLUMN_PLACEMENT_TYPE] = 1,
+    [DATASET_COLUMN_PLACEMENT_X] = 1,
+    [DATASET_COLUMN_PLACEMENT_Y] = 1,
+    [DATASET_COLUMN_PLACEMENT_ROTATION] = 1,
+    [DATASET_COLUMN_PLACEMENT_HOLD] = 1,
+    [DATASET_COLUMN_LINES_CLEARED] = 1,
+    [DATASET_COLUMN_SCORE_GAINED] = 4,
+    [DATASET_COLUMN_GAME_SCORE] = 8,
+    [DATASET_COLUMN_GAME_LINES] = 4,
+    [DATASET_COLUMN_GAME_PIECES] = 4,
+    [DATASET_COLUMN_GAME_OVER] = 1
+};
+_Static_assert(DATASET_COLUMN_COUNT <= DATASET_MAX_COLUMN_COUNT, "Column widths must fit the header");
+
+static const char* const DATASET_COLUMN_NAMES[DATASET_COLUMN_COUNT] = {
+    "game_id", "piece_index", "board", "current", "hold", "queue", "can_hold", "combo", "level",
+    "placement_type", "placement_x", "placement_y", "placement_rotation", "placement_hold",
+    "lines_cleared", "score_gained", "game_score", "game_lines", "game_pieces", "game_over"
+};
+
+// An encoded chunk on its way to the file.
+typedef struct {
+    uint8_t* data;
+    size_t size;
+    uint32_t row_count;
+} DatasetChunk;
+
+struct DatasetWriter {
+    FILE* file;
+    thrd_t thread;
+    DatasetChunk* queue;
+    uint32_t queue_capacity;
+    uint32_t head;
+    uint32_t count;
+    bool closed;
+    mtx_t mutex;
+    cnd_t not_empty;
+    cnd_t not_full;
+    // Writing thread only, until it is joined.
+    uint8_t* index;
+    size_t index_size;
+    size_t index_capacity;
+    uint64_t offset;
+    uint64_t row_count;
+    uint64_t chunk_count;
+    uint32_t chunk_rows;
+    atomic_bool failed;
+};
+
+struct DatasetProducer {
+    DatasetWriter* writer;
+    uint8_t* columns[DATASET_COLUMN_COUNT];     // chunk_rows values each.
+    uint8_t* shuffled;                          // Scratch for the widest column.
+    uint32_t row_count;
+};
+
+struct DatasetReader {
+    MappedFile file;
+    const uint8_t* index;
+    uint64_t row_count;
+    uint32_t chunk_count;
+    uint32_t chunk_rows;
+};
+
+static inline void write_le(uint8_t* out, uint64_t value, uint8_t size)
+{
+    for (uint8_t i = 0; i < size; i++)
+    {
+        out[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static inline uint64_t read_le(const uint8_t* in, uint8_t size)
+{
+    uint64_t value = 0;
+    for (uint8_t i = 0; i < size; i++)
+    {
+        value |= (uint64_t)in[i] << (8 * i);
+    }
+    return value;
+}
+
+static uint32_t hash_chunk(const uint8_t* chunk, size_t size)
+{
+    uint32_t hash = FNV32_OFFSET_BASIS;
+    for (size_t i = DATASET_CHUNK_HEADER_SIZE; i < size; i++)
+    {
+        hash = (hash ^ chunk[i]) * FNV32_PRIME;
+    }
+    return hash;
+}
+
+const char* get_dataset_column_name(DatasetColumn column)
+{
+    return (column < DATASET_COLUMN_COUNT) ? DATASET_COLUMN_NAMES[column] : "unknown";
+}
+
+void set_dataset_row_state(DatasetRow* row, uint64_t game_id, const Game* game)
+{
+    memset(row, 0, sizeof(DatasetRow));
+    row->game_id = game_id;
+    row->piece_index = game->placed_piece_count;
+    const uint8_t row_count = (game->playfield.row_count < DATASET_BOARD_ROW_COUNT) ? game->playfield.row_count : DATASET_BOARD_ROW_COUNT;
+    for (uint8_t y = 0; y < row_count; y++)
+    {
+        row->board[y] = (uint32_t)game->playfield.cells[y];
+    }
+    row->current = (uint8_t)game->controlled_piece.type;
+    row->hold = (game->held_piece) ? (uint8_t)game->held_piece->type : 0;
+    for (uint8_t i = 0; i < PIECE_PREVIEW_COUNT; i++)
+    {
+        row->queue[i] = (uint8_t)peek_piece_queue(game, i)->type;
+    }
+    row->can_hold = game->can_hold_piece && (game->setting_bit_flags & SETTING_CAN_HOLD);
+    row->combo_count = game->combo_count;
+    row->level_index = game->level_index;
+}
+
+// Codec.
+
+// PackBits: a control byte below 128 is followed by that many plus one literal bytes, one at or above it repeats the next byte.
+static size_t encode_runs(const uint8_t* in, size_t size, uint8_t* out, size_t capacity)
+{
+    size_t i = 0;
+    size_t o = 0;
+    while (i < size)
+    {
+        size_t run = 1;
+        while (i + run < size && run < RUN_MAX_LENGTH && in[i + run] == in[i]) run++;
+        if (run >= RUN_MIN_LENGTH)
+        {
+            if (o + 2 > capacity) return 0;
+            out[o++] = (uint8_t)(128 + run - RUN_MIN_LENGTH);
+            out[o++] = in[i];
+            i += run;
+            continue;
+        }
+        // Literals up to where a run is worth starting.
+        size_t literal = 0;
+        while (i + literal < size && literal < LITERAL_MAX_LENGTH &&
+            !(i + literal + 2 < size && in[i + literal] == in[i + literal + 1] && in[i + literal] == in[i + literal + 2]))
+        {
+            literal++;
+        }
+        if (o + 1 + literal > capacity) return 0;
+        out[o++] = (uint8_t)(literal - 1);
+        memcpy(&out[o], &in[i], literal);
+        o += literal;
+        i += literal;
+    }
+    return o;
+}
+
+// The runs are over byte planes (byte 0 of every value, then byte 1...), and get put back into whole values as they are read.
+static bool decode_runs(const uint8_t* in, size_t size, uint8_t* out_values, uint32_t value_count, uint8_t width)
+{
+    const size_t expected = (size_t)value_count * width;
+    size_t produced = 0;
+    uint32_t value = 0;
+    uint8_t plane = 0;
+    size_t i = 0;
+    while (i < size)
+    {
+        const uint8_t control = in[i++];
+        const bool is_run = control >= 128;
+        const size_t length = is_run ? (size_t)control - 128 + RUN_MIN_LENGTH : (size_t)control + 1;
+        if (produced + length > expected || i + (is_run ? 1 : length) > size) return false;
+        for (size_t j = 0; j < length; j++)
+        {
+            out_values[(size_t)value * width + plane] = is_run ? in[i] : in[i + j];
+            if (++value == value_count)
+            {
+                value = 0;
+                plane++;
+            }
+        }
+        i += is_run ? 1 : length;
+        produced += length;
+    }
+    return produced == expected;
+}
+
+// Writing.
+
+static void push_chunk(DatasetWriter* writer, DatasetChunk chunk)
+{
+    mtx_lock(&writer->mutex);
+    while (writer->count == writer->queue_capacity)
+    {
+        cnd_wait(&writer->not_full, &writer->mutex);
+    }
+    writer->queue[(writer->head + writer->count++) % writer->queue_capacity] = chunk;
+    cnd_signal(&writer->not_empty);
+    mtx_unlock(&writer->mutex);
+}
+
+static bool pop_chunk(DatasetWriter* writer, DatasetChunk* out_chunk)
+{
+    mtx_lock(&writer->mutex);
+    while (!writer->count && !writer->closed)
+    {
+        cnd_wait(&writer->not_empty, &writer->mutex);
+    }
+    if (!writer->count)
+    {
+        mtx_unlock(&writer->mutex);
+        return false;
+    }
+    *out_chunk = writer->queue[writer->head];
+    writer->head = (writer->head + 1) % writer->queue_capacity;
+    writer->count--;
+    cnd_signal(&writer->not_full);
+    mtx_unlock(&writer->mutex);
+    return true;
+}
+
+// Appends chunks in the order they come in and remembers where each went. Once anything fails, chunks are only freed.
+static int run_dataset_writer(void* arg)
+{
+    DatasetWriter* writer = arg;
+    DatasetChunk chunk;
+    set_trace_thread_name("dataset writer");
+    while (pop_chunk(writer, &chunk))
+    {
+        if (!atomic_load_explicit(&writer->failed, memory_order_relaxed))
+        {
+            TRACE_BEGIN("dataset write");
+            if (writer->index_size + DATASET_INDEX_ENTRY_SIZE > writer->index_capacity)
+            {
+                const size_t capacity = (writer->index_capacity) ? writer->index_capacity * 2 : 1024 * DATASET_INDEX_ENTRY_SIZE;
+                uint8_t* index = realloc(writer->index, capacity);
+                if (index)
+                {
+                    writer->index = index;
+                    writer->index_capacity = capacity;
+                }
+            }
+            if (writer->index_size + DATASET_INDEX_ENTRY_SIZE > writer->index_capacity || fwrite(chunk.data, 1, chunk.size, writer->file) != chunk.size)
+            {
+                atomic_store_explicit(&writer->failed, true, memory_order_relaxed);
+            }
+            else
+            {
+                uint8_t* entry = &writer->index[writer->index_size];
+                write_le(&entry[0], writer->offset, 8);
+                write_le(&entry[8], writer->row_count, 8);
+                write_le(&entry[16], chunk.size, 4);
+                write_le(&entry[20], chunk.row_count, 4);
+                writer->index_size += DATASET_INDEX_ENTRY_SIZE;
+                writer->offset += chunk.size;
+                writer->row_count += chunk.row_count;
+                writer->chunk_count++;
+            }
+            TRACE_END("dataset write");
+        }
+        free(chunk.data);
+    }
+    return 0;
+}
+
+DatasetWriter* create_dataset_writer(const char* path, uint32_t chunk_rows, uint32_t queue_capacity)
+{
+    DatasetWriter* writer = calloc(1, sizeof(DatasetWriter));
+    if (!writer) return 0;
+    writer->chunk_rows = (chunk_rows) ? chunk_rows : DATASET_DEFAULT_CHUNK_ROWS;
+    writer->queue_capacity = (queue_capacity) ? queue_capacity : DATASET_DEFAULT_QUEUE_CAPACITY;
+    writer->queue = malloc(writer->queue_capacity * sizeof(DatasetChunk));
+    writer->file = fopen(path, "wb");
+    uint8_t header[DATASET_HEADER_SIZE] = { 0 };
+    memcpy(header, DATASET_MAGIC, 4);
+    write_le(&header[4], DATASET_VERSION, 2);
+    write_le(&header[6], DATASET_COLUMN_COUNT, 2);
+    write_le(&header[8], writer->chunk_rows, 4);
+    memcpy(&header[16], DATASET_COLUMN_WIDTHS, DATASET_COLUMN_COUNT);
+    if (!writer->queue || !writer->file || fwrite(header, 1, sizeof(header), writer->file) != sizeof(header))
+    {
+        if (writer->file) fclose(writer->file);
+        free(writer->queue);
+        free(writer);
+        return 0;
+    }
+    writer->offset = DATASET_HEADER_SIZE;
+    atomic_init(&writer->failed, false);
+    const bool has_mutex = mtx_init(&writer->mutex, mtx_plain) == thrd_success;
+    const bool has_not_empty = has_mutex && cnd_init(&writer->not_empty) == thrd_success;
+    const bool has_not_full = has_not_empty && cnd_init(&writer->not_full) == thrd_success;
+    if (!has_not_full || thrd_create(&writer->thread, run_dataset_writer, writer) != thrd_success)
+    {
+        if (has_not_full) cnd_destroy(&writer->not_full);
+        if (has_not_empty) cnd_destroy(&writer->not_empty);
+        if (has_mutex) mtx_destroy(&writer->mutex);
+        fclose(writer->file);
+        free(writer->queue);
+        free(writer);
+        return 0;
+    }
+    return writer;
+}
+
+bool close_dataset_writer(DatasetWriter* writer)
+{
+    mtx_lock(&writer->mutex);
+    writer->closed = true;
+    cnd_broadcast(&writer->not_empty);
+    mtx_unlock(&writer->mutex);
+    thrd_join(writer->thread, 0);
+
+    bool written = !atomic_load(&writer->failed);
+    uint8_t footer[DATASET_FOOTER_SIZE] = { 0 };
+    write_le(&footer[0], writer->offset, 8);
+    write_le(&footer[8], writer->chunk_count, 8);
+    write_le(&footer[16], writer->row_count, 8);
+    memcpy(&footer[24], DATASET_INDEX_MAGIC, 4);
+    if (written && writer->index_size) written = fwrite(writer->index, 1, writer->index_size, writer->file) == writer->index_size;
+    if (written) written = fwrite(footer, 1, sizeof(footer), writer->file) == sizeof(footer);
+    written &= fclose(writer->file) == 0;
+
+    cnd_destroy(&writer->not_full);
+    cnd_destroy(&writer->not_empty);
+    mtx_destroy(&writer->mutex);
+    free(writer->index);
+    free(writer->queue);
+    free(writer);
+    return written;
+}
+
+DatasetProducer* create_dataset_producer(DatasetWriter* writer)
+{
+    DatasetProducer* producer = calloc(1, sizeof(DatasetProducer));
+    if (!producer) return 0;
+    producer->writer = writer;
+    bool allocated = true;
+    uint8_t widest = 0;
+    for (uint8_t c = 0; c < DATASET_COLUMN_COUNT; c++)
+    {
+        producer->columns[c] = malloc((size_t)writer->chunk_rows * DATASET_COLUMN_WIDTHS[c]);
+        allocated &= producer->columns[c] != 0;
+        if (DATASET_COLUMN_WIDTHS[c] > widest) widest = DATASET_COLUMN_WIDTHS[c];
+    }
+    producer->shuffled = malloc((size_t)writer->chunk_rows * widest);
+    if (!allocated || !producer->shuffled)
+    {
+        producer->row_count = 0;
+        destroy_dataset_producer(producer);
+        return 0;
+    }
+    return producer;
+}
+
+// Encodes every column of the rows so far, each as runs over its byte planes or raw if that came out no smaller.
+static bool queue_producer_chunk(DatasetProducer* producer)
+{
+    const uint32_t rows = producer->row_count;
+    if (!rows) return true;
+    size_t capacity = DATASET_CHUNK_HEADER_SIZE + DATASET_COLUMN_COUNT * DATASET_COLUMN_HEADER_SIZE;
+    for (uint8_t c = 0; c < DATASET_COLUMN_COUNT; c++)
+    {
+        capacity += (size_t)rows * DATASET_COLUMN_WIDTHS[c];
+    }
+    uint8_t* data = malloc(capacity);
+    if (!data) return false;
+    memset(data, 0, DATASET_CHUNK_HEADER_SIZE + DATASET_COLUMN_COUNT * DATASET_COLUMN_HEADER_SIZE);
+    write_le(data, rows, 4);
+    size_t size = DATASET_CHUNK_HEADER_SIZE + DATASET_COLUMN_COUNT * DATASET_COLUMN_HEADER_SIZE;
+    for (uint8_t c = 0; c < DATASET_COLUMN_COUNT; c++)
+    {
+        const uint8_t width = DATASET_COLUMN_WIDTHS[c];
+        const size_t raw_size = (size_t)rows * width;
+        const uint8_t* planes = producer->columns[c];
+        if (width > 1)
+        {
+            for (uint8_t plane = 0; plane < width; plane++)
+            {
+                for (uint32_t i = 0; i < rows; i++)
+                {
+                    producer->shuffled[(size_t)plane * rows + i] = producer->columns[c][(size_t)i * width + plane];
+                }
+            }
+            planes = producer->shuffled;
+        }
+        size_t encoded_size = encode_runs(planes, raw_size, &data[size], raw_size - 1);
+        DatasetCodec codec = DATASET_CODEC_SHUFFLED_RUNS;
+        if (!encoded_size)
+        {
+            memcpy(&data[size], producer->columns[c], raw_size);
+            encoded_size = raw_size;
+            codec = DATASET_CODEC_RAW;
+        }
+        uint8_t* column_header = &data[DATASET_CHUNK_HEADER_SIZE + c * DATASET_COLUMN_HEADER_SIZE];
+        column_header[0] = (uint8_t)codec;
+        write_le(&column_header[4], encoded_size, 4);
+        size += encoded_size;
+    }
+    write_le(&data[4], hash_chunk(data, size), 4);
+    push_chunk(producer->writer, (DatasetChunk){ data, size, rows });
+    producer->row_count = 0;
+    return true;
+}
+
+bool append_dataset_row(DatasetProducer* producer, const DatasetRow* row)
+{
+    const size_t i = producer->row_count;
+    uint8_t** columns = producer->columns;
+    write_le(&columns[DATASET_COLUMN_GAME_ID][i * 8], row->game_id, 8);
+    write_le(&columns[DATASET_COLUMN_PIECE_INDEX][i * 4], row->piece_index, 4);
+    for (uint8_t y = 0; y < DATASET_BOARD_ROW_COUNT; y++)
+    {
+        write_le(&columns[DATASET_COLUMN_BOARD][(i * DATASET_BOARD_ROW_COUNT + y) * 4], row->board[y], 4);
+    }
+    columns[DATASET_COLUMN_CURRENT][i] = row->current;
+    columns[DATASET_COLUMN_HOLD][i] = row->hold;
+    memcpy(&columns[DATASET_COLUMN_QUEUE][i * PIECE_PREVIEW_COUNT], row->queue, PIECE_PREVIEW_COUNT);
+    columns[DATASET_COLUMN_CAN_HOLD][i] = row->can_hold;
+    columns[DATASET_COLUMN_COMBO][i] = row->combo_count;
+    columns[DATASET_COLUMN_LEVEL][i] = row->level_index;
+    columns[DATASET_COLUMN_PLACEMENT_TYPE][i] = (uint8_t)row->placement.type;
+    columns[DATASET_COLUMN_PLACEMENT_X][i] = row->placement.pos_x;
+    columns[DATASET_COLUMN_PLACEMENT_Y][i] = row->placement.pos_y;
+    columns[DATASET_COLUMN_PLACEMENT_ROTATION][i] = row->placement.rotation;
+    columns[DATASET_COLUMN_PLACEMENT_HOLD][i] = row->placement.use_hold;
+    columns[DATASET_COLUMN_LINES_CLEARED][i] = row->lines_cleared;
+    write_le(&columns[DATASET_COLUMN_SCORE_GAINED][i * 4], row->score_gained, 4);
+    write_le(&columns[DATASET_COLUMN_GAME_SCORE][i * 8], row->game_score, 8);
+    write_le(&columns[DATASET_COLUMN_GAME_LINES][i * 4], row->game_lines, 4);
+    write_le(&columns[DATASET_COLUMN_GAME_PIECES][i * 4], row->game_pieces, 4);
+    columns[DATASET_COLUMN_GAME_OVER][i] = row->game_over;
+    if (++producer->row_count < producer->writer->chunk_rows) return true;
+    return queue_producer_chunk(producer);
+}
+
+bool destroy_dataset_producer(DatasetProducer* producer)
+{
+    if (!producer) return true;
+    const bool queued = queue_producer_chunk(producer);
+    for (uint8_t c = 0; c < DATASET_COLUMN_COUNT; c++)
+    {
+        free(producer->columns[c]);
+    }
+    free(producer->shuffled);
+    free(producer);
+    return queued;
+}
+
+// Reading.
+
+DatasetReader* open_dataset(const char* path)
+{
+    DatasetReader* reader = calloc(1, sizeof(DatasetReader));
+    if (!reader) return 0;
+    if (!map_file(path, false, &reader->file))
+    {
+        free(reader);
+        return 0;
+    }
+    const uint8_t* data = reader->file.data;
+    const size_t size = reader->file.size;
+    if (size < DATASET_HEADER_SIZE + DATASET_FOOTER_SIZE || memcmp(data, DATASET_MAGIC, 4) != 0 || read_le(&data[4], 2) != DATASET_VERSION ||
+        read_le(&data[6], 2) != DATASET_COLUMN_COUNT || memcmp(&data[16], DATASET_COLUMN_WIDTHS, DATASET_COLUMN_COUNT) != 0)
+    {
+        goto invalid;
+    }
+    reader->chunk_rows = (uint32_t)read_le(&data[8], 4);
+    const uint8_t* footer = &data[size - DATASET_FOOTER_SIZE];
+    const uint64_t index_offset = read_le(&footer[0], 8);
+    const uint64_t chunk_count = read_le(&footer[8], 8);
+    reader->row_count = read_le(&footer[16], 8);
+    if (memcmp(&footer[24], DATASET_INDEX_MAGIC, 4) != 0 || chunk_count > UINT32_MAX || index_offset < DATASET_HEADER_SIZE ||
+        index_offset + chunk_count * DATASET_INDEX_ENTRY_SIZE + DATASET_FOOTER_SIZE != size)
+    {
+        goto invalid;
+    }
+    reader->chunk_count = (uint32_t)chunk_count;
+    reader->index = &data[index_offset];
+
+    // Chunks have to tile the file and the rows, so every later lookup can trust the index.
+    uint64_t offset = DATASET_HEADER_SIZE;
+    uint64_t first_row = 0;
+    for (uint32_t i = 0; i < reader->chunk_count; i++)
+    {
+        const uint8_t* entry = &reader->index[(size_t)i * DATASET_INDEX_ENTRY_SIZE];
+        const uint64_t chunk_size = read_le(&entry[16], 4);
+        const uint32_t row_count = (uint32_t)read_le(&entry[20], 4);
+        if (read_le(&entry[0], 8) != offset || read_le(&entry[8], 8) != first_row || !row_count || row_count > reader->chunk_rows ||
+            chunk_size < DATASET_CHUNK_HEADER_SIZE + DATASET_COLUMN_COUNT * DATASET_COLUMN_HEADER_SIZE || read_le(&data[offset], 4) != row_count)
+        {
+            goto invalid;
+        }
+        offset += chunk_size;
+        first_row += row_count;
+        if (offset > index_offset) goto invalid;
+    }
+    if (offset != index_offset || first_row != reader->row_count) goto invalid;
+    return reader;
+
+invalid:
+    unmap_file(&reader->file);
+    free(reader);
+    return 0;
+}
+
+void close_dataset(DatasetReader* reader)
+{
+    if (!reader) return;
+    unmap_file(&reader->file);
+    free(reader);
+}
+
+uint64_t get_dataset_row_count(const DatasetReader* reader)
+{
+    return reader->row_count;
+}
+
+uint32_t get_dataset_chunk_count(const DatasetReader* reader)
+{
+    return reader->chunk_count;
+}
+
+uint32_t get_dataset_chunk_rows(const DatasetReader* reader)
+{
+    return reader->chunk_rows;
+}
+
+bool get_dataset_chunk(const DatasetReader* reader, uint32_t chunk_index, uint64_t* out_first_row, uint32_t* out_row_count)
+{
+    if (chunk_index >= reader->chunk_count) return false;
+    const uint8_t* entry = &reader->index[(size_t)chunk_index * DATASET_INDEX_ENTRY_SIZE];
+    if (out_first_row) *out_first_row = read_le(&entry[8], 8);
+    if (out_row_count) *out_row_count = (uint32_t)read_le(&entry[20], 4);
+    return true;
+}
+
+bool find_dataset_chunk(const DatasetReader* reader, uint64_t row_index, uint32_t* out_chunk_index, uint32_t* out_row_in_chunk)
+{
+    if (row_index >= reader->row_count) return false;
+    uint32_t left = 0;
+    uint32_t right = reader->chunk_count - 1;
+    while (left < right)
+    {
+        const uint32_t middle = left + (right - left + 1) / 2;
+        if (read_le(&reader->index[(size_t)middle * DATASET_INDEX_ENTRY_SIZE + 8], 8) <= row_index)
+        {
+            left = middle;
+        }
+        else
+        {
+            right = middle - 1;
+        }
+    }
+    *out_chunk_index = left;
+    *out_row_in_chunk = (uint32_t)(row_index - read_le(&reader->index[(size_t)left * DATASET_INDEX_ENTRY_SIZE + 8], 8));
+    return true;
+}
+
+// Finds a column's bytes within a chunk. False if the column sizes run past the chunk.
+static bool locate_dataset_column(const DatasetReader* reader, uint32_t chunk_index, DatasetColumn column,
+    const uint8_t** out_encoded, size_t* out_encoded_size, DatasetCodec* out_codec, uint32_t* out_row_count)
+{
+    if (chunk_index >= reader->chunk_count || column >= DATASET_COLUMN_COUNT) return false;
+    const uint8_t* entry = &reader->index[(size_t)chunk_index * DATASET_INDEX_ENTRY_SIZE];
+    const uint8_t* chunk = &reader->file.data[read_le(&entry[0], 8)];
+    const size_t chunk_size = (size_t)read_le(&entry[16], 4);
+    size_t offset = DATASET_CHUNK_HEADER_SIZE + DATASET_COLUMN_COUNT * DATASET_COLUMN_HEADER_SIZE;
+    for (uint8_t c = 0; c < column; c++)
+    {
+        offset += (size_t)read_le(&chunk[DATASET_CHUNK_HEADER_SIZE + c * DATASET_COLUMN_HEADER_SIZE + 4], 4);
+    }
+    const uint8_t* column_header = &chunk[DATASET_CHUNK_HEADER_SIZE + column * DATASET_COLUMN_HEADER_SIZE];
+    *out_encoded_size = (size_t)read_le(&column_header[4], 4);
+    if (offset + *out_encoded_size > chunk_size) return false;
+    *out_encoded = &chunk[offset];
+    *out_codec = (DatasetCodec)column_header[0];
+    *out_row_count = (uint32_t)read_le(&entry[20], 4);
+    return true;
+}
+
+bool get_dataset_column_sizes(const DatasetReader* reader, uint32_t chunk_index, DatasetColumn column, size_t* out_encoded_size, size_t* out_decoded_size)
+{
+    const uint8_t* encoded;
+    DatasetCodec codec;
+    uint32_t row_count;
+    if (!locate_dataset_column(reader, chunk_index, column, &encoded, out_encoded_size, &codec, &row_count)) return false;
+    *out_decoded_size = (size_t)row_count * DATASET_COLUMN_WIDTHS[column];
+    return true;
+}
+
+bool decode_dataset_column(const DatasetReader* reader, uint32_t chunk_index, DatasetColumn column, uint8_t* out_values)
+{
+    const uint8_t* encoded;
+    size_t encoded_size;
+    DatasetCodec codec;
+    uint32_t row_count;
+    if (!locate_dataset_column(reader, chunk_index, column, &encoded, &encoded_size, &codec, &row_count)) return false;
+    const uint8_t width = DATASET_COLUMN_WIDTHS[column];
+    switch (codec)
+    {
+    case DATASET_CODEC_RAW:
+        if (encoded_size != (size_t)row_count * width) return false;
+        memcpy(out_values, encoded, encoded_size);
+        return true;
+    case DATASET_CODEC_SHUFFLED_RUNS:
+        return decode_runs(encoded, encoded_size, out_values, row_count, width);
+    }
+    return false;
+}
+
+bool check_dataset_chunk(const DatasetReader* reader, uint32_t chunk_index)
+{
+    if (chunk_index >= reader->chunk_count) return false;
+    const uint8_t* entry = &reader->index[(size_t)chunk_index * DATASET_INDEX_ENTRY_SIZE];
+    const uint8_t* chunk = &reader->file.data[read_le(&entry[0], 8)];
+    return read_le(&chunk[4], 4) == hash_chunk(chunk, (size_t)read_le(&entry[16], 4));
+}
+
+bool decode_dataset_rows(const DatasetReader* reader, uint32_t chunk_index, DatasetRow* out_rows)
+{
+    uint32_t row_count;
+    if (!get_dataset_chunk(reader, chunk_index, 0, &row_count)) return false;
+    uint8_t* values = malloc((size_t)row_count * DATASET_COLUMN_WIDTHS[DATASET_COLUMN_BOARD]); // The widest column.
+    if (!values) return false;
+    memset(out_rows, 0, row_count * sizeof(DatasetRow));
+    for (uint8_t c = 0; c < DATASET_COLUMN_COUNT; c++)
+    {
+        if (!decode_dataset_column(reader, chunk_index, (DatasetColumn)c, values))
+        {
+            free(values);
+            return false;
+        }
+        const uint8_t width = DATASET_COLUMN_WIDTHS[c];
+        for (uint32_t i = 0; i < row_count; i++)
+        {
+            DatasetRow* row = &out_rows[i];
+            const uint8_t* value = &values[(size_t)i * width];
+            switch ((DatasetColumn)c)
+            {
+            case DATASET_COLUMN_GAME_ID:             row->game_id = read_le(value, 8); break;
+            case DATASET_COLUMN_PIECE_INDEX:         row->piece_index = (uint32_t)read_le(value, 4); break;
+            case DATASET_COLUMN_BOARD:
+                for (uint8_t y = 0; y < DATASET_BOARD_ROW_COUNT; y++)
+                {
+                    row->board[y] = (uint32_t)read_le(&value[y * 4], 4);
+                }
+                break;
+            case DATASET_COLUMN_CURRENT:             row->current = value[0]; break;
+            case DATASET_COLUMN_HOLD:                row->hold = value[0]; break;
+            case DATASET_COLUMN_QUEUE:               memcpy(row->queue, value, PIECE_PREVIEW_COUNT); break;
+            case DATASET_COLUMN_CAN_HOLD:            row->can_hold = value[0]; break;
+            case DATASET_COLUMN_COMBO:               row->combo_count = value[0]; break;
+            case DATASET_COLUMN_LEVEL:               row->level_index = value[0]; break;
+            case DATASET_COLUMN_PLACEMENT_TYPE:      row->placement.type = (PieceType)value[0]; break;
+            case DATASET_COLUMN_PLACEMENT_X:         row->placement.pos_x = value[0]; break;
+            case DATASET_COLUMN_PLACEMENT_Y:         row->placement.pos_y = value[0]; break;
+            case DATASET_COLUMN_PLACEMENT_ROTATION:  row->placement.rotation = value[0]; break;
+            case DATASET_COLUMN_PLACEMENT_HOLD:      row->placement.use_hold = value[0]; break;
+            case DATASET_COLUMN_LINES_CLEARED:       row->lines_cleared = value[0]; break;
+            case DATASET_COLUMN_SCORE_GAINED:        row->score_gained = (uint32_t)read_le(value, 4); break;
+            case DATASET_COLUMN_GAME_SCORE:          row->game_score = read_le(value, 8); break;
+            case DATASET_COLUMN_GAME_LINES:          row->game_lines = (uint32_t)read_le(value, 4); break;
+            case DATASET_COLUMN_GAME_PIECES:         row->game_pieces = (uint32_t)read_le(value, 4); break;
+            case DATASET_COLUMN_GAME_OVER:           row->game_over = value[0]; break;
+            case DATASET_COLUMN_COUNT:               break;
+            }
+        }
+    }
+    free(values);
+    return true;
+}
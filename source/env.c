@@ -0,0 +1,103 @@
+#include <stdlib.h>
+
+#include "env.h"
+#include "util.h"
+
+_Static_assert(sizeof(EnvObservation) == 96, "EnvObservation is part of the ABI, its size must not change by accident.");
+
+struct EnvBatch {
+    uint64_t seed_state;    // Source of the fresh seed every game gets when it is reset.
+    uint32_t env_count;
+    Game games[];
+};
+
+void write_env_observation(const Game* game, EnvObservation* out_obs)
+{
+    for (uint8_t y = 0; y < ENV_OBSERVATION_ROW_COUNT; y++)
+    {
+        out_obs->rows[y] = (uint32_t)game->playfield.cells[y]; // Env games are always the default size, so nothing is cut off.
+    }
+    out_obs->piece_type = (uint8_t)game->controlled_piece.type;
+    out_obs->piece_rotation = game->controlled_piece.rotation;
+    out_obs->piece_x = game->controlled_piece.pos_x;
+    out_obs->piece_y = game->controlled_piece.pos_y;
+    out_obs->ghost_y = game->controlled_piece_ground_y;
+    out_obs->held_type = (game->held_piece) ? (uint8_t)game->held_piece->type : 0;
+    out_obs->can_hold = game->can_hold_piece;
+    out_obs->combo_count = game->combo_count;
+    out_obs->level_index = game->level_index;
+    for (uint8_t i = 0; i < PIECE_PREVIEW_COUNT; i++)
+    {
+        out_obs->queue[i] = (uint8_t)peek_piece_queue(game, i)->type;
+    }
+    out_obs->reserved[0] = 0;
+    out_obs->reserved[1] = 0;
+}
+
+static inline void reset_env_game(EnvBatch* envs, Game* game)
+{
+    *game = get_seeded_initialized_game(next_random(&envs->seed_state));
+    game->controlled_piece_ground_y = get_playfield_piece_cells_hard_drop_y(
+        &game->playfield,
+        game->controlled_piece.cells,
+        game->controlled_piece.size,
+        game->controlled_piece.pos_x,
+        game->controlled_piece.pos_y
+    );
+}
+
+uint32_t env_abi_version(void)
+{
+    return ENV_ABI_VERSION;
+}
+
+EnvBatch* env_create(uint32_t env_count, uint64_t seed)
+{
+    EnvBatch* envs = malloc(sizeof(EnvBatch) + (size_t)env_count * sizeof(Game));
+    if (!envs) return 0;
+    envs->seed_state = seed;
+    envs->env_count = env_count;
+    for (uint32_t i = 0; i < env_count; i++)
+    {
+        reset_env_game(envs, &envs->games[i]);
+    }
+    return envs;
+}
+
+void env_destroy(EnvBatch* envs)
+{
+    free(envs);
+}
+
+uint32_t env_count(const EnvBatch* envs)
+{
+    return envs->env_count;
+}
+
+void env_reset(EnvBatch* envs, EnvObservation* out_obs)
+{
+    for (uint32_t i = 0; i < envs->env_count; i++)
+    {
+        reset_env_game(envs, &envs->games[i]);
+        write_env_observation(&envs->games[i], &out_obs[i]);
+    }
+}
+
+void env_step(EnvBatch* envs, const ACTION_BIT_FLAGS* actions, uint32_t n, EnvObservation* out_obs, float* out_reward, uint8_t* out_done)
+{
+    if (n > envs->env_count) n = envs->env_count;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        Game* game = &envs->games[i];
+        const uint64_t previous_score = game->score;
+        tick(game, ENV_TICK_DELTA_TIME, actions[i] & ~ACTION_PAUSE); // Pausing means nothing to a trainer.
+        out_reward[i] = (float)(game->score - previous_score);
+        const bool done = is_game_over(game);
+        out_done[i] = done;
+        if (done)
+        {
+            reset_env_game(envs, game);
+        }
+        write_env_observation(game, &out_obs[i]);
+    }
+}
@@ -0,0 +1,490 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+#include "bot.h"
+#include "clock.h"
+#include "dataset.h"
+#include "mapped_file.h"
+#include "replay.h"
+#include "trace.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <unistd.h>
+#endif // _WIN32
+
+#define EXPORT_QUEUE_CAPACITY       1024    // Replays waiting for a producer. Only offsets into mapped files.
+#define EXPORT_MAX_THREADS          256
+#define EXPORT_MAX_PATH             4096
+#define EXPORT_DEFAULT_MAX_PIECES   1000
+
+// A mapped replay file, unmapped once its last replay is exported.
+typedef struct {
+    MappedFile mapping;
+    atomic_uint references;
+} ExportFile;
+
+typedef struct {
+    ExportFile* file;
+    size_t offset;
+    size_t size;
+} ExportJob;
+
+typedef struct {
+    DatasetWriter* writer;
+    // Replays.
+    ExportJob jobs[EXPORT_QUEUE_CAPACITY];
+    uint32_t head;
+    uint32_t count;
+    bool closed;
+    mtx_t mutex;
+    cnd_t not_empty;
+    cnd_t not_full;
+    // Bot games.
+    uint32_t game_count;
+    uint32_t max_pieces;
+    bool is_playing_games;
+    // Results.
+    atomic_ullong next_game_id;
+    atomic_ullong exported_game_count;
+    atomic_ullong row_count;
+    atomic_ullong skipped_count;     // Bad replays, and locks no placement explains.
+    atomic_bool failed;
+} ExportContext;
+
+static uint32_t get_processor_count(void)
+{
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (uint32_t)info.dwNumberOfProcessors;
+#else
+    const long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return (count > 0) ? (uint32_t)count : 1;
+#endif // _WIN32
+}
+
+static void release_file(ExportFile* file)
+{
+    if (atomic_fetch_sub_explicit(&file->references, 1, memory_order_acq_rel) != 1) return;
+    unmap_file(&file->mapping);
+    free(file);
+}
+
+static void push_job(ExportContext* context, ExportJob job)
+{
+    mtx_lock(&context->mutex);
+    while (context->count == EXPORT_QUEUE_CAPACITY)
+    {
+        cnd_wait(&context->not_full, &context->mutex);
+    }
+    context->jobs[(context->head + context->count++) % EXPORT_QUEUE_CAPACITY] = job;
+    cnd_signal(&context->not_empty);
+    mtx_unlock(&context->mutex);
+}
+
+static bool pop_job(ExportContext* context, ExportJob* out_job)
+{
+    mtx_lock(&context->mutex);
+    while (!context->count && !context->closed)
+    {
+        cnd_wait(&context->not_empty, &context->mutex);
+    }
+    if (!context->count)
+    {
+        mtx_unlock(&context->mutex);
+        return false;
+    }
+    *out_job = context->jobs[context->head];
+    context->head = (context->head + 1) % EXPORT_QUEUE_CAPACITY;
+    context->count--;
+    cnd_signal(&context->not_full);
+    mtx_unlock(&context->mutex);
+    return true;
+}
+
+// Replays only log inputs, so the placement is whichever one, applied from the state the piece spawned in, leaves the same board.
+// Pieces that look the same in two rotations give the first of them.
+static bool find_locked_placement(const Game* spawn, const Game* locked, Placement* out_placement)
+{
+    const bool can_hold = spawn->can_hold_piece && (spawn->setting_bit_flags & SETTING_CAN_HOLD);
+    const Playfield* playfield = &spawn->playfield;
+    for (uint8_t hold = 0; hold <= can_hold; hold++)
+    {
+        const PieceType type = (!hold) ? spawn->controlled_piece.type : (spawn->held_piece) ? spawn->held_piece->type : peek_piece_queue(spawn, 0)->type;
+        for (uint8_t rotation = 0; rotation < get_piece_unique_rotation_count(type); rotation++)
+        {
+            for (uint8_t pos_x = 0; pos_x < playfield->column_count + COLUMN_OFFSET; pos_x++)
+            {
+                for (uint8_t pos_y = 0; pos_y < playfield->row_count; pos_y++)
+                {
+                    const Placement placement = { type, pos_x, pos_y, rotation, hold };
+                    if (!is_placement_valid(spawn, placement)) continue;
+                    Game game = *spawn;
+                    attempt_apply_placement(&game, placement);
+                    if (memcmp(game.playfield.cells, locked->playfield.cells, sizeof(PlayfieldCells)) == 0 &&
+                        memcmp(game.playfield.type_planes, locked->playfield.type_planes, sizeof(game.playfield.type_planes)) == 0)
+                    {
+                        *out_placement = placement;
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+    return false;
+}
+
+static void set_row_outcome(DatasetRow* row, const Game* spawn, const Game* locked)
+{
+    row->lines_cleared = (uint8_t)(locked->playfield.lines_cleared - spawn->playfield.lines_cleared);
+    row->score_gained = (uint32_t)(locked->score - spawn->score);
+}
+
+static void set_row_game_outcome(DatasetRow* row, const Game* final_game)
+{
+    row->game_score = final_game->score;
+    row->game_lines = final_game->playfield.lines_cleared;
+    row->game_pieces = final_game->placed_piece_count;
+    row->game_over = is_game_over((Game*)final_game);
+}
+
+// Two passes: the first only ticks to learn how the game ends, so the second can stream rows out without holding the game in memory.
+static void export_replay(ExportContext* context, DatasetProducer* producer, const uint8_t* data, size_t size)
+{
+    ReplayHeader header;
+    if (!read_replay_header(data, size, &header) || get_replay_size(&header) > size)
+    {
+        atomic_fetch_add_explicit(&context->skipped_count, 1, memory_order_relaxed);
+        return;
+    }
+    const uint8_t* actions = &data[REPLAY_HEADER_SIZE];
+    const double delta_time = 1.0 / header.tick_rate;
+    Game final_game = get_replay_initialized_game(&header);
+    for (uint32_t t = 0; t < header.tick_count && !is_game_over(&final_game); t++)
+    {
+        tick(&final_game, delta_time, actions[t]);
+    }
+
+    const uint64_t game_id = atomic_fetch_add_explicit(&context->next_game_id, 1, memory_order_relaxed);
+    Game game = get_replay_initialized_game(&header);
+    Game spawn = game;
+    uint64_t rows = 0;
+    for (uint32_t t = 0; t < header.tick_count && !is_game_over(&game); t++)
+    {
+        tick(&game, delta_time, actions[t]);
+        if (game.placed_piece_count == spawn.placed_piece_count) continue;
+        DatasetRow row;
+        set_dataset_row_state(&row, game_id, &spawn);
+        if (find_locked_placement(&spawn, &game, &row.placement))
+        {
+            set_row_outcome(&row, &spawn, &game);
+            set_row_game_outcome(&row, &final_game);
+            if (!append_dataset_row(producer, &row)) atomic_store_explicit(&context->failed, true, memory_order_relaxed);
+            rows++;
+        }
+        else
+        {
+            atomic_fetch_add_explicit(&context->skipped_count, 1, memory_order_relaxed);
+        }
+        spawn = game;
+    }
+    atomic_fetch_add_explicit(&context->row_count, rows, memory_order_relaxed);
+    atomic_fetch_add_explicit(&context->exported_game_count, 1, memory_order_relaxed);
+}
+
+// Bot games are only known once they end, so their rows wait in rows (max_pieces of them at most) until then.
+static void export_bot_game(ExportContext* context, DatasetProducer* producer, Bot* bot, DatasetRow* rows, uint64_t game_id)
+{
+    Game game = get_seeded_initialized_game(game_id);
+    uint32_t row_count = 0;
+    while (row_count < context->max_pieces && !is_game_over(&game))
+    {
+        Placement placement;
+        if (!search_bot_placement(bot, &game, &placement, 0)) break;
+        DatasetRow* row = &rows[row_count++];
+        set_dataset_row_state(row, game_id, &game);
+        row->placement = placement;
+        const Game spawn = game;
+        attempt_apply_placement(&game, placement);
+        set_row_outcome(row, &spawn, &game);
+    }
+    for (uint32_t i = 0; i < row_count; i++)
+    {
+        set_row_game_outcome(&rows[i], &game);
+        if (!append_dataset_row(producer, &rows[i])) atomic_store_explicit(&context->failed, true, memory_order_relaxed);
+    }
+    atomic_fetch_add_explicit(&context->row_count, row_count, memory_order_relaxed);
+    atomic_fetch_add_explicit(&context->exported_game_count, 1, memory_order_relaxed);
+}
+
+// Every producer fills and encodes its own chunks, so the only thing they share is the writer's queue.
+static int run_export_worker(void* arg)
+{
+    ExportContext* context = arg;
+    set_trace_thread_name("export worker");
+    DatasetProducer* producer = create_dataset_producer(context->writer);
+    if (!producer)
+    {
+        atomic_store_explicit(&context->failed, true, memory_order_relaxed);
+        return 0;
+    }
+    if (context->is_playing_games)
+    {
+        BotSettings settings = get_default_bot_settings();
+        settings.beam_width = 16;
+        settings.depth = 2;
+        settings.thread_count = 1;
+        Bot* bot = create_bot(settings);
+        DatasetRow* rows = malloc(context->max_pieces * sizeof(DatasetRow));
+        if (bot && rows)
+        {
+            uint64_t game_id;
+            while ((game_id = atomic_fetch_add_explicit(&context->next_game_id, 1, memory_order_relaxed)) <= context->game_count)
+            {
+                poll_trace_dump(); // The main thread only joins, so a SIGUSR1 is answered here.
+                export_bot_game(context, producer, bot, rows, game_id);
+            }
+        }
+        else
+        {
+            atomic_store_explicit(&context->failed, true, memory_order_relaxed);
+        }
+        free(rows);
+        destroy_bot(bot);
+    }
+    else
+    {
+        ExportJob job;
+        while (pop_job(context, &job))
+        {
+            poll_trace_dump();
+            export_replay(context, producer, &job.file->mapping.data[job.offset], job.size);
+            release_file(job.file);
+        }
+    }
+    if (!destroy_dataset_producer(producer)) atomic_store_explicit(&context->failed, true, memory_order_relaxed);
+    return 0;
+}
+
+static void queue_file(ExportContext* context, const char* path)
+{
+    TRACE_BEGIN("replay map");
+    ExportFile* file = calloc(1, sizeof(ExportFile));
+    const bool is_mapped = file && map_file(path, true, &file->mapping);
+    TRACE_END("replay map");
+    if (!is_mapped)
+    {
+        fprintf(stderr, "zetris-export: can't map %s\n", path);
+        free(file);
+        return;
+    }
+    atomic_init(&file->references, 1);
+    size_t offset = 0;
+    while (offset < file->mapping.size)
+    {
+        ReplayHeader header;
+        if (!read_replay_header(&file->mapping.data[offset], file->mapping.size - offset, &header) || get_replay_size(&header) > file->mapping.size - offset)
+        {
+            fprintf(stderr, "zetris-export: %s has a bad replay at offset %zu, skipping the rest of the file\n", path, offset);
+            atomic_fetch_add_explicit(&context->skipped_count, 1, memory_order_relaxed);
+            break;
+        }
+        const size_t size = get_replay_size(&header);
+        atomic_fetch_add_explicit(&file->references, 1, memory_order_relaxed);
+        push_job(context, (ExportJob){ file, offset, size });
+        offset += size;
+    }
+    release_file(file);
+}
+
+static void queue_path(ExportContext* context, const char* path)
+{
+    char child[EXPORT_MAX_PATH];
+#if defined(_WIN32)
+    const DWORD attributes = GetFileAttributesA(path);
+    if (attributes == INVALID_FILE_ATTRIBUTES || !(attributes & FILE_ATTRIBUTE_DIRECTORY))
+    {
+        queue_file(context, path);
+        return;
+    }
+    snprintf(child, sizeof(child), "%s\\*", path);
+    WIN32_FIND_DATAA entry;
+    HANDLE find = FindFirstFileA(child, &entry);
+    if (find == INVALID_HANDLE_VALUE) return;
+    do
+    {
+        if (strcmp(entry.cFileName, ".") == 0 || strcmp(entry.cFileName, "..") == 0) continue;
+        snprintf(child, sizeof(child), "%s\\%s", path, entry.cFileName);
+        queue_path(context, child);
+    } while (FindNextFileA(find, &entry));
+    FindClose(find);
+#else
+    DIR* directory = opendir(path);
+    if (!directory)
+    {
+        queue_file(context, path);
+        return;
+    }
+    struct dirent* entry;
+    while ((entry = readdir(directory)))
+    {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+        snprintf(child, sizeof(child), "%s/%s", path, entry->d_name);
+        queue_path(context, child);
+    }
+    closedir(directory);
+#endif // _WIN32
+}
+
+// paths is 0 to play game_count bot games instead.
+static int export_dataset(const char* dataset_path, char** paths, int path_count, uint32_t game_count, uint32_t max_pieces, uint32_t thread_count)
+{
+    static ExportContext context; // Too big for the stack.
+    context.writer = create_dataset_writer(dataset_path, 0, 0);
+    if (!context.writer)
+    {
+        fprintf(stderr, "zetris-export: can't write %s\n", dataset_path);
+        return 1;
+    }
+    context.is_playing_games = !paths;
+    context.game_count = game_count;
+    context.max_pieces = (max_pieces) ? max_pieces : EXPORT_DEFAULT_MAX_PIECES;
+    atomic_init(&context.next_game_id, 1);
+    if (mtx_init(&context.mutex, mtx_plain) != thrd_success || cnd_init(&context.not_empty) != thrd_success ||
+        cnd_init(&context.not_full) != thrd_success)
+    {
+        fprintf(stderr, "zetris-export: couldn't create the job queue\n");
+        close_dataset_writer(context.writer);
+        return 1;
+    }
+    thrd_t threads[EXPORT_MAX_THREADS];
+    const uint64_t start = get_monotonic_nanoseconds();
+    uint32_t started_count = 0;
+    while (started_count < thread_count && thrd_create(&threads[started_count], run_export_worker, &context) == thrd_success)
+    {
+        started_count++;
+    }
+    if (started_count < thread_count)
+    {
+        fprintf(stderr, "zetris-export: couldn't start %u of %u worker threads\n", thread_count - started_count, thread_count);
+        atomic_store(&context.failed, true);
+        atomic_store(&context.next_game_id, (unsigned long long)game_count + 1); // The workers that did start stop after their current game.
+    }
+    for (int i = 0; i < path_count && started_count == thread_count; i++)
+    {
+        queue_path(&context, paths[i]);
+    }
+    mtx_lock(&context.mutex);
+    context.closed = true;
+    cnd_broadcast(&context.not_empty);
+    mtx_unlock(&context.mutex);
+    for (uint32_t i = 0; i < started_count; i++)
+    {
+        thrd_join(threads[i], 0);
+    }
+    const bool written = close_dataset_writer(context.writer) && !atomic_load(&context.failed);
+    const double seconds = (double)(get_monotonic_nanoseconds() - start) / NANOSECONDS_PER_SECOND;
+
+    const unsigned long long rows = atomic_load(&context.row_count);
+    printf("zetris-export: %llu games, %llu rows, %llu skipped, %u threads, %.2f s, %.0f rows/s%s\n",
+        atomic_load(&context.exported_game_count), rows, atomic_load(&context.skipped_count),
+        thread_count, seconds, rows / seconds, written ? "" : ", WRITE FAILED");
+    cnd_destroy(&context.not_full);
+    cnd_destroy(&context.not_empty);
+    mtx_destroy(&context.mutex);
+    return written ? 0 : 1;
+}
+
+// Checks and decodes every chunk, and prints how well each column packed.
+static int print_dataset_info(const char* path)
+{
+    DatasetReader* reader = open_dataset(path);
+    if (!reader)
+    {
+        fprintf(stderr, "zetris-export: %s is not a dataset, or is cut short\n", path);
+        return 1;
+    }
+    const uint32_t chunk_count = get_dataset_chunk_count(reader);
+    uint8_t* values = malloc((size_t)get_dataset_chunk_rows(reader) * DATASET_COLUMN_WIDTHS[DATASET_COLUMN_BOARD]);
+    if (!values)
+    {
+        close_dataset(reader);
+        return 1;
+    }
+    size_t encoded_sizes[DATASET_COLUMN_COUNT] = { 0 };
+    size_t decoded_sizes[DATASET_COLUMN_COUNT] = { 0 };
+    uint32_t bad_chunks = 0;
+    const uint64_t start = get_monotonic_nanoseconds();
+    for (uint32_t i = 0; i < chunk_count; i++)
+    {
+        bool is_chunk_good = check_dataset_chunk(reader, i);
+        for (uint8_t c = 0; c < DATASET_COLUMN_COUNT; c++)
+        {
+            size_t encoded_size;
+            size_t decoded_size;
+            is_chunk_good &= get_dataset_column_sizes(reader, i, (DatasetColumn)c, &encoded_size, &decoded_size) &&
+                decode_dataset_column(reader, i, (DatasetColumn)c, values);
+            encoded_sizes[c] += encoded_size;
+            decoded_sizes[c] += decoded_size;
+        }
+        bad_chunks += !is_chunk_good;
+    }
+    const double seconds = (double)(get_monotonic_nanoseconds() - start) / NANOSECONDS_PER_SECOND;
+    free(values);
+
+    size_t encoded_total = 0;
+    size_t decoded_total = 0;
+    printf("%s: %llu rows in %u chunks\n", path, (unsigned long long)get_dataset_row_count(reader), chunk_count);
+    for (uint8_t c = 0; c < DATASET_COLUMN_COUNT; c++)
+    {
+        printf("  %-20s %3u bytes, %12zu -> %12zu (%.1fx)\n", get_dataset_column_name((DatasetColumn)c), DATASET_COLUMN_WIDTHS[c],
+            decoded_sizes[c], encoded_sizes[c], encoded_sizes[c] ? (double)decoded_sizes[c] / encoded_sizes[c] : 0.0);
+        encoded_total += encoded_sizes[c];
+        decoded_total += decoded_sizes[c];
+    }
+    printf("  total %zu -> %zu bytes (%.1fx), decoded at %.0f MB/s, %u bad chunks\n", decoded_total, encoded_total,
+        encoded_total ? (double)decoded_total / encoded_total : 0.0, decoded_total / seconds / 1e6, bad_chunks);
+    close_dataset(reader);
+    return bad_chunks ? 1 : 0;
+}
+
+int main(int argc, char* argv[])
+{
+    install_trace_dumps(0);
+    if (argc > 2 && strcmp(argv[1], "--info") == 0)
+    {
+        return print_dataset_info(argv[2]);
+    }
+
+    int first_argument = 1;
+    uint32_t thread_count = get_processor_count();
+    if (argc > 2 && strcmp(argv[1], "--threads") == 0)
+    {
+        thread_count = (uint32_t)strtoul(argv[2], 0, 10);
+        first_argument = 3;
+    }
+    if (thread_count == 0) thread_count = 1;
+    if (thread_count > EXPORT_MAX_THREADS) thread_count = EXPORT_MAX_THREADS;
+    if (first_argument + 1 >= argc)
+    {
+        printf("usage: zetris-export [--threads count] <dataset> <replay file or directory>...\n");
+        printf("       zetris-export [--threads count] <dataset> --games <count> [max pieces per game]\n");
+        printf("       zetris-export --info <dataset>\n");
+        return 1;
+    }
+    const char* dataset_path = argv[first_argument];
+    if (strcmp(argv[first_argument + 1], "--games") == 0)
+    {
+        const uint32_t game_count = (argc > first_argument + 2) ? (uint32_t)strtoul(argv[first_argument + 2], 0, 10) : 100;
+        const uint32_t max_pieces = (argc > first_argument + 3) ? (uint32_t)strtoul(argv[first_argument + 3], 0, 10) : EXPORT_DEFAULT_MAX_PIECES;
+        return export_dataset(dataset_path, 0, 0, game_count, max_pieces, thread_count);
+    }
+    return export_dataset(dataset_path, &argv[first_argument + 1], argc - first_argument - 1, 0, 0, thread_count);
+}
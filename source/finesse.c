@@ -0,0 +1,475 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "finesse.h"
+
+#define STATE_WIDTH     (MAX_COLUMN_COUNT + COLUMN_OFFSET)  // Every pos_x a piece can have.
+#define STATE_COUNT     (PIECE_ROTATION_STATES * MAX_ROW_COUNT * STATE_WIDTH)
+#define NO_PARENT       UINT16_MAX
+#define TABLE_WIDTH     (DEFAULT_COLUMN_COUNT + COLUMN_OFFSET)
+
+static const ACTION_BIT_FLAGS FINESSE_INPUT_KEYS[FINESSE_INPUT_COUNT] = {
+    [FINESSE_TAP_LEFT] = ACTION_MOVE_LEFT,
+    [FINESSE_TAP_RIGHT] = ACTION_MOVE_RIGHT,
+    [FINESSE_DAS_LEFT] = ACTION_MOVE_LEFT,
+    [FINESSE_DAS_RIGHT] = ACTION_MOVE_RIGHT,
+    [FINESSE_ROTATE_CLOCKWISE] = ACTION_ROTATE_CLOCKWISE,
+    [FINESSE_ROTATE_COUNTER] = ACTION_ROTATE_COUNTER,
+    [FINESSE_SOFT_DROP] = ACTION_SOFT_DROP,
+    [FINESSE_HOLD] = ACTION_HOLD_PIECE,
+    [FINESSE_HARD_DROP] = ACTION_HARD_DROP
+};
+
+static const char* const FINESSE_INPUT_NAMES[FINESSE_INPUT_COUNT] = {
+    "tap left", "tap right", "das left", "das right", "rotate clockwise", "rotate counter", "soft drop", "hold", "hard drop"
+};
+
+// The cells a piece covers, from its first row with cells down. Two rotations that cover the same cells have the same footprint.
+typedef struct {
+    uint64_t rows[PIECE_MAX_SIZE];
+    uint8_t top;
+} Footprint;
+
+// Cheapest path on an empty default board from the spawn state, for a drop at (rotation, pos_x).
+typedef struct {
+    uint8_t inputs[FINESSE_MAX_INPUTS];
+    uint8_t input_count;    // 0 if the search found nothing.
+} TableEntry;
+
+struct FinessePlanner {
+    TableEntry table[PIECE_COUNT + 1][PIECE_ROTATION_STATES][TABLE_WIDTH];
+    uint8_t table_clear_rows[PIECE_COUNT + 1];  // Rows from the top a table path can touch. Only empty ones there keep it the same path.
+    uint32_t stamps[STATE_COUNT];               // Visited if equal to stamp, so nothing is cleared between searches.
+    uint16_t parents[STATE_COUNT];
+    uint8_t parent_inputs[STATE_COUNT];
+    uint16_t queue[STATE_COUNT];
+    uint32_t stamp;
+};
+
+static inline uint16_t get_state_index(uint8_t pos_x, uint8_t pos_y, uint8_t rotation)
+{
+    return (uint16_t)(((uint32_t)rotation * MAX_ROW_COUNT + pos_y) * STATE_WIDTH + pos_x);
+}
+
+static inline FinesseState get_index_state(uint16_t index)
+{
+    return (FinesseState){
+        .pos_x = (uint8_t)(index % STATE_WIDTH),
+        .pos_y = (uint8_t)((index / STATE_WIDTH) % MAX_ROW_COUNT),
+        .rotation = (uint8_t)(index / (STATE_WIDTH * MAX_ROW_COUNT))
+    };
+}
+
+static Footprint get_footprint(PieceType type, uint8_t rotation, uint8_t pos_x, uint8_t pos_y)
+{
+    const PieceCells cells = PIECE_ROTATION_CELLS[type][rotation];
+    Footprint footprint = { { 0 }, 0 };
+    uint8_t count = 0;
+    for (uint8_t y = 0; y < PIECE_MAX_SIZE; y++)
+    {
+        const uint64_t row = (uint64_t)((cells >> (PIECE_MAX_SIZE * y)) & 0xF) << pos_x;
+        if (!row && !count) continue;
+        if (!count) footprint.top = pos_y + y;
+        footprint.rows[count++] = row;
+    }
+    return footprint;
+}
+
+static inline bool are_footprints_equal(const Footprint* a, const Footprint* b)
+{
+    return a->top == b->top && memcmp(a->rows, b->rows, sizeof(a->rows)) == 0;
+}
+
+static inline uint8_t get_landing_y(const Playfield* playfield, PieceType type, const FinesseState* state)
+{
+    const PieceCells cells = PIECE_ROTATION_CELLS[type][state->rotation];
+    return get_playfield_piece_cells_hard_drop_y((Playfield*)playfield, cells, get_piece_data(type)->size, state->pos_x, state->pos_y);
+}
+
+static inline bool is_state_free(const Playfield* playfield, PieceType type, const FinesseState* state)
+{
+    return state->pos_x < STATE_WIDTH && state->pos_y < MAX_ROW_COUNT &&
+        !are_playfield_piece_cells_colliding((Playfield*)playfield, PIECE_ROTATION_CELLS[type][state->rotation], get_piece_data(type)->size, state->pos_x, state->pos_y);
+}
+
+// Where input takes the piece, the same way tick would move it. False if it doesn't move at all.
+static bool apply_finesse_input(const Playfield* playfield, PieceType type, FinesseState* state, FinesseInput input)
+{
+    const PieceData* piece_data = get_piece_data(type);
+    const PieceCells cells = PIECE_ROTATION_CELLS[type][state->rotation];
+    switch (input)
+    {
+    case FINESSE_TAP_LEFT:
+    case FINESSE_TAP_RIGHT:
+    case FINESSE_DAS_LEFT:
+    case FINESSE_DAS_RIGHT:
+    {
+        const int8_t direction = (input == FINESSE_TAP_LEFT || input == FINESSE_DAS_LEFT) ? -1 : 1;
+        const uint8_t distance = get_playfield_piece_cells_shift_distance(playfield, cells, piece_data->size, state->pos_x, state->pos_y, direction);
+        const bool is_das = (input == FINESSE_DAS_LEFT || input == FINESSE_DAS_RIGHT);
+        if (!distance || (is_das && distance < 2)) return false; // A DAS that only goes one cell is a tap.
+        state->pos_x = (uint8_t)(state->pos_x + direction * (is_das ? distance : 1));
+        return true;
+    }
+    case FINESSE_ROTATE_CLOCKWISE:
+    case FINESSE_ROTATE_COUNTER:
+    {
+        if (piece_data->size == NONE_2X2) return false;
+        Piece piece = { 0 };
+        piece.rotation_wall_kicks = piece_data->rotation_wall_kicks;
+        piece.cells = cells;
+        piece.type = type;
+        piece.size = piece_data->size;
+        piece.rotation = state->rotation;
+        piece.pos_x = state->pos_x;
+        piece.pos_y = state->pos_y;
+        if (!attempt_rotate_piece((Playfield*)playfield, &piece, input == FINESSE_ROTATE_CLOCKWISE)) return false;
+        state->pos_x = piece.pos_x;
+        state->pos_y = piece.pos_y;
+        state->rotation = piece.rotation;
+        return true;
+    }
+    case FINESSE_SOFT_DROP:
+    {
+        const uint8_t ground_y = get_landing_y(playfield, type, state);
+        if (ground_y == state->pos_y) return false;
+        state->pos_y = ground_y;
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+// Breadth first over (x, y, rotation), so the first state whose drop covers target is reached with the fewest inputs.
+// Inputs are tried in enum order, so ties go to moves before rotations, and to anything before a soft drop.
+static bool search_finesse_path(FinessePlanner* planner, const Playfield* playfield, PieceType type, FinesseState start, const Footprint* target, bool allow_soft_drop, FinessePath* out_path)
+{
+    if (!is_state_free(playfield, type, &start)) return false;
+    const uint32_t stamp = ++planner->stamp;
+    const uint16_t start_index = get_state_index(start.pos_x, start.pos_y, start.rotation);
+    planner->stamps[start_index] = stamp;
+    planner->parents[start_index] = NO_PARENT;
+    uint32_t head = 0;
+    uint32_t tail = 0;
+    planner->queue[tail++] = start_index;
+    while (head < tail)
+    {
+        const uint16_t index = planner->queue[head++];
+        const FinesseState state = get_index_state(index);
+        FinesseState landing = state;
+        landing.pos_y = get_landing_y(playfield, type, &state);
+        const Footprint footprint = get_footprint(type, landing.rotation, landing.pos_x, landing.pos_y);
+        if (are_footprints_equal(&footprint, target))
+        {
+            // Walk back to the start, then write the inputs out in order.
+            uint8_t count = 1;
+            for (uint16_t i = index; planner->parents[i] != NO_PARENT; i = planner->parents[i]) count++;
+            if (count > FINESSE_MAX_INPUTS) return false;
+            out_path->input_count = count;
+            out_path->key_count = count - 1;
+            out_path->is_from_table = false;
+            out_path->inputs[count - 1] = FINESSE_HARD_DROP;
+            out_path->states[count - 1] = landing;
+            uint8_t slot = count - 1;
+            for (uint16_t i = index; planner->parents[i] != NO_PARENT; i = planner->parents[i])
+            {
+                slot--;
+                out_path->inputs[slot] = planner->parent_inputs[i];
+                out_path->states[slot] = get_index_state(i);
+            }
+            return true;
+        }
+        for (uint8_t input = 0; input < FINESSE_SOFT_DROP + (allow_soft_drop ? 1 : 0); input++)
+        {
+            FinesseState next = state;
+            if (!apply_finesse_input(playfield, type, &next, (FinesseInput)input) || !is_state_free(playfield, type, &next)) continue;
+            const uint16_t next_index = get_state_index(next.pos_x, next.pos_y, next.rotation);
+            if (planner->stamps[next_index] == stamp) continue;
+            planner->stamps[next_index] = stamp;
+            planner->parents[next_index] = index;
+            planner->parent_inputs[next_index] = input;
+            planner->queue[tail++] = next_index;
+        }
+    }
+    return false;
+}
+
+FinessePlanner* create_finesse_planner()
+{
+    FinessePlanner* planner = calloc(1, sizeof(FinessePlanner));
+    if (!planner) return 0;
+    // Soft drops and tucks depend on the stack, so the tables only cover inputs at spawn height.
+    const Game empty = get_seeded_initialized_game(0);
+    const Playfield* playfield = &empty.playfield;
+    for (uint8_t type = I_TYPE; type <= L_TYPE; type++)
+    {
+        const uint8_t size = get_piece_data((PieceType)type)->size;
+        const FinesseState spawn = { (DEFAULT_COLUMN_COUNT / 2) - (size / 2) + COLUMN_OFFSET, PIECE_SPAWN_ROW_OFFSET, 0 };
+        uint8_t clear_rows = spawn.pos_y + size;
+        for (uint8_t rotation = 0; rotation < PIECE_ROTATION_STATES; rotation++)
+        {
+            for (uint8_t pos_x = 0; pos_x < TABLE_WIDTH; pos_x++)
+            {
+                const FinesseState drop = { pos_x, spawn.pos_y, rotation };
+                if (!is_state_free(playfield, (PieceType)type, &drop)) continue;
+                const Footprint target = get_footprint((PieceType)type, rotation, pos_x, get_landing_y(playfield, (PieceType)type, &drop));
+                FinessePath path;
+                if (!search_finesse_path(planner, playfield, (PieceType)type, spawn, &target, false, &path)) continue;
+                TableEntry* entry = &planner->table[type][rotation][pos_x];
+                entry->input_count = path.input_count;
+                memcpy(entry->inputs, path.inputs, path.input_count);
+                for (uint8_t i = 0; i + 1 < path.input_count; i++)
+                {
+                    if (path.states[i].pos_y + size > clear_rows) clear_rows = path.states[i].pos_y + size;
+                }
+            }
+        }
+        planner->table_clear_rows[type] = clear_rows + 2; // Room for the kicks that were tried and failed, too.
+    }
+    return planner;
+}
+
+void destroy_finesse_planner(FinessePlanner* planner)
+{
+    free(planner);
+}
+
+const char* get_finesse_input_name(FinesseInput input)
+{
+    return (input < FINESSE_INPUT_COUNT) ? FINESSE_INPUT_NAMES[input] : "unknown";
+}
+
+// The table path, replayed on the real board. Only taken when nothing near the spawn could change what any input does.
+static bool lookup_finesse_path(const FinessePlanner* planner, const Playfield* playfield, PieceType type, FinesseState start, const Footprint* target, Placement placement, FinessePath* out_path)
+{
+    const uint8_t size = get_piece_data(type)->size;
+    const FinesseState spawn = { (DEFAULT_COLUMN_COUNT / 2) - (size / 2) + COLUMN_OFFSET, PIECE_SPAWN_ROW_OFFSET, 0 };
+    if (playfield->column_count != DEFAULT_COLUMN_COUNT || memcmp(&start, &spawn, sizeof(FinesseState)) != 0 ||
+        placement.pos_x >= TABLE_WIDTH || planner->table_clear_rows[type] > playfield->row_count) return false;
+    for (uint8_t y = 0; y < planner->table_clear_rows[type]; y++)
+    {
+        if (playfield->cells[y]) return false;
+    }
+    const TableEntry* entry = &planner->table[type][placement.rotation][placement.pos_x];
+    if (!entry->input_count) return false;
+    FinesseState state = start;
+    for (uint8_t i = 0; i + 1 < entry->input_count; i++)
+    {
+        apply_finesse_input(playfield, type, &state, (FinesseInput)entry->inputs[i]);
+        out_path->inputs[i] = entry->inputs[i];
+        out_path->states[i] = state;
+    }
+    state.pos_y = get_landing_y(playfield, type, &state);
+    const Footprint footprint = get_footprint(type, state.rotation, state.pos_x, state.pos_y);
+    if (!are_footprints_equal(&footprint, target)) return false; // Lands higher or lower than asked, the stack is in the way.
+    out_path->inputs[entry->input_count - 1] = FINESSE_HARD_DROP;
+    out_path->states[entry->input_count - 1] = state;
+    out_path->input_count = entry->input_count;
+    out_path->key_count = entry->input_count - 1;
+    out_path->is_from_table = true;
+    return true;
+}
+
+bool find_finesse_path(FinessePlanner* planner, const Game* game, Placement target, FinessePath* out_path)
+{
+    if (target.type < I_TYPE || target.type > L_TYPE || target.rotation >= PIECE_ROTATION_STATES) return false;
+    Game held;
+    const Game* from = game;
+    if (target.use_hold)
+    {
+        if (!game->can_hold_piece || !(game->setting_bit_flags & SETTING_CAN_HOLD)) return false;
+        // A zero length tick does the hold and nothing else, and leaves the new piece at spawn.
+        held = *game;
+        held.previous_action_bit_flags = 0;
+        tick(&held, 0.0, ACTION_HOLD_PIECE);
+        from = &held;
+    }
+    const Piece* piece = &from->controlled_piece;
+    if (piece->type != target.type) return false;
+
+    const Footprint footprint = get_footprint(target.type, target.rotation, target.pos_x, target.pos_y);
+    const FinesseState start = { piece->pos_x, piece->pos_y, piece->rotation };
+    FinessePath path;
+    // Moves at spawn height then a drop is what finesse means, soft drops are only for what can't be reached that way.
+    if (!lookup_finesse_path(planner, &from->playfield, target.type, start, &footprint, target, &path) &&
+        !search_finesse_path(planner, &from->playfield, target.type, start, &footprint, false, &path) &&
+        !search_finesse_path(planner, &from->playfield, target.type, start, &footprint, true, &path)) return false;
+    if (!target.use_hold)
+    {
+        *out_path = path;
+        return true;
+    }
+    if (path.input_count + 1 > FINESSE_MAX_INPUTS) return false;
+    out_path->inputs[0] = FINESSE_HOLD;
+    out_path->states[0] = start;
+    memcpy(&out_path->inputs[1], path.inputs, path.input_count);
+    memcpy(&out_path->states[1], path.states, path.input_count * sizeof(FinesseState));
+    out_path->input_count = path.input_count + 1;
+    out_path->key_count = path.key_count;
+    out_path->is_from_table = path.is_from_table;
+    return true;
+}
+
+// Controller.
+
+bool needs_finesse_controller_target(const FinesseController* controller, const Game* game)
+{
+    return !controller->has_target || controller->target_placed_piece_count != game->placed_piece_count;
+}
+
+bool set_finesse_controller_target(FinesseController* controller, FinessePlanner* planner, const Game* game, Placement target)
+{
+    controller->target = target;
+    controller->target_placed_piece_count = game->placed_piece_count;
+    controller->next_input = 0;
+    controller->replan_count = 0;
+    controller->is_input_held = false;
+    controller->has_target = true;
+    if (find_finesse_path(planner, game, target, &controller->path)) return true;
+    controller->path.inputs[0] = FINESSE_HARD_DROP;
+    controller->path.input_count = 1;
+    controller->path.key_count = 0;
+    controller->replan_count = FINESSE_MAX_REPLANS;
+    return false;
+}
+
+// Whether the piece is where the path expects before input next_input. y is left out, gravity is expected to move it.
+static bool is_controller_on_path(const FinesseController* controller, const Game* game)
+{
+    if (!controller->next_input) return true;
+    const FinesseState* expected = &controller->path.states[controller->next_input - 1];
+    return game->controlled_piece.pos_x == expected->pos_x && game->controlled_piece.rotation == expected->rotation;
+}
+
+ACTION_BIT_FLAGS get_finesse_controller_action_bit_flags(FinesseController* controller, FinessePlanner* planner, const Game* game)
+{
+    if (needs_finesse_controller_target(controller, game) || controller->next_input >= controller->path.input_count)
+    {
+        return 0;
+    }
+
+    const Piece* piece = &game->controlled_piece;
+    const ACTION_BIT_FLAGS previous = game->previous_action_bit_flags; // What tick will compare with, so a key still down from the last piece is released first.
+    ACTION_BIT_FLAGS action_bit_flags = 0;
+    while (controller->next_input < controller->path.input_count)
+    {
+        const FinesseInput input = (FinesseInput)controller->path.inputs[controller->next_input];
+        const ACTION_BIT_FLAGS key = FINESSE_INPUT_KEYS[input];
+        const bool is_held_input = (input == FINESSE_DAS_LEFT || input == FINESSE_DAS_RIGHT || input == FINESSE_SOFT_DROP);
+        if (controller->is_input_held)
+        {
+            const int8_t direction = (input == FINESSE_DAS_LEFT) ? -1 : 1;
+            const bool is_done = (input == FINESSE_SOFT_DROP) ? piece->pos_y == game->controlled_piece_ground_y :
+                !get_playfield_piece_cells_shift_distance(&game->playfield, piece->cells, piece->size, piece->pos_x, piece->pos_y, direction);
+            if (!is_done)
+            {
+                action_bit_flags = key;
+                break;
+            }
+            controller->is_input_held = false;
+            controller->next_input++;
+            continue;
+        }
+        if (input != FINESSE_HARD_DROP && !is_controller_on_path(controller, game))
+        {
+            // Gravity or a kick took it somewhere else. Plan again from here, or drop where it is once that keeps happening.
+            const bool is_replanned = controller->replan_count < FINESSE_MAX_REPLANS && find_finesse_path(planner, game, (Placement){
+                controller->target.type, controller->target.pos_x, controller->target.pos_y, controller->target.rotation, false }, &controller->path);
+            controller->replan_count = is_replanned ? controller->replan_count + 1 : FINESSE_MAX_REPLANS;
+            if (!is_replanned)
+            {
+                controller->path.inputs[0] = FINESSE_HARD_DROP;
+                controller->path.input_count = 1;
+            }
+            controller->next_input = 0;
+            continue;
+        }
+        if (previous & key) break; // Released for a tick, so the next press is a fresh one.
+        action_bit_flags = key;
+        if (is_held_input)  controller->is_input_held = true;
+        else                controller->next_input++;
+        break;
+    }
+    return action_bit_flags;
+}
+
+uint32_t get_finesse_action_stream(FinessePlanner* planner, const Game* game, Placement target, double delta_time, ACTION_BIT_FLAGS* out_action_bit_flags, uint32_t capacity)
+{
+    Game copy = *game;
+    FinesseController controller = { 0 };
+    if (!set_finesse_controller_target(&controller, planner, &copy, target)) return 0;
+    const Footprint footprint = get_footprint(target.type, target.rotation, target.pos_x, target.pos_y);
+    for (uint32_t i = 0; i < capacity; i++)
+    {
+        const ACTION_BIT_FLAGS action_bit_flags = get_finesse_controller_action_bit_flags(&controller, planner, &copy);
+        // Where the piece locks if this tick locks it: dropped if hard dropping, where it is if the lock delay ran out.
+        const Piece before = copy.controlled_piece;
+        const uint8_t landing_y = (action_bit_flags & ACTION_HARD_DROP) ?
+            get_playfield_piece_cells_hard_drop_y(&copy.playfield, before.cells, before.size, before.pos_x, before.pos_y) : before.pos_y;
+        tick(&copy, delta_time, action_bit_flags);
+        out_action_bit_flags[i] = action_bit_flags;
+        if (copy.placed_piece_count == game->placed_piece_count) continue;
+        const Footprint locked = get_footprint(before.type, before.rotation, before.pos_x, landing_y);
+        return are_footprints_equal(&locked, &footprint) ? i + 1 : 0;
+    }
+    return 0;
+}
+
+// Tracker.
+
+void reset_finesse_tracker(FinesseTracker* tracker, const Game* game)
+{
+    tracker->spawn = *game;
+    tracker->last_state = (FinesseState){ game->controlled_piece.pos_x, game->controlled_piece.pos_y, game->controlled_piece.rotation };
+    tracker->key_count = 0;
+    tracker->is_tracking = true;
+    tracker->previous_action_bit_flags = game->previous_action_bit_flags;
+}
+
+bool track_finesse(FinesseTracker* tracker, FinessePlanner* planner, ACTION_BIT_FLAGS action_bit_flags, const Game* game)
+{
+    if (!tracker->is_tracking)
+    {
+        reset_finesse_tracker(tracker, game);
+        return false;
+    }
+    const ACTION_BIT_FLAGS pressed = action_bit_flags & ~tracker->previous_action_bit_flags;
+    tracker->previous_action_bit_flags = action_bit_flags;
+    const FinesseState before = tracker->last_state;
+    const Piece* piece = &game->controlled_piece;
+    tracker->last_state = (FinesseState){ piece->pos_x, piece->pos_y, piece->rotation };
+
+    if (game->placed_piece_count == tracker->spawn.placed_piece_count)
+    {
+        if (game->can_hold_piece != tracker->spawn.can_hold_piece || piece->type != tracker->spawn.controlled_piece.type)
+        {
+            reset_finesse_tracker(tracker, game); // Held, a new piece to judge from here.
+            return false;
+        }
+        tracker->key_count += (uint8_t)(((pressed & ACTION_MOVE_LEFT) != 0) + ((pressed & ACTION_MOVE_RIGHT) != 0) +
+            ((pressed & ACTION_ROTATE_CLOCKWISE) != 0) + ((pressed & ACTION_ROTATE_COUNTER) != 0) + ((pressed & ACTION_SOFT_DROP) != 0));
+        return false;
+    }
+
+    // Locked. It dropped from where it was, or the lock delay ran out there. A press on the locking tick moved it first, so that piece isn't judged.
+    const bool is_judged = game->placed_piece_count == tracker->spawn.placed_piece_count + 1 &&
+        !(pressed & (ACTION_MOVE_LEFT | ACTION_MOVE_RIGHT | ACTION_ROTATE_CLOCKWISE | ACTION_ROTATE_COUNTER));
+    const PieceType type = tracker->spawn.controlled_piece.type;
+    Placement placement = { type, before.pos_x, before.pos_y, before.rotation, false };
+    if (pressed & ACTION_HARD_DROP) placement.pos_y = get_landing_y(&tracker->spawn.playfield, type, &before);
+    FinessePath path;
+    const bool is_found = is_judged && find_finesse_path(planner, &tracker->spawn, placement, &path);
+    if (is_found)
+    {
+        tracker->last_key_count = tracker->key_count;
+        tracker->last_optimal_key_count = path.key_count;
+        tracker->is_last_fault = tracker->key_count > path.key_count;
+        tracker->piece_count++;
+        tracker->fault_count += tracker->is_last_fault;
+        tracker->extra_key_count += tracker->is_last_fault ? tracker->key_count - path.key_count : 0;
+    }
+    reset_finesse_tracker(tracker, game);
+    tracker->previous_action_bit_flags = action_bit_flags;
+    return is_found;
+}
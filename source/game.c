@@ -1,22 +1,62 @@
 #include <math.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GAME_SSE2
+#include <emmintrin.h>
+#endif
+
 #include "game.h"
+#include "trace.h"
 #include "util.h"
 
+_Static_assert(PIECE_COUNT < (1 << CELL_TYPE_PLANE_COUNT), "Every PieceType has to fit in the playfield type planes.");
+
+// The same draws and swaps as shuffle, so seeds give the bags they always did. With the bag size known here the loop unrolls
+// and every modulo is by a constant, a multiply instead of a division, which matters at a bag every seven placements.
+static void fill_piece_bag(PieceData** bag, uint64_t* random_state)
+{
+    memcpy(bag, ALL_PIECE_DATA, PIECE_COUNT * sizeof(PieceData*));
+    for (uint8_t i = 0; i < PIECE_COUNT - 1; i++)
+    {
+        const uint8_t j = i + (uint8_t)(next_random(random_state) % (PIECE_COUNT - i));
+        PieceData* swapped = bag[j];
+        bag[j] = bag[i];
+        bag[i] = swapped;
+    }
+}
+
 Game get_default_initialized_game()
 {
+    return get_seeded_initialized_game(((uint64_t)rand() << 32) ^ (uint64_t)rand());
+}
+
+Game get_seeded_initialized_game(uint64_t seed)
+{
+    return get_sized_initialized_game(seed, DEFAULT_ROW_COUNT, DEFAULT_COLUMN_COUNT);
+}
+
+Game get_sized_initialized_game(uint64_t seed, uint8_t row_count, uint8_t column_count)
+{
+    // Room for the ceiling and a piece under it, and no wider than a PlayfieldRow with its walls.
+    if (row_count < DEFAULT_CEILING + PIECE_MAX_SIZE) row_count = DEFAULT_CEILING + PIECE_MAX_SIZE;
+    if (row_count > MAX_ROW_COUNT) row_count = MAX_ROW_COUNT;
+    if (column_count < PIECE_MAX_SIZE) column_count = PIECE_MAX_SIZE;
+    if (column_count > MAX_COLUMN_COUNT) column_count = MAX_COLUMN_COUNT;
     Game game = {
         .score = 0,
+        .random_state = seed,
         .held_piece = 0,
-        .piece_queue = 0,
+        .piece_queue = {0},
         .controlled_piece = {0},
         .playfield = {
             .cells = {0},
             .lines_cleared = 0,
-            .row_count = DEFAULT_ROW_COUNT,
-            .column_count = DEFAULT_COLUMN_COUNT,
+            .row_count = row_count,
+            .column_count = column_count,
             .ceiling = DEFAULT_CEILING
         },
+        .handling = { DEFAULT_DAS, DEFAULT_ARR, DEFAULT_SOFT_DROP_FACTOR },
+        .placed_piece_count = 0,
         .level_index = 0,
         .piece_queue_index = 0,
         .cleared_lines_last_piece = 0,
@@ -25,14 +65,65 @@ Game get_default_initialized_game()
         .setting_bit_flags = SETTINGS_DEFAULT,
         .previous_action_bit_flags = 0
 	};
-    memcpy(game.piece_queue, ALL_PIECE_DATA, PIECE_COUNT * sizeof(PieceData*));
-    shuffle(game.piece_queue, PIECE_COUNT, sizeof(PieceData*));
+    for (uint8_t bag = 0; bag < PIECE_QUEUE_LENGTH; bag += PIECE_COUNT)
+    {
+        fill_piece_bag(&game.piece_queue[bag], &game.random_state);
+    }
     reset_controlled_piece(&game, pop_piece_queue(&game));
 	return game;
 }
 
+Handling get_default_handling()
+{
+    return (Handling){ DEFAULT_DAS, DEFAULT_ARR, DEFAULT_SOFT_DROP_FACTOR };
+}
+
+bool is_handling_valid(const Handling handling)
+{
+    // Written so NaN fails every comparison.
+    return handling.das >= 0.0f && handling.das <= MAX_DAS && handling.arr >= 0.0f && handling.arr <= MAX_ARR &&
+        handling.soft_drop_factor >= 0.0f && handling.soft_drop_factor <= MAX_SOFT_DROP_FACTOR;
+}
+
+// Moves at most distance cells, stopping at the wall or stack.
+static uint8_t shift_controlled_piece(Game* game, const int8_t x_direction, const uint8_t distance)
+{
+    Piece* piece = &game->controlled_piece;
+    const uint8_t free_distance = get_playfield_piece_cells_shift_distance(&game->playfield, piece->cells, piece->size, piece->pos_x, piece->pos_y, x_direction);
+    const uint8_t traveled = (distance < free_distance) ? distance : free_distance;
+    set_piece_position(piece, (uint8_t)(piece->pos_x + x_direction * traveled), piece->pos_y);
+    return traveled;
+}
+
+static void hold_controlled_piece(Game* game)
+{
+    PieceData* to_be_held = get_piece_data(game->controlled_piece.type);
+    reset_controlled_piece(game, (game->held_piece) ? game->held_piece : pop_piece_queue(game));
+    game->held_piece = to_be_held;
+    game->can_hold_piece = false;
+}
+
+// Points a level for the lines one piece clears, as many as a piece is tall.
+static const uint16_t LINE_CLEAR_SCORES[PIECE_MAX_SIZE + 1] = { 0, 100, 300, 500, 800 };
+
+// Everything a lock does once the cells are in: scoring the lines they cleared, and the next piece. Without a branch on the line
+// count, which in search and rollouts is close to a coin flip every piece.
+static inline void finish_piece_lock(Game* game, const uint8_t cleared_lines)
+{
+    const uint32_t is_clear = (cleared_lines != 0);
+    const uint8_t clear_mask = (uint8_t)(0 - is_clear);
+    const uint32_t line_score = (cleared_lines <= PIECE_MAX_SIZE) ? LINE_CLEAR_SCORES[cleared_lines] : 0;
+    game->score += (uint64_t)(game->level_index + 1) * (line_score + 50 * game->combo_count * is_clear);
+    game->combo_count = (uint8_t)(game->combo_count + 1) & clear_mask;
+    game->cleared_lines_last_piece = (cleared_lines & clear_mask) | (game->cleared_lines_last_piece & ~clear_mask);
+    game->placed_piece_count++;
+    reset_controlled_piece(game, pop_piece_queue(game));
+    game->can_hold_piece = true;
+}
+
 void tick(Game* game, double delta_time, ACTION_BIT_FLAGS action_bit_flags)
 {
+    TRACE_BEGIN("tick");
     // Action bit flags that are not intended to be long pressed. 
     ACTION_BIT_FLAGS unique_action_bit_flags = (action_bit_flags ^ game->previous_action_bit_flags) & action_bit_flags;
     // Lock reset event
@@ -40,10 +131,7 @@ void tick(Game* game, double delta_time, ACTION_BIT_FLAGS action_bit_flags)
     // Hold
     if (unique_action_bit_flags & ACTION_HOLD_PIECE && game->can_hold_piece && game->setting_bit_flags & SETTING_CAN_HOLD)
     {
-        PieceData* to_be_held = get_piece_data(game->controlled_piece.type);
-        reset_controlled_piece(game, (game->held_piece) ? game->held_piece : pop_piece_queue(game));
-        game->held_piece = to_be_held;
-        game->can_hold_piece = false;
+        hold_controlled_piece(game);
     }
     // Hard drop
     else if (unique_action_bit_flags & ACTION_HARD_DROP)
@@ -70,53 +158,71 @@ void tick(Game* game, double delta_time, ACTION_BIT_FLAGS action_bit_flags)
             }
         }
 
-        // Essentially, this does: hey, do we have stored velocity for the opposite direction of this frames action?
-        // If so, it simply will reset the velocity to 0 so we don't have to "gain back" what was lost.
+        // Movement. A press moves one cell. Held for DAS, it repeats every ARR, or goes all the way with ARR_INSTANT.
+        // velo_x is how long the held direction has been charging, minus the repeats already made.
+        const Handling* handling = &game->handling;
+        const int8_t held_x_direction = ((action_bit_flags & ACTION_MOVE_RIGHT) ? 1 : 0) - ((action_bit_flags & ACTION_MOVE_LEFT) ? 1 : 0);
         uint8_t x_distance_traveled = 0;
-        if (unique_action_bit_flags & ACTION_MOVE_RIGHT) 
+        if (unique_action_bit_flags & (ACTION_MOVE_RIGHT | ACTION_MOVE_LEFT))
         {
             game->controlled_piece.velo_x = 0.0f;
-            x_distance_traveled = attempt_move_piece_until_collision(&game->playfield, &game->controlled_piece, 1, 0, 1);
+            x_distance_traveled = shift_controlled_piece(game, (unique_action_bit_flags & ACTION_MOVE_RIGHT) ? 1 : -1, 1);
         }
-        else if (unique_action_bit_flags & ACTION_MOVE_LEFT)
+        else if (held_x_direction)
         {
-            game->controlled_piece.velo_x = 0.0f;
-            x_distance_traveled = attempt_move_piece_until_collision(&game->playfield, &game->controlled_piece, -1, 0, 1);
-        }
-        else 
-        {
-			game->controlled_piece.velo_x += ((action_bit_flags & ACTION_MOVE_RIGHT ? HORIZONTAL_VELOCITY : 0.0f) + (action_bit_flags & ACTION_MOVE_LEFT ? -HORIZONTAL_VELOCITY : 0.0f)) * delta_time;
-			uint8_t x_distance = (uint8_t)(fabsf(game->controlled_piece.velo_x)); // This could lead to weird shit, probably would be better to clamp first.
-			if (x_distance) // If there is greater than 0 cell distance
-			{
-				int8_t x_direction = SIGN(game->controlled_piece.velo_x);
-                x_distance_traveled = attempt_move_piece_until_collision(&game->playfield, &game->controlled_piece, x_direction, 0, x_distance);
-                if (!x_distance_traveled) // If the piece couldn't move a single cell
+            game->controlled_piece.velo_x += (float)delta_time;
+            if (game->controlled_piece.velo_x >= handling->das)
+            {
+                const bool is_instant = (handling->arr <= ARR_INSTANT);
+                const float repeats = (is_instant) ? UINT8_MAX : 1.0f + (game->controlled_piece.velo_x - handling->das) / handling->arr;
+                const uint8_t distance = (uint8_t)fmaxf(0.0f, fminf(repeats, UINT8_MAX)); // Clamped before the cast, fminf also turns NaN into UINT8_MAX.
+                x_distance_traveled = shift_controlled_piece(game, held_x_direction, distance);
+                if (is_instant || x_distance_traveled < distance)
                 {
-                    game->controlled_piece.velo_x = 0.0f;                           // Reset velocity. This is okay since we move anyways on first input.
-                    action_bit_flags &= ~(ACTION_MOVE_RIGHT & ACTION_MOVE_LEFT);    // Remove the intent to move right or left so we can reconsider next frame. Just don't want velocity to get too high.
+                    game->controlled_piece.velo_x = handling->das; // Stays charged against the wall, ready for the moment there is room.
                 }
                 else
                 {
-                    game->controlled_piece.velo_x += (-x_direction * x_distance_traveled);
+                    game->controlled_piece.velo_x -= x_distance_traveled * handling->arr;
                 }
-			}
+            }
+        }
+        else
+        {
+            game->controlled_piece.velo_x = 0.0f; // Released, or both held at once.
         }
 		if (x_distance_traveled)
 		{
 			lock_reset_bit_flags |= LOCK_RESET_MOVE;
 		}
         
-        // Gravity & soft drop
-        game->controlled_piece.velo_y += ((action_bit_flags & ACTION_SOFT_DROP ? VERTICAL_VELOCITY : 0.0f) + ALL_LEVELS[game->level_index].gravity) * delta_time;
-		uint8_t y_distance = (uint8_t)(fabsf(game->controlled_piece.velo_y)); // This could lead to weird shit, probably would be better to clamp first.
+        // Gravity & soft drop. Falling is capped by the ground row instead of checking every cell on the way.
+        const uint8_t ground_y = get_playfield_piece_cells_hard_drop_y(
+            &game->playfield,
+            game->controlled_piece.cells,
+            game->controlled_piece.size,
+            game->controlled_piece.pos_x,
+            game->controlled_piece.pos_y
+        );
+        const bool is_soft_dropping = (action_bit_flags & ACTION_SOFT_DROP);
+        uint8_t y_distance = 0;
+        if (is_soft_dropping && handling->soft_drop_factor <= SOFT_DROP_INSTANT)
+        {
+            y_distance = UINT8_MAX;
+            game->controlled_piece.velo_y = 0.0f;
+        }
+        else
+        {
+            game->controlled_piece.velo_y += ALL_LEVELS[game->level_index].gravity * (is_soft_dropping ? handling->soft_drop_factor : 1.0f) * delta_time;
+            y_distance = (uint8_t)fminf(fabsf(game->controlled_piece.velo_y), UINT8_MAX); // Clamped before the cast, no board is that tall anyway.
+        }
 		if (y_distance)
 		{
-			int8_t y_direction = SIGN(game->controlled_piece.velo_y);
-			uint8_t y_velocity_consumed = attempt_move_piece_until_collision(&game->playfield, &game->controlled_piece, 0, y_direction, y_distance);
+			const uint8_t y_velocity_consumed = (ground_y - game->controlled_piece.pos_y < y_distance) ? ground_y - game->controlled_piece.pos_y : y_distance;
 			if (y_velocity_consumed)
 			{
-                game->controlled_piece.velo_y += (-y_direction * y_velocity_consumed);
+                set_piece_position(&game->controlled_piece, game->controlled_piece.pos_x, game->controlled_piece.pos_y + y_velocity_consumed);
+                if (game->controlled_piece.velo_y) game->controlled_piece.velo_y -= y_velocity_consumed;
                 lock_reset_bit_flags |= LOCK_RESET_DROP;
 			}
 		}
@@ -171,13 +277,10 @@ void tick(Game* game, double delta_time, ACTION_BIT_FLAGS action_bit_flags)
 		}
 	}
 
-    if (game->level_index < LEVEL_COUNT - 1 &&
-        game->playfield.lines_cleared >= ALL_LEVELS[game->level_index].lines_cleared)
-    {
-        game->level_index++;
-    }
+    update_level(game);
 
     game->previous_action_bit_flags = action_bit_flags;
+    TRACE_END("tick");
 }
 
 bool is_game_over(Game* game)
@@ -187,31 +290,222 @@ bool is_game_over(Game* game)
 
 void reset_game(Game* game)
 {
-    exit(1);
+    const SETTING_BIT_FLAGS setting_bit_flags = game->setting_bit_flags;
+    const Handling handling = game->handling;
+    *game = get_sized_initialized_game(next_random(&game->random_state), game->playfield.row_count, game->playfield.column_count); // Keeps the board size.
+    game->setting_bit_flags = setting_bit_flags;
+    game->handling = handling;
+    game->can_hold_piece = (setting_bit_flags & SETTING_CAN_HOLD);
+}
+
+// Piece row y shifted to pos_x, in the same coordinates as pos_x (so the playfield starts at bit COLUMN_OFFSET).
+static inline uint64_t get_piece_row_mask(const PieceCells piece_cells, const uint8_t y, const uint8_t pos_x)
+{
+    return (uint64_t)((piece_cells >> (PIECE_MAX_SIZE * y)) & 0xF) << pos_x;
+}
+
+// Everything outside the columns of the playfield, so a wall counts as a cell.
+static inline uint64_t get_playfield_walls_mask(const Playfield* playfield)
+{
+    return ~((((uint64_t)1 << playfield->column_count) - 1) << COLUMN_OFFSET);
+}
+
+#ifdef GAME_SSE2
+#define ROWS_PER_VECTOR (sizeof(__m128i) / sizeof(PlayfieldRow))
+
+// Piece rows y on, as many as fit a vector, shifted to the playfield like get_piece_row_mask >> COLUMN_OFFSET.
+static inline __m128i get_piece_row_vector(const PieceCells piece_cells, const uint8_t y, const __m128i left, const __m128i right)
+{
+#ifdef ZETRIS_WIDE_ROWS
+    const __m128i rows = _mm_setr_epi32((piece_cells >> (PIECE_MAX_SIZE * y)) & 0xF, 0, (piece_cells >> (PIECE_MAX_SIZE * (y + 1))) & 0xF, 0);
+    return _mm_srl_epi64(_mm_sll_epi64(rows, left), right);
+#else
+    const __m128i rows = _mm_setr_epi32((piece_cells >> (PIECE_MAX_SIZE * y)) & 0xF, (piece_cells >> (PIECE_MAX_SIZE * (y + 1))) & 0xF,
+        (piece_cells >> (PIECE_MAX_SIZE * (y + 2))) & 0xF, (piece_cells >> (PIECE_MAX_SIZE * (y + 3))) & 0xF);
+    return _mm_srl_epi32(_mm_sll_epi32(rows, left), right);
+#endif // ZETRIS_WIDE_ROWS
+}
+
+// Every bit of a row lane set where the row equals full_row.
+static inline __m128i get_row_vector_equal(const __m128i rows, const PlayfieldRow full_row)
+{
+#ifdef ZETRIS_WIDE_ROWS
+    const __m128i halves = _mm_cmpeq_epi32(rows, _mm_setr_epi32((int)full_row, (int)(full_row >> 32), (int)full_row, (int)(full_row >> 32)));
+    return _mm_and_si128(halves, _mm_shuffle_epi32(halves, _MM_SHUFFLE(2, 3, 0, 1))); // SSE2 has no 64 bit compare, both halves have to match.
+#else
+    return _mm_cmpeq_epi32(rows, _mm_set1_epi32((int)full_row));
+#endif // ZETRIS_WIDE_ROWS
+}
+#endif // GAME_SSE2
+
+bool is_placement_valid(const Game* game, Placement placement)
+{
+    if (placement.type < I_TYPE || placement.type > L_TYPE || placement.rotation >= PIECE_ROTATION_STATES) return false;
+    // The piece that would be placed, selected rather than branched on, since use_hold is close to random in search.
+    const PieceData* after_hold = (game->held_piece) ? game->held_piece : peek_piece_queue(game, 0);
+    const bool can_hold = game->can_hold_piece && (game->setting_bit_flags & SETTING_CAN_HOLD);
+    const PieceType placed_types[2] = { game->controlled_piece.type, after_hold->type };
+    const PieceType placed_type = placed_types[placement.use_hold];
+    if ((placement.use_hold & !can_hold) | (placed_type != placement.type)) return false;
+    // are_piece_cells_on_playfield_ground in one pass: no piece row is blocked where it is, and at least one is a row down (walls
+    // can't be, it is the same columns). Rows past the bottom count as blocked. All four rows are checked, empty ones included, so
+    // the piece's shape is never a branch.
+    if (placement.pos_x > 64 - PIECE_MAX_SIZE) return false;
+    const Playfield* playfield = &game->playfield;
+    const PieceCells cells = PIECE_ROTATION_CELLS[placement.type][placement.rotation];
+    const uint64_t walls = get_playfield_walls_mask(playfield);
+    uint64_t blocked = 0;
+    uint64_t blocked_below = 0;
+    for (uint8_t y = 0; y < PIECE_MAX_SIZE; y++)
+    {
+        const uint64_t piece_row = get_piece_row_mask(cells, y, placement.pos_x);
+        const int row = placement.pos_y + y;
+        const uint64_t here = (uint64_t)playfield->cells[(row < MAX_ROW_COUNT) ? row : MAX_ROW_COUNT - 1] << COLUMN_OFFSET;
+        const uint64_t below = (uint64_t)playfield->cells[(row + 1 < MAX_ROW_COUNT) ? row + 1 : MAX_ROW_COUNT - 1] << COLUMN_OFFSET;
+        blocked |= piece_row & (walls | here | ((uint64_t)0 - (row >= playfield->row_count)));
+        blocked_below |= piece_row & (below | ((uint64_t)0 - (row + 1 >= playfield->row_count)));
+    }
+    return !blocked && blocked_below;
+}
+
+// Holds if asked and writes a valid placement's cells into the board, returning whether any of its rows filled.
+static inline bool lock_placement_rows(Game* game, const Placement placement)
+{
+    // A hold here only leaves the controlled piece in held_piece, the piece it brings out is replaced by the next one on lock. So
+    // it is a select, and the only branch is on the first hold of a round, which takes its piece from the queue. Bots hold close to
+    // every other piece, so branching on use_hold would mispredict about as often as not.
+    PieceData* controlled_piece_data = (PieceData*)ALL_PIECE_DATA[game->controlled_piece.type - 1];
+    if (placement.use_hold & !game->held_piece)
+    {
+        pop_piece_queue(game);
+    }
+    PieceData* const held_pieces[2] = { game->held_piece, controlled_piece_data }; // Indexed, since gcc turns a ?: here back into a branch.
+    game->held_piece = held_pieces[placement.use_hold];
+    // The placement is valid, so its cells are inside the walls and on empty cells, which have no type bits set either: they are
+    // or'd in without masking. All four piece rows are written, empty ones included, so the piece's shape is never a branch. Where the piece
+    // was and how it got there don't matter, the next piece replaces it.
+    Playfield* playfield = &game->playfield;
+    const PieceCells cells = PIECE_ROTATION_CELLS[placement.type][placement.rotation];
+    const PlayfieldRow full_row = (PlayfieldRow)(~get_playfield_walls_mask(playfield) >> COLUMN_OFFSET);
+    PlayfieldRow type_bits[CELL_TYPE_PLANE_COUNT];
+    for (uint8_t i = 0; i < CELL_TYPE_PLANE_COUNT; i++)
+    {
+        type_bits[i] = (PlayfieldRow)0 - ((placement.type >> i) & 1U);
+    }
+    bool is_row_filled = false;
+#ifdef GAME_SSE2
+    // A vector of rows at a time in cells and each type plane, unless the piece box hangs past the last row.
+    if (placement.pos_y <= MAX_ROW_COUNT - PIECE_MAX_SIZE)
+    {
+        const int shift = placement.pos_x - COLUMN_OFFSET; // Negative when the piece's left columns are empty and over the wall.
+        const __m128i left = _mm_cvtsi32_si128((shift > 0) ? shift : 0);
+        const __m128i right = _mm_cvtsi32_si128((shift < 0) ? -shift : 0);
+        __m128i filled = _mm_setzero_si128();
+        for (uint8_t y = 0; y < PIECE_MAX_SIZE; y += ROWS_PER_VECTOR)
+        {
+            const __m128i rows = get_piece_row_vector(cells, y, left, right);
+            __m128i* cells_at = (__m128i*)&playfield->cells[placement.pos_y + y];
+            const __m128i locked = _mm_or_si128(_mm_loadu_si128(cells_at), rows);
+            _mm_storeu_si128(cells_at, locked);
+            for (uint8_t i = 0; i < CELL_TYPE_PLANE_COUNT; i++)
+            {
+                __m128i* plane_at = (__m128i*)&playfield->type_planes[i][placement.pos_y + y];
+                _mm_storeu_si128(plane_at, _mm_or_si128(_mm_loadu_si128(plane_at), _mm_and_si128(rows, _mm_set1_epi32((int)type_bits[i]))));
+            }
+            filled = _mm_or_si128(filled, get_row_vector_equal(locked, full_row));
+        }
+        is_row_filled = _mm_movemask_epi8(filled) != 0;
+    }
+    else
+#endif // GAME_SSE2
+    for (uint8_t y = 0; y < PIECE_MAX_SIZE; y++)
+    {
+        const PlayfieldRow row_mask = (PlayfieldRow)(get_piece_row_mask(cells, y, placement.pos_x) >> COLUMN_OFFSET);
+        const uint8_t row = (placement.pos_y + y < MAX_ROW_COUNT) ? placement.pos_y + y : MAX_ROW_COUNT - 1; // Only ever for an empty piece row.
+        playfield->cells[row] |= row_mask;
+        for (uint8_t i = 0; i < CELL_TYPE_PLANE_COUNT; i++)
+        {
+            playfield->type_planes[i][row] |= type_bits[i] & row_mask;
+        }
+        is_row_filled |= (playfield->cells[row] == full_row);
+    }
+    return is_row_filled;
+}
+
+bool attempt_apply_placement(Game* game, Placement placement)
+{
+    if (!is_placement_valid(game, placement)) return false;
+    // Clears the way tick does, so boards no game could reach (a decoded state, say) come out the same too.
+    lock_placement_rows(game, placement);
+    finish_piece_lock(game, clear_filled_lines(&game->playfield, placement.pos_y + ALL_PIECE_DATA[placement.type - 1]->size));
+    update_level(game);
+    return true;
+}
+
+void apply_drop_placement(Game* game, const Placement placement)
+{
+    // On a board a game reached only the piece's rows can have filled, and clear_filled_piece_rows only runs when one did.
+    const uint8_t size = ALL_PIECE_DATA[placement.type - 1]->size;
+    finish_piece_lock(game, lock_placement_rows(game, placement) ? clear_filled_piece_rows(&game->playfield, placement.pos_y, size) : 0);
+    update_level(game);
+}
+
+static uint16_t get_piece_type_drop_placements(const Playfield* playfield, const PieceType type, const bool use_hold, Placement* out_placements)
+{
+    Playfield* const field = (Playfield*)playfield;
+    const PieceSize size = get_piece_data(type)->size;
+    const uint8_t spawn_x = (playfield->column_count / 2) - (size / 2) + COLUMN_OFFSET; // Same as reset_controlled_piece.
+    // Nothing can collide above the stack, so drops start just over it instead of at spawn.
+    uint8_t top_row = 0;
+    while (top_row < playfield->row_count && !playfield->cells[top_row]) top_row++;
+    const uint8_t drop_start_y = (top_row > PIECE_SPAWN_ROW_OFFSET + PIECE_MAX_SIZE) ? top_row - PIECE_MAX_SIZE : PIECE_SPAWN_ROW_OFFSET;
+
+    uint16_t count = 0;
+    for (uint8_t rotation = 0; rotation < get_piece_unique_rotation_count(type); rotation++)
+    {
+        const PieceCells cells = PIECE_ROTATION_CELLS[type][rotation];
+        for (int8_t direction = -1; direction <= 1; direction += 2)
+        {
+            for (int pos_x = (direction < 0) ? spawn_x : spawn_x + 1; pos_x >= 0; pos_x += direction)
+            {
+                if (are_playfield_piece_cells_colliding(field, cells, size, (uint8_t)pos_x, PIECE_SPAWN_ROW_OFFSET)) break;
+                uint8_t pos_y = drop_start_y;
+                while (!are_playfield_piece_cells_colliding(field, cells, size, (uint8_t)pos_x, pos_y + 1)) pos_y++;
+                out_placements[count++] = (Placement){ type, (uint8_t)pos_x, pos_y, rotation, use_hold };
+            }
+        }
+    }
+    return count;
+}
+
+uint16_t get_drop_placements(const Game* game, bool include_hold, Placement* out_placements)
+{
+    uint16_t count = get_piece_type_drop_placements(&game->playfield, game->controlled_piece.type, false, out_placements);
+    if (include_hold && game->can_hold_piece && (game->setting_bit_flags & SETTING_CAN_HOLD))
+    {
+        const PieceData* after_hold = (game->held_piece) ? game->held_piece : peek_piece_queue(game, 0);
+        if (after_hold->type != game->controlled_piece.type) // Swapping for the same type changes nothing.
+        {
+            count += get_piece_type_drop_placements(&game->playfield, after_hold->type, true, out_placements + count);
+        }
+    }
+    return count;
 }
 
 bool are_playfield_piece_cells_colliding(Playfield* const playfield, const PieceCells piece_cells, const PieceSize piece_size, const uint8_t pos_x, const uint8_t pos_y)
 {
-    uint8_t visited_piece_cells = 0;
+    // One AND per piece row against the playfield row with its walls, instead of a bounds check and lookup per cell.
+    if (pos_x > 64 - PIECE_MAX_SIZE) return true;
+    const uint64_t walls = get_playfield_walls_mask(playfield);
     for (uint8_t y = 0; y < piece_size; y++)
     {
-    	for (uint8_t x = 0; x < piece_size; x++)
-    	{
-    		// If there is a cell in this block position
-    		if (is_piece_cell(piece_cells, x, y))
-    		{
-    			visited_piece_cells++;
-    			// If there is a cell in this playfield position
-    			if (is_playfield_cell(playfield, pos_x + x, pos_y + y))
-    			{
-    				return true;
-    			}
-    			if (visited_piece_cells == PIECE_CELL_COUNT)
-    			{
-    				return false;
-    			}
-    		}
-    	}
+        const uint64_t piece_row = get_piece_row_mask(piece_cells, y, pos_x);
+        if (!piece_row) continue;
+        if (pos_y + y >= playfield->row_count ||
+            (piece_row & (walls | ((uint64_t)playfield->cells[pos_y + y] << COLUMN_OFFSET))))
+        {
+            return true;
+        }
     }
     return false;
 }
@@ -272,6 +566,15 @@ uint8_t attempt_move_piece_until_collision(Playfield* playfield, Piece* piece, i
 
 uint8_t get_playfield_piece_cells_hard_drop_y(Playfield* playfield, PieceCells piece_cells, PieceSize piece_size, uint8_t pos_x, uint8_t pos_y)
 {
+    // Rows above the stack are empty, so the piece falls through them in one step and only checks row by row inside the stack.
+    uint8_t top_row = 0;
+    while (top_row < playfield->row_count && !playfield->cells[top_row]) top_row++;
+    uint8_t bottom_offset = piece_size;
+    while (bottom_offset > 0 && !((piece_cells >> (PIECE_MAX_SIZE * (bottom_offset - 1))) & 0xF)) bottom_offset--;
+    if (bottom_offset && top_row >= bottom_offset && top_row - bottom_offset > pos_y)
+    {
+        pos_y = top_row - bottom_offset;
+    }
     for (; pos_y < playfield->row_count; pos_y++)
     {
         if (are_piece_cells_on_playfield_ground(playfield, piece_cells, piece_size, pos_x, pos_y))
@@ -282,82 +585,106 @@ uint8_t get_playfield_piece_cells_hard_drop_y(Playfield* playfield, PieceCells p
     return pos_y;
 }
 
-void lock_piece_cells_in_playfield(Playfield* playfield, PieceCells piece_cells, PieceSize piece_size, uint8_t pos_x, uint8_t pos_y)
+uint8_t get_playfield_piece_cells_shift_distance(const Playfield* playfield, PieceCells piece_cells, PieceSize piece_size, uint8_t pos_x, uint8_t pos_y, int8_t x_direction)
+{
+    // Every row of a piece is one unbroken run of cells, so only its leading cell can run into anything.
+    if (pos_x > 64 - PIECE_MAX_SIZE) return 0;
+    const uint64_t walls = get_playfield_walls_mask(playfield);
+    uint8_t distance = UINT8_MAX;
+    for (uint8_t y = 0; y < piece_size; y++)
+    {
+        const uint64_t piece_row = get_piece_row_mask(piece_cells, y, pos_x);
+        if (!piece_row) continue;
+        if (pos_y + y >= playfield->row_count) return 0;
+        // The walls mask covers every bit outside the playfield, so there is always something ahead.
+        const uint64_t blocked = walls | ((uint64_t)playfield->cells[pos_y + y] << COLUMN_OFFSET);
+        uint8_t row_distance;
+        if (x_direction > 0)
+        {
+            const uint8_t leading = 63 - count_leading_zeros_64(piece_row);
+            row_distance = count_trailing_zeros_64((blocked >> leading) >> 1);
+        }
+        else
+        {
+            const uint8_t leading = count_trailing_zeros_64(piece_row);
+            row_distance = leading - 1 - (63 - count_leading_zeros_64(blocked & ((1ULL << leading) - 1)));
+        }
+        if (row_distance < distance) distance = row_distance;
+    }
+    return (distance == UINT8_MAX) ? 0 : distance;
+}
+
+void lock_piece_cells_in_playfield(Playfield* playfield, PieceCells piece_cells, PieceSize piece_size, PieceType piece_type, uint8_t pos_x, uint8_t pos_y)
 {
-	uint8_t visited_piece_cells = 0;
-	for (uint8_t y = 0; y < piece_size; y++)
+    // Cells outside the playfield are dropped, same as attempt_add_playfield_cell_at.
+    if (pos_x > 64 - PIECE_MAX_SIZE) return;
+    const uint64_t walls = get_playfield_walls_mask(playfield);
+	for (uint8_t y = 0; y < piece_size && pos_y + y < playfield->row_count; y++)
 	{
-		for (uint8_t x = 0; x < piece_size; x++)
-		{
-			if (is_piece_cell(piece_cells, x, y))
-			{
-				visited_piece_cells++;
-				attempt_add_playfield_cell_at(playfield, pos_x + x, pos_y + y);
-				if (visited_piece_cells == 4) return;
-			}
-		}
+		const PlayfieldRow row_mask = (PlayfieldRow)((get_piece_row_mask(piece_cells, y, pos_x) & ~walls) >> COLUMN_OFFSET);
+		if (!row_mask) continue;
+		playfield->cells[pos_y + y] |= row_mask;
+		set_playfield_row_cell_types(playfield, pos_y + y, row_mask, (uint8_t)piece_type);
 	}
 }
 
 void reset_controlled_piece(Game* game, PieceData* optional_piece_data)
 {
-    reset_piece_lock(&game->controlled_piece);
-    reset_piece_velocity(&game->controlled_piece);
+    // Field by field rather than through the piece.c helpers, since this runs for every piece a search or rollout places.
+    Piece* piece = &game->controlled_piece;
     if (optional_piece_data)
     {
-        copy_data_into_piece(&game->controlled_piece, optional_piece_data);
-        game->controlled_piece.rotation = 0;
+        piece->rotation_wall_kicks = optional_piece_data->rotation_wall_kicks;
+        piece->cells = optional_piece_data->cells;
+        piece->type = optional_piece_data->type;
+        piece->size = optional_piece_data->size;
+        piece->rotation = 0;
     }
-    set_piece_position(&game->controlled_piece, (game->playfield.column_count / 2) - (game->controlled_piece.size / 2) + COLUMN_OFFSET, PIECE_SPAWN_ROW_OFFSET);
+    piece->velo_x = 0.0f;
+    piece->velo_y = 0.0f;
+    piece->timer = 0.0f;
+    piece->moves = 0;
+    piece->on_ground = false;
+    piece->pos_x = (game->playfield.column_count / 2) - (piece->size / 2) + COLUMN_OFFSET;
+    piece->pos_y = PIECE_SPAWN_ROW_OFFSET;
 }
 
 void on_controlled_piece_place(Game* game)
 {
+    TRACE_BEGIN("lock"); // Locking, line clears and the bag refill, the part of a tick that varies.
     lock_piece_cells_in_playfield(
         &game->playfield,
         game->controlled_piece.cells,
         game->controlled_piece.size,
+        game->controlled_piece.type,
         game->controlled_piece.pos_x,
         game->controlled_piece.pos_y
     );
-    uint8_t cleared_lines = clear_filled_lines(&game->playfield, game->controlled_piece.pos_y + game->controlled_piece.size);
-    if (cleared_lines)
-    {
-        switch (cleared_lines)
-        {
-        case 1:
-            game->score += (game->level_index + 1) * 100;
-            break;
-        case 2:
-            game->score += (game->level_index + 1) * 300;
-            break;
-        case 3:
-            game->score += (game->level_index + 1) * 500;
-            break;
-        case 4:
-            game->score += (game->level_index + 1) * 800;
-            break;
-        }
-        game->score += 50 * game->combo_count * (game->level_index + 1);
-        game->combo_count++;
-        game->cleared_lines_last_piece = cleared_lines;
-    }
-    else
+    finish_piece_lock(game, clear_filled_lines(&game->playfield, game->controlled_piece.pos_y + game->controlled_piece.size));
+    TRACE_END("lock");
+}
+
+void update_level(Game* game)
+{
+    if (game->level_index < LEVEL_COUNT - 1 &&
+        game->playfield.lines_cleared >= ALL_LEVELS[game->level_index].lines_cleared)
     {
-        game->combo_count = 0;
+        game->level_index++;
     }
-    reset_controlled_piece(game, pop_piece_queue(game));
-    game->can_hold_piece = true;
 }
 
 PieceData* pop_piece_queue(Game* game)
 {
 	PieceData* retval = game->piece_queue[game->piece_queue_index];
 	game->piece_queue_index++;
-	if (game->piece_queue_index >= PIECE_COUNT)
+	if (game->piece_queue_index % PIECE_COUNT == 0) // Just finished a bag, so refill it behind the one we moved into.
 	{
-		game->piece_queue_index = 0;
-		shuffle(game->piece_queue, PIECE_COUNT, sizeof(PieceData*));
+		const uint8_t finished_bag = game->piece_queue_index - PIECE_COUNT;
+		fill_piece_bag(&game->piece_queue[finished_bag], &game->random_state);
+		if (game->piece_queue_index >= PIECE_QUEUE_LENGTH)
+		{
+			game->piece_queue_index = 0;
+		}
 	}
 	return retval;
 }
@@ -367,6 +694,11 @@ PieceData* top_piece_queue(Game* game)
 	return game->piece_queue[game->piece_queue_index];
 }
 
+PieceData* peek_piece_queue(const Game* game, uint8_t offset)
+{
+	return game->piece_queue[(game->piece_queue_index + offset) % PIECE_QUEUE_LENGTH];
+}
+
 const Level ALL_LEVELS[LEVEL_COUNT] = {
     // Level 1
     {
@@ -0,0 +1,80 @@
+#include <string.h>
+
+#include "mapped_file.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+bool map_file(const char* path, bool is_sequential, MappedFile* out_file)
+{
+    memset(out_file, 0, sizeof(MappedFile));
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, is_sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS, 0);
+    LARGE_INTEGER size;
+    if (file == INVALID_HANDLE_VALUE) return false;
+    if (!GetFileSizeEx(file, &size))
+    {
+        CloseHandle(file);
+        return false;
+    }
+    out_file->file = file;
+    out_file->size = (size_t)size.QuadPart;
+    if (out_file->size)
+    {
+        out_file->mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+        if (out_file->mapping) out_file->data = MapViewOfFile(out_file->mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!out_file->data)
+        {
+            unmap_file(out_file);
+            return false;
+        }
+    }
+    return true;
+}
+
+void unmap_file(MappedFile* file)
+{
+    if (file->data) UnmapViewOfFile(file->data);
+    if (file->mapping) CloseHandle(file->mapping);
+    if (file->file) CloseHandle(file->file);
+    memset(file, 0, sizeof(MappedFile));
+}
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool map_file(const char* path, bool is_sequential, MappedFile* out_file)
+{
+    memset(out_file, 0, sizeof(MappedFile));
+    const int descriptor = open(path, O_RDONLY);
+    struct stat status;
+    if (descriptor < 0) return false;
+    if (fstat(descriptor, &status) != 0)
+    {
+        close(descriptor);
+        return false;
+    }
+    out_file->size = (size_t)status.st_size;
+    if (out_file->size)
+    {
+        void* data = mmap(0, out_file->size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if (data == MAP_FAILED)
+        {
+            close(descriptor);
+            return false;
+        }
+        madvise(data, out_file->size, is_sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+        out_file->data = data;
+    }
+    close(descriptor); // The mapping keeps the file alive.
+    return true;
+}
+
+void unmap_file(MappedFile* file)
+{
+    if (file->data) munmap((void*)file->data, file->size);
+    memset(file, 0, sizeof(MappedFile));
+}
+#endif // _WIN32
@@ -0,0 +1,640 @@
+#include <math.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+#include "mcts.h"
+#include "util.h"
+
+#define MCTS_NULL_NODE          UINT32_MAX
+#define MCTS_VALUE_SCALE        1024.0      // Fixed point for value sums, so they can be added atomically.
+#define MCTS_GAME_OVER_RETURN   -20.0       // Worse than any board a rollout can leave behind.
+#define MCTS_BOARD_WEIGHT       0.25         // How much the board at the end of a rollout counts next to the lines it cleared.
+#define MCTS_SEED               0x5A45545249534D43ULL
+
+// Line clear rewards in the same ratio as the scoring in on_controlled_piece_place, used by the rollout policy.
+static const float LINE_CLEAR_UNITS[PIECE_MAX_SIZE + 1] = { 0.0f, 1.0f, 3.0f, 5.0f, 8.0f };
+
+enum {
+    MCTS_NODE_LEAF,
+    MCTS_NODE_EXPANDING,    // One thread is allocating its children, everyone else treats it as a leaf.
+    MCTS_NODE_EXPANDED
+};
+
+typedef struct {
+    Placement placement;            // 8 bytes, edge from the parent.
+    uint32_t first_child;           // 4 bytes, MCTS_NULL_NODE until expanded (or if nothing can be placed).
+    uint32_t next_sibling;          // 4 bytes, also links the free list of the pool.
+    atomic_uint visits;             // 4 bytes
+    atomic_uint virtual_visits;     // 4 bytes, threads currently below this node times the virtual loss.
+    atomic_llong value_sum;         // 8 bytes, MCTS_VALUE_SCALE fixed point.
+    atomic_uchar state;             // 1 byte
+} MctsNode;
+
+typedef struct {
+    thrd_t thread;
+    Mcts* mcts;
+    uint64_t random_state;
+    uint32_t rollouts;
+} MctsWorker;
+
+struct Mcts {
+    MctsSettings settings;
+    MctsWorker* workers;        // Worker 0 is whoever calls search_mcts_placement.
+    // Node pool. Only expansion allocates while searching, so a mutex is cheap enough.
+    Pool node_pool;
+    MctsNode* nodes;            // node_pool.items, so a node index goes straight to the node.
+    uint32_t* release_stack;
+    atomic_bool pool_exhausted;
+    mtx_t pool_mutex;
+    // The tree.
+    uint32_t root;
+    Game root_game;
+    uint64_t origin_score;      // Score when the tree was started. Every return in the tree is measured from here, so reused values stay comparable.
+    uint8_t origin_level_index;
+    bool has_root;
+    uint64_t seed_state;
+    // The search.
+    uint64_t deadline;
+    atomic_uint rollouts;
+    atomic_uint value_min_bits; // Range of returns seen, for normalizing. Stored as float bits.
+    atomic_uint value_max_bits;
+    // Thread pool.
+    mtx_t mutex;
+    cnd_t job_ready;
+    cnd_t job_done;
+    uint32_t job_generation;
+    uint8_t busy_workers;
+    bool quit;
+};
+
+MctsSettings get_default_mcts_settings()
+{
+    MctsSettings settings = {
+        .time_budget = MCTS_DEFAULT_TIME_BUDGET,
+        .max_rollouts = 0,
+        .node_capacity = MCTS_DEFAULT_NODE_CAPACITY,
+        .exploration = MCTS_DEFAULT_EXPLORATION,
+        .rollout_epsilon = MCTS_DEFAULT_ROLLOUT_EPSILON,
+        .rollout_depth = MCTS_DEFAULT_ROLLOUT_DEPTH,
+        .max_children = MCTS_DEFAULT_MAX_CHILDREN,
+        .thread_count = MCTS_DEFAULT_THREAD_COUNT,
+        .virtual_loss = MCTS_DEFAULT_VIRTUAL_LOSS
+    };
+    return settings;
+}
+
+static inline float bits_to_float(const uint32_t bits)
+{
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static inline uint32_t float_to_bits(const float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+// Pool functions. Callers hold pool_mutex while searching; between searches only the calling thread touches the pool.
+
+static uint32_t allocate_node(Mcts* mcts, const Placement placement)
+{
+    const uint32_t index = take_pool_index(&mcts->node_pool);
+    if (index == POOL_NULL_INDEX) return MCTS_NULL_NODE;
+    MctsNode* node = &mcts->nodes[index];
+    node->placement = placement;
+    node->first_child = MCTS_NULL_NODE;
+    node->next_sibling = MCTS_NULL_NODE;
+    atomic_init(&node->visits, 0);
+    atomic_init(&node->virtual_visits, 0);
+    atomic_init(&node->value_sum, 0);
+    atomic_init(&node->state, MCTS_NODE_LEAF);
+    return index;
+}
+
+static void release_subtree(Mcts* mcts, const uint32_t subtree_root)
+{
+    uint32_t stack_size = 0;
+    mcts->release_stack[stack_size++] = subtree_root;
+    while (stack_size)
+    {
+        const uint32_t index = mcts->release_stack[--stack_size];
+        for (uint32_t child = mcts->nodes[index].first_child; child != MCTS_NULL_NODE; child = mcts->nodes[child].next_sibling)
+        {
+            mcts->release_stack[stack_size++] = child;
+        }
+        give_pool_index(&mcts->node_pool, index);
+    }
+    atomic_store_explicit(&mcts->pool_exhausted, false, memory_order_relaxed);
+}
+
+static void release_tree(Mcts* mcts)
+{
+    if (mcts->has_root) release_subtree(mcts, mcts->root);
+    mcts->has_root = false;
+}
+
+// Determinization. The preview is what a player knows, so everything past it in the bags is reshuffled per simulation, and the bags after that come from a fresh random state.
+static void determinize_piece_queue(Game* game, uint64_t* random_state)
+{
+    const uint8_t bag_offset = game->piece_queue_index % PIECE_COUNT;
+    const uint8_t known_length = PIECE_QUEUE_LENGTH - bag_offset; // Past this the current bag has been used up and is yet to be refilled.
+    PieceData* hidden[PIECE_COUNT];
+    uint8_t positions[PIECE_COUNT];
+    uint8_t hidden_count = 0;
+    uint8_t bag = UINT8_MAX;
+    for (uint8_t offset = PIECE_PREVIEW_COUNT; offset <= known_length; offset++)
+    {
+        const uint8_t position = (game->piece_queue_index + offset) % PIECE_QUEUE_LENGTH;
+        if ((offset == known_length || position / PIECE_COUNT != bag) && hidden_count)
+        {
+            for (uint8_t i = hidden_count; i-- > 0;) // Fisher-Yates straight into the queue.
+            {
+                const uint8_t j = (uint8_t)(next_random(random_state) % (i + 1));
+                game->piece_queue[positions[i]] = hidden[j];
+                hidden[j] = hidden[i];
+            }
+            hidden_count = 0;
+        }
+        if (offset == known_length) break;
+        bag = position / PIECE_COUNT;
+        positions[hidden_count] = position;
+        hidden[hidden_count++] = game->piece_queue[position];
+    }
+    game->random_state = next_random(random_state);
+}
+
+// Light rollout policy. Row masks in playfield columns (no wall offset), evaluated top down.
+static float evaluate_rollout_placement(const Playfield* playfield, const Placement* placement, const uint8_t top_row)
+{
+    PlayfieldRow rows[MAX_ROW_COUNT];
+    const PlayfieldRow full_row = get_playfield_full_row(playfield);
+    const PieceCells cells = PIECE_ROTATION_CELLS[placement->type][placement->rotation];
+    const uint8_t top = (placement->pos_y < top_row) ? placement->pos_y : top_row;
+    memcpy(&rows[top], &playfield->cells[top], (playfield->row_count - top) * sizeof(PlayfieldRow));
+    for (uint8_t y = 0; y < PIECE_MAX_SIZE; y++)
+    {
+        const uint64_t piece_row = (cells >> (PIECE_MAX_SIZE * y)) & 0xF;
+        if (piece_row) rows[placement->pos_y + y] |= (PlayfieldRow)((piece_row << placement->pos_x) >> COLUMN_OFFSET);
+    }
+
+    // Clear full rows by compacting the rest downwards.
+    uint8_t cleared = 0;
+    for (int y = playfield->row_count - 1; y >= top; y--)
+    {
+        if (rows[y] == full_row)    cleared++;
+        else if (cleared)           rows[y + cleared] = rows[y];
+    }
+    for (uint8_t y = top; y < top + cleared; y++)
+    {
+        rows[y] = 0;
+    }
+    return 0.76f * LINE_CLEAR_UNITS[cleared] + evaluate_playfield_rows(rows, top + cleared, playfield->row_count, playfield->column_count);
+}
+
+static inline uint8_t get_top_row(const Playfield* playfield)
+{
+    uint8_t top_row = 0;
+    while (top_row < playfield->row_count && !playfield->cells[top_row]) top_row++;
+    return top_row;
+}
+
+// Plays out rollout_depth pieces and returns lines cleared since the tree's origin, plus a little for the board left behind.
+static double run_rollout(MctsWorker* worker, Game* game)
+{
+    const Mcts* mcts = worker->mcts;
+    const float epsilon = (mcts->settings.rollout_epsilon < 1.0f) ? mcts->settings.rollout_epsilon : 1.0f;
+    const uint32_t epsilon_threshold = (uint32_t)(epsilon * (double)UINT32_MAX);
+    Placement placements[MAX_DROP_PLACEMENT_COUNT];
+    bool game_over = is_game_over(game);
+    for (uint8_t i = 0; i < mcts->settings.rollout_depth && !game_over; i++)
+    {
+        const uint16_t count = get_drop_placements(game, false, placements); // Hold is left to the tree, rollouts only need to be cheap and sensible.
+        if (!count)
+        {
+            game_over = true;
+            break;
+        }
+        const uint64_t random = next_random(&worker->random_state);
+        uint16_t chosen = 0;
+        if ((uint32_t)random < epsilon_threshold)
+        {
+            chosen = (uint16_t)((random >> 32) % count);
+        }
+        else
+        {
+            const uint8_t top_row = get_top_row(&game->playfield);
+            float best = -INFINITY;
+            for (uint16_t j = 0; j < count; j++)
+            {
+                const float evaluation = evaluate_rollout_placement(&game->playfield, &placements[j], top_row);
+                if (evaluation > best)
+                {
+                    best = evaluation;
+                    chosen = j;
+                }
+            }
+        }
+        apply_drop_placement(game, placements[chosen]); // Straight from get_drop_placements, so no need to check it again.
+        game_over = is_game_over(game);
+    }
+
+    const double lines = (double)(game->score - mcts->origin_score) / (100.0 * (mcts->origin_level_index + 1));
+    if (game_over) return lines + MCTS_GAME_OVER_RETURN;
+    return lines + MCTS_BOARD_WEIGHT * evaluate_playfield_rows(game->playfield.cells, get_top_row(&game->playfield), game->playfield.row_count, game->playfield.column_count);
+}
+
+// Tree functions.
+
+static bool expand_node(Mcts* mcts, const uint32_t index, const Game* game)
+{
+    MctsNode* node = &mcts->nodes[index];
+    if (atomic_load_explicit(&mcts->pool_exhausted, memory_order_relaxed)) return false;
+    unsigned char expected = MCTS_NODE_LEAF;
+    if (!atomic_compare_exchange_strong_explicit(&node->state, &expected, MCTS_NODE_EXPANDING, memory_order_acquire, memory_order_relaxed)) return false;
+
+    // Children are the rollout policy's favourites, best first. Without the pruning the visits spread over every column and rotation and say nothing.
+    Placement placements[MAX_DROP_PLACEMENT_COUNT];
+    float evaluations[MAX_DROP_PLACEMENT_COUNT];
+    const uint16_t placement_count = get_drop_placements(game, true, placements);
+    const uint8_t top_row = get_top_row(&game->playfield);
+    for (uint16_t i = 0; i < placement_count; i++)
+    {
+        evaluations[i] = evaluate_rollout_placement(&game->playfield, &placements[i], top_row);
+    }
+    const uint8_t count = (placement_count < mcts->settings.max_children) ? (uint8_t)placement_count : mcts->settings.max_children;
+    for (uint8_t i = 0; i < count; i++) // Partial selection sort, count is small.
+    {
+        uint16_t best = i;
+        for (uint16_t j = i + 1; j < placement_count; j++)
+        {
+            if (evaluations[j] > evaluations[best]) best = j;
+        }
+        const Placement placement = placements[best];
+        placements[best] = placements[i];
+        placements[i] = placement;
+        evaluations[best] = evaluations[i];
+    }
+
+    mtx_lock(&mcts->pool_mutex);
+    if (mcts->node_pool.free_count < count)
+    {
+        mtx_unlock(&mcts->pool_mutex);
+        atomic_store_explicit(&mcts->pool_exhausted, true, memory_order_relaxed);
+        atomic_store_explicit(&node->state, MCTS_NODE_LEAF, memory_order_release);
+        return false;
+    }
+    uint32_t first_child = MCTS_NULL_NODE;
+    for (uint8_t i = count; i-- > 0;)
+    {
+        const uint32_t child = allocate_node(mcts, placements[i]);
+        mcts->nodes[child].next_sibling = first_child;
+        first_child = child;
+    }
+    mtx_unlock(&mcts->pool_mutex);
+    node->first_child = first_child;
+    atomic_store_explicit(&node->state, MCTS_NODE_EXPANDED, memory_order_release);
+    return true;
+}
+
+// UCT over normalized mean returns. Virtual visits count as the worst return seen, which is what steers other threads away.
+static uint32_t select_child(const Mcts* mcts, const MctsNode* node, const float value_min, const float value_range)
+{
+    const uint32_t parent_visits = atomic_load_explicit(&node->visits, memory_order_relaxed) + atomic_load_explicit(&node->virtual_visits, memory_order_relaxed);
+    const float log_parent_visits = logf((float)parent_visits + 1.0f);
+    uint32_t best_child = node->first_child;
+    float best = -INFINITY;
+    for (uint32_t index = node->first_child; index != MCTS_NULL_NODE; index = mcts->nodes[index].next_sibling)
+    {
+        const MctsNode* child = &mcts->nodes[index];
+        const uint32_t virtual_visits = atomic_load_explicit(&child->virtual_visits, memory_order_relaxed);
+        const uint32_t visits = atomic_load_explicit(&child->visits, memory_order_relaxed) + virtual_visits;
+        if (!visits) return index;
+        const float value_sum = (float)(atomic_load_explicit(&child->value_sum, memory_order_relaxed) / MCTS_VALUE_SCALE) + virtual_visits * value_min;
+        const float mean = (value_sum / visits - value_min) / value_range;
+        const float score = mean + mcts->settings.exploration * sqrtf(log_parent_visits / visits);
+        if (score > best)
+        {
+            best = score;
+            best_child = index;
+        }
+    }
+    return best_child;
+}
+
+static void update_value_range(Mcts* mcts, const float value)
+{
+    uint32_t bits = atomic_load_explicit(&mcts->value_min_bits, memory_order_relaxed);
+    while (value < bits_to_float(bits) &&
+        !atomic_compare_exchange_weak_explicit(&mcts->value_min_bits, &bits, float_to_bits(value), memory_order_relaxed, memory_order_relaxed));
+    bits = atomic_load_explicit(&mcts->value_max_bits, memory_order_relaxed);
+    while (value > bits_to_float(bits) &&
+        !atomic_compare_exchange_weak_explicit(&mcts->value_max_bits, &bits, float_to_bits(value), memory_order_relaxed, memory_order_relaxed));
+}
+
+static void run_simulation(MctsWorker* worker)
+{
+    Mcts* mcts = worker->mcts;
+    const uint8_t virtual_loss = mcts->settings.virtual_loss;
+    const float value_min = bits_to_float(atomic_load_explicit(&mcts->value_min_bits, memory_order_relaxed));
+    const float value_max = bits_to_float(atomic_load_explicit(&mcts->value_max_bits, memory_order_relaxed));
+    const float value_range = (value_max > value_min) ? value_max - value_min : 1.0f;
+    const float loss_value = (value_max > value_min) ? value_min : 0.0f;
+
+    Game game = mcts->root_game;
+    determinize_piece_queue(&game, &worker->random_state);
+    uint32_t path[MCTS_MAX_TREE_DEPTH + 1];
+    uint8_t path_length = 0;
+    path[path_length++] = mcts->root;
+    bool expanded = false;
+    while (!expanded)
+    {
+        const MctsNode* node = &mcts->nodes[path[path_length - 1]];
+        if (atomic_load_explicit(&node->state, memory_order_acquire) != MCTS_NODE_EXPANDED)
+        {
+            // One new node per simulation. Only plies whose pieces are all in the preview go in the tree, past that the rollout takes over.
+            if (path_length - 1 >= MCTS_MAX_TREE_DEPTH || is_game_over(&game) || !expand_node(mcts, path[path_length - 1], &game)) break;
+            expanded = true;
+        }
+        if (node->first_child == MCTS_NULL_NODE) break; // Nothing fits, the rollout scores it as a loss.
+        const uint32_t child = select_child(mcts, node, loss_value, value_range);
+        atomic_fetch_add_explicit(&mcts->nodes[child].virtual_visits, virtual_loss, memory_order_relaxed);
+        path[path_length++] = child;
+        apply_drop_placement(&game, mcts->nodes[child].placement); // Always valid, everything the tree placed so far was in the preview.
+    }
+
+    const double value = run_rollout(worker, &game);
+    update_value_range(mcts, (float)value);
+    const long long fixed_value = (long long)(value * MCTS_VALUE_SCALE);
+    for (uint8_t i = 0; i < path_length; i++)
+    {
+        MctsNode* node = &mcts->nodes[path[i]];
+        atomic_fetch_add_explicit(&node->value_sum, fixed_value, memory_order_relaxed);
+        atomic_fetch_add_explicit(&node->visits, 1, memory_order_relaxed);
+        if (i > 0) atomic_fetch_sub_explicit(&node->virtual_visits, virtual_loss, memory_order_relaxed);
+    }
+    worker->rollouts++;
+}
+
+static void run_simulations(MctsWorker* worker)
+{
+    Mcts* mcts = worker->mcts;
+    const uint32_t max_rollouts = mcts->settings.max_rollouts;
+    // The calling thread always gets one in, so there is always a root to choose from.
+    do
+    {
+        if (max_rollouts && atomic_fetch_add_explicit(&mcts->rollouts, 1, memory_order_relaxed) >= max_rollouts) break;
+        run_simulation(worker);
+    } while (get_monotonic_nanoseconds() < mcts->deadline);
+}
+
+static int run_mcts_worker(void* arg)
+{
+    MctsWorker* worker = arg;
+    Mcts* mcts = worker->mcts;
+    uint32_t seen_generation = 0;
+    for (;;)
+    {
+        mtx_lock(&mcts->mutex);
+        while (!mcts->quit && mcts->job_generation == seen_generation)
+        {
+            cnd_wait(&mcts->job_ready, &mcts->mutex);
+        }
+        if (mcts->quit)
+        {
+            mtx_unlock(&mcts->mutex);
+            return 0;
+        }
+        seen_generation = mcts->job_generation;
+        mtx_unlock(&mcts->mutex);
+
+        run_simulations(worker);
+
+        mtx_lock(&mcts->mutex);
+        if (--mcts->busy_workers == 0) cnd_signal(&mcts->job_done);
+        mtx_unlock(&mcts->mutex);
+    }
+}
+
+static bool init_mcts_sync(Mcts* mcts)
+{
+    if (mtx_init(&mcts->pool_mutex, mtx_plain) != thrd_success) return false;
+    if (mtx_init(&mcts->mutex, mtx_plain) != thrd_success)
+    {
+        mtx_destroy(&mcts->pool_mutex);
+        return false;
+    }
+    if (cnd_init(&mcts->job_ready) != thrd_success)
+    {
+        mtx_destroy(&mcts->mutex);
+        mtx_destroy(&mcts->pool_mutex);
+        return false;
+    }
+    if (cnd_init(&mcts->job_done) != thrd_success)
+    {
+        cnd_destroy(&mcts->job_ready);
+        mtx_destroy(&mcts->mutex);
+        mtx_destroy(&mcts->pool_mutex);
+        return false;
+    }
+    return true;
+}
+
+Mcts* create_mcts(MctsSettings settings)
+{
+    if (settings.thread_count == 0) settings.thread_count = 1;
+    if (settings.max_children == 0) settings.max_children = 1;
+    if (settings.node_capacity < MAX_DROP_PLACEMENT_COUNT + 1) settings.node_capacity = MAX_DROP_PLACEMENT_COUNT + 1;
+
+    Mcts* mcts = calloc(1, sizeof(Mcts));
+    if (!mcts) return 0;
+    mcts->settings = settings;
+    mcts->workers = calloc(settings.thread_count, sizeof(MctsWorker));
+    mcts->release_stack = malloc(settings.node_capacity * sizeof(uint32_t));
+    if (!mcts->workers || !mcts->release_stack || !init_pool(&mcts->node_pool, sizeof(MctsNode), settings.node_capacity, settings.use_huge_pages))
+    {
+        free(mcts->workers);
+        free(mcts->release_stack);
+        free(mcts);
+        return 0;
+    }
+    mcts->nodes = (MctsNode*)mcts->node_pool.items;
+    mcts->seed_state = MCTS_SEED;
+    if (!init_mcts_sync(mcts))
+    {
+        release_pool(&mcts->node_pool);
+        free(mcts->workers);
+        free(mcts->release_stack);
+        free(mcts);
+        return 0;
+    }
+    for (uint8_t i = 0; i < settings.thread_count; i++)
+    {
+        MctsWorker* worker = &mcts->workers[i];
+        worker->mcts = mcts;
+        if (i > 0 && thrd_create(&worker->thread, run_mcts_worker, worker) != thrd_success)
+        {
+            mcts->settings.thread_count = i; // So destroy_mcts only joins the workers that started.
+            destroy_mcts(mcts);
+            return 0;
+        }
+    }
+    return mcts;
+}
+
+void destroy_mcts(Mcts* mcts)
+{
+    if (!mcts) return;
+    mtx_lock(&mcts->mutex);
+    mcts->quit = true;
+    cnd_broadcast(&mcts->job_ready);
+    mtx_unlock(&mcts->mutex);
+    for (uint8_t i = 1; i < mcts->settings.thread_count; i++)
+    {
+        thrd_join(mcts->workers[i].thread, 0);
+    }
+    cnd_destroy(&mcts->job_done);
+    cnd_destroy(&mcts->job_ready);
+    mtx_destroy(&mcts->mutex);
+    mtx_destroy(&mcts->pool_mutex);
+    free(mcts->release_stack);
+    release_pool(&mcts->node_pool);
+    free(mcts->workers);
+    free(mcts);
+}
+
+// Whether the tree's root still describes this game. The hidden part of the queue is left out since simulations reshuffle it anyway.
+static bool is_same_root_game(const Game* a, const Game* b)
+{
+    if (memcmp(a->playfield.cells, b->playfield.cells, sizeof(PlayfieldCells)) != 0 ||
+        a->score != b->score ||
+        a->placed_piece_count != b->placed_piece_count ||
+        a->controlled_piece.type != b->controlled_piece.type ||
+        a->held_piece != b->held_piece ||
+        a->can_hold_piece != b->can_hold_piece ||
+        a->combo_count != b->combo_count ||
+        a->level_index != b->level_index ||
+        a->setting_bit_flags != b->setting_bit_flags)
+    {
+        return false;
+    }
+    for (uint8_t offset = 0; offset < PIECE_PREVIEW_COUNT; offset++)
+    {
+        if (peek_piece_queue(a, offset) != peek_piece_queue(b, offset)) return false;
+    }
+    return true;
+}
+
+bool search_mcts_placement(Mcts* mcts, const Game* game, Placement* out_placement, MctsSearchStats* optional_out_stats)
+{
+    const uint64_t start = get_monotonic_nanoseconds();
+    if (mcts->has_root && !is_same_root_game(&mcts->root_game, game)) release_tree(mcts);
+    if (!mcts->has_root)
+    {
+        mcts->root = allocate_node(mcts, (Placement){ 0 });
+        mcts->root_game = *game;
+        mcts->origin_score = game->score;
+        mcts->origin_level_index = game->level_index;
+        mcts->has_root = true;
+    }
+    const uint32_t reused_visits = atomic_load_explicit(&mcts->nodes[mcts->root].visits, memory_order_relaxed);
+
+    mcts->deadline = start + mcts->settings.time_budget;
+    atomic_store_explicit(&mcts->rollouts, 0, memory_order_relaxed);
+    atomic_store_explicit(&mcts->value_min_bits, float_to_bits(INFINITY), memory_order_relaxed);
+    atomic_store_explicit(&mcts->value_max_bits, float_to_bits(-INFINITY), memory_order_relaxed);
+    for (uint8_t i = 0; i < mcts->settings.thread_count; i++)
+    {
+        mcts->workers[i].random_state = next_random(&mcts->seed_state);
+        mcts->workers[i].rollouts = 0;
+    }
+
+    mtx_lock(&mcts->mutex);
+    mcts->busy_workers = mcts->settings.thread_count - 1;
+    mcts->job_generation++;
+    cnd_broadcast(&mcts->job_ready);
+    mtx_unlock(&mcts->mutex);
+
+    run_simulations(&mcts->workers[0]);
+
+    mtx_lock(&mcts->mutex);
+    while (mcts->busy_workers)
+    {
+        cnd_wait(&mcts->job_done, &mcts->mutex);
+    }
+    mtx_unlock(&mcts->mutex);
+
+    // Most visited child, ties broken by mean return.
+    const MctsNode* root = &mcts->nodes[mcts->root];
+    const MctsNode* best = 0;
+    for (uint32_t index = root->first_child; index != MCTS_NULL_NODE; index = mcts->nodes[index].next_sibling)
+    {
+        const MctsNode* child = &mcts->nodes[index];
+        const uint32_t visits = atomic_load_explicit(&child->visits, memory_order_relaxed);
+        if (!best)
+        {
+            best = child;
+            continue;
+        }
+        const uint32_t best_visits = atomic_load_explicit(&best->visits, memory_order_relaxed);
+        if (visits > best_visits ||
+            (visits == best_visits && visits && atomic_load_explicit(&child->value_sum, memory_order_relaxed) / visits > atomic_load_explicit(&best->value_sum, memory_order_relaxed) / best_visits))
+        {
+            best = child;
+        }
+    }
+    if (best) *out_placement = best->placement;
+
+    if (optional_out_stats)
+    {
+        optional_out_stats->elapsed = get_monotonic_nanoseconds() - start;
+        optional_out_stats->rollouts = 0;
+        for (uint8_t i = 0; i < mcts->settings.thread_count; i++)
+        {
+            optional_out_stats->rollouts += mcts->workers[i].rollouts;
+        }
+        optional_out_stats->reused_visits = reused_visits;
+        optional_out_stats->tree_node_count = get_pool_taken_count(&mcts->node_pool);
+        optional_out_stats->rollouts_per_second = optional_out_stats->rollouts * (double)NANOSECONDS_PER_SECOND / optional_out_stats->elapsed;
+    }
+    return best != 0;
+}
+
+void advance_mcts(Mcts* mcts, Placement played)
+{
+    if (!mcts->has_root) return;
+    MctsNode* root = &mcts->nodes[mcts->root];
+    uint32_t kept = MCTS_NULL_NODE;
+    for (uint32_t index = root->first_child; index != MCTS_NULL_NODE; index = mcts->nodes[index].next_sibling)
+    {
+        const Placement* placement = &mcts->nodes[index].placement;
+        if (placement->type == played.type && placement->pos_x == played.pos_x && placement->pos_y == played.pos_y &&
+            placement->rotation == played.rotation && placement->use_hold == played.use_hold)
+        {
+            kept = index;
+            break;
+        }
+    }
+    if (kept == MCTS_NULL_NODE || !attempt_apply_placement(&mcts->root_game, played))
+    {
+        release_tree(mcts);
+        return;
+    }
+
+    // Unlink the kept child so releasing the old root leaves it alone.
+    uint32_t* link = &root->first_child;
+    while (*link != kept) link = &mcts->nodes[*link].next_sibling;
+    *link = mcts->nodes[kept].next_sibling;
+    mcts->nodes[kept].next_sibling = MCTS_NULL_NODE;
+    release_subtree(mcts, mcts->root);
+    mcts->root = kept;
+}
+
+AllocatorStats get_mcts_node_stats(const Mcts* mcts)
+{
+    return get_pool_stats(&mcts->node_pool);
+}
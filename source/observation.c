@@ -0,0 +1,165 @@
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OBSERVATION_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "observation.h"
+
+// A whole plane is packed into one contiguous bit stream (bit y * width + x), so expansion runs over 200 cells instead of 20 short rows.
+#define PLANE_WORD_COUNT ((OBSERVATION_PLANE_CELL_COUNT + 63) / 64)
+
+typedef uint64_t PlaneBits[PLANE_WORD_COUNT];
+
+static inline void deposit_plane_row(PlaneBits bits, const uint8_t y, const uint64_t row)
+{
+    const uint32_t bit = (uint32_t)y * OBSERVATION_PLANE_WIDTH;
+    const uint32_t shift = bit & 63;
+    bits[bit >> 6] |= row << shift;
+    if (shift + OBSERVATION_PLANE_WIDTH > 64)
+    {
+        bits[(bit >> 6) + 1] |= row >> (64 - shift);
+    }
+}
+
+static inline void pack_board_plane(const EnvObservation* obs, PlaneBits bits)
+{
+    const uint64_t row_mask = (1ULL << OBSERVATION_PLANE_WIDTH) - 1;
+    for (uint8_t y = 0; y < OBSERVATION_PLANE_HEIGHT; y++)
+    {
+        deposit_plane_row(bits, y, obs->rows[y] & row_mask);
+    }
+}
+
+static inline void pack_piece_plane(const EnvObservation* obs, const uint8_t pos_y, PlaneBits bits)
+{
+    const uint64_t row_mask = (1ULL << OBSERVATION_PLANE_WIDTH) - 1;
+    const PieceCells cells = PIECE_ROTATION_CELLS[obs->piece_type <= PIECE_COUNT ? obs->piece_type : 0][obs->piece_rotation & (PIECE_ROTATION_STATES - 1)];
+    const int column = (int)obs->piece_x - COLUMN_OFFSET;
+    for (uint8_t y = 0; y < PIECE_MAX_SIZE && pos_y + y < OBSERVATION_PLANE_HEIGHT; y++)
+    {
+        uint64_t row = (cells >> (PIECE_MAX_SIZE * y)) & 0xF;
+        row = (column >= 0) ? (row << column) : (row >> -column);
+        deposit_plane_row(bits, pos_y + y, row & row_mask);
+    }
+}
+
+static inline bool get_plane_bit(const PlaneBits bits, const uint32_t i)
+{
+    return (bits[i >> 6] >> (i & 63)) & 1;
+}
+
+// Spreads the low 8 bits of x into 8 bytes of 0 or 1 (bit i into byte i) without branching.
+static inline uint64_t spread_byte_bits(const uint64_t x)
+{
+    const uint64_t t = ((x & 0xFF) * 0x0101010101010101ULL) & 0x8040201008040201ULL;
+    return ((t + 0x7F7F7F7F7F7F7F7FULL) >> 7) & 0x0101010101010101ULL;
+}
+
+static void expand_plane_u8(const PlaneBits bits, uint8_t* out)
+{
+    uint32_t i = 0;
+#ifdef OBSERVATION_SSE2
+    const __m128i bit_mask = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, (char)128, 1, 2, 4, 8, 16, 32, 64, (char)128);
+    const __m128i one = _mm_set1_epi8(1);
+    for (; i + 16 <= OBSERVATION_PLANE_CELL_COUNT; i += 16)
+    {
+        __m128i v = _mm_cvtsi32_si128((int)((bits[i >> 6] >> (i & 63)) & 0xFFFF));
+        v = _mm_unpacklo_epi8(v, v);    // lo lo hi hi ...
+        v = _mm_unpacklo_epi16(v, v);   // lo x4, hi x4 ...
+        v = _mm_unpacklo_epi32(v, v);   // lo x8, hi x8
+        v = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(v, bit_mask), bit_mask), one);
+        _mm_storeu_si128((__m128i*)(out + i), v);
+    }
+#endif // OBSERVATION_SSE2
+    for (; i + 8 <= OBSERVATION_PLANE_CELL_COUNT; i += 8)
+    {
+        const uint64_t bytes = spread_byte_bits(bits[i >> 6] >> (i & 63));
+        memcpy(out + i, &bytes, sizeof(bytes));
+    }
+    for (; i < OBSERVATION_PLANE_CELL_COUNT; i++)
+    {
+        out[i] = get_plane_bit(bits, i);
+    }
+}
+
+static void expand_plane_f32(const PlaneBits bits, float* out)
+{
+    uint32_t i = 0;
+#ifdef OBSERVATION_SSE2
+    const __m128i bit_mask = _mm_setr_epi32(1, 2, 4, 8);
+    const __m128i float_one = _mm_castps_si128(_mm_set1_ps(1.0f));
+    for (; i + 4 <= OBSERVATION_PLANE_CELL_COUNT; i += 4)
+    {
+        const __m128i v = _mm_set1_epi32((int)((bits[i >> 6] >> (i & 63)) & 0xF));
+        const __m128i set = _mm_cmpeq_epi32(_mm_and_si128(v, bit_mask), bit_mask);
+        _mm_storeu_ps(out + i, _mm_castsi128_ps(_mm_and_si128(set, float_one)));
+    }
+#endif // OBSERVATION_SSE2
+    for (; i < OBSERVATION_PLANE_CELL_COUNT; i++)
+    {
+        out[i] = (float)get_plane_bit(bits, i);
+    }
+}
+
+void encode_observation_planes(const EnvObservation* obs, uint32_t n, OBSERVATION_PLANE_BIT_FLAGS plane_bit_flags, ObservationLayout layout, ObservationDType dtype, void* out)
+{
+    const size_t element_size = (dtype == OBSERVATION_DTYPE_FLOAT32) ? sizeof(float) : sizeof(uint8_t);
+    for (uint32_t i = 0; i < n; i++)
+    {
+        PlaneBits planes[OBSERVATION_PLANE_COUNT];
+        uint8_t channel_count = 0;
+        memset(planes, 0, sizeof(planes));
+        if (plane_bit_flags & OBSERVATION_PLANE_BOARD)  pack_board_plane(&obs[i], planes[channel_count++]);
+        if (plane_bit_flags & OBSERVATION_PLANE_ACTIVE) pack_piece_plane(&obs[i], obs[i].piece_y, planes[channel_count++]);
+        if (plane_bit_flags & OBSERVATION_PLANE_GHOST)  pack_piece_plane(&obs[i], obs[i].ghost_y, planes[channel_count++]);
+
+        const size_t observation_elements = (size_t)channel_count * OBSERVATION_PLANE_CELL_COUNT;
+        uint8_t* observation_out = (uint8_t*)out + i * observation_elements * element_size;
+        if (layout == OBSERVATION_LAYOUT_NCHW)
+        {
+            for (uint8_t c = 0; c < channel_count; c++)
+            {
+                if (dtype == OBSERVATION_DTYPE_FLOAT32) expand_plane_f32(planes[c], (float*)observation_out + c * OBSERVATION_PLANE_CELL_COUNT);
+                else                                    expand_plane_u8(planes[c], observation_out + c * OBSERVATION_PLANE_CELL_COUNT);
+            }
+        }
+        else
+        {
+            // Channels are interleaved per cell, so expand every plane with the wide path first and then scatter.
+            uint8_t expanded[OBSERVATION_PLANE_COUNT][OBSERVATION_PLANE_CELL_COUNT];
+            for (uint8_t c = 0; c < channel_count; c++)
+            {
+                expand_plane_u8(planes[c], expanded[c]);
+            }
+            for (uint32_t cell = 0; cell < OBSERVATION_PLANE_CELL_COUNT; cell++)
+            {
+                for (uint8_t c = 0; c < channel_count; c++)
+                {
+                    if (dtype == OBSERVATION_DTYPE_FLOAT32) ((float*)observation_out)[cell * channel_count + c] = (float)expanded[c][cell];
+                    else                                    observation_out[cell * channel_count + c] = expanded[c][cell];
+                }
+            }
+        }
+    }
+}
+
+void encode_observation_one_hot(const EnvObservation* obs, uint32_t n, ObservationDType dtype, void* out)
+{
+    const size_t element_size = (dtype == OBSERVATION_DTYPE_FLOAT32) ? sizeof(float) : sizeof(uint8_t);
+    memset(out, 0, (size_t)n * OBSERVATION_ONE_HOT_SIZE * element_size);
+    for (uint32_t i = 0; i < n; i++)
+    {
+        uint8_t slot_types[OBSERVATION_PIECE_SLOT_COUNT];
+        slot_types[0] = obs[i].held_type;
+        memcpy(&slot_types[1], obs[i].queue, PIECE_PREVIEW_COUNT);
+        for (uint8_t slot = 0; slot < OBSERVATION_PIECE_SLOT_COUNT; slot++)
+        {
+            if (slot_types[slot] == 0 || slot_types[slot] > PIECE_COUNT) continue;
+            const size_t index = (size_t)i * OBSERVATION_ONE_HOT_SIZE + slot * PIECE_COUNT + (slot_types[slot] - 1);
+            if (dtype == OBSERVATION_DTYPE_FLOAT32) ((float*)out)[index] = 1.0f;
+            else                                    ((uint8_t*)out)[index] = 1;
+        }
+    }
+}
@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mapped_file.h"
+#include "opening_book.h"
+
+struct OpeningBook {
+    MappedFile file;
+    const uint8_t* slots;
+    uint32_t slot_mask;
+    OpeningBookInfo info;
+};
+
+static inline void write_le(uint8_t* out, uint64_t value, uint8_t size)
+{
+    for (uint8_t i = 0; i < size; i++)
+    {
+        out[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static inline uint64_t read_le(const uint8_t* in, uint8_t size)
+{
+    uint64_t value = 0;
+    for (uint8_t i = 0; i < size; i++)
+    {
+        value |= (uint64_t)in[i] << (8 * i);
+    }
+    return value;
+}
+
+// The SplitMix64 finalizer over each word, so keys are spread well enough to index the table with their low bits.
+static inline uint64_t mix_key(uint64_t key, uint64_t value)
+{
+    key = (key ^ value) * 0xBF58476D1CE4E5B9ULL;
+    return key ^ (key >> 31);
+}
+
+uint64_t get_opening_book_key(const Game* game)
+{
+    const Playfield* playfield = &game->playfield;
+    // The empty rows on top are only counted, so an opening board hashes a handful of rows instead of all of them.
+    uint8_t y = 0;
+    while (y < playfield->row_count && !playfield->cells[y]) y++;
+    uint64_t key = mix_key(0x9E3779B97F4A7C15ULL, y);
+    for (; y < playfield->row_count; y++)
+    {
+        key = mix_key(key, playfield->cells[y]);
+    }
+    uint64_t pieces = (uint64_t)game->controlled_piece.type | (uint64_t)((game->held_piece) ? game->held_piece->type : 0) << 4;
+    uint8_t queue_index = game->piece_queue_index;
+    for (uint8_t i = 0; i < PIECE_PREVIEW_COUNT; i++)
+    {
+        pieces |= (uint64_t)game->piece_queue[queue_index]->type << (8 + 4 * i); // peek_piece_queue, without the call and the modulo.
+        queue_index = (queue_index + 1 < PIECE_QUEUE_LENGTH) ? queue_index + 1 : 0;
+    }
+    pieces |= (uint64_t)game->can_hold_piece << 28 | (uint64_t)((game->setting_bit_flags & SETTING_CAN_HOLD) != 0) << 29 | (uint64_t)game->combo_count << 32 |
+        (uint64_t)playfield->row_count << 40 | (uint64_t)playfield->column_count << 48 | (uint64_t)playfield->ceiling << 56;
+    key = mix_key(key, pieces);
+    return key ? key : 1;
+}
+
+bool write_opening_book(const char* path, const OpeningBookEntry* entries, uint32_t entry_count, uint8_t plies, uint16_t beam_width, uint8_t depth)
+{
+    uint32_t slot_count = 1;
+    while (slot_count < 2 * (uint64_t)entry_count && slot_count < (1U << 31)) slot_count <<= 1;
+    if (entry_count >= slot_count) return false;
+    const size_t size = OPENING_BOOK_HEADER_SIZE + (size_t)slot_count * OPENING_BOOK_SLOT_SIZE;
+    uint8_t* data = calloc(1, size);
+    if (!data) return false;
+    memcpy(data, OPENING_BOOK_MAGIC, 4);
+    write_le(&data[4], OPENING_BOOK_VERSION, 2);
+    data[6] = (uint8_t)(8 * sizeof(PlayfieldRow));
+    data[7] = plies;
+    write_le(&data[8], slot_count, 4);
+    write_le(&data[12], entry_count, 4);
+    write_le(&data[16], beam_width, 2);
+    data[18] = depth;
+    uint8_t* slots = &data[OPENING_BOOK_HEADER_SIZE];
+    for (uint32_t i = 0; i < entry_count; i++)
+    {
+        const OpeningBookEntry* entry = &entries[i];
+        uint32_t index = (uint32_t)entry->key & (slot_count - 1);
+        while (read_le(&slots[(size_t)index * OPENING_BOOK_SLOT_SIZE], 8)) index = (index + 1) & (slot_count - 1);
+        uint8_t* slot = &slots[(size_t)index * OPENING_BOOK_SLOT_SIZE];
+        write_le(slot, entry->key, 8);
+        slot[8] = (uint8_t)entry->placement.type;
+        slot[9] = entry->placement.pos_x;
+        slot[10] = entry->placement.pos_y;
+        slot[11] = entry->placement.rotation;
+        slot[12] = entry->placement.use_hold;
+        slot[13] = entry->completed_depth;
+    }
+    FILE* file = fopen(path, "wb");
+    bool written = file && fwrite(data, 1, size, file) == size;
+    if (file) written &= fclose(file) == 0;
+    free(data);
+    return written;
+}
+
+OpeningBook* open_opening_book(const char* path)
+{
+    OpeningBook* book = calloc(1, sizeof(OpeningBook));
+    if (!book) return 0;
+    if (!map_file(path, false, &book->file))
+    {
+        free(book);
+        return 0;
+    }
+    const uint8_t* data = book->file.data;
+    const size_t size = book->file.size;
+    if (size < OPENING_BOOK_HEADER_SIZE || memcmp(data, OPENING_BOOK_MAGIC, 4) != 0 || read_le(&data[4], 2) != OPENING_BOOK_VERSION ||
+        data[6] != 8 * sizeof(PlayfieldRow))
+    {
+        close_opening_book(book);
+        return 0;
+    }
+    book->info = (OpeningBookInfo){
+        .slot_count = (uint32_t)read_le(&data[8], 4),
+        .entry_count = (uint32_t)read_le(&data[12], 4),
+        .beam_width = (uint16_t)read_le(&data[16], 2),
+        .depth = data[18],
+        .plies = data[7]
+    };
+    // A table with no empty slot would never end a miss, and every slot has to be inside the file.
+    const uint32_t slot_count = book->info.slot_count;
+    if (!slot_count || (slot_count & (slot_count - 1)) || book->info.entry_count >= slot_count ||
+        size != OPENING_BOOK_HEADER_SIZE + (size_t)slot_count * OPENING_BOOK_SLOT_SIZE)
+    {
+        close_opening_book(book);
+        return 0;
+    }
+    book->slots = &data[OPENING_BOOK_HEADER_SIZE];
+    book->slot_mask = slot_count - 1;
+    return book;
+}
+
+void close_opening_book(OpeningBook* book)
+{
+    if (!book) return;
+    unmap_file(&book->file);
+    free(book);
+}
+
+OpeningBookInfo get_opening_book_info(const OpeningBook* book)
+{
+    return book->info;
+}
+
+bool find_opening_book_placement(const OpeningBook* book, const Game* game, Placement* out_placement, uint8_t* optional_out_completed_depth)
+{
+    const uint64_t key = get_opening_book_key(game);
+    uint32_t index = (uint32_t)key & book->slot_mask;
+    // Bounded by the table size as well, in case a damaged file has no empty slot after all.
+    for (uint32_t probe = 0; probe <= book->slot_mask; probe++)
+    {
+        const uint8_t* slot = &book->slots[(size_t)index * OPENING_BOOK_SLOT_SIZE];
+        const uint64_t slot_key = read_le(slot, 8);
+        if (!slot_key) return false;
+        if (slot_key == key)
+        {
+            *out_placement = (Placement){
+                .type = (PieceType)slot[8],
+                .pos_x = slot[9],
+                .pos_y = slot[10],
+                .rotation = slot[11],
+                .use_hold = slot[12] != 0
+            };
+            if (optional_out_completed_depth) *optional_out_completed_depth = slot[13];
+            return true;
+        }
+        index = (index + 1) & book->slot_mask;
+    }
+    return false;
+}
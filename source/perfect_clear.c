@@ -0,0 +1,701 @@
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+#include "perfect_clear.h"
+#include "trace.h"
+#include "util.h"
+
+#define BAND_MAX_ROWS       (PERFECT_CLEAR_MAX_HEIGHT + PIECE_MAX_SIZE) // The lines of the clear, with room above them for a piece to come in.
+#define STATE_WIDTH         (MAX_COLUMN_COUNT + COLUMN_OFFSET)         // Every pos_x a piece can have.
+#define STATE_COUNT         (PIECE_ROTATION_STATES * BAND_MAX_ROWS * STATE_WIDTH)
+#define NODES_PER_CLOCK     16                                          // Nodes between looks at the clock.
+#define NO_BRANCH           UINT32_MAX
+
+typedef enum {
+    SEARCH_DEAD,            // No clear from here.
+    SEARCH_FOUND,
+    SEARCH_ABORTED          // Out of time, or an earlier branch already has a clear.
+} SearchResult;
+
+// A piece that can be placed from a node, and what the node looks like after.
+typedef struct {
+    PieceType type;
+    uint8_t sequence_index;
+    uint8_t held_type;
+    bool use_hold;
+} PerfectClearOption;
+
+// Where a piece can lock, and the cells it covers in the packed board. pos_y is in band rows until it is written out.
+typedef struct {
+    uint64_t mask;
+    Placement placement;
+} PerfectClearMove;
+
+// A placement of the first piece and the node it leads to. The unit of work threads take.
+typedef struct {
+    uint64_t field;
+    Placement placement;
+    uint8_t height;
+    uint8_t sequence_index;
+    uint8_t held_type;
+} PerfectClearBranch;
+
+typedef struct {
+    thrd_t thread;
+    PerfectClearSolver* solver;
+    PerfectClearMove* moves;                // STATE_COUNT per depth, so each depth keeps its moves while the ones below it are tried.
+    Placement path[PERFECT_CLEAR_MAX_PIECES];
+    uint8_t path_length;
+    uint32_t branch;                        // Being searched.
+    uint32_t clock_countdown;
+    uint64_t visited_nodes;
+    uint64_t pruned_nodes;
+    uint64_t memo_hits;
+    // Breadth first search over (x, y, rotation) for one node's moves.
+    uint64_t band[BAND_MAX_ROWS];           // Rows with the walls set, in the same coordinates as pos_x.
+    uint32_t stamps[STATE_COUNT];           // Visited if equal to stamp, so nothing is cleared between searches.
+    uint16_t queue[STATE_COUNT];
+    uint32_t stamp;
+} PerfectClearWorker;
+
+struct PerfectClearSolver {
+    PerfectClearSettings settings;
+    PerfectClearWorker* workers;            // Worker 0 is whoever calls solve_perfect_clear.
+    atomic_ullong* memo;                    // Packed nodes with no clear, 0 for an empty entry.
+    uint32_t memo_mask;
+    PerfectClearBranch* branches;
+    uint32_t branch_count;
+    // The height being solved.
+    uint64_t deadline;
+    atomic_uint next_branch;
+    atomic_uint best_branch;                // Lowest branch with a clear, NO_BRANCH until there is one.
+    atomic_bool out_of_time;
+    Placement solution[PERFECT_CLEAR_MAX_PIECES];
+    uint8_t solution_length;
+    // The game being solved.
+    PieceType sequence[1 + PIECE_COUNT];    // Controlled piece, then the queue.
+    uint8_t sequence_length;
+    uint8_t row_count;
+    uint8_t column_count;
+    bool can_hold;
+    uint64_t row_mask;                      // Every column of one packed row.
+    uint64_t even_column_mask;              // Every packed cell in an even column.
+    uint64_t column_masks[PERFECT_CLEAR_MAX_CELLS];
+    // Thread pool.
+    mtx_t mutex;
+    cnd_t job_ready;
+    cnd_t job_done;
+    uint32_t job_generation;
+    uint8_t busy_workers;
+    bool quit;
+};
+
+PerfectClearSettings get_default_perfect_clear_settings()
+{
+    PerfectClearSettings settings = {
+        .time_budget = PERFECT_CLEAR_DEFAULT_TIME_BUDGET,
+        .memo_size = PERFECT_CLEAR_DEFAULT_MEMO_SIZE,
+        .max_pieces = PERFECT_CLEAR_MAX_PIECES,
+        .max_height = 4,
+        .queue_length = PIECE_PREVIEW_COUNT,
+        .thread_count = PERFECT_CLEAR_DEFAULT_THREAD_COUNT
+    };
+    return settings;
+}
+
+static inline uint16_t get_state_index(uint8_t pos_x, uint8_t pos_y, uint8_t rotation)
+{
+    return (uint16_t)(((uint32_t)rotation * BAND_MAX_ROWS + pos_y) * STATE_WIDTH + pos_x);
+}
+
+// The packed board is a row of column_count bits per line, the bottom line first.
+static inline uint64_t get_region_mask(const PerfectClearSolver* solver, uint8_t height)
+{
+    return (height * solver->column_count >= 64) ? ~0ULL : (1ULL << (height * solver->column_count)) - 1;
+}
+
+static uint64_t clear_packed_lines(const PerfectClearSolver* solver, uint64_t field, uint8_t* height)
+{
+    const uint8_t column_count = solver->column_count;
+    for (uint8_t row = *height; row-- > 0;)
+    {
+        if (((field >> (row * column_count)) & solver->row_mask) != solver->row_mask) continue;
+        const uint64_t below = field & ((1ULL << (row * column_count)) - 1);
+        field = below | ((field >> ((row + 1) * column_count)) << (row * column_count));
+        (*height)--;
+    }
+    return field;
+}
+
+// The SplitMix64 finalizer, so keys that differ in a few cells land far apart.
+static inline uint32_t get_memo_index(const PerfectClearSolver* solver, uint64_t key)
+{
+    key = (key ^ (key >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    key = (key ^ (key >> 27)) * 0x94D049BB133111EBULL;
+    return (uint32_t)(key ^ (key >> 31)) & solver->memo_mask;
+}
+
+// Never 0, since a node that is still being searched has at least one line.
+static inline uint64_t get_memo_key(uint64_t field, uint8_t height, uint8_t held_type)
+{
+    return field | (uint64_t)height << PERFECT_CLEAR_MAX_CELLS | (uint64_t)held_type << (PERFECT_CLEAR_MAX_CELLS + 3);
+}
+
+// Whether the pieces can make up the difference between empty cells in even and odd columns. See perfect_clear.h.
+static inline bool can_balance_columns(int difference, const uint8_t type_counts[PIECE_COUNT + 1])
+{
+    const int half = (difference < 0) ? -difference / 2 : difference / 2;
+    const int i_count = type_counts[I_TYPE];
+    const int t_count = type_counts[T_TYPE];
+    const int jl_count = type_counts[J_TYPE] + type_counts[L_TYPE];
+    if (half > 2 * i_count + t_count + jl_count) return false;
+    return t_count > 0 || ((half - jl_count) & 1) == 0;
+}
+
+// Cheap checks on the packed board that rule a node out before any of its moves are searched.
+static bool is_node_hopeless(const PerfectClearSolver* solver, uint64_t field, uint8_t height, uint8_t sequence_index, uint8_t held_type, uint8_t depth)
+{
+    const uint64_t empty = ~field & get_region_mask(solver, height);
+    const uint8_t empty_count = count_set_bits_64(empty);
+    const uint8_t needed = empty_count / PIECE_CELL_COUNT;
+    // Every placement takes a piece of the sequence. The held one can go last without its replacement being known.
+    const uint8_t known = solver->sequence_length - sequence_index + (held_type ? 1 : 0);
+    if (depth + needed > solver->settings.max_pieces || needed > known) return true;
+
+    uint8_t left_empty_count = 0;
+    for (uint8_t x = 0; x < solver->column_count; x++)
+    {
+        const uint64_t column = empty & solver->column_masks[x];
+        if (!column && (left_empty_count % PIECE_CELL_COUNT)) return true;
+        left_empty_count += count_set_bits_64(column);
+    }
+
+    if (solver->column_count & 1) return false; // A line clear takes one more from one side, so nothing is kept.
+    const int difference = 2 * count_set_bits_64(empty & solver->even_column_mask) - empty_count;
+    // The pieces placed are the first needed of the held piece and the sequence, or the first needed + 1 less the one held at the end.
+    uint8_t pieces[PERFECT_CLEAR_MAX_PIECES + 1];
+    uint8_t piece_count = 0;
+    if (held_type) pieces[piece_count++] = held_type;
+    for (uint8_t i = sequence_index; i < solver->sequence_length && piece_count <= needed; i++)
+    {
+        pieces[piece_count++] = solver->sequence[i];
+    }
+    uint8_t type_counts[PIECE_COUNT + 1] = { 0 };
+    for (uint8_t i = 0; i < piece_count; i++)
+    {
+        type_counts[pieces[i]]++;
+    }
+    if (piece_count == needed + 1)
+    {
+        uint8_t tried_types = 0;
+        for (uint8_t i = 0; i < piece_count; i++)
+        {
+            if (tried_types & (1 << pieces[i])) continue;
+            tried_types |= 1 << pieces[i];
+            type_counts[pieces[i]]--;
+            const bool can_balance = can_balance_columns(difference, type_counts);
+            type_counts[pieces[i]]++;
+            if (can_balance) return false;
+        }
+        return true;
+    }
+    return !can_balance_columns(difference, type_counts);
+}
+
+// The rows of a piece in each rotation, and the first and last that have cells, so collision skips the empty ones.
+typedef struct {
+    uint64_t rows[PIECE_ROTATION_STATES][PIECE_MAX_SIZE];
+    uint8_t top[PIECE_ROTATION_STATES];
+    uint8_t bottom[PIECE_ROTATION_STATES];
+    const PieceRotationWallKicks* rotation_wall_kicks;
+    PieceType type;
+    PieceSize size;
+} BandPiece;
+
+static BandPiece get_band_piece(PieceType type)
+{
+    const PieceData* piece_data = get_piece_data(type);
+    BandPiece piece = { .rotation_wall_kicks = piece_data->rotation_wall_kicks, .type = type, .size = piece_data->size };
+    for (uint8_t rotation = 0; rotation < PIECE_ROTATION_STATES; rotation++)
+    {
+        piece.top[rotation] = PIECE_MAX_SIZE;
+        for (uint8_t y = 0; y < PIECE_MAX_SIZE; y++)
+        {
+            piece.rows[rotation][y] = (PIECE_ROTATION_CELLS[type][rotation] >> (PIECE_MAX_SIZE * y)) & 0xF;
+            if (!piece.rows[rotation][y]) continue;
+            if (piece.top[rotation] == PIECE_MAX_SIZE) piece.top[rotation] = y;
+            piece.bottom[rotation] = y;
+        }
+    }
+    return piece;
+}
+
+static inline bool is_band_colliding(const PerfectClearWorker* worker, uint8_t band_rows, const BandPiece* piece, uint8_t rotation, int pos_x, int pos_y)
+{
+    if (pos_x < 0 || pos_y < 0 || pos_x > 64 - PIECE_MAX_SIZE || pos_y + piece->bottom[rotation] >= band_rows) return true;
+    for (uint8_t y = piece->top[rotation]; y <= piece->bottom[rotation]; y++)
+    {
+        if ((piece->rows[rotation][y] << pos_x) & worker->band[pos_y + y]) return true;
+    }
+    return false;
+}
+
+// Same tests in the same order as attempt_rotate_piece, so the piece ends up where tick would put it.
+static bool rotate_band_state(const PerfectClearWorker* worker, uint8_t band_rows, const BandPiece* piece, bool clockwise, uint8_t* pos_x, uint8_t* pos_y, uint8_t* rotation)
+{
+    const uint8_t rotation_tests_index = *rotation + (clockwise ? 1 : 0);
+    const uint8_t next_rotation = (*rotation + PIECE_ROTATION_STATES + (clockwise ? 1 : -1)) & (PIECE_ROTATION_STATES - 1);
+    for (uint8_t test_index = 0; test_index < PIECE_ROTATION_TESTS; test_index++)
+    {
+        int8_t x_wall_kick = 0;
+        int8_t y_wall_kick = 0;
+        if (test_index > 0)
+        {
+            const WallKick wall_kick = (*(piece->rotation_wall_kicks))[rotation_tests_index][test_index - 1];
+            x_wall_kick = UNPACK_X(wall_kick);
+            y_wall_kick = -UNPACK_Y(wall_kick); // Flip sign since board is "upside down".
+        }
+        if (!is_band_colliding(worker, band_rows, piece, next_rotation, *pos_x + x_wall_kick, *pos_y + y_wall_kick))
+        {
+            *pos_x = (uint8_t)(*pos_x + x_wall_kick);
+            *pos_y = (uint8_t)(*pos_y + y_wall_kick);
+            *rotation = next_rotation;
+            return true;
+        }
+    }
+    return false;
+}
+
+static inline void visit_band_state(PerfectClearWorker* worker, uint32_t* tail, uint8_t pos_x, uint8_t pos_y, uint8_t rotation)
+{
+    const uint16_t index = get_state_index(pos_x, pos_y, rotation);
+    if (worker->stamps[index] == worker->stamp) return;
+    worker->stamps[index] = worker->stamp;
+    worker->queue[(*tail)++] = index;
+}
+
+// Every place the piece can lock inside the lines, each set of cells once, lowest cells first so the stack fills from the bottom.
+// Breadth first from spawn over slides, soft drops to the ground and rotations. Returns how many.
+static uint32_t generate_moves(PerfectClearWorker* worker, uint64_t field, uint8_t height, PieceType type, bool use_hold, PerfectClearMove* out_moves)
+{
+    const PerfectClearSolver* solver = worker->solver;
+    const uint8_t column_count = solver->column_count;
+    const uint8_t band_rows = height + PIECE_MAX_SIZE;
+    const uint64_t walls = ~(solver->row_mask << COLUMN_OFFSET);
+    for (uint8_t y = 0; y < band_rows; y++)
+    {
+        const uint8_t row = band_rows - 1 - y;
+        worker->band[y] = walls | ((y < PIECE_MAX_SIZE) ? 0 : ((field >> (row * column_count)) & solver->row_mask) << COLUMN_OFFSET);
+    }
+
+    const BandPiece piece = get_band_piece(type);
+    const uint8_t spawn_x = column_count / 2 - piece.size / 2 + COLUMN_OFFSET;
+    if (is_band_colliding(worker, band_rows, &piece, 0, spawn_x, 0)) return 0;
+    worker->stamp++;
+    uint32_t head = 0;
+    uint32_t tail = 0;
+    uint32_t move_count = 0;
+    visit_band_state(worker, &tail, spawn_x, 0, 0);
+    while (head < tail)
+    {
+        const uint16_t index = worker->queue[head++];
+        const uint8_t pos_x = (uint8_t)(index % STATE_WIDTH);
+        const uint8_t pos_y = (uint8_t)((index / STATE_WIDTH) % BAND_MAX_ROWS);
+        const uint8_t rotation = (uint8_t)(index / (STATE_WIDTH * BAND_MAX_ROWS));
+        uint8_t ground_y = pos_y;
+        while (!is_band_colliding(worker, band_rows, &piece, rotation, pos_x, ground_y + 1)) ground_y++;
+
+        // Resting. Only a piece wholly inside the lines can be part of the clear.
+        if (ground_y == pos_y && pos_y + piece.top[rotation] >= PIECE_MAX_SIZE)
+        {
+            uint64_t mask = 0;
+            for (uint8_t y = piece.top[rotation]; y <= piece.bottom[rotation]; y++)
+            {
+                mask |= (piece.rows[rotation][y] << pos_x >> COLUMN_OFFSET) << ((band_rows - 1 - pos_y - y) * column_count);
+            }
+            uint32_t slot = move_count;
+            while (slot > 0 && out_moves[slot - 1].mask > mask) slot--;
+            if (slot == 0 || out_moves[slot - 1].mask != mask)
+            {
+                memmove(&out_moves[slot + 1], &out_moves[slot], (move_count - slot) * sizeof(PerfectClearMove));
+                out_moves[slot] = (PerfectClearMove){ mask, { type, pos_x, pos_y, rotation, use_hold } };
+                move_count++;
+            }
+        }
+
+        for (int8_t direction = -1; direction <= 1; direction += 2)
+        {
+            if (!is_band_colliding(worker, band_rows, &piece, rotation, pos_x + direction, pos_y)) visit_band_state(worker, &tail, (uint8_t)(pos_x + direction), pos_y, rotation);
+        }
+        if (ground_y != pos_y) visit_band_state(worker, &tail, pos_x, ground_y, rotation);
+        for (uint8_t clockwise = 0; clockwise < PIECE_ROTATION_DIRECTIONS && piece.size != NONE_2X2; clockwise++)
+        {
+            uint8_t next_x = pos_x;
+            uint8_t next_y = pos_y;
+            uint8_t next_rotation = rotation;
+            if (rotate_band_state(worker, band_rows, &piece, clockwise, &next_x, &next_y, &next_rotation)) visit_band_state(worker, &tail, next_x, next_y, next_rotation);
+        }
+    }
+    return move_count;
+}
+
+// What can be placed next: the piece that came out, the held one, or with nothing held the one after.
+static uint8_t get_options(const PerfectClearSolver* solver, uint8_t sequence_index, uint8_t held_type, bool can_hold, uint8_t needed, PerfectClearOption out_options[2])
+{
+    uint8_t count = 0;
+    if (sequence_index >= solver->sequence_length)
+    {
+        // The held piece can still go last, for a piece out of view. What is held after doesn't matter.
+        if (can_hold && held_type && needed == 1) out_options[count++] = (PerfectClearOption){ held_type, sequence_index, 0, true };
+        return count;
+    }
+    const PieceType active_type = solver->sequence[sequence_index];
+    out_options[count++] = (PerfectClearOption){ active_type, sequence_index + 1, held_type, false };
+    if (!can_hold) return count;
+    if (held_type)
+    {
+        if (held_type != active_type) out_options[count++] = (PerfectClearOption){ held_type, sequence_index + 1, active_type, true };
+    }
+    else if (sequence_index + 1 < solver->sequence_length)
+    {
+        out_options[count++] = (PerfectClearOption){ solver->sequence[sequence_index + 1], sequence_index + 2, active_type, true };
+    }
+    return count;
+}
+
+static inline Placement get_game_placement(const PerfectClearSolver* solver, Placement placement, uint8_t height)
+{
+    placement.pos_y = (uint8_t)(placement.pos_y + solver->row_count - (height + PIECE_MAX_SIZE));
+    return placement;
+}
+
+static SearchResult search_node(PerfectClearWorker* worker, uint64_t field, uint8_t height, uint8_t sequence_index, uint8_t held_type, uint8_t depth)
+{
+    PerfectClearSolver* solver = worker->solver;
+    if (height == 0)
+    {
+        worker->path_length = depth;
+        return SEARCH_FOUND;
+    }
+    if (--worker->clock_countdown == 0)
+    {
+        worker->clock_countdown = NODES_PER_CLOCK;
+        if (get_monotonic_nanoseconds() > solver->deadline) atomic_store_explicit(&solver->out_of_time, true, memory_order_relaxed);
+    }
+    if (atomic_load_explicit(&solver->out_of_time, memory_order_relaxed) ||
+        atomic_load_explicit(&solver->best_branch, memory_order_relaxed) < worker->branch)
+    {
+        return SEARCH_ABORTED;
+    }
+    worker->visited_nodes++;
+    if (is_node_hopeless(solver, field, height, sequence_index, held_type, depth))
+    {
+        worker->pruned_nodes++;
+        return SEARCH_DEAD;
+    }
+    const uint64_t key = get_memo_key(field, height, held_type);
+    atomic_ullong* memo_entry = &solver->memo[get_memo_index(solver, key)];
+    if (atomic_load_explicit(memo_entry, memory_order_relaxed) == key)
+    {
+        worker->memo_hits++;
+        return SEARCH_DEAD;
+    }
+
+    const uint8_t needed = (uint8_t)((height * solver->column_count - count_set_bits_64(field)) / PIECE_CELL_COUNT);
+    PerfectClearOption options[2];
+    const uint8_t option_count = get_options(solver, sequence_index, held_type, solver->can_hold, needed, options);
+    PerfectClearMove* moves = &worker->moves[(size_t)depth * STATE_COUNT];
+    for (uint8_t o = 0; o < option_count; o++)
+    {
+        const PerfectClearOption* option = &options[o];
+        const uint32_t move_count = generate_moves(worker, field, height, option->type, option->use_hold, moves);
+        for (uint32_t m = 0; m < move_count; m++)
+        {
+            uint8_t next_height = height;
+            const uint64_t next_field = clear_packed_lines(solver, field | moves[m].mask, &next_height);
+            worker->path[depth] = get_game_placement(solver, moves[m].placement, height);
+            const SearchResult result = search_node(worker, next_field, next_height, option->sequence_index, option->held_type, depth + 1);
+            if (result != SEARCH_DEAD) return result;
+        }
+    }
+    atomic_store_explicit(memo_entry, key, memory_order_relaxed);
+    return SEARCH_DEAD;
+}
+
+static void search_branches(PerfectClearWorker* worker)
+{
+    TRACE_BEGIN("perfect clear search");
+    PerfectClearSolver* solver = worker->solver;
+    worker->clock_countdown = NODES_PER_CLOCK;
+    for (;;)
+    {
+        const uint32_t index = atomic_fetch_add_explicit(&solver->next_branch, 1, memory_order_relaxed);
+        if (index >= solver->branch_count || index > atomic_load_explicit(&solver->best_branch, memory_order_relaxed) ||
+            atomic_load_explicit(&solver->out_of_time, memory_order_relaxed))
+        {
+            break;
+        }
+        const PerfectClearBranch* branch = &solver->branches[index];
+        worker->branch = index;
+        worker->path[0] = branch->placement;
+        if (search_node(worker, branch->field, branch->height, branch->sequence_index, branch->held_type, 1) != SEARCH_FOUND) continue;
+        mtx_lock(&solver->mutex);
+        if (index < atomic_load_explicit(&solver->best_branch, memory_order_relaxed))
+        {
+            atomic_store_explicit(&solver->best_branch, index, memory_order_relaxed);
+            memcpy(solver->solution, worker->path, worker->path_length * sizeof(Placement));
+            solver->solution_length = worker->path_length;
+        }
+        mtx_unlock(&solver->mutex);
+    }
+    TRACE_END("perfect clear search");
+}
+
+static int run_perfect_clear_worker(void* arg)
+{
+    PerfectClearWorker* worker = arg;
+    PerfectClearSolver* solver = worker->solver;
+    uint32_t seen_generation = 0;
+    set_trace_thread_name("perfect clear worker");
+    for (;;)
+    {
+        mtx_lock(&solver->mutex);
+        while (!solver->quit && solver->job_generation == seen_generation)
+        {
+            cnd_wait(&solver->job_ready, &solver->mutex);
+        }
+        if (solver->quit)
+        {
+            mtx_unlock(&solver->mutex);
+            return 0;
+        }
+        seen_generation = solver->job_generation;
+        mtx_unlock(&solver->mutex);
+
+        search_branches(worker);
+
+        mtx_lock(&solver->mutex);
+        if (--solver->busy_workers == 0) cnd_signal(&solver->job_done);
+        mtx_unlock(&solver->mutex);
+    }
+}
+
+static void free_perfect_clear_solver(PerfectClearSolver* solver)
+{
+    for (uint8_t i = 0; solver->workers && i < solver->settings.thread_count; i++)
+    {
+        free(solver->workers[i].moves);
+    }
+    free(solver->branches);
+    free(solver->memo);
+    free(solver->workers);
+    free(solver);
+}
+
+// Joins workers 1 to started_count - 1. Worker 0 is the calling thread.
+static void stop_perfect_clear_workers(PerfectClearSolver* solver, uint8_t started_count)
+{
+    mtx_lock(&solver->mutex);
+    solver->quit = true;
+    cnd_broadcast(&solver->job_ready);
+    mtx_unlock(&solver->mutex);
+    for (uint8_t i = 1; i < started_count; i++)
+    {
+        thrd_join(solver->workers[i].thread, 0);
+    }
+}
+
+PerfectClearSolver* create_perfect_clear_solver(PerfectClearSettings settings)
+{
+    if (settings.thread_count == 0) settings.thread_count = 1;
+    if (settings.max_pieces == 0 || settings.max_pieces > PERFECT_CLEAR_MAX_PIECES) settings.max_pieces = PERFECT_CLEAR_MAX_PIECES;
+    if (settings.max_height == 0 || settings.max_height > PERFECT_CLEAR_MAX_HEIGHT) settings.max_height = PERFECT_CLEAR_MAX_HEIGHT;
+    if (settings.queue_length > PIECE_COUNT) settings.queue_length = PIECE_COUNT;
+    uint32_t memo_size = 1;
+    while (memo_size < settings.memo_size && memo_size < (1U << 31)) memo_size <<= 1;
+    settings.memo_size = memo_size;
+
+    PerfectClearSolver* solver = calloc(1, sizeof(PerfectClearSolver));
+    if (!solver) return 0;
+    solver->settings = settings;
+    solver->memo_mask = memo_size - 1;
+    solver->workers = calloc(settings.thread_count, sizeof(PerfectClearWorker));
+    solver->memo = calloc(memo_size, sizeof(atomic_ullong));
+    solver->branches = calloc(2 * STATE_COUNT, sizeof(PerfectClearBranch));
+    bool failed = !solver->workers || !solver->memo || !solver->branches;
+    for (uint8_t i = 0; i < settings.thread_count && !failed; i++)
+    {
+        solver->workers[i].moves = malloc((size_t)PERFECT_CLEAR_MAX_PIECES * STATE_COUNT * sizeof(PerfectClearMove));
+        failed |= !solver->workers[i].moves;
+    }
+    const bool has_mutex = !failed && mtx_init(&solver->mutex, mtx_plain) == thrd_success;
+    const bool has_job_ready = has_mutex && cnd_init(&solver->job_ready) == thrd_success;
+    const bool has_job_done = has_job_ready && cnd_init(&solver->job_done) == thrd_success;
+    if (!has_job_done)
+    {
+        if (has_job_ready) cnd_destroy(&solver->job_ready);
+        if (has_mutex) mtx_destroy(&solver->mutex);
+        free_perfect_clear_solver(solver);
+        return 0;
+    }
+    for (uint8_t i = 0; i < settings.thread_count; i++)
+    {
+        PerfectClearWorker* worker = &solver->workers[i];
+        worker->solver = solver;
+        if (i > 0 && thrd_create(&worker->thread, run_perfect_clear_worker, worker) != thrd_success)
+        {
+            stop_perfect_clear_workers(solver, i);
+            cnd_destroy(&solver->job_done);
+            cnd_destroy(&solver->job_ready);
+            mtx_destroy(&solver->mutex);
+            free_perfect_clear_solver(solver);
+            return 0;
+        }
+    }
+    return solver;
+}
+
+void destroy_perfect_clear_solver(PerfectClearSolver* solver)
+{
+    if (!solver) return;
+    stop_perfect_clear_workers(solver, solver->settings.thread_count);
+    cnd_destroy(&solver->job_done);
+    cnd_destroy(&solver->job_ready);
+    mtx_destroy(&solver->mutex);
+    free_perfect_clear_solver(solver);
+}
+
+void cancel_perfect_clear_search(PerfectClearSolver* solver)
+{
+    atomic_store_explicit(&solver->out_of_time, true, memory_order_relaxed);
+}
+
+// Searches for a clear over exactly height lines. The first piece's placements become the branches the threads share.
+static PerfectClearStatus solve_height(PerfectClearSolver* solver, uint64_t field, uint8_t height, uint8_t held_type, bool root_can_hold)
+{
+    if (is_node_hopeless(solver, field, height, 0, held_type, 0)) return PERFECT_CLEAR_IMPOSSIBLE;
+    for (uint32_t i = 0; i <= solver->memo_mask; i++)
+    {
+        atomic_store_explicit(&solver->memo[i], 0, memory_order_relaxed);
+    }
+    PerfectClearWorker* worker = &solver->workers[0];
+    const uint8_t needed = (uint8_t)((height * solver->column_count - count_set_bits_64(field)) / PIECE_CELL_COUNT);
+    PerfectClearOption options[2];
+    const uint8_t option_count = get_options(solver, 0, held_type, root_can_hold, needed, options);
+    solver->branch_count = 0;
+    for (uint8_t o = 0; o < option_count; o++)
+    {
+        const uint32_t move_count = generate_moves(worker, field, height, options[o].type, options[o].use_hold, worker->moves);
+        for (uint32_t m = 0; m < move_count; m++)
+        {
+            PerfectClearBranch* branch = &solver->branches[solver->branch_count++];
+            branch->height = height;
+            branch->field = clear_packed_lines(solver, field | worker->moves[m].mask, &branch->height);
+            branch->placement = get_game_placement(solver, worker->moves[m].placement, height);
+            branch->sequence_index = options[o].sequence_index;
+            branch->held_type = options[o].held_type;
+        }
+    }
+
+    atomic_store_explicit(&solver->next_branch, 0, memory_order_relaxed);
+    atomic_store_explicit(&solver->best_branch, NO_BRANCH, memory_order_relaxed);
+    mtx_lock(&solver->mutex);
+    solver->busy_workers = solver->settings.thread_count - 1;
+    solver->job_generation++;
+    cnd_broadcast(&solver->job_ready);
+    mtx_unlock(&solver->mutex);
+
+    search_branches(worker);
+
+    mtx_lock(&solver->mutex);
+    while (solver->busy_workers)
+    {
+        cnd_wait(&solver->job_done, &solver->mutex);
+    }
+    mtx_unlock(&solver->mutex);
+
+    if (atomic_load_explicit(&solver->best_branch, memory_order_relaxed) != NO_BRANCH) return PERFECT_CLEAR_FOUND;
+    return atomic_load_explicit(&solver->out_of_time, memory_order_relaxed) ? PERFECT_CLEAR_TIMED_OUT : PERFECT_CLEAR_IMPOSSIBLE;
+}
+
+PerfectClearStatus solve_perfect_clear(PerfectClearSolver* solver, const Game* game, PerfectClearSolution* out_solution, PerfectClearStats* optional_out_stats)
+{
+    TRACE_BEGIN("perfect clear");
+    const uint64_t start = get_monotonic_nanoseconds();
+    const PerfectClearSettings* settings = &solver->settings;
+    const Playfield* playfield = &game->playfield;
+    solver->deadline = start + settings->time_budget;
+    atomic_store_explicit(&solver->out_of_time, false, memory_order_relaxed);
+    for (uint8_t i = 0; i < settings->thread_count; i++)
+    {
+        PerfectClearWorker* worker = &solver->workers[i];
+        worker->visited_nodes = worker->pruned_nodes = worker->memo_hits = 0;
+    }
+
+    solver->row_count = playfield->row_count;
+    solver->column_count = playfield->column_count;
+    solver->can_hold = (game->setting_bit_flags & SETTING_CAN_HOLD) != 0;
+    solver->sequence_length = 1 + settings->queue_length;
+    solver->sequence[0] = game->controlled_piece.type;
+    for (uint8_t i = 0; i < settings->queue_length; i++)
+    {
+        solver->sequence[1 + i] = peek_piece_queue(game, i)->type;
+    }
+    const uint8_t held_type = (game->held_piece) ? (uint8_t)game->held_piece->type : 0;
+    const bool root_can_hold = solver->can_hold && game->can_hold_piece;
+
+    // Packs the bottom lines, and finds how many of them have cells.
+    const uint8_t column_count = playfield->column_count;
+    const uint8_t packed_rows = (column_count <= PERFECT_CLEAR_MAX_CELLS) ? PERFECT_CLEAR_MAX_CELLS / column_count : 0;
+    solver->row_mask = (1ULL << column_count) - 1;
+    solver->even_column_mask = 0;
+    memset(solver->column_masks, 0, sizeof(solver->column_masks));
+    uint64_t field = 0;
+    uint8_t stack_height = 0;
+    for (uint8_t row = 0; row < playfield->row_count; row++)
+    {
+        const PlayfieldRow cells = playfield->cells[playfield->row_count - 1 - row];
+        if (cells) stack_height = row + 1;
+        if (row >= packed_rows) continue;
+        field |= ((uint64_t)cells & solver->row_mask) << (row * column_count);
+        for (uint8_t x = 0; x < column_count; x++)
+        {
+            solver->column_masks[x] |= 1ULL << (row * column_count + x);
+            if (!(x & 1)) solver->even_column_mask |= 1ULL << (row * column_count + x);
+        }
+    }
+    const uint8_t filled_count = count_set_bits_64(field);
+
+    PerfectClearStatus status = PERFECT_CLEAR_IMPOSSIBLE;
+    for (uint8_t height = (stack_height) ? stack_height : 1; height <= settings->max_height && height <= packed_rows; height++)
+    {
+        if (height + PIECE_MAX_SIZE > playfield->row_count) break;
+        const uint8_t empty_count = height * column_count - filled_count;
+        if (empty_count / PIECE_CELL_COUNT > settings->max_pieces) break;
+        if (empty_count % PIECE_CELL_COUNT) continue;
+        status = solve_height(solver, field, height, held_type, root_can_hold);
+        if (status == PERFECT_CLEAR_FOUND)
+        {
+            memcpy(out_solution->placements, solver->solution, solver->solution_length * sizeof(Placement));
+            out_solution->placement_count = solver->solution_length;
+            out_solution->height = height;
+        }
+        if (status != PERFECT_CLEAR_IMPOSSIBLE) break;
+    }
+
+    if (optional_out_stats)
+    {
+        *optional_out_stats = (PerfectClearStats){ .elapsed = get_monotonic_nanoseconds() - start };
+        for (uint8_t i = 0; i < settings->thread_count; i++)
+        {
+            const PerfectClearWorker* worker = &solver->workers[i];
+            optional_out_stats->visited_nodes += worker->visited_nodes;
+            optional_out_stats->pruned_nodes += worker->pruned_nodes;
+            optional_out_stats->memo_hits += worker->memo_hits;
+        }
+    }
+    TRACE_END("perfect clear");
+    return status;
+}
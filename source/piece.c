@@ -43,6 +43,21 @@ const PieceData* get_piece_data(const PieceType piece_type)
     }
 }
 
+uint8_t get_piece_unique_rotation_count(const PieceType piece_type)
+{
+    switch (piece_type)
+    {
+    case O_TYPE:
+        return 1;
+    case I_TYPE:
+    case S_TYPE:
+    case Z_TYPE:
+        return 2; // The other two rotations land on the same cells, one column or row over.
+    default:
+        return PIECE_ROTATION_STATES;
+    }
+}
+
 // PieceData related functions.
 void copy_data_into_piece(Piece* piece, PieceData* const piece_data)
 {
@@ -183,6 +198,18 @@ const PieceData* ALL_PIECE_DATA[PIECE_COUNT] = {
     &L_DATA
 };
 
+// Precomputed with get_rotated_piece_cells, so hot paths don't have to rotate cell by cell.
+const PieceCells PIECE_ROTATION_CELLS[PIECE_COUNT + 1][PIECE_ROTATION_STATES] = {
+    { 0x0000, 0x0000, 0x0000, 0x0000 }, // None
+    { 0x00F0, 0x4444, 0x0F00, 0x2222 }, // I
+    { 0x0033, 0x0033, 0x0033, 0x0033 }, // O
+    { 0x0072, 0x0262, 0x0270, 0x0232 }, // T
+    { 0x0036, 0x0462, 0x0360, 0x0231 }, // S
+    { 0x0063, 0x0264, 0x0630, 0x0132 }, // Z
+    { 0x0071, 0x0226, 0x0470, 0x0322 }, // J
+    { 0x0074, 0x0622, 0x0170, 0x0223 }  // L
+};
+
 const PieceRotationWallKicks WALL_KICKS_TSZJL = {
     // State: 0
     {   // Left rotation: 0->L
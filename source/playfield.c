@@ -1,6 +1,7 @@
 #include <stdlib.h>
 
 #include "playfield.h"
+#include "util.h"
 
 bool is_outside_bounds(const Playfield* playfield, const uint8_t pos_x, const uint8_t pos_y)
 {
@@ -9,7 +10,7 @@ bool is_outside_bounds(const Playfield* playfield, const uint8_t pos_x, const ui
 
 bool is_playfield_cell(const Playfield* playfield, const uint8_t pos_x, const uint8_t pos_y)
 {
-    return is_outside_bounds(playfield, pos_x, pos_y) || (playfield->cells[pos_y] & (1U << (pos_x - COLUMN_OFFSET)));
+    return is_outside_bounds(playfield, pos_x, pos_y) || (playfield->cells[pos_y] & ((PlayfieldRow)1 << (pos_x - COLUMN_OFFSET)));
 }
 
 bool are_cells_above_ceiling(const Playfield* playfield)
@@ -21,24 +22,58 @@ bool are_cells_above_ceiling(const Playfield* playfield)
 	return false;
 }
 
-bool attempt_add_playfield_cell_at(Playfield* playfield, const uint8_t pos_x, const uint8_t pos_y)
+bool attempt_add_playfield_cell_at(Playfield* playfield, const uint8_t pos_x, const uint8_t pos_y, const uint8_t cell_type)
 {
 	if (!is_outside_bounds(playfield, pos_x, pos_y))
 	{
-		playfield->cells[pos_y] |= (1U << (pos_x - COLUMN_OFFSET));
+		playfield->cells[pos_y] |= ((PlayfieldRow)1 << (pos_x - COLUMN_OFFSET));
+		set_playfield_row_cell_types(playfield, pos_y, (PlayfieldRow)1 << (pos_x - COLUMN_OFFSET), cell_type);
         return true;
 	}
     return false;
 }
 
+void set_playfield_row_cell_types(Playfield* playfield, const uint8_t pos_y, const PlayfieldRow row_mask, const uint8_t cell_type)
+{
+    for (uint8_t i = 0; i < CELL_TYPE_PLANE_COUNT; i++)
+    {
+        // Branchless: all ones or all zeros depending on bit i of the type.
+        const PlayfieldRow bit = (PlayfieldRow)0 - ((cell_type >> i) & 1U);
+        playfield->type_planes[i][pos_y] = (playfield->type_planes[i][pos_y] & ~row_mask) | (bit & row_mask);
+    }
+}
+
+uint8_t get_playfield_cell_type(const Playfield* playfield, const uint8_t pos_x, const uint8_t pos_y)
+{
+    if (is_outside_bounds(playfield, pos_x, pos_y)) return 0;
+    const uint8_t x = pos_x - COLUMN_OFFSET;
+    uint8_t cell_type = 0;
+    for (uint8_t i = 0; i < CELL_TYPE_PLANE_COUNT; i++)
+    {
+        cell_type |= ((playfield->type_planes[i][pos_y] >> x) & 1U) << i;
+    }
+    return cell_type;
+}
+
+PlayfieldRow get_playfield_full_row(const Playfield* playfield)
+{
+    // In two steps, so a row as wide as PlayfieldRow doesn't shift by its own width.
+    return (playfield->column_count) ? (((PlayfieldRow)1 << (playfield->column_count - 1)) << 1) - 1 : 0;
+}
+
 // TODO: Change this to filled lines (or others to filled rows).
 uint8_t clear_filled_lines(Playfield* playfield, const uint8_t pos_y)
 {
     uint8_t y = (pos_y > playfield->row_count) ? playfield->row_count : pos_y;
 
-    const uint32_t mask = (1U << playfield->column_count) - 1;
+    // Rows above the stack are empty and only ever move onto other empty rows, so the scan stops at its top and the rows the
+    // stack came down from are emptied after.
+    uint8_t top_row = 0;
+    while (top_row < y && !playfield->cells[top_row]) top_row++;
+
+    const PlayfieldRow mask = get_playfield_full_row(playfield);
     uint8_t rows_cleared = 0;
-    for (; y > 0; y--)
+    for (; y > top_row; y--)
     {
         if (playfield->cells[y - 1] == mask)
         {
@@ -47,9 +82,81 @@ uint8_t clear_filled_lines(Playfield* playfield, const uint8_t pos_y)
         else if (rows_cleared)
         {
             playfield->cells[y - 1 + rows_cleared] = playfield->cells[y - 1];
-            playfield->cells[y - 1] = 0;
+            for (uint8_t i = 0; i < CELL_TYPE_PLANE_COUNT; i++)
+            {
+                playfield->type_planes[i][y - 1 + rows_cleared] = playfield->type_planes[i][y - 1];
+            }
+        }
+    }
+    for (y = top_row; y < top_row + rows_cleared; y++)
+    {
+        playfield->cells[y] = 0;
+        for (uint8_t i = 0; i < CELL_TYPE_PLANE_COUNT; i++)
+        {
+            playfield->type_planes[i][y] = 0;
         }
     }
     playfield->lines_cleared += rows_cleared;
     return rows_cleared;
-}
\ No newline at end of file
+}
+
+uint8_t clear_filled_piece_rows(Playfield* playfield, const uint8_t pos_y, const uint8_t size)
+{
+    const uint8_t bottom = (pos_y + size > playfield->row_count) ? playfield->row_count : pos_y + size;
+    const PlayfieldRow mask = get_playfield_full_row(playfield);
+
+    // Which piece rows filled is close to random, so they are compacted without a branch on it: each is copied down to the
+    // write row, which only moves up past rows that stay.
+    uint8_t write_y = bottom;
+    for (uint8_t y = bottom; y > pos_y; y--)
+    {
+        const PlayfieldRow row = playfield->cells[y - 1];
+        playfield->cells[write_y - 1] = row;
+        for (uint8_t i = 0; i < CELL_TYPE_PLANE_COUNT; i++)
+        {
+            playfield->type_planes[i][write_y - 1] = playfield->type_planes[i][y - 1];
+        }
+        write_y -= (row != mask);
+    }
+    const uint8_t rows_cleared = write_y - pos_y;
+
+    // The stack above the piece moves down as a block. It ends at the first empty row: in a game every row of the stack holds
+    // something, since a piece always locks resting on the rows under it and clears move the rows above along with it.
+    uint8_t top_row = pos_y;
+    for (; top_row > 0 && playfield->cells[top_row - 1]; top_row--)
+    {
+        playfield->cells[top_row - 1 + rows_cleared] = playfield->cells[top_row - 1];
+        for (uint8_t i = 0; i < CELL_TYPE_PLANE_COUNT; i++)
+        {
+            playfield->type_planes[i][top_row - 1 + rows_cleared] = playfield->type_planes[i][top_row - 1];
+        }
+    }
+    for (uint8_t y = top_row; y < top_row + rows_cleared; y++)
+    {
+        playfield->cells[y] = 0;
+        for (uint8_t i = 0; i < CELL_TYPE_PLANE_COUNT; i++)
+        {
+            playfield->type_planes[i][y] = 0;
+        }
+    }
+    playfield->lines_cleared += rows_cleared;
+    return rows_cleared;
+}
+
+// Aggregate height, holes and bumpiness without ever building column heights, summed a row at a time.
+float evaluate_playfield_rows(const PlayfieldRow* rows, const uint8_t top_row, const uint8_t row_count, const uint8_t column_count)
+{
+    const PlayfieldRow neighbour_mask = (PlayfieldRow)((1ULL << (column_count - 1)) - 1);
+    PlayfieldRow covered = 0;
+    uint32_t aggregate_height = 0;
+    uint32_t holes = 0;
+    uint32_t bumpiness = 0;
+    for (uint8_t y = top_row; y < row_count; y++)
+    {
+        covered |= rows[y];
+        aggregate_height += count_row_set_bits(covered);                                // Columns whose top is at or above this row.
+        holes += count_row_set_bits(covered & ~rows[y]);
+        bumpiness += count_row_set_bits((covered ^ (covered >> 1)) & neighbour_mask);   // Neighbours where only one of the two reaches this row.
+    }
+    return -0.51f * aggregate_height - 0.36f * holes - 0.18f * bumpiness;
+}
@@ -1,14 +1,42 @@
+#include <stdatomic.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
 
+#include "advisor.h"
+#include "bot.h"
+#include "clock.h"
 #include "game.h"
 #include "engine.h"
+#include "finesse.h"
+#include "opening_book.h"
+#include "perfect_clear.h"
+#include "rewind.h"
+#include "trace.h"
+#include "triple_buffer.h"
+#include "versus.h"
 #include "raylib.h"
 #define RAYGUI_IMPLEMENTATION
 #include "raygui.h"
+#include "zetris_logo.h" // Generated by CMake from ZETRIS_LOGO.png.
 
 #define SCREEN_WIDTH	800
 #define SCREEN_HEIGHT	450
 #define TARGET_FPS		60
+#define FRAME_SAMPLE_COUNT	240	// Frames the overlay's percentiles and averages are over.
+#define SPECTATOR_DEFAULT_MATCH_COUNT	32	// Two boards each, so 64 on the wall.
+#define SPECTATOR_MAX_MATCH_COUNT	32	// Up and Down double and halve the matches, from one up to this.
+#define SPECTATOR_STEP_INTERVAL		(NANOSECONDS_PER_SECOND / TARGET_FPS)	// The stepping thread's pace, a step a frame.
+#define SPECTATOR_STEPS_PER_PIECE	6	// Matches take turns, so only a slice of them search on any one step.
+#define SPECTATOR_RESULT_STEPS		90	// How long a finished match stays up before the next one starts.
+#define SPECTATOR_BOARD_GAP			1	// Empty texels between boards.
+#define TRACE_PATH					"zetris_trace.json"	// Unless ZETRIS_TRACE says otherwise.
+#define OPENING_BOOK_PATH			"zetris_book.zbk"	// From zetris-book. Played without searching while the advisor finds the position in it.
+#define PERFECT_CLEAR_HINT_TIME_BUDGET	(100 * NANOSECONDS_PER_MILLISECOND)	// Per piece. Solved off the render thread, so it can take several frames.
+#if defined(DEBUG) || defined(_DEBUG) || !defined(NDEBUG)
+#define PRINT_STARTUP_TIMES
+#endif // DEBUG
 
 // Source: https://youtu.be/w0FSHNzSr_M?si=FdDbWrEIgIq2gdsi
 #if defined(_WIN32) && !defined(_DEBUG)
@@ -21,13 +49,100 @@ const Vector2	HELD_PIECE_SIZE = { 200.0f, 200.0f };
 const Vector2	PIECE_QUEUE_SIZE = { 200.0f, 200.0f };
 const Vector2	PAUSE_CONTINUE_BUTTON_SIZE = { 215.0f, 75.0f };
 const Vector2	RESTART_BUTTON_SIZE = { 215.0f, 75.0f };
+const float		PAUSE_LOGO_SCALE = 0.5f;
+const float		MAX_RESUME_FRAME_TIME = 1.0f / TARGET_FPS;
 Vector2			PLAYFIELD_START;
 Vector2			PLAYFIELD_SIZE; 
 Vector2			HELD_PIECE_START;
 Vector2			PIECE_QUEUE_START;
 bool			isPaused = false;
 bool			pressedEscapeLastTick = false;
-//uint8_t PIECE_BUFFER[VISIBLE_ROW_COUNT][VISIBLE_COLUMN_COUNT]; // TODO: colors
+bool			isBotPlaying = false;
+bool			isHintShown = false;
+bool			isFinesseShown = false;
+bool			isPerfectClearShown = false;
+BotAdvisor*		advisor;
+OpeningBook*	openingBook;		// 0 if there is no book file.
+uint32_t		adviceSnapshotId;	// Newest snapshot sent to the advisor, so advice for older pieces is ignored.
+BotController	botController;
+RewindRing*		rewindRing;
+FinessePlanner*	finessePlanner;
+FinesseTracker	finesseTracker;		// Zeroed to start counting again from the next tick.
+Texture2D		logoTexture;
+PerfectClearAdvisor*	perfectClearAdvisor;
+uint32_t				perfectClearSnapshotId;	// Newest snapshot sent to the perfect clear advisor, like adviceSnapshotId.
+
+// Bot matches side by side. A thread of its own plays them and hands a copy over after every step, so no search ever holds up a frame.
+// Every board is a block of texels in one texture, a texel per cell, so the whole wall is one upload and one draw.
+typedef struct {
+	uint32_t matchCount;
+	// Stepping thread only.
+	VersusMatch* matches;
+	uint32_t* finishedSteps;
+	Bot* bot;
+	uint64_t nextSeed;
+	uint32_t step;
+	// Stepping thread to render thread, matchCount matches each.
+	VersusMatch* shownMatches[3];
+	TripleBuffer shownSlots;
+	thrd_t thread;
+	atomic_bool isStepping;	// Only while the wall is shown, so the matches wait while the game is played, like the game waits for them.
+	atomic_bool quit;
+	// Render thread only.
+	Color* texels;
+	Texture2D texture;
+	Rectangle destination;
+	int columns;	// Boards across. Even, so both boards of a match share a row.
+	int boardWidth;	// Texels, gap included.
+	int boardHeight;
+} SpectatorWall;
+
+typedef enum {
+	PACING_FIXED,		// SetTargetFPS: sleeps (and spins) the rest of each frame.
+	PACING_VSYNC,		// Swaps wait for the display.
+	PACING_UNCAPPED		// No waiting at all, lowest latency and highest power.
+} PacingMode;
+
+typedef struct {
+	PacingMode mode;
+	int fps;
+} PacingOption;
+
+// F2 cycles through these. The first is what the client always did.
+const PacingOption PACING_OPTIONS[] = {
+	{ PACING_FIXED, TARGET_FPS },
+	{ PACING_FIXED, 120 },
+	{ PACING_FIXED, 144 },
+	{ PACING_FIXED, 240 },
+	{ PACING_VSYNC, 0 },
+	{ PACING_UNCAPPED, 0 }
+};
+#define PACING_OPTION_COUNT (sizeof(PACING_OPTIONS) / sizeof(PACING_OPTIONS[0]))
+
+// Nanosecond timings of the last FRAME_SAMPLE_COUNT frames, written round robin.
+typedef struct {
+	uint64_t frameTimes[FRAME_SAMPLE_COUNT];	// EndDrawing to EndDrawing
+	uint64_t tickTimes[FRAME_SAMPLE_COUNT];		// Game tick, bot controller, rewind recording and advisor snapshots
+	uint64_t renderTimes[FRAME_SAMPLE_COUNT];	// BeginDrawing until EndDrawing is called
+	uint64_t presentTimes[FRAME_SAMPLE_COUNT];	// EndDrawing: flush, swap, pacing wait and input polling
+	uint64_t frameEnd;
+	uint64_t renderStart;
+	uint64_t tickTime;
+	uint32_t index;
+	uint32_t count;
+} FrameStats;
+
+uint8_t			pacingOptionIndex = 0;
+bool			isIdleEventWaiting = true;	// Paused and game over screens only redraw on input.
+bool			isEventWaitingEnabled = false;
+bool			wasIdleLastFrame = false;
+bool			isOverlayShown = false;
+FrameStats		frameStats;
+SpectatorWall*	spectatorWall;
+bool			isSpectating = false;
+// Indexed by PieceType, which is also what the playfield type planes hold. 0 is a cell without a known type.
+const Color		PIECE_COLORS[PIECE_COUNT + 1] = { LIGHTGRAY, SKYBLUE, YELLOW, PURPLE, GREEN, RED, BLUE, ORANGE };
+const float		GHOST_PIECE_ALPHA = 0.35f;
 
 uint8_t GetActionBitFlags()
 {
@@ -42,6 +157,89 @@ uint8_t GetActionBitFlags()
 	return inputBitFlags;
 }
 
+// The search runs on the advisor's thread, so the piece just waits (and falls) until the advice for it is final.
+uint8_t GetBotActionBitFlags(const Game* game)
+{
+	adviceSnapshotId = update_bot_advisor_game(advisor, game);
+	BotAdvice advice;
+	if (needs_bot_controller_target(&botController, game) && get_bot_advice(advisor, &advice) &&
+		advice.snapshot_id == adviceSnapshotId && advice.is_final && advice.has_placement)
+	{
+		set_bot_controller_target(&botController, game, advice.placement);
+	}
+	return get_bot_controller_action_bit_flags(&botController, game);
+}
+
+void DrawPlacementOutline(const Game* game, Placement placement, Color color)
+{
+	const PieceCells cells = PIECE_ROTATION_CELLS[placement.type][placement.rotation];
+	const uint8_t size = get_piece_data(placement.type)->size;
+	for (uint8_t y = 0; y < size; y++)
+	{
+		for (uint8_t x = 0; x < size; x++)
+		{
+			if (!is_piece_cell(cells, x, y) || placement.pos_y + y < game->playfield.ceiling) continue;
+			DrawRectangleLines(
+				PLAYFIELD_START.x + (placement.pos_x + x - COLUMN_OFFSET) * CELL_SIZE,
+				PLAYFIELD_START.y + (placement.pos_y + y - game->playfield.ceiling) * CELL_SIZE,
+				CELL_SIZE, CELL_SIZE, color);
+		}
+	}
+}
+
+// Outlines where the advisor would put the piece. It refines while you look, one ply at a time.
+void DrawAdviceHint(const Game* game)
+{
+	BotAdvice advice;
+	if (!get_bot_advice(advisor, &advice) || advice.snapshot_id != adviceSnapshotId || !advice.has_placement) return;
+	const Placement placement = advice.placement;
+	DrawPlacementOutline(game, placement, PIECE_COLORS[placement.type]);
+	DrawText(
+		TextFormat("HINT%s depth %d, %.1f ms", placement.use_hold ? " (hold)" : "", advice.completed_depth, advice.elapsed / 1e6),
+		PLAYFIELD_START.x + PLAYFIELD_SIZE.x,
+		PLAYFIELD_START.y + PIECE_QUEUE_SIZE.y + 80,
+		10,
+		advice.is_final ? WHITE : LIGHTGRAY
+	);
+}
+
+// Outlines the first piece of a perfect clear with the pieces in view, if there is one. The solve runs on the advisor's thread,
+// so this only draws its answer for the current piece once there is one.
+void DrawPerfectClearHint(const Game* game)
+{
+	PerfectClearAdvice advice;
+	if (!perfectClearAdvisor || !get_perfect_clear_advice(perfectClearAdvisor, &advice) || advice.snapshot_id != perfectClearSnapshotId) return;
+	const char* text = "NO PC in view";
+	if (advice.status == PERFECT_CLEAR_FOUND)
+	{
+		const Placement placement = advice.solution.placements[0];
+		DrawPlacementOutline(game, placement, GOLD);
+		text = TextFormat("PC%s in %d pieces, %d lines", placement.use_hold ? " (hold)" : "", advice.solution.placement_count, advice.solution.height);
+	}
+	else if (advice.status == PERFECT_CLEAR_TIMED_OUT)
+	{
+		text = "PC search timed out";
+	}
+	DrawText(
+		TextFormat("%s, %.1f ms", text, advice.stats.elapsed / 1e6),
+		PLAYFIELD_START.x + PLAYFIELD_SIZE.x,
+		PLAYFIELD_START.y + PIECE_QUEUE_SIZE.y + 100,
+		10,
+		(advice.status == PERFECT_CLEAR_FOUND) ? GOLD : LIGHTGRAY
+	);
+}
+
+// Presses for the last piece against the fewest that put it there, and the running count of pieces that took more.
+void DrawFinesse()
+{
+	const char* text = finesseTracker.piece_count ?
+		TextFormat("FINESSE %u/%u faults, last %u keys (needed %u)", finesseTracker.fault_count, finesseTracker.piece_count,
+			finesseTracker.last_key_count, finesseTracker.last_optimal_key_count) :
+		"FINESSE place a piece";
+	DrawText(text, PLAYFIELD_START.x + PLAYFIELD_SIZE.x, PLAYFIELD_START.y + PIECE_QUEUE_SIZE.y + 95, 10,
+		(finesseTracker.piece_count && finesseTracker.is_last_fault) ? RED : WHITE);
+}
+
 void DrawPlayfieldAndPiece(const Game* game)
 {
 	DrawRectangle(PLAYFIELD_START.x, PLAYFIELD_START.y, PLAYFIELD_SIZE.x, PLAYFIELD_SIZE.y, DARKGRAY);
@@ -59,17 +257,17 @@ void DrawPlayfieldAndPiece(const Game* game)
 				controlledYAdjusted >= 0 && controlledYAdjusted < game->controlled_piece.size &&
 				is_piece_cell(game->controlled_piece.cells, controlledXAdjusted, controlledYAdjusted))
 			{
-				DrawRectangle(PLAYFIELD_START.x + (x - COLUMN_OFFSET) * CELL_SIZE, PLAYFIELD_START.y + (y - game->playfield.ceiling) * CELL_SIZE, CELL_SIZE, CELL_SIZE, RED);
+				DrawRectangle(PLAYFIELD_START.x + (x - COLUMN_OFFSET) * CELL_SIZE, PLAYFIELD_START.y + (y - game->playfield.ceiling) * CELL_SIZE, CELL_SIZE, CELL_SIZE, PIECE_COLORS[game->controlled_piece.type]);
 			}
 			else if (controlledXAdjusted >= 0 && controlledXAdjusted < game->controlled_piece.size &&
 				ghostYAdjusted >= 0 && ghostYAdjusted < game->controlled_piece.size &&
 				is_piece_cell(game->controlled_piece.cells, controlledXAdjusted, ghostYAdjusted))
 			{
-				DrawRectangle(PLAYFIELD_START.x + (x - COLUMN_OFFSET) * CELL_SIZE, PLAYFIELD_START.y + (y - game->playfield.ceiling) * CELL_SIZE, CELL_SIZE, CELL_SIZE, ORANGE);
+				DrawRectangle(PLAYFIELD_START.x + (x - COLUMN_OFFSET) * CELL_SIZE, PLAYFIELD_START.y + (y - game->playfield.ceiling) * CELL_SIZE, CELL_SIZE, CELL_SIZE, Fade(PIECE_COLORS[game->controlled_piece.type], GHOST_PIECE_ALPHA));
 			}
 			else if (is_playfield_cell(&game->playfield, x, y))
 			{
-				DrawRectangle(PLAYFIELD_START.x + (x - COLUMN_OFFSET) * CELL_SIZE, PLAYFIELD_START.y + (y - game->playfield.ceiling) * CELL_SIZE, CELL_SIZE, CELL_SIZE, YELLOW);
+				DrawRectangle(PLAYFIELD_START.x + (x - COLUMN_OFFSET) * CELL_SIZE, PLAYFIELD_START.y + (y - game->playfield.ceiling) * CELL_SIZE, CELL_SIZE, CELL_SIZE, PIECE_COLORS[get_playfield_cell_type(&game->playfield, x, y)]);
 			}
 		}
 	}
@@ -87,7 +285,7 @@ void DrawPieceQueue(const Game* game)
 			{
 				if (is_piece_cell(next_piece->cells, x, y))
 				{
-					DrawRectangle(PIECE_QUEUE_START.x + (CELL_SIZE * x), PIECE_QUEUE_START.y + (CELL_SIZE * y), CELL_SIZE, CELL_SIZE, GREEN);
+					DrawRectangle(PIECE_QUEUE_START.x + (CELL_SIZE * x), PIECE_QUEUE_START.y + (CELL_SIZE * y), CELL_SIZE, CELL_SIZE, PIECE_COLORS[next_piece->type]);
 				}
 			}
 		}
@@ -105,19 +303,167 @@ void DrawHeldPiece(const Game* game)
 			{
 				if (is_piece_cell(game->held_piece->cells, x, y))
 				{
-					DrawRectangle(HELD_PIECE_START.x + (CELL_SIZE * x), HELD_PIECE_START.y + (CELL_SIZE * y), CELL_SIZE, CELL_SIZE, GREEN);
+					DrawRectangle(HELD_PIECE_START.x + (CELL_SIZE * x), HELD_PIECE_START.y + (CELL_SIZE * y), CELL_SIZE, CELL_SIZE, PIECE_COLORS[game->held_piece->type]);
 				}
 			}
 		}
 	}
 }
 
+void ApplyPacing()
+{
+	const PacingOption option = PACING_OPTIONS[pacingOptionIndex];
+	if (option.mode == PACING_VSYNC)
+	{
+		SetWindowState(FLAG_VSYNC_HINT);
+	}
+	else
+	{
+		ClearWindowState(FLAG_VSYNC_HINT);
+	}
+	SetTargetFPS((option.mode == PACING_FIXED) ? option.fps : 0);
+}
+
+void HandlePacingKeys()
+{
+	if (IsKeyPressed(KEY_F1)) isOverlayShown = !isOverlayShown;
+	if (IsKeyPressed(KEY_F2))
+	{
+		pacingOptionIndex = (pacingOptionIndex + 1) % PACING_OPTION_COUNT;
+		ApplyPacing();
+	}
+	if (IsKeyPressed(KEY_F3)) isIdleEventWaiting = !isIdleEventWaiting;
+}
+
+// F5 starts and stops recording, F6 writes out what the rings hold now, right after a hitch is the time.
+void HandleTraceKeys()
+{
+	if (IsKeyPressed(KEY_F5)) set_trace_enabled(!is_trace_enabled());
+	if (IsKeyPressed(KEY_F6)) request_trace_dump();
+	poll_trace_dump();
+}
+
+// Nothing moves on the paused and game over screens, so let EndDrawing block until there is input instead of redrawing the same frame.
+void UpdateEventWaiting(bool isIdle)
+{
+	const bool shouldWait = isIdle && isIdleEventWaiting;
+	if (shouldWait != isEventWaitingEnabled)
+	{
+		if (shouldWait)
+		{
+			EnableEventWaiting();
+		}
+		else
+		{
+			DisableEventWaiting();
+		}
+		isEventWaitingEnabled = shouldWait;
+	}
+}
+
+void BeginFrame()
+{
+	TRACE_BEGIN("render");
+	frameStats.renderStart = get_monotonic_nanoseconds();
+	BeginDrawing();
+}
+
+void EndFrame()
+{
+	const uint64_t renderEnd = get_monotonic_nanoseconds();
+	TRACE_END("render");
+	TRACE_BEGIN("EndDrawing"); // Flush, swap, pacing wait and input polling.
+	EndDrawing();
+	TRACE_END("EndDrawing");
+	const uint64_t frameEnd = get_monotonic_nanoseconds();
+	if (frameStats.frameEnd && !isEventWaitingEnabled)
+	{
+		const uint32_t i = frameStats.index;
+		frameStats.frameTimes[i] = frameEnd - frameStats.frameEnd;
+		frameStats.tickTimes[i] = frameStats.tickTime;
+		frameStats.renderTimes[i] = renderEnd - frameStats.renderStart;
+		frameStats.presentTimes[i] = frameEnd - renderEnd;
+		frameStats.index = (i + 1) % FRAME_SAMPLE_COUNT;
+		if (frameStats.count < FRAME_SAMPLE_COUNT) frameStats.count++;
+	}
+	frameStats.frameEnd = (isEventWaitingEnabled) ? 0 : frameEnd; // Frames that waited for input would only skew the numbers.
+	frameStats.tickTime = 0;
+}
+
+int CompareFrameTimes(const void* a, const void* b)
+{
+	const uint64_t x = *(const uint64_t*)a;
+	const uint64_t y = *(const uint64_t*)b;
+	return (x > y) - (x < y);
+}
+
+double GetAverageMilliseconds(const uint64_t* samples, uint32_t count)
+{
+	uint64_t sum = 0;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		sum += samples[i];
+	}
+	return (count) ? sum / (count * 1e6) : 0.0;
+}
+
+void DrawPerformanceOverlay()
+{
+	if (!isOverlayShown || !frameStats.count)
+	{
+		DrawFPS(0, 0);
+		return;
+	}
+	const uint32_t count = frameStats.count;
+	uint64_t sorted[FRAME_SAMPLE_COUNT];
+	memcpy(sorted, frameStats.frameTimes, count * sizeof(uint64_t));
+	qsort(sorted, count, sizeof(uint64_t), CompareFrameTimes);
+	const double frameAverage = GetAverageMilliseconds(frameStats.frameTimes, count);
+	const double tickAverage = GetAverageMilliseconds(frameStats.tickTimes, count);
+	const double renderAverage = GetAverageMilliseconds(frameStats.renderTimes, count);
+	const double presentAverage = GetAverageMilliseconds(frameStats.presentTimes, count);
+
+	// Input is polled at the end of EndDrawing, so on average it waited half a frame to be seen, then it goes through a tick, a render and a present,
+	// then the display scans it out: half a refresh on average, a whole one behind vsync. A guess without a photodiode, but it moves the right way.
+	const int refreshRate = GetMonitorRefreshRate(GetCurrentMonitor());
+	const double refreshTime = 1000.0 / ((refreshRate > 0) ? refreshRate : TARGET_FPS);
+	const PacingOption option = PACING_OPTIONS[pacingOptionIndex];
+	const double inputToPhoton = frameAverage * 0.5 + tickAverage + renderAverage + presentAverage +
+		refreshTime * ((option.mode == PACING_VSYNC) ? 1.0 : 0.5);
+
+	const char* pacingName = (option.mode == PACING_VSYNC) ? "vsync" : (option.mode == PACING_UNCAPPED) ? "uncapped" : TextFormat("fixed %d", option.fps);
+	DrawRectangle(0, 0, 330, 72, Fade(BLACK, 0.75f));
+	DrawText(TextFormat("%d FPS, frame p50 %.2f p95 %.2f p99 %.2f max %.2f ms", GetFPS(),
+		sorted[count / 2] / 1e6, sorted[count * 95 / 100] / 1e6, sorted[count * 99 / 100] / 1e6, sorted[count - 1] / 1e6), 4, 4, 10, WHITE);
+	DrawText(TextFormat("tick %.3f ms, render %.3f ms, present %.3f ms", tickAverage, renderAverage, presentAverage), 4, 18, 10, WHITE);
+	DrawText(TextFormat("input to photon ~%.1f ms (estimate)", inputToPhoton), 4, 32, 10, WHITE);
+	DrawText(TextFormat("F2 pacing: %s, F3 idle event waiting: %s", pacingName, isIdleEventWaiting ? "on" : "off"), 4, 46, 10, LIGHTGRAY);
+	DrawText(TextFormat("F1 hides this, F5 trace: %s, F6 writes it", is_trace_enabled() ? "on" : "off"), 4, 60, 10, LIGHTGRAY);
+}
+
+// Undo: back to the tick the last placed piece spawned on, and forget everything after it.
+void RewindPiece(Game* game)
+{
+	uint32_t tickIndex;
+	uint32_t newestTickIndex;
+	if (!game->placed_piece_count || !find_rewind_piece_tick(rewindRing, game->placed_piece_count - 1, &tickIndex))
+	{
+		if (!get_rewind_tick_range(rewindRing, &tickIndex, &newestTickIndex)) return;
+	}
+	if (restore_rewind_tick(rewindRing, tickIndex, game))
+	{
+		truncate_rewind_ring(rewindRing, tickIndex);
+	}
+}
+
 void RenderFrame(const Game* game)
 {
-	DrawFPS(0, 0);
 	ClearBackground(BLACK);
 	DrawRectangle(PLAYFIELD_START.x, PLAYFIELD_START.y, PLAYFIELD_SIZE.x, PLAYFIELD_SIZE.y, DARKGRAY);
 	DrawPlayfieldAndPiece(game);
+	if (isHintShown) DrawAdviceHint(game);
+	if (isPerfectClearShown) DrawPerfectClearHint(game);
+	if (isFinesseShown) DrawFinesse();
 	DrawHeldPiece(game);
 	DrawPieceQueue(game);
 	// Level
@@ -144,15 +490,50 @@ void RenderFrame(const Game* game)
 		20,
 		WHITE
 	);
+	if (isBotPlaying)
+	{
+		DrawText("BOT", PLAYFIELD_START.x + PLAYFIELD_SIZE.x, PLAYFIELD_START.y + PIECE_QUEUE_SIZE.y + 60, 20, GREEN);
+	}
+	DrawPerformanceOverlay();
 }
 
 void OnPlay(Game* game)
 {
-	tick(game, GetFrameTime(), GetActionBitFlags());
+	if (IsKeyPressed(KEY_B)) isBotPlaying = !isBotPlaying;
+	if (IsKeyPressed(KEY_T)) isHintShown = !isHintShown;
+	if (IsKeyPressed(KEY_C)) isPerfectClearShown = !isPerfectClearShown;
+	if (IsKeyPressed(KEY_F))
+	{
+		isFinesseShown = !isFinesseShown;
+		finesseTracker = (FinesseTracker){ 0 };
+	}
+	if (IsKeyPressed(KEY_Z))
+	{
+		RewindPiece(game);
+		finesseTracker.is_tracking = false;
+	}
+	else
+	{
+		// The frame after an idle screen spans however long it waited for input.
+		const float frameTime = (wasIdleLastFrame && GetFrameTime() > MAX_RESUME_FRAME_TIME) ? MAX_RESUME_FRAME_TIME : GetFrameTime();
+		const uint64_t tickStart = get_monotonic_nanoseconds();
+		TRACE_BEGIN("input");
+		const ACTION_BIT_FLAGS actionBitFlags = isBotPlaying ? GetBotActionBitFlags(game) : GetActionBitFlags();
+		TRACE_END("input");
+		tick(game, frameTime, actionBitFlags);
+		TRACE_BEGIN("after tick"); // Rewind recording, finesse tracking and the advisor snapshots.
+		record_rewind_tick(rewindRing, game);
+		if (isFinesseShown && !isBotPlaying)	track_finesse(&finesseTracker, finessePlanner, actionBitFlags, game);
+		else									finesseTracker.is_tracking = false;	// The bot's pieces aren't yours.
+		if (isHintShown) adviceSnapshotId = update_bot_advisor_game(advisor, game);
+		if (isPerfectClearShown && perfectClearAdvisor) perfectClearSnapshotId = update_perfect_clear_advisor_game(perfectClearAdvisor, game);
+		TRACE_END("after tick");
+		frameStats.tickTime = get_monotonic_nanoseconds() - tickStart;
+	}
 
-	BeginDrawing();
+	BeginFrame();
 	RenderFrame(game);
-	EndDrawing();
+	EndFrame();
 }
 
 bool HandleAndCheckPause()
@@ -174,8 +555,17 @@ bool HandleAndCheckPause()
 
 void OnPause(Game* game)
 {
-	BeginDrawing();
+	BeginFrame();
 	RenderFrame(game);
+	DrawTextureEx(
+		logoTexture,
+		(Vector2) {
+		CENTER_OF_SCREEN.x - logoTexture.width * PAUSE_LOGO_SCALE * 0.5f,
+		CENTER_OF_SCREEN.y - PAUSE_CONTINUE_BUTTON_SIZE.y - 20.0f - logoTexture.height * PAUSE_LOGO_SCALE},
+		0.0f,
+		PAUSE_LOGO_SCALE,
+		WHITE
+	);
 	int pressedContinue = GuiButton(
 		(Rectangle) {
 		CENTER_OF_SCREEN.x - PAUSE_CONTINUE_BUTTON_SIZE.x * 0.5f,
@@ -192,19 +582,21 @@ void OnPause(Game* game)
 		RESTART_BUTTON_SIZE.y},
 		"Restart"
 	);
-	EndDrawing();
+	EndFrame();
 
 	if (pressedContinue) isPaused = false;
 	if (pressedRestart)
 	{
 		isPaused = false;
 		*game = get_default_initialized_game(); // Temporary
+		clear_rewind_ring(rewindRing);
+		finesseTracker.is_tracking = false;
 	}
 }
 
 void OnGameOver(Game* game)
 {
-	BeginDrawing();
+	BeginFrame();
 	RenderFrame(game);
 	const char* gameOverText = "GAME OVER!";
 	int gameOverTextWidth = MeasureText(gameOverText, 50);
@@ -234,12 +626,249 @@ void OnGameOver(Game* game)
 		RESTART_BUTTON_SIZE.y},
 		"Restart"
 	);
-	EndDrawing();
+	EndFrame();
 
 	if (pressedRestart)
 	{
 		*game = get_default_initialized_game();
+		clear_rewind_ring(rewindRing);
+		finesseTracker.is_tracking = false;
+	}
+	else if (IsKeyPressed(KEY_Z))
+	{
+		RewindPiece(game);
+		finesseTracker.is_tracking = false;
+	}
+}
+
+void FreeSpectatorWall(SpectatorWall* wall)
+{
+	for (uint8_t i = 0; i < 3; i++)
+	{
+		free(wall->shownMatches[i]);
+	}
+	free(wall->texels);
+	free(wall->finishedSteps);
+	free(wall->matches);
+	destroy_bot(wall->bot);
+	free(wall);
+}
+
+// Every match places a piece per player every SPECTATOR_STEPS_PER_PIECE steps, staggered so the searches spread evenly over the steps.
+void StepSpectatorWall(SpectatorWall* wall)
+{
+	for (uint32_t m = 0; m < wall->matchCount; m++)
+	{
+		VersusMatch* match = &wall->matches[m];
+		if (match->is_over)
+		{
+			if (++wall->finishedSteps[m] >= SPECTATOR_RESULT_STEPS)
+			{
+				init_versus_match(match, wall->nextSeed++);
+				wall->finishedSteps[m] = 0;
+			}
+			continue;
+		}
+		if ((wall->step + m) % SPECTATOR_STEPS_PER_PIECE) continue;
+		for (uint8_t p = 0; p < VERSUS_PLAYER_COUNT && !match->is_over; p++)
+		{
+			Placement placement;
+			if (!search_bot_placement(wall->bot, &match->players[p].game, &placement, 0))
+			{
+				// Nowhere left to go is as good as topping out.
+				match->players[p].topped_out = true;
+				match->is_over = true;
+				match->winner = (p + 1) % VERSUS_PLAYER_COUNT;
+				break;
+			}
+			apply_versus_placement(match, p, placement);
+		}
+	}
+	wall->step++;
+}
+
+// Paced like frames, but a late step isn't made up for, so a slow machine slows the matches down instead of stepping in bursts.
+int RunSpectatorWall(void* arg)
+{
+	SpectatorWall* wall = arg;
+	set_trace_thread_name("spectator");
+	uint64_t nextStep = get_monotonic_nanoseconds();
+	while (!atomic_load_explicit(&wall->quit, memory_order_relaxed))
+	{
+		if (atomic_load_explicit(&wall->isStepping, memory_order_relaxed))
+		{
+			TRACE_BEGIN("spectator step");
+			StepSpectatorWall(wall);
+			memcpy(wall->shownMatches[wall->shownSlots.back], wall->matches, wall->matchCount * sizeof(VersusMatch));
+			publish_triple_buffer(&wall->shownSlots);
+			TRACE_END("spectator step");
+		}
+		nextStep += SPECTATOR_STEP_INTERVAL;
+		const uint64_t now = get_monotonic_nanoseconds();
+		if (now < nextStep)
+		{
+			thrd_sleep(&(struct timespec){ .tv_nsec = (long)(nextStep - now) }, 0);
+		}
+		else
+		{
+			nextStep = now;
+		}
+	}
+	return 0;
+}
+
+// Bots on every board, kept cheap: two plies over a narrow beam on one thread is under a tenth of a millisecond a piece.
+// Each player has their own bags (init_versus_match), so the two boards of a match play out differently.
+SpectatorWall* CreateSpectatorWall(uint32_t matchCount)
+{
+	SpectatorWall* wall = calloc(1, sizeof(SpectatorWall));
+	if (!wall) return 0;
+	wall->matchCount = matchCount;
+	BotSettings botSettings = get_default_bot_settings();
+	botSettings.beam_width = 8;
+	botSettings.depth = 2;
+	botSettings.thread_count = 1;
+	wall->bot = create_bot(botSettings);
+	wall->matches = calloc(matchCount, sizeof(VersusMatch));
+	wall->finishedSteps = calloc(matchCount, sizeof(uint32_t));
+	bool isAllocated = wall->bot && wall->matches && wall->finishedSteps;
+	for (uint8_t i = 0; i < 3; i++)
+	{
+		wall->shownMatches[i] = malloc(matchCount * sizeof(VersusMatch));
+		isAllocated = isAllocated && wall->shownMatches[i];
+	}
+	if (!isAllocated)
+	{
+		FreeSpectatorWall(wall);
+		return 0;
+	}
+	for (uint32_t m = 0; m < matchCount; m++)
+	{
+		init_versus_match(&wall->matches[m], wall->nextSeed++);
+	}
+	// Every slot starts out as the first matches, so the render thread has something to show before the first step.
+	for (uint8_t i = 0; i < 3; i++)
+	{
+		memcpy(wall->shownMatches[i], wall->matches, matchCount * sizeof(VersusMatch));
+	}
+	init_triple_buffer(&wall->shownSlots);
+
+	// Whichever even column count leaves the boards biggest, leaving room for a line of text under them.
+	const int boardCount = (int)matchCount * VERSUS_PLAYER_COUNT;
+	wall->boardWidth = DEFAULT_COLUMN_COUNT + SPECTATOR_BOARD_GAP;
+	wall->boardHeight = (DEFAULT_ROW_COUNT - DEFAULT_CEILING) + SPECTATOR_BOARD_GAP;
+	float scale = 0.0f;
+	for (int columns = VERSUS_PLAYER_COUNT; columns <= boardCount; columns += VERSUS_PLAYER_COUNT)
+	{
+		const int rows = (boardCount + columns - 1) / columns;
+		const float widthScale = SCREEN_WIDTH / (float)(columns * wall->boardWidth);
+		const float heightScale = (SCREEN_HEIGHT - 20) / (float)(rows * wall->boardHeight);
+		const float columnsScale = (widthScale < heightScale) ? widthScale : heightScale;
+		if (columnsScale > scale)
+		{
+			scale = columnsScale;
+			wall->columns = columns;
+		}
+	}
+	const int rows = (boardCount + wall->columns - 1) / wall->columns;
+	const int width = wall->columns * wall->boardWidth - SPECTATOR_BOARD_GAP;
+	const int height = rows * wall->boardHeight - SPECTATOR_BOARD_GAP;
+	if (scale >= 1.0f) scale = (float)(int)scale; // Whole texels per cell keep every cell the same size.
+	wall->destination = (Rectangle){ (SCREEN_WIDTH - width * scale) * 0.5f, (SCREEN_HEIGHT - 20 - height * scale) * 0.5f, width * scale, height * scale };
+
+	wall->texels = calloc((size_t)width * height, sizeof(Color));
+	if (!wall->texels)
+	{
+		FreeSpectatorWall(wall);
+		return 0;
+	}
+	atomic_init(&wall->isStepping, false);
+	atomic_init(&wall->quit, false);
+	if (thrd_create(&wall->thread, RunSpectatorWall, wall) != thrd_success)
+	{
+		FreeSpectatorWall(wall);
+		return 0;
+	}
+	Image image = GenImageColor(width, height, BLANK);
+	wall->texture = LoadTextureFromImage(image);
+	UnloadImage(image);
+	SetTextureFilter(wall->texture, TEXTURE_FILTER_POINT);
+	return wall;
+}
+
+void DestroySpectatorWall(SpectatorWall* wall)
+{
+	if (!wall) return;
+	atomic_store_explicit(&wall->quit, true, memory_order_relaxed);
+	thrd_join(wall->thread, 0);
+	UnloadTexture(wall->texture);
+	FreeSpectatorWall(wall);
+}
+
+// Draws the newest step the stepping thread handed over, or the last one again if it hasn't finished another.
+void DrawSpectatorWall(SpectatorWall* wall)
+{
+	acquire_triple_buffer(&wall->shownSlots);
+	const VersusMatch* matches = wall->shownMatches[wall->shownSlots.front];
+	const int width = wall->texture.width;
+	const Color emptyColor = DARKGRAY;
+	for (uint32_t b = 0; b < wall->matchCount * VERSUS_PLAYER_COUNT; b++)
+	{
+		const VersusMatch* match = &matches[b / VERSUS_PLAYER_COUNT];
+		const Playfield* playfield = &match->players[b % VERSUS_PLAYER_COUNT].game.playfield;
+		const bool isLoser = match->is_over && match->winner != b % VERSUS_PLAYER_COUNT;
+		Color* origin = &wall->texels[(b / wall->columns) * wall->boardHeight * width + (b % wall->columns) * wall->boardWidth];
+		for (uint8_t y = playfield->ceiling; y < playfield->row_count; y++)
+		{
+			Color* texel = &origin[(y - playfield->ceiling) * width];
+			const PlayfieldRow row = playfield->cells[y];
+			for (uint8_t x = 0; x < playfield->column_count; x++)
+			{
+				Color color = ((row >> x) & 1) ? PIECE_COLORS[get_playfield_cell_type(playfield, x + COLUMN_OFFSET, y)] : emptyColor;
+				if (isLoser)
+				{
+					color = (Color){ color.r / 2, color.g / 2, color.b / 2, color.a };
+				}
+				texel[x] = color;
+			}
+		}
 	}
+	UpdateTexture(wall->texture, wall->texels);
+	DrawTexturePro(wall->texture, (Rectangle){ 0.0f, 0.0f, (float)width, (float)wall->texture.height }, wall->destination, (Vector2){ 0.0f, 0.0f }, 0.0f, WHITE);
+}
+
+void OnSpectate()
+{
+	frameStats.tickTime = 0; // The matches are stepped on their own thread.
+
+	BeginFrame();
+	ClearBackground(BLACK);
+	DrawSpectatorWall(spectatorWall);
+	DrawText(TextFormat("%u bot matches, Up and Down for more or fewer, F4 to go back", spectatorWall->matchCount), 4, SCREEN_HEIGHT - 18, 10, LIGHTGRAY);
+	DrawPerformanceOverlay();
+	EndFrame();
+}
+
+// F4 swaps between the game and the wall. The wall is only built the first time, and whichever isn't shown waits where it was.
+// On the wall, Up and Down build a new one with twice or half the matches.
+void HandleSpectatorKey()
+{
+	if (IsKeyPressed(KEY_F4))
+	{
+		if (!spectatorWall) spectatorWall = CreateSpectatorWall(SPECTATOR_DEFAULT_MATCH_COUNT);
+		isSpectating = !isSpectating && spectatorWall;
+	}
+	else if (isSpectating && (IsKeyPressed(KEY_UP) || IsKeyPressed(KEY_DOWN)))
+	{
+		const uint32_t matchCount = IsKeyPressed(KEY_UP) ? spectatorWall->matchCount * 2 : spectatorWall->matchCount / 2;
+		SpectatorWall* resized = (matchCount >= 1 && matchCount <= SPECTATOR_MAX_MATCH_COUNT) ? CreateSpectatorWall(matchCount) : 0;
+		if (resized)
+		{
+			DestroySpectatorWall(spectatorWall);
+			spectatorWall = resized;
+		}
+	}
+	if (spectatorWall) atomic_store_explicit(&spectatorWall->isStepping, isSpectating, memory_order_relaxed);
 }
 
 //void OnTitleScreen()
@@ -247,26 +876,63 @@ void OnGameOver(Game* game)
 //
 //}
 
+// Everything the client needs is compiled in (the logo here, raylib's default font and raygui's default style in their headers), so startup reads no files.
+void LoadEmbeddedAssets()
+{
+	Image logoImage = LoadImageFromMemory(".png", ZETRIS_LOGO_DATA, ZETRIS_LOGO_SIZE);
+	logoTexture = LoadTextureFromImage(logoImage);
+	UnloadImage(logoImage);
+}
+
 void game_loop()
 { 
+#ifdef PRINT_STARTUP_TIMES
+	const uint64_t startupStart = get_monotonic_nanoseconds();
+#endif // PRINT_STARTUP_TIMES
 	PLAYFIELD_SIZE = (Vector2){ (float)(CELL_SIZE * DEFAULT_COLUMN_COUNT), (float)(CELL_SIZE * (DEFAULT_ROW_COUNT - DEFAULT_CEILING) )};
 	PLAYFIELD_START = (Vector2){ CENTER_OF_SCREEN.x - PLAYFIELD_SIZE.x / 2.0, CENTER_OF_SCREEN.y - PLAYFIELD_SIZE.y / 2.0 };
 	HELD_PIECE_START = (Vector2){PLAYFIELD_START.x - HELD_PIECE_SIZE.x, PLAYFIELD_START.y};
 	PIECE_QUEUE_START = (Vector2){ PLAYFIELD_START.x + PLAYFIELD_SIZE.x, PLAYFIELD_START.y };
     InitWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "Zetris");
-	//#if defined(DEBUG) || defined(_DEBUG) || !defined(NDEBUG)
-	//if (FileExists("ZETRIS_LOGO.png"))
-	//{
-	//	Image zetrisLogo = LoadImage("ZETRIS_LOGO.png");
-	//	ExportImageAsCode(zetrisLogo, "raylibzetrislogo.h");
-	//}
-	//#endif // DEBUG
+#ifdef PRINT_STARTUP_TIMES
+	const uint64_t startupWindow = get_monotonic_nanoseconds();
+#endif // PRINT_STARTUP_TIMES
+	LoadEmbeddedAssets();
 	SetExitKey(KEY_NULL);
-	SetTargetFPS(TARGET_FPS);
+	install_trace_dumps(TRACE_PATH);
+	set_trace_thread_name("main");
+	ApplyPacing();
+	BotSettings advisorSettings = get_default_bot_settings();
+	advisorSettings.time_budget = BOT_ADVISOR_DEFAULT_TIME_BUDGET;
+	openingBook = open_opening_book(OPENING_BOOK_PATH);
+	advisorSettings.opening_book = openingBook;
+	advisor = create_bot_advisor(advisorSettings);
+	rewindRing = create_rewind_ring(get_default_rewind_settings());
+	finessePlanner = create_finesse_planner();
+	PerfectClearSettings perfectClearSettings = get_default_perfect_clear_settings();
+	perfectClearSettings.time_budget = PERFECT_CLEAR_HINT_TIME_BUDGET;
+	perfectClearAdvisor = create_perfect_clear_advisor(perfectClearSettings);
 	Game game = get_default_initialized_game();
+	record_rewind_tick(rewindRing, &game);
+#ifdef PRINT_STARTUP_TIMES
+	const uint64_t startupLoaded = get_monotonic_nanoseconds();
+	bool isFirstFrame = true;
+#endif // PRINT_STARTUP_TIMES
 	while (!WindowShouldClose())
 	{
-		if (HandleAndCheckPause())
+		HandlePacingKeys();
+		HandleTraceKeys();
+		HandleSpectatorKey();
+		if (isSpectating)
+		{
+			UpdateEventWaiting(false);
+			OnSpectate();
+			wasIdleLastFrame = false;
+			continue;
+		}
+		const bool isIdle = HandleAndCheckPause() || is_game_over(&game);
+		UpdateEventWaiting(isIdle);
+		if (isPaused)
 		{
 			OnPause(&game);
 		}
@@ -278,6 +944,25 @@ void game_loop()
 		{
 			OnPlay(&game);
 		}
+		wasIdleLastFrame = isIdle;
+#ifdef PRINT_STARTUP_TIMES
+		if (isFirstFrame)
+		{
+			// The first EndDrawing above has presented, so this is the first frame the player can act on.
+			const uint64_t startupFirstFrame = get_monotonic_nanoseconds();
+			TraceLog(LOG_INFO, "STARTUP: window %.2f ms, assets and game %.2f ms, first frame %.2f ms, total %.2f ms",
+				(startupWindow - startupStart) / 1e6, (startupLoaded - startupWindow) / 1e6,
+				(startupFirstFrame - startupLoaded) / 1e6, (startupFirstFrame - startupStart) / 1e6);
+			isFirstFrame = false;
+		}
+#endif // PRINT_STARTUP_TIMES
 	}
+	DestroySpectatorWall(spectatorWall);
+	destroy_rewind_ring(rewindRing);
+	destroy_finesse_planner(finessePlanner);
+	destroy_perfect_clear_advisor(perfectClearAdvisor);
+	UnloadTexture(logoTexture);
+	destroy_bot_advisor(advisor);
+	close_opening_book(openingBook);
     CloseWindow();
 }
\ No newline at end of file
@@ -0,0 +1,286 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "replay.h"
+#include "trace.h"
+
+#define FNV_OFFSET_BASIS    0xCBF29CE484222325ULL
+#define FNV_PRIME           0x100000001B3ULL
+
+static inline uint64_t hash_bytes(uint64_t hash, const void* data, size_t size)
+{
+    const uint8_t* bytes = data;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ bytes[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+static inline uint64_t hash_value(const uint64_t hash, const uint64_t value)
+{
+    uint8_t bytes[8];
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        bytes[i] = (uint8_t)(value >> (8 * i));
+    }
+    return hash_bytes(hash, bytes, sizeof(bytes));
+}
+
+uint64_t hash_game_state(const Game* game)
+{
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for (uint8_t y = 0; y < game->playfield.row_count; y++)
+    {
+        hash = hash_value(hash, game->playfield.cells[y]);
+    }
+    hash = hash_value(hash, game->score);
+    hash = hash_value(hash, game->random_state);
+    hash = hash_value(hash, game->playfield.lines_cleared);
+    hash = hash_value(hash, game->placed_piece_count);
+    const Piece* piece = &game->controlled_piece;
+    const uint8_t small_fields[] = {
+        (uint8_t)piece->type, piece->rotation, piece->pos_x, piece->pos_y, piece->moves, piece->on_ground,
+        (game->held_piece) ? (uint8_t)game->held_piece->type : 0,
+        game->piece_queue_index, game->level_index, game->combo_count, game->can_hold_piece
+    };
+    return hash_bytes(hash, small_fields, sizeof(small_fields));
+}
+
+Game get_replay_initialized_game(const ReplayHeader* header)
+{
+    // Same as reset_game: a seeded game with the recorded settings.
+    Game game = get_seeded_initialized_game(header->seed);
+    game.setting_bit_flags = header->setting_bit_flags;
+    game.can_hold_piece = (header->setting_bit_flags & SETTING_CAN_HOLD);
+    game.handling = header->handling;
+    return game;
+}
+
+const char* get_replay_verdict_name(ReplayVerdict verdict)
+{
+    switch (verdict)
+    {
+    case REPLAY_VALID:                  return "valid";
+    case REPLAY_BAD_HEADER:             return "bad header";
+    case REPLAY_TRUNCATED:              return "truncated";
+    case REPLAY_CHECKPOINT_MISMATCH:    return "checkpoint mismatch";
+    case REPLAY_ENDED_EARLY:            return "game over before the log ended";
+    case REPLAY_RESULT_MISMATCH:        return "result mismatch";
+    }
+    return "unknown";
+}
+
+// Recording.
+
+bool begin_replay_recording(ReplayRecorder* recorder, uint64_t seed, SETTING_BIT_FLAGS setting_bit_flags, Handling handling, uint8_t tick_rate)
+{
+    if (!is_handling_valid(handling)) return false; // It would never read back.
+    memset(recorder, 0, sizeof(ReplayRecorder));
+    recorder->header.seed = seed;
+    recorder->header.setting_bit_flags = setting_bit_flags;
+    recorder->header.handling = handling;
+    recorder->header.tick_rate = (tick_rate) ? tick_rate : REPLAY_DEFAULT_TICK_RATE;
+    recorder->header.checkpoint_interval = REPLAY_DEFAULT_CHECKPOINT_INTERVAL;
+    recorder->delta_time = 1.0 / recorder->header.tick_rate;
+    recorder->action_capacity = 60 * 60 * recorder->header.tick_rate; // An hour, then it doubles.
+    recorder->actions = malloc(recorder->action_capacity);
+    recorder->checkpoints = malloc((recorder->action_capacity / recorder->header.checkpoint_interval) * sizeof(uint64_t));
+    recorder->game = get_replay_initialized_game(&recorder->header);
+    if (!recorder->actions || !recorder->checkpoints)
+    {
+        end_replay_recording(recorder);
+        return false;
+    }
+    return true;
+}
+
+bool tick_replay_recording(ReplayRecorder* recorder, ACTION_BIT_FLAGS action_bit_flags)
+{
+    ReplayHeader* header = &recorder->header;
+    if (is_game_over(&recorder->game)) return false; // verify_replay rejects ticks logged after the game ended.
+    if (header->tick_count == recorder->action_capacity)
+    {
+        if (recorder->action_capacity >= REPLAY_MAX_TICK_COUNT) return false;
+        const uint32_t capacity = (recorder->action_capacity * 2 < REPLAY_MAX_TICK_COUNT) ? recorder->action_capacity * 2 : REPLAY_MAX_TICK_COUNT;
+        uint8_t* actions = realloc(recorder->actions, capacity);
+        if (!actions) return false;
+        recorder->actions = actions;
+        uint64_t* checkpoints = realloc(recorder->checkpoints, (capacity / header->checkpoint_interval) * sizeof(uint64_t));
+        if (!checkpoints) return false;
+        recorder->checkpoints = checkpoints;
+        recorder->action_capacity = capacity;
+    }
+    tick(&recorder->game, recorder->delta_time, action_bit_flags);
+    recorder->actions[header->tick_count++] = action_bit_flags;
+    if (header->tick_count % header->checkpoint_interval == 0)
+    {
+        recorder->checkpoints[header->tick_count / header->checkpoint_interval - 1] = hash_game_state(&recorder->game);
+    }
+    header->score = recorder->game.score;
+    header->lines_cleared = recorder->game.playfield.lines_cleared;
+    header->level_index = recorder->game.level_index;
+    return true;
+}
+
+size_t get_replay_size(const ReplayHeader* header)
+{
+    return REPLAY_HEADER_SIZE + (size_t)header->tick_count + (size_t)(header->tick_count / header->checkpoint_interval) * sizeof(uint64_t);
+}
+
+static inline void write_le(uint8_t* out, uint64_t value, uint8_t size)
+{
+    for (uint8_t i = 0; i < size; i++)
+    {
+        out[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static inline uint64_t read_le(const uint8_t* in, uint8_t size)
+{
+    uint64_t value = 0;
+    for (uint8_t i = 0; i < size; i++)
+    {
+        value |= (uint64_t)in[i] << (8 * i);
+    }
+    return value;
+}
+
+// Floats go through their bits, so a replay gets back exactly the handling it was recorded with.
+static inline void write_float_le(uint8_t* out, float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    write_le(out, bits, 4);
+}
+
+static inline float read_float_le(const uint8_t* in)
+{
+    const uint32_t bits = (uint32_t)read_le(in, 4);
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static bool write_replay_file(const ReplayRecorder* recorder, FILE* file)
+{
+    const ReplayHeader* header = &recorder->header;
+    uint8_t bytes[REPLAY_HEADER_SIZE] = { 0 };
+    memcpy(bytes, REPLAY_MAGIC, 4);
+    write_le(&bytes[4], REPLAY_VERSION, 2);
+    bytes[6] = header->setting_bit_flags;
+    bytes[7] = header->tick_rate;
+    write_le(&bytes[8], header->seed, 8);
+    write_le(&bytes[16], header->tick_count, 4);
+    write_le(&bytes[20], header->checkpoint_interval, 4);
+    write_le(&bytes[24], header->score, 8);
+    write_le(&bytes[32], header->lines_cleared, 4);
+    bytes[36] = header->level_index;
+    write_float_le(&bytes[40], header->handling.das);
+    write_float_le(&bytes[44], header->handling.arr);
+    write_float_le(&bytes[48], header->handling.soft_drop_factor);
+    if (fwrite(bytes, 1, sizeof(bytes), file) != sizeof(bytes)) return false;
+    if (fwrite(recorder->actions, 1, header->tick_count, file) != header->tick_count) return false;
+    const uint32_t checkpoint_count = header->tick_count / header->checkpoint_interval;
+    for (uint32_t i = 0; i < checkpoint_count; i++)
+    {
+        uint8_t checkpoint[8];
+        write_le(checkpoint, recorder->checkpoints[i], 8);
+        if (fwrite(checkpoint, 1, sizeof(checkpoint), file) != sizeof(checkpoint)) return false;
+    }
+    return true;
+}
+
+bool write_replay(const ReplayRecorder* recorder, FILE* file)
+{
+    TRACE_BEGIN("replay write");
+    const bool written = write_replay_file(recorder, file);
+    TRACE_END("replay write");
+    return written;
+}
+
+void end_replay_recording(ReplayRecorder* recorder)
+{
+    free(recorder->actions);
+    free(recorder->checkpoints);
+    recorder->actions = 0;
+    recorder->checkpoints = 0;
+    recorder->action_capacity = 0;
+}
+
+// Verification.
+
+bool read_replay_header(const uint8_t* data, size_t size, ReplayHeader* out_header)
+{
+    if (size < REPLAY_HEADER_SIZE || memcmp(data, REPLAY_MAGIC, 4) != 0 || read_le(&data[4], 2) != REPLAY_VERSION) return false;
+    out_header->setting_bit_flags = data[6];
+    out_header->tick_rate = data[7];
+    out_header->seed = read_le(&data[8], 8);
+    out_header->tick_count = (uint32_t)read_le(&data[16], 4);
+    out_header->checkpoint_interval = (uint32_t)read_le(&data[20], 4);
+    out_header->score = read_le(&data[24], 8);
+    out_header->lines_cleared = (uint32_t)read_le(&data[32], 4);
+    out_header->level_index = data[36];
+    out_header->handling.das = read_float_le(&data[40]);
+    out_header->handling.arr = read_float_le(&data[44]);
+    out_header->handling.soft_drop_factor = read_float_le(&data[48]);
+    return out_header->tick_rate && out_header->checkpoint_interval && out_header->tick_count <= REPLAY_MAX_TICK_COUNT &&
+        is_handling_valid(out_header->handling);
+}
+
+static ReplayVerification resimulate_replay(const uint8_t* data, size_t size)
+{
+    ReplayVerification result = { 0 };
+    ReplayHeader header;
+    if (!read_replay_header(data, size, &header))
+    {
+        result.verdict = REPLAY_BAD_HEADER;
+        return result;
+    }
+    if (get_replay_size(&header) > size)
+    {
+        result.verdict = REPLAY_TRUNCATED;
+        return result;
+    }
+
+    const uint8_t* actions = &data[REPLAY_HEADER_SIZE];
+    const uint8_t* checkpoints = &actions[header.tick_count];
+    const double delta_time = 1.0 / header.tick_rate;
+    Game game = get_replay_initialized_game(&header);
+    result.verdict = REPLAY_VALID;
+    for (uint32_t t = 0; t < header.tick_count; t++)
+    {
+        if (is_game_over(&game))
+        {
+            result.verdict = REPLAY_ENDED_EARLY;
+            result.divergence_tick = t;
+            break;
+        }
+        tick(&game, delta_time, actions[t]);
+        result.simulated_ticks = t + 1;
+        if ((t + 1) % header.checkpoint_interval == 0 &&
+            hash_game_state(&game) != read_le(&checkpoints[((t + 1) / header.checkpoint_interval - 1) * sizeof(uint64_t)], 8))
+        {
+            result.verdict = REPLAY_CHECKPOINT_MISMATCH;
+            result.divergence_tick = t;
+            break;
+        }
+    }
+    result.score = game.score;
+    result.lines_cleared = game.playfield.lines_cleared;
+    result.level_index = game.level_index;
+    if (result.verdict == REPLAY_VALID && (game.score != header.score || game.playfield.lines_cleared != header.lines_cleared || game.level_index != header.level_index))
+    {
+        result.verdict = REPLAY_RESULT_MISMATCH;
+        result.divergence_tick = header.tick_count;
+    }
+    return result;
+}
+
+ReplayVerification verify_replay(const uint8_t* data, size_t size)
+{
+    TRACE_BEGIN("replay verify");
+    const ReplayVerification result = resimulate_replay(data, size);
+    TRACE_END("replay verify");
+    return result;
+}
@@ -0,0 +1,391 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "rewind.h"
+
+#define REWIND_ON_GROUND    0b00000001
+#define REWIND_CAN_HOLD     0b00000010
+
+// What changes from tick to tick: the controlled piece and the hold. Everything else only changes with a board delta.
+typedef struct {
+    float velo_x;                       // 4 bytes
+    float velo_y;                       // 4 bytes
+    float timer;                        // 4 bytes
+    uint32_t delta_count;               // 4 bytes, board deltas recorded up to and including this tick.
+    PieceCells cells;                   // 2 bytes
+    uint8_t type;                       // 1 byte
+    uint8_t rotation;                   // 1 byte
+    uint8_t pos_x;                      // 1 byte
+    uint8_t pos_y;                      // 1 byte
+    uint8_t moves;                      // 1 byte
+    uint8_t held_type;                  // 1 byte, 0 when nothing is held.
+    uint8_t piece_queue_index;          // 1 byte
+    uint8_t controlled_piece_ground_y;  // 1 byte
+    uint8_t bit_flags;                  // 1 byte, REWIND_ON_GROUND and REWIND_CAN_HOLD.
+    ACTION_BIT_FLAGS previous_action_bit_flags;
+    SETTING_BIT_FLAGS setting_bit_flags;
+} RewindTick;
+
+// What a lock (or a hold that refills a bag) changes. The rows that changed live in the row ring.
+typedef struct {
+    uint64_t score;
+    uint64_t random_state;
+    uint32_t first_row;                 // Row ring index of its first changed row.
+    uint32_t lines_cleared;
+    uint32_t placed_piece_count;
+    uint8_t piece_queue[PIECE_QUEUE_LENGTH]; // PieceType of every slot.
+    uint8_t changed_row_count;
+    uint8_t level_index;
+    uint8_t combo_count;
+    uint8_t cleared_lines_last_piece;
+} RewindDelta;
+
+typedef struct {
+    Game game;
+    uint32_t tick_index;
+    uint32_t delta_count;               // Board deltas already in game.
+} RewindKeyframe;
+
+#define ROW_PLANE_COUNT (1 + CELL_TYPE_PLANE_COUNT) // Occupancy, then the type planes.
+
+// Every ring is indexed by how many entries were ever pushed, and only the last capacity of them are kept.
+struct RewindRing {
+    RewindSettings settings;
+    RewindTick* ticks;
+    RewindDelta* deltas;
+    PlayfieldRow* row_planes;           // ROW_PLANE_COUNT per row.
+    uint8_t* row_indices;
+    RewindKeyframe* keyframes;
+    uint32_t keyframe_capacity;
+    uint32_t tick_count;
+    uint32_t delta_count;
+    uint32_t row_count;
+    uint32_t keyframe_count;
+    Game last;                          // The newest tick, to diff the next one against.
+    bool has_last;
+};
+
+RewindSettings get_default_rewind_settings()
+{
+    RewindSettings settings = {
+        .keyframe_interval = REWIND_DEFAULT_KEYFRAME_INTERVAL,
+        .tick_capacity = REWIND_DEFAULT_TICK_CAPACITY,
+        .delta_capacity = REWIND_DEFAULT_DELTA_CAPACITY,
+        .row_capacity = REWIND_DEFAULT_ROW_CAPACITY
+    };
+    return settings;
+}
+
+static inline uint32_t get_oldest_index(const uint32_t count, const uint32_t capacity)
+{
+    return (count > capacity) ? count - capacity : 0;
+}
+
+RewindRing* create_rewind_ring(RewindSettings settings)
+{
+    if (settings.keyframe_interval == 0) settings.keyframe_interval = 1;
+    if (settings.tick_capacity == 0) settings.tick_capacity = 1;
+    if (settings.delta_capacity == 0) settings.delta_capacity = 1;
+    if (settings.row_capacity < MAX_ROW_COUNT) settings.row_capacity = MAX_ROW_COUNT; // A delta's rows always fit.
+
+    RewindRing* ring = calloc(1, sizeof(RewindRing));
+    if (!ring) return 0;
+    ring->settings = settings;
+    // Enough keyframes to cover every delta kept, plus the one the oldest of them builds on.
+    ring->keyframe_capacity = settings.delta_capacity / settings.keyframe_interval + 2;
+    ring->ticks = malloc(settings.tick_capacity * sizeof(RewindTick));
+    ring->deltas = malloc(settings.delta_capacity * sizeof(RewindDelta));
+    ring->row_planes = malloc(settings.row_capacity * ROW_PLANE_COUNT * sizeof(PlayfieldRow));
+    ring->row_indices = malloc(settings.row_capacity * sizeof(uint8_t));
+    ring->keyframes = malloc(ring->keyframe_capacity * sizeof(RewindKeyframe));
+    if (!ring->ticks || !ring->deltas || !ring->row_planes || !ring->row_indices || !ring->keyframes)
+    {
+        destroy_rewind_ring(ring);
+        return 0;
+    }
+    return ring;
+}
+
+void destroy_rewind_ring(RewindRing* ring)
+{
+    if (!ring) return;
+    free(ring->ticks);
+    free(ring->deltas);
+    free(ring->row_planes);
+    free(ring->row_indices);
+    free(ring->keyframes);
+    free(ring);
+}
+
+size_t get_rewind_ring_memory_size(const RewindRing* ring)
+{
+    return sizeof(RewindRing) +
+        ring->settings.tick_capacity * sizeof(RewindTick) +
+        ring->settings.delta_capacity * sizeof(RewindDelta) +
+        ring->settings.row_capacity * (ROW_PLANE_COUNT * sizeof(PlayfieldRow) + sizeof(uint8_t)) +
+        ring->keyframe_capacity * sizeof(RewindKeyframe);
+}
+
+void clear_rewind_ring(RewindRing* ring)
+{
+    ring->tick_count = 0;
+    ring->delta_count = 0;
+    ring->row_count = 0;
+    ring->keyframe_count = 0;
+    ring->has_last = false;
+}
+
+static void push_keyframe(RewindRing* ring, const Game* game, const uint32_t tick_index)
+{
+    RewindKeyframe* keyframe = &ring->keyframes[ring->keyframe_count++ % ring->keyframe_capacity];
+    keyframe->game = *game;
+    keyframe->tick_index = tick_index;
+    keyframe->delta_count = ring->delta_count;
+}
+
+static void push_delta(RewindRing* ring, const Game* game)
+{
+    RewindDelta* delta = &ring->deltas[ring->delta_count++ % ring->settings.delta_capacity];
+    delta->score = game->score;
+    delta->random_state = game->random_state;
+    delta->first_row = ring->row_count;
+    delta->lines_cleared = game->playfield.lines_cleared;
+    delta->placed_piece_count = game->placed_piece_count;
+    for (uint8_t i = 0; i < PIECE_QUEUE_LENGTH; i++)
+    {
+        delta->piece_queue[i] = (uint8_t)game->piece_queue[i]->type;
+    }
+    delta->changed_row_count = 0;
+    const Playfield* playfield = &game->playfield;
+    const Playfield* last = &ring->last.playfield;
+    for (uint8_t y = 0; y < playfield->row_count; y++)
+    {
+        // Cleared lines shift rows down, so a row can keep its cells and still change types.
+        bool is_changed = (playfield->cells[y] != last->cells[y]);
+        for (uint8_t i = 0; i < CELL_TYPE_PLANE_COUNT; i++)
+        {
+            is_changed |= (playfield->type_planes[i][y] != last->type_planes[i][y]);
+        }
+        if (!is_changed) continue;
+        const uint32_t row = ring->row_count++ % ring->settings.row_capacity;
+        PlayfieldRow* planes = &ring->row_planes[row * ROW_PLANE_COUNT];
+        planes[0] = playfield->cells[y];
+        for (uint8_t i = 0; i < CELL_TYPE_PLANE_COUNT; i++)
+        {
+            planes[i + 1] = playfield->type_planes[i][y];
+        }
+        ring->row_indices[row] = y;
+        delta->changed_row_count++;
+    }
+    delta->level_index = game->level_index;
+    delta->combo_count = game->combo_count;
+    delta->cleared_lines_last_piece = game->cleared_lines_last_piece;
+}
+
+static void apply_delta(const RewindRing* ring, const RewindDelta* delta, Game* game)
+{
+    for (uint32_t i = 0; i < delta->changed_row_count; i++)
+    {
+        const uint32_t row = (delta->first_row + i) % ring->settings.row_capacity;
+        const PlayfieldRow* planes = &ring->row_planes[row * ROW_PLANE_COUNT];
+        const uint8_t y = ring->row_indices[row];
+        game->playfield.cells[y] = planes[0];
+        for (uint8_t j = 0; j < CELL_TYPE_PLANE_COUNT; j++)
+        {
+            game->playfield.type_planes[j][y] = planes[j + 1];
+        }
+    }
+    game->score = delta->score;
+    game->random_state = delta->random_state;
+    game->playfield.lines_cleared = delta->lines_cleared;
+    game->placed_piece_count = delta->placed_piece_count;
+    for (uint8_t i = 0; i < PIECE_QUEUE_LENGTH; i++)
+    {
+        game->piece_queue[i] = (PieceData*)get_piece_data((PieceType)delta->piece_queue[i]);
+    }
+    game->level_index = delta->level_index;
+    game->combo_count = delta->combo_count;
+    game->cleared_lines_last_piece = delta->cleared_lines_last_piece;
+}
+
+static void apply_tick(const RewindTick* tick, Game* game)
+{
+    const PieceData* piece_data = get_piece_data((PieceType)tick->type);
+    Piece* piece = &game->controlled_piece;
+    piece->rotation_wall_kicks = piece_data->rotation_wall_kicks;
+    piece->velo_x = tick->velo_x;
+    piece->velo_y = tick->velo_y;
+    piece->timer = tick->timer;
+    piece->cells = tick->cells;
+    piece->type = (PieceType)tick->type;
+    piece->size = piece_data->size;
+    piece->rotation = tick->rotation;
+    piece->pos_x = tick->pos_x;
+    piece->pos_y = tick->pos_y;
+    piece->moves = tick->moves;
+    piece->on_ground = tick->bit_flags & REWIND_ON_GROUND;
+    game->held_piece = (tick->held_type) ? (PieceData*)get_piece_data((PieceType)tick->held_type) : 0;
+    game->piece_queue_index = tick->piece_queue_index;
+    game->controlled_piece_ground_y = tick->controlled_piece_ground_y;
+    game->can_hold_piece = tick->bit_flags & REWIND_CAN_HOLD;
+    game->previous_action_bit_flags = tick->previous_action_bit_flags;
+    game->setting_bit_flags = tick->setting_bit_flags;
+}
+
+uint32_t record_rewind_tick(RewindRing* ring, const Game* game)
+{
+    if (ring->has_last && game->placed_piece_count < ring->last.placed_piece_count) clear_rewind_ring(ring); // Reset, the old round can't be rebuilt from this one.
+
+    const uint32_t tick_index = ring->tick_count;
+    if (!ring->has_last)
+    {
+        push_keyframe(ring, game, tick_index);
+    }
+    else if (game->placed_piece_count != ring->last.placed_piece_count || game->random_state != ring->last.random_state) // A lock, or a bag refilled.
+    {
+        push_delta(ring, game);
+        const RewindKeyframe* keyframe = &ring->keyframes[(ring->keyframe_count - 1) % ring->keyframe_capacity];
+        if (game->placed_piece_count - keyframe->game.placed_piece_count >= ring->settings.keyframe_interval) push_keyframe(ring, game, tick_index);
+    }
+
+    const Piece* piece = &game->controlled_piece;
+    RewindTick* tick = &ring->ticks[tick_index % ring->settings.tick_capacity];
+    tick->velo_x = piece->velo_x;
+    tick->velo_y = piece->velo_y;
+    tick->timer = piece->timer;
+    tick->delta_count = ring->delta_count;
+    tick->cells = piece->cells;
+    tick->type = (uint8_t)piece->type;
+    tick->rotation = piece->rotation;
+    tick->pos_x = piece->pos_x;
+    tick->pos_y = piece->pos_y;
+    tick->moves = piece->moves;
+    tick->held_type = (game->held_piece) ? (uint8_t)game->held_piece->type : 0;
+    tick->piece_queue_index = game->piece_queue_index;
+    tick->controlled_piece_ground_y = game->controlled_piece_ground_y;
+    tick->bit_flags = (piece->on_ground ? REWIND_ON_GROUND : 0) | (game->can_hold_piece ? REWIND_CAN_HOLD : 0);
+    tick->previous_action_bit_flags = game->previous_action_bit_flags;
+    tick->setting_bit_flags = game->setting_bit_flags;
+    ring->tick_count++;
+    ring->last = *game;
+    ring->has_last = true;
+    return tick_index;
+}
+
+// Whether every delta from delta_index on is still in the rings.
+static bool are_deltas_kept(const RewindRing* ring, const uint32_t delta_index)
+{
+    if (delta_index < get_oldest_index(ring->delta_count, ring->settings.delta_capacity)) return false;
+    if (delta_index == ring->delta_count) return true;
+    return ring->deltas[delta_index % ring->settings.delta_capacity].first_row >= get_oldest_index(ring->row_count, ring->settings.row_capacity);
+}
+
+// Newest keyframe at or before tick_index, or 0 if it has been overwritten.
+static const RewindKeyframe* find_keyframe(const RewindRing* ring, const uint32_t tick_index)
+{
+    uint32_t low = get_oldest_index(ring->keyframe_count, ring->keyframe_capacity);
+    uint32_t high = ring->keyframe_count;
+    if (low == high || ring->keyframes[low % ring->keyframe_capacity].tick_index > tick_index) return 0;
+    while (high - low > 1)
+    {
+        const uint32_t middle = low + (high - low) / 2;
+        if (ring->keyframes[middle % ring->keyframe_capacity].tick_index <= tick_index)  low = middle;
+        else                                                                            high = middle;
+    }
+    return &ring->keyframes[low % ring->keyframe_capacity];
+}
+
+bool get_rewind_tick_range(const RewindRing* ring, uint32_t* out_oldest, uint32_t* out_newest)
+{
+    if (!ring->tick_count) return false;
+    const uint32_t oldest_tick = get_oldest_index(ring->tick_count, ring->settings.tick_capacity);
+    for (uint32_t i = get_oldest_index(ring->keyframe_count, ring->keyframe_capacity); i < ring->keyframe_count; i++)
+    {
+        const RewindKeyframe* keyframe = &ring->keyframes[i % ring->keyframe_capacity];
+        if (!are_deltas_kept(ring, keyframe->delta_count)) continue;
+        // Ticks before the next keyframe need this one, so it only helps if it isn't older than them all.
+        const bool is_newest = (i + 1 == ring->keyframe_count);
+        if (!is_newest && ring->keyframes[(i + 1) % ring->keyframe_capacity].tick_index <= oldest_tick) continue;
+        *out_oldest = (keyframe->tick_index > oldest_tick) ? keyframe->tick_index : oldest_tick;
+        *out_newest = ring->tick_count - 1;
+        return true;
+    }
+    return false;
+}
+
+bool restore_rewind_tick(const RewindRing* ring, uint32_t tick_index, Game* out_game)
+{
+    if (tick_index >= ring->tick_count || tick_index < get_oldest_index(ring->tick_count, ring->settings.tick_capacity)) return false;
+    const RewindKeyframe* keyframe = find_keyframe(ring, tick_index);
+    if (!keyframe || !are_deltas_kept(ring, keyframe->delta_count)) return false;
+
+    const RewindTick* tick = &ring->ticks[tick_index % ring->settings.tick_capacity];
+    *out_game = keyframe->game;
+    for (uint32_t i = keyframe->delta_count; i < tick->delta_count; i++)
+    {
+        apply_delta(ring, &ring->deltas[i % ring->settings.delta_capacity], out_game);
+    }
+    apply_tick(tick, out_game);
+    return true;
+}
+
+bool find_rewind_piece_tick(const RewindRing* ring, uint32_t placed_piece_count, uint32_t* out_tick_index)
+{
+    uint32_t oldest;
+    uint32_t newest;
+    if (!get_rewind_tick_range(ring, &oldest, &newest)) return false;
+    // placed_piece_count only grows within a round, so the deltas are sorted by it. The tick wanted is the one right after the delta that reached it.
+    const uint32_t oldest_delta = ring->ticks[oldest % ring->settings.tick_capacity].delta_count;
+    uint32_t low = oldest_delta;
+    uint32_t high = ring->delta_count;
+    while (low < high)
+    {
+        const uint32_t middle = low + (high - low) / 2;
+        if (ring->deltas[middle % ring->settings.delta_capacity].placed_piece_count < placed_piece_count)   low = middle + 1;
+        else                                                                                                high = middle;
+    }
+    if (low == oldest_delta)
+    {
+        // The oldest tick may already have had it, and then the first delta with it is only a bag refill.
+        Game game;
+        if (restore_rewind_tick(ring, oldest, &game) && game.placed_piece_count == placed_piece_count)
+        {
+            *out_tick_index = oldest;
+            return true;
+        }
+    }
+    if (low == ring->delta_count || ring->deltas[low % ring->settings.delta_capacity].placed_piece_count != placed_piece_count) return false;
+
+    // The first tick whose delta_count includes delta low.
+    uint32_t tick_low = oldest;
+    uint32_t tick_high = newest;
+    while (tick_low < tick_high)
+    {
+        const uint32_t middle = tick_low + (tick_high - tick_low) / 2;
+        if (ring->ticks[middle % ring->settings.tick_capacity].delta_count <= low)  tick_low = middle + 1;
+        else                                                                        tick_high = middle;
+    }
+    *out_tick_index = tick_low;
+    return true;
+}
+
+void truncate_rewind_ring(RewindRing* ring, uint32_t tick_index)
+{
+    if (tick_index + 1 >= ring->tick_count) return;
+    if (!restore_rewind_tick(ring, tick_index, &ring->last))
+    {
+        clear_rewind_ring(ring);
+        return;
+    }
+    const uint32_t delta_count = ring->ticks[tick_index % ring->settings.tick_capacity].delta_count;
+    ring->tick_count = tick_index + 1;
+    if (delta_count < ring->delta_count)
+    {
+        ring->row_count = ring->deltas[delta_count % ring->settings.delta_capacity].first_row;
+        ring->delta_count = delta_count;
+    }
+    while (ring->keyframe_count && ring->keyframes[(ring->keyframe_count - 1) % ring->keyframe_capacity].tick_index > tick_index)
+    {
+        ring->keyframe_count--;
+    }
+}
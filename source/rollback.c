@@ -0,0 +1,165 @@
+#include <string.h>
+
+#include "rollback.h"
+#include "util.h"
+
+_Static_assert((ROLLBACK_INPUT_RING_SIZE & (ROLLBACK_INPUT_RING_SIZE - 1)) == 0, "The input ring is indexed with a mask.");
+_Static_assert(ROLLBACK_INPUT_RING_SIZE >= ROLLBACK_MAX_FRAMES + ROLLBACK_MAX_INPUT_DELAY, "Inputs must outlive the frames they can be rolled back to.");
+
+static inline uint32_t get_input_slot(uint32_t frame)
+{
+    return frame & (ROLLBACK_INPUT_RING_SIZE - 1);
+}
+
+void init_rollback_session(RollbackSession* session, uint64_t seed, uint8_t local_player, uint8_t input_delay)
+{
+    memset(session, 0, sizeof(RollbackSession));
+    init_versus_match(&session->match, seed);
+    session->local_player = local_player % VERSUS_PLAYER_COUNT;
+    session->input_delay = (input_delay > ROLLBACK_MAX_INPUT_DELAY) ? ROLLBACK_MAX_INPUT_DELAY : input_delay;
+    // Nobody presses anything before the delay runs out, so both sides know those inputs already. Both must use the same delay.
+    for (uint32_t f = 0; f < session->input_delay; f++)
+    {
+        session->received_frames[get_input_slot(f)] = f + 1;
+    }
+    session->local_frame = session->input_delay;
+    session->confirmed_frame = session->input_delay;
+    session->acked_frame = session->input_delay;
+    session->rollback_frame = UINT32_MAX;
+}
+
+void add_rollback_local_input(RollbackSession* session, ACTION_BIT_FLAGS action_bit_flags)
+{
+    const uint32_t frame = session->frame + session->input_delay;
+    if (frame + 1 - session->acked_frame > ROLLBACK_INPUT_RING_SIZE) return; // Would overwrite an input the remote may still need. advance stalls first.
+    session->inputs[session->local_player][get_input_slot(frame)] = action_bit_flags & ~ACTION_PAUSE;
+    if (frame + 1 > session->local_frame) session->local_frame = frame + 1;
+}
+
+void write_rollback_packet(const RollbackSession* session, RollbackPacket* out_packet)
+{
+    out_packet->first_frame = session->acked_frame;
+    out_packet->ack_frame = session->confirmed_frame;
+    out_packet->input_count = (uint8_t)(session->local_frame - session->acked_frame);
+    for (uint8_t i = 0; i < out_packet->input_count; i++)
+    {
+        out_packet->inputs[i] = session->inputs[session->local_player][get_input_slot(session->acked_frame + i)];
+    }
+}
+
+void receive_rollback_packet(RollbackSession* session, const RollbackPacket* packet)
+{
+    if (packet->ack_frame > session->acked_frame && packet->ack_frame <= session->local_frame) session->acked_frame = packet->ack_frame;
+    const uint8_t remote_player = (session->local_player + 1) % VERSUS_PLAYER_COUNT;
+    const uint8_t count = (packet->input_count > ROLLBACK_MAX_PACKET_INPUTS) ? ROLLBACK_MAX_PACKET_INPUTS : packet->input_count;
+    for (uint8_t i = 0; i < count; i++)
+    {
+        const uint32_t frame = packet->first_frame + i;
+        const uint32_t slot = get_input_slot(frame);
+        // Already known, or so far ahead its slot still holds a frame that can be rolled back to.
+        if (frame < session->confirmed_frame || frame - session->confirmed_frame >= ROLLBACK_INPUT_RING_SIZE || session->received_frames[slot] == frame + 1) continue;
+        const ACTION_BIT_FLAGS action_bit_flags = packet->inputs[i] & ~ACTION_PAUSE;
+        if (frame < session->frame && session->inputs[remote_player][slot] != action_bit_flags)
+        {
+            session->stats.misprediction_count++;
+            if (frame < session->rollback_frame) session->rollback_frame = frame;
+        }
+        session->inputs[remote_player][slot] = action_bit_flags;
+        session->received_frames[slot] = frame + 1;
+    }
+    while (session->received_frames[get_input_slot(session->confirmed_frame)] == session->confirmed_frame + 1)
+    {
+        session->confirmed_frame++;
+    }
+}
+
+// Saves the match, then steps it with the local input and the remote one, or the remote's previous input if it hasn't arrived.
+static void simulate_rollback_frame(RollbackSession* session, uint32_t frame)
+{
+    const uint8_t remote_player = (session->local_player + 1) % VERSUS_PLAYER_COUNT;
+    const uint32_t slot = get_input_slot(frame);
+    if (session->received_frames[slot] != frame + 1)
+    {
+        session->inputs[remote_player][slot] = frame ? session->inputs[remote_player][get_input_slot(frame - 1)] : 0;
+    }
+    session->saved[frame % ROLLBACK_MAX_FRAMES] = session->match;
+    ACTION_BIT_FLAGS action_bit_flags[VERSUS_PLAYER_COUNT];
+    for (uint8_t i = 0; i < VERSUS_PLAYER_COUNT; i++)
+    {
+        action_bit_flags[i] = session->inputs[i][slot];
+    }
+    step_versus_match(&session->match, action_bit_flags, ROLLBACK_TICK_DELTA_TIME);
+}
+
+bool settle_rollback_session(RollbackSession* session)
+{
+    const uint32_t rollback_frame = session->rollback_frame;
+    session->rollback_frame = UINT32_MAX;
+    if (rollback_frame >= session->frame) return false;
+    // Never older than ROLLBACK_MAX_FRAMES: a misprediction is at or after confirmed_frame, which advance keeps that close.
+    session->match = session->saved[rollback_frame % ROLLBACK_MAX_FRAMES];
+    for (uint32_t f = rollback_frame; f < session->frame; f++)
+    {
+        simulate_rollback_frame(session, f);
+    }
+    const uint32_t frames = session->frame - rollback_frame;
+    session->stats.rollback_count++;
+    session->stats.resimulated_frame_count += frames;
+    if (frames > session->stats.max_rollback_frames) session->stats.max_rollback_frames = frames;
+    return true;
+}
+
+bool advance_rollback_frame(RollbackSession* session)
+{
+    settle_rollback_session(session);
+    if (session->frame >= session->confirmed_frame + ROLLBACK_MAX_FRAMES || session->local_frame <= session->frame ||
+        session->local_frame - session->acked_frame >= ROLLBACK_INPUT_RING_SIZE)
+    {
+        session->stats.stall_count++;
+        return false;
+    }
+    simulate_rollback_frame(session, session->frame);
+    session->frame++;
+    session->stats.frame_count++;
+    return true;
+}
+
+// Loopback.
+
+void init_loopback_link(LoopbackLink* link, uint64_t seed, uint32_t latency, uint32_t jitter, uint8_t loss_percent)
+{
+    memset(link, 0, sizeof(LoopbackLink));
+    link->latency = latency;
+    link->jitter = jitter;
+    link->loss_percent = loss_percent;
+    link->random_state = seed;
+}
+
+void send_loopback_packet(LoopbackLink* link, uint8_t to_player, const RollbackPacket* packet, uint64_t now)
+{
+    link->sent_count++;
+    if (link->count == LOOPBACK_CAPACITY || next_random(&link->random_state) % 100 < link->loss_percent)
+    {
+        link->dropped_count++;
+        return;
+    }
+    LoopbackPacket* slot = &link->packets[link->count++];
+    slot->packet = *packet;
+    slot->to_player = to_player;
+    slot->deliver_time = now + link->latency + (link->jitter ? next_random(&link->random_state) % (link->jitter + 1) : 0);
+}
+
+bool receive_loopback_packet(LoopbackLink* link, uint8_t player, uint64_t now, RollbackPacket* out_packet)
+{
+    uint32_t next = UINT32_MAX;
+    for (uint32_t i = 0; i < link->count; i++)
+    {
+        const LoopbackPacket* slot = &link->packets[i];
+        if (slot->to_player != player || slot->deliver_time > now) continue;
+        if (next == UINT32_MAX || slot->deliver_time < link->packets[next].deliver_time) next = i;
+    }
+    if (next == UINT32_MAX) return false;
+    *out_packet = link->packets[next].packet;
+    link->packets[next] = link->packets[--link->count];
+    return true;
+}
@@ -0,0 +1,84 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bridge.h"
+#include "clock.h"
+
+#define SERVE_CONNECT_TIMEOUT       (60 * NANOSECONDS_PER_SECOND)   // For the first answer, while the client starts up.
+#define SERVE_DEFAULT_TIMEOUT_MS    5000
+
+// Same start as env_reset, so a bot sees the ghost from the first state.
+static Game get_served_game(uint64_t seed)
+{
+    Game game = get_seeded_initialized_game(seed);
+    game.controlled_piece_ground_y = get_playfield_piece_cells_hard_drop_y(
+        &game.playfield,
+        game.controlled_piece.cells,
+        game.controlled_piece.size,
+        game.controlled_piece.pos_x,
+        game.controlled_piece.pos_y
+    );
+    return game;
+}
+
+// Plays games in lockstep: every tick waits for the client's action for it, so a run is the same for a bot however slow it thinks.
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        printf("usage: zetris-serve <name> [games] [seed] [spin count] [timeout ms]\n");
+        return 1;
+    }
+    const char* name = argv[1];
+    const uint32_t game_count = (argc > 2) ? (uint32_t)strtoul(argv[2], 0, 10) : 1;
+    const uint64_t seed = (argc > 3) ? strtoull(argv[3], 0, 10) : 1;
+    const uint32_t spin_count = (argc > 4) ? (uint32_t)strtoul(argv[4], 0, 10) : BRIDGE_DEFAULT_SPIN_COUNT;
+    const uint64_t timeout = ((argc > 5) ? strtoull(argv[5], 0, 10) : SERVE_DEFAULT_TIMEOUT_MS) * NANOSECONDS_PER_MILLISECOND;
+    Bridge* bridge = create_bridge_host(name, spin_count);
+    if (!bridge)
+    {
+        printf("zetris-serve: couldn't create the shared memory segment %s\n", name);
+        return 1;
+    }
+    printf("zetris-serve: hosting %s, waiting for a client\n", name);
+
+    uint64_t tick_index = 0;
+    uint64_t round_trip_total = 0;
+    uint64_t round_trip_max = 0;
+    int result = 0;
+    for (uint32_t g = 0; g < game_count && !result; g++)
+    {
+        Game game = get_served_game(seed + g);
+        const uint64_t first_tick = tick_index;
+        for (;;)
+        {
+            const uint64_t start = get_monotonic_nanoseconds();
+            publish_bridge_state(bridge, &game, tick_index, g);
+            ACTION_BIT_FLAGS action_bit_flags;
+            if (!wait_bridge_action(bridge, tick_index, &action_bit_flags, tick_index ? timeout : SERVE_CONNECT_TIMEOUT))
+            {
+                printf("zetris-serve: no action for tick %llu, stopping\n", (unsigned long long)tick_index);
+                result = 1;
+                break;
+            }
+            if (tick_index)
+            {
+                const uint64_t elapsed = get_monotonic_nanoseconds() - start;
+                round_trip_total += elapsed;
+                if (elapsed > round_trip_max) round_trip_max = elapsed;
+            }
+            tick_index++;
+            if (is_game_over(&game)) break; // Its last state was answered, so the client saw it.
+            tick(&game, ENV_TICK_DELTA_TIME, action_bit_flags & ~ACTION_PAUSE);
+        }
+        printf("game %u: score %llu, %u lines, %u pieces, %llu ticks\n", g, (unsigned long long)game.score, game.playfield.lines_cleared,
+            game.placed_piece_count, (unsigned long long)(tick_index - first_tick));
+    }
+    destroy_bridge(bridge);
+    if (tick_index > 1)
+    {
+        printf("zetris-serve: round trips %.2f us on average, %.2f us at most\n", round_trip_total / 1e3 / (tick_index - 1), round_trip_max / 1e3);
+    }
+    return result;
+}
@@ -0,0 +1,312 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+#include "clock.h"
+#include "game.h"
+#include "trace.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif // _WIN32
+
+#define SIM_MAX_THREADS             256
+#define SIM_DEFAULT_GAME_COUNT      1000
+#define SIM_DEFAULT_MAX_PIECES      1000    // Per game. The policy can go on forever on the early levels.
+#define SIM_DEFAULT_SEED            1
+#define SIM_TICK_TIME               (1.0 / 60.0)
+#define SIM_STUCK_TICKS             8       // Ticks the piece doesn't move before the controller drops it where it is.
+
+#define SIM_WEIGHT_LINES            0.76f   // Against evaluate_playfield_rows, the same as the MCTS rollout policy.
+
+typedef struct {
+    uint64_t score;
+    uint32_t lines;
+    uint32_t pieces;
+    uint64_t ticks;
+    bool topped_out;
+} SimResult;
+
+typedef struct {
+    SimResult* results;     // By game, so the distribution is the same whatever thread played which game.
+    uint32_t game_count;
+    uint32_t max_pieces;
+    uint64_t seed;
+    atomic_uint next_game;
+} SimContext;
+
+typedef struct {
+    thrd_t thread;
+    SimContext* context;
+    uint64_t policy_time;   // Nanoseconds spent choosing placements, the rest is tick.
+} SimWorker;
+
+// The same idea as the bot's controller, without the bot: one fresh press a tick, released the tick after, since tick only acts on presses.
+typedef struct {
+    Placement target;
+    uint32_t target_placed_piece_count;
+    uint8_t last_pos_x;
+    uint8_t last_rotation;
+    uint8_t stuck_ticks;
+    bool has_target;
+    ACTION_BIT_FLAGS previous_action_bit_flags;
+} SimController;
+
+static uint32_t get_processor_count(void)
+{
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (uint32_t)info.dwNumberOfProcessors;
+#else
+    const long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return (count > 0) ? (uint32_t)count : 1;
+#endif // _WIN32
+}
+
+// Greedy over every drop placement, with hold. False if there is none, and the piece is just dropped.
+static bool choose_policy_placement(const Game* game, Placement* out_placement)
+{
+    Placement placements[MAX_DROP_PLACEMENT_COUNT];
+    const uint16_t placement_count = get_drop_placements(game, true, placements);
+    bool is_found = false;
+    double best_value = 0.0;
+    for (uint16_t i = 0; i < placement_count; i++)
+    {
+        Game next = *game;
+        apply_drop_placement(&next, placements[i]);
+        if (is_game_over(&next)) continue;
+        const double value = SIM_WEIGHT_LINES * next.cleared_lines_last_piece +
+            evaluate_playfield_rows(next.playfield.cells, 0, next.playfield.row_count, next.playfield.column_count);
+        if (!is_found || value > best_value)
+        {
+            best_value = value;
+            *out_placement = placements[i];
+            is_found = true;
+        }
+    }
+    return is_found;
+}
+
+static ACTION_BIT_FLAGS get_sim_controller_action_bit_flags(SimController* controller, const Game* game)
+{
+    const Piece* piece = &game->controlled_piece;
+    const Placement* target = &controller->target;
+    controller->stuck_ticks = (piece->pos_x == controller->last_pos_x && piece->rotation == controller->last_rotation) ? controller->stuck_ticks + 1 : 0;
+    controller->last_pos_x = piece->pos_x;
+    controller->last_rotation = piece->rotation;
+
+    const ACTION_BIT_FLAGS previous = controller->previous_action_bit_flags;
+    ACTION_BIT_FLAGS action_bit_flags = 0;
+    if (!controller->has_target || controller->stuck_ticks >= SIM_STUCK_TICKS)
+    {
+        action_bit_flags |= ACTION_HARD_DROP & ~previous;
+    }
+    else if (target->use_hold && piece->type != target->type && game->can_hold_piece)
+    {
+        action_bit_flags |= ACTION_HOLD_PIECE & ~previous;
+    }
+    else if (piece->rotation == target->rotation && piece->pos_x == target->pos_x)
+    {
+        action_bit_flags |= ACTION_HARD_DROP & ~previous;
+    }
+    else
+    {
+        if (piece->rotation != target->rotation)
+        {
+            const bool clockwise = ((target->rotation - piece->rotation) & (PIECE_ROTATION_STATES - 1)) != PIECE_ROTATION_STATES - 1;
+            action_bit_flags |= (clockwise ? ACTION_ROTATE_CLOCKWISE : ACTION_ROTATE_COUNTER) & ~previous;
+        }
+        if (piece->pos_x != target->pos_x)
+        {
+            action_bit_flags |= ((piece->pos_x < target->pos_x) ? ACTION_MOVE_RIGHT : ACTION_MOVE_LEFT) & ~previous;
+        }
+    }
+    controller->previous_action_bit_flags = action_bit_flags;
+    return action_bit_flags;
+}
+
+// One game, a tick at a time, the way a client plays it. A placement is chosen whenever a new piece spawns.
+static SimResult play_sim_game(SimWorker* worker, uint64_t seed)
+{
+    const uint32_t max_pieces = worker->context->max_pieces;
+    Game game = get_seeded_initialized_game(seed);
+    SimController controller = { 0 };
+    uint64_t ticks = 0;
+    while (!is_game_over(&game) && game.placed_piece_count < max_pieces)
+    {
+        if (!controller.has_target || controller.target_placed_piece_count != game.placed_piece_count)
+        {
+            const uint64_t start = get_monotonic_nanoseconds();
+            controller.has_target = choose_policy_placement(&game, &controller.target);
+            worker->policy_time += get_monotonic_nanoseconds() - start;
+            controller.target_placed_piece_count = game.placed_piece_count;
+            controller.last_pos_x = game.controlled_piece.pos_x;
+            controller.last_rotation = game.controlled_piece.rotation;
+            controller.stuck_ticks = 0;
+            controller.previous_action_bit_flags = 0;
+        }
+        tick(&game, SIM_TICK_TIME, get_sim_controller_action_bit_flags(&controller, &game));
+        ticks++;
+    }
+    return (SimResult){
+        .score = game.score,
+        .lines = game.playfield.lines_cleared,
+        .pieces = game.placed_piece_count,
+        .ticks = ticks,
+        .topped_out = is_game_over(&game)
+    };
+}
+
+static int run_sim_worker(void* arg)
+{
+    SimWorker* worker = arg;
+    SimContext* context = worker->context;
+    set_trace_thread_name("sim worker");
+    uint32_t game_index;
+    while ((game_index = atomic_fetch_add_explicit(&context->next_game, 1, memory_order_relaxed)) < context->game_count)
+    {
+        poll_trace_dump(); // The main thread only joins, so a SIGUSR1 is answered here.
+        context->results[game_index] = play_sim_game(worker, context->seed + game_index);
+    }
+    return 0;
+}
+
+static int compare_scores(const void* a, const void* b)
+{
+    const uint64_t score_a = *(const uint64_t*)a;
+    const uint64_t score_b = *(const uint64_t*)b;
+    return (score_a > score_b) - (score_a < score_b);
+}
+
+static int run_sim(uint32_t game_count, uint32_t max_pieces, uint64_t seed, uint32_t thread_count)
+{
+    static SimWorker workers[SIM_MAX_THREADS];
+    static SimContext context;
+    context.results = calloc(game_count, sizeof(SimResult));
+    uint64_t* scores = malloc(game_count * sizeof(uint64_t));
+    if (!context.results || !scores)
+    {
+        fprintf(stderr, "zetris-sim: out of memory for %u games\n", game_count);
+        free(context.results);
+        free(scores);
+        return 1;
+    }
+    context.game_count = game_count;
+    context.max_pieces = max_pieces;
+    context.seed = seed;
+    atomic_init(&context.next_game, 0);
+
+    const uint64_t start = get_monotonic_nanoseconds();
+    uint32_t started_count = 1; // Worker 0 is this thread.
+    while (started_count < thread_count)
+    {
+        workers[started_count].context = &context;
+        if (thrd_create(&workers[started_count].thread, run_sim_worker, &workers[started_count]) != thrd_success) break;
+        started_count++;
+    }
+    if (started_count < thread_count)
+    {
+        fprintf(stderr, "zetris-sim: couldn't start %u of %u worker threads\n", thread_count - started_count, thread_count);
+        atomic_store(&context.next_game, game_count); // The workers that did start stop after their current game.
+    }
+    workers[0].context = &context;
+    run_sim_worker(&workers[0]);
+    for (uint32_t i = 1; i < started_count; i++)
+    {
+        thrd_join(workers[i].thread, 0);
+    }
+    if (started_count < thread_count)
+    {
+        free(context.results);
+        free(scores);
+        return 1;
+    }
+    const double seconds = (double)(get_monotonic_nanoseconds() - start) / NANOSECONDS_PER_SECOND;
+
+    uint64_t ticks = 0;
+    uint64_t pieces = 0;
+    uint64_t lines = 0;
+    uint64_t score_total = 0;
+    uint64_t checksum = 0x9E3779B97F4A7C15ULL;
+    uint32_t topped_out_count = 0;
+    uint64_t policy_time = 0;
+    for (uint32_t i = 0; i < game_count; i++)
+    {
+        const SimResult* result = &context.results[i];
+        ticks += result->ticks;
+        pieces += result->pieces;
+        lines += result->lines;
+        score_total += result->score;
+        topped_out_count += result->topped_out;
+        scores[i] = result->score;
+        checksum = (checksum ^ result->score ^ (uint64_t)result->pieces << 40 ^ result->ticks << 20) * 0x100000001B3ULL;
+    }
+    for (uint32_t i = 0; i < thread_count; i++)
+    {
+        policy_time += workers[i].policy_time;
+    }
+    qsort(scores, game_count, sizeof(uint64_t), compare_scores);
+
+    printf("zetris-sim: %u games from seed %llu, at most %u pieces each, %u threads, %.2f s\n", game_count, (unsigned long long)seed,
+        max_pieces, thread_count, seconds);
+    printf("  %.1f games/s, %.0f ticks/s, %.0f pieces/s, %.1f%% of thread time choosing placements\n", game_count / seconds,
+        ticks / seconds, pieces / seconds, 100.0 * policy_time / (seconds * NANOSECONDS_PER_SECOND * thread_count));
+    printf("  %llu ticks, %llu pieces, %llu lines, %u topped out, %u reached the piece limit\n", (unsigned long long)ticks,
+        (unsigned long long)pieces, (unsigned long long)lines, topped_out_count, game_count - topped_out_count);
+    printf("  score: mean %.0f, min %llu, p10 %llu, p25 %llu, median %llu, p75 %llu, p90 %llu, max %llu\n", (double)score_total / game_count,
+        (unsigned long long)scores[0], (unsigned long long)scores[game_count / 10], (unsigned long long)scores[game_count / 4],
+        (unsigned long long)scores[game_count / 2], (unsigned long long)scores[3 * game_count / 4], (unsigned long long)scores[9 * game_count / 10],
+        (unsigned long long)scores[game_count - 1]);
+    printf("  checksum %016llx, the same for the same games on any thread count\n", (unsigned long long)checksum);
+    free(context.results);
+    free(scores);
+    return 0;
+}
+
+static bool parse_sim_number(const char* text, unsigned long long* out_value)
+{
+    char* end;
+    *out_value = strtoull(text, &end, 10);
+    return text[0] >= '0' && text[0] <= '9' && *end == '\0';
+}
+
+int main(int argc, char* argv[])
+{
+    install_trace_dumps(0);
+    uint32_t thread_count = get_processor_count();
+    unsigned long long values[3] = { SIM_DEFAULT_GAME_COUNT, SIM_DEFAULT_MAX_PIECES, SIM_DEFAULT_SEED }; // Games, max pieces, seed.
+    uint8_t value_count = 0;
+    bool is_valid = true;
+    for (int i = 1; i < argc && is_valid; i++)
+    {
+        unsigned long long value;
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc && parse_sim_number(argv[i + 1], &value))
+        {
+            thread_count = (value > SIM_MAX_THREADS) ? SIM_MAX_THREADS : (uint32_t)value;
+            i++;
+        }
+        else if (value_count < 3 && parse_sim_number(argv[i], &value))
+        {
+            values[value_count++] = value;
+        }
+        else
+        {
+            is_valid = false;
+        }
+    }
+    if (!is_valid)
+    {
+        printf("usage: zetris-sim [--threads count] [games] [max pieces] [seed]\n");
+        return 1;
+    }
+    if (thread_count == 0) thread_count = 1;
+    const uint32_t game_count = (values[0] == 0) ? 1 : (values[0] > UINT32_MAX) ? UINT32_MAX : (uint32_t)values[0];
+    const uint32_t max_pieces = (values[1] == 0) ? 1 : (values[1] > UINT32_MAX) ? UINT32_MAX : (uint32_t)values[1];
+    return run_sim(game_count, max_pieces, values[2], thread_count);
+}
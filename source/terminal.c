@@ -1,74 +1,193 @@
 #ifdef TERMINAL_ENGINE
-#include <time.h>
+#include <stdio.h>
+#include <threads.h>
 
+#include "clock.h"
 #include "engine.h"
-#include "util.h"
+#include "game.h"
+#include "trace.h"
 
-void GameLoop()
+#if defined(_WIN32)
+#include <conio.h>
+#else
+#include <termios.h>
+#include <unistd.h>
+#endif // _WIN32
+
+#define FRAME_TIME		(NANOSECONDS_PER_SECOND / 60)
+#define KEY_ESCAPE		27
+
+#if !defined(_WIN32)
+static struct termios savedTerminal;
+static bool isTerminalRaw = false;
+#endif // _WIN32
+
+// Keys come through one at a time without waiting for enter, and aren't echoed over the board.
+void BeginRawInput()
+{
+#if !defined(_WIN32)
+	if (tcgetattr(STDIN_FILENO, &savedTerminal) != 0) return;
+	struct termios raw = savedTerminal;
+	raw.c_lflag &= ~(ICANON | ECHO);
+	raw.c_cc[VMIN] = 0;
+	raw.c_cc[VTIME] = 0;
+	isTerminalRaw = tcsetattr(STDIN_FILENO, TCSANOW, &raw) == 0;
+#endif // _WIN32
+}
+
+void EndRawInput()
 {
-    Game game = InitGame();
-    clock_t lastTime = clock();
-    while(!IsGameOver(&game))
-    {
-        clock_t currentTime = clock();
-        double deltaTime = (double)(currentTime - lastTime) / CLOCKS_PER_SEC;
-        TickGame(&game, deltaTime, GetActionBitFlags());
-        RenderFrame(&game);
-        lastTime = currentTime;
-        clock_t awaitStart = clock();
-        while(1)
-        {
-            if(((double)(clock() - awaitStart) / CLOCKS_PER_SEC) > 0.5) break;
-        }
-    }
-    printf("Game Over\n");
+#if !defined(_WIN32)
+	if (isTerminalRaw) tcsetattr(STDIN_FILENO, TCSANOW, &savedTerminal);
+	isTerminalRaw = false;
+#endif // _WIN32
 }
 
-uint8_t GetActionBitFlags()
+// -1 when no key is waiting.
+int ReadKey()
 {
-    return 0;
+#if defined(_WIN32)
+	return _kbhit() ? _getch() : -1;
+#else
+	unsigned char key;
+	return (read(STDIN_FILENO, &key, 1) == 1) ? key : -1;
+#endif // _WIN32
 }
 
+// A terminal only reports presses (and the key repeat), never releases, so every key read is down for the one tick.
+// Arrows arrive as ESC [ A..D on terminals and as a 224 (or 0) prefix from conio.
+ACTION_BIT_FLAGS GetActionBitFlags(bool* outQuit)
+{
+	ACTION_BIT_FLAGS actionBitFlags = 0;
+	int key;
+	while ((key = ReadKey()) != -1)
+	{
+		if (key == KEY_ESCAPE && ReadKey() == '[')
+		{
+			key = ReadKey();
+			switch (key)
+			{
+			case 'A': actionBitFlags |= ACTION_ROTATE_CLOCKWISE;	break;
+			case 'B': actionBitFlags |= ACTION_SOFT_DROP;			break;
+			case 'C': actionBitFlags |= ACTION_MOVE_RIGHT;			break;
+			case 'D': actionBitFlags |= ACTION_MOVE_LEFT;			break;
+			}
+			continue;
+		}
+		if (key == 224 || key == 0)
+		{
+			key = ReadKey();
+			switch (key)
+			{
+			case 72: actionBitFlags |= ACTION_ROTATE_CLOCKWISE;	break;
+			case 80: actionBitFlags |= ACTION_SOFT_DROP;		break;
+			case 77: actionBitFlags |= ACTION_MOVE_RIGHT;		break;
+			case 75: actionBitFlags |= ACTION_MOVE_LEFT;		break;
+			}
+			continue;
+		}
+		switch (key)
+		{
+		case 'a': actionBitFlags |= ACTION_MOVE_LEFT;			break;
+		case 'd': actionBitFlags |= ACTION_MOVE_RIGHT;			break;
+		case 's': actionBitFlags |= ACTION_SOFT_DROP;			break;
+		case 'w':
+		case 'x': actionBitFlags |= ACTION_ROTATE_CLOCKWISE;	break;
+		case 'z': actionBitFlags |= ACTION_ROTATE_COUNTER;		break;
+		case 'c': actionBitFlags |= ACTION_HOLD_PIECE;			break;
+		case ' ': actionBitFlags |= ACTION_HARD_DROP;			break;
+		case 'q': *outQuit = true;								break;
+		}
+	}
+	return actionBitFlags;
+}
+
+char GetPieceLetter(PieceType type)
+{
+	return " IOTSZJL"[type];
+}
+
+// The whole frame is drawn into one buffer and written at once, so the board doesn't flicker line by line.
 void RenderFrame(const Game* game)
 {
-    printf("\033[2J\033[H");
-    fflush(stdout);
-    printf("\033[?25l");
-    const uint8_t activeBlockXOffset = (uint8_t)(game->playfield.activeBlock.x);
-    const uint8_t activeBlockYOffset = (uint8_t)(game->playfield.activeBlock.y);
-    const uint8_t ghostBlockYOffset = (uint8_t)(game->ghostBlockY);
-    for(uint8_t y = HIDDEN_ROW_COUNT; y < game->playfield.rowCount + HIDDEN_ROW_COUNT; y++)
-    {
-        const int8_t activeYAdjusted = (y - activeBlockYOffset);
-        const int8_t ghostYAdjusted = (y - ghostBlockYOffset);
-        for(uint8_t x = 0; x < game->playfield.columnCount; x++)
-        {
-            const int8_t xAdjusted = (x - activeBlockXOffset);
-            if(
-                (game->playfield.cells[y] & (1U << x)) ||
-                (xAdjusted >= 0 && xAdjusted < game->playfield.activeBlock.component.rotSize) &&
-                (activeYAdjusted >= 0 && activeYAdjusted < game->playfield.activeBlock.component.rotSize) &&
-                (game->playfield.activeBlock.component.cells & (1U << (BLOCK_SIZE * activeYAdjusted + xAdjusted)))
-            ){
-                printf("# ");
-            }
-            else if(
-                (xAdjusted >= 0 && xAdjusted < game->playfield.activeBlock.component.rotSize) &&
-                (ghostYAdjusted >= 0 && ghostYAdjusted < game->playfield.activeBlock.component.rotSize) &&
-                (game->playfield.activeBlock.component.cells & (1U << (BLOCK_SIZE * ghostYAdjusted + xAdjusted)))
-            ) {
-                printf("+ ");
-            }
-            else {
-                printf(". ");
-            }
-        }
-        printf("\n");
-        // output[(y - 4)];
-    }
-    printf("\033[?25h");
-    printf("------------------\n");
-    // printf(output);
-    // free(output);
+	static char frame[(MAX_ROW_COUNT + 8) * (2 * MAX_COLUMN_COUNT + 64)];
+	size_t length = 0;
+	length += snprintf(&frame[length], sizeof(frame) - length, "\033[H");
+	const int controlledBlockXOffset = game->controlled_piece.pos_x;
+	const int controlledBlockYOffset = game->controlled_piece.pos_y;
+	const int ghostBlockYOffset = game->controlled_piece_ground_y;
+	const int controlledSize = game->controlled_piece.size;
+	for (uint8_t y = game->playfield.ceiling; y < game->playfield.row_count; y++)
+	{
+		const int controlledYAdjusted = y - controlledBlockYOffset;
+		const int ghostYAdjusted = y - ghostBlockYOffset;
+		frame[length++] = '|';
+		for (uint8_t x = COLUMN_OFFSET; x < game->playfield.column_count + COLUMN_OFFSET; x++)
+		{
+			const int controlledXAdjusted = x - controlledBlockXOffset;
+			char cell = '.';
+			if (controlledXAdjusted >= 0 && controlledXAdjusted < controlledSize &&
+				controlledYAdjusted >= 0 && controlledYAdjusted < controlledSize &&
+				is_piece_cell(game->controlled_piece.cells, controlledXAdjusted, controlledYAdjusted))
+			{
+				cell = '#';
+			}
+			else if (controlledXAdjusted >= 0 && controlledXAdjusted < controlledSize &&
+				ghostYAdjusted >= 0 && ghostYAdjusted < controlledSize &&
+				is_piece_cell(game->controlled_piece.cells, controlledXAdjusted, ghostYAdjusted))
+			{
+				cell = '+';
+			}
+			else if (is_playfield_cell(&game->playfield, x, y))
+			{
+				const uint8_t type = get_playfield_cell_type(&game->playfield, x, y);
+				cell = type ? GetPieceLetter((PieceType)type) : 'X';
+			}
+			frame[length++] = cell;
+			frame[length++] = ' ';
+		}
+		frame[length++] = '|';
+		frame[length++] = '\n';
+	}
+	char queue[PIECE_PREVIEW_COUNT + 1];
+	for (uint8_t i = 0; i < PIECE_PREVIEW_COUNT; i++)
+	{
+		queue[i] = GetPieceLetter(peek_piece_queue(game, i)->type);
+	}
+	queue[PIECE_PREVIEW_COUNT] = '\0';
+	length += snprintf(&frame[length], sizeof(frame) - length,
+		"Hold: %c  Next: %s\033[K\nLevel: %d  Score: %llu  Lines: %u\033[K\n",
+		game->held_piece ? GetPieceLetter(game->held_piece->type) : '-', queue,
+		game->level_index + 1, (unsigned long long)game->score, game->playfield.lines_cleared);
+	fwrite(frame, 1, length, stdout);
+	fflush(stdout);
+}
+
+void game_loop()
+{
+	install_trace_dumps(0);
+	set_trace_thread_name("main");
+	BeginRawInput();
+	printf("\033[2J\033[?25l");
+	Game game = get_default_initialized_game();
+	bool quit = false;
+	uint64_t lastTime = get_monotonic_nanoseconds();
+	while (!quit && !is_game_over(&game))
+	{
+		const uint64_t currentTime = get_monotonic_nanoseconds();
+		tick(&game, (double)(currentTime - lastTime) / NANOSECONDS_PER_SECOND, GetActionBitFlags(&quit));
+		lastTime = currentTime;
+		RenderFrame(&game);
+		poll_trace_dump();
+		const uint64_t frameEnd = currentTime + FRAME_TIME;
+		const uint64_t now = get_monotonic_nanoseconds();
+		if (now < frameEnd)
+		{
+			const uint64_t wait = frameEnd - now;
+			thrd_sleep(&(struct timespec){ .tv_sec = (time_t)(wait / NANOSECONDS_PER_SECOND), .tv_nsec = (long)(wait % NANOSECONDS_PER_SECOND) }, 0);
+		}
+	}
+	printf("\033[?25h%sScore: %llu\n", is_game_over(&game) ? "Game Over! " : "", (unsigned long long)game.score);
+	EndRawInput();
 }
-#endif // TERMINAL_ENGINE
\ No newline at end of file
+#endif // TERMINAL_ENGINE
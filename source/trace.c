@@ -0,0 +1,184 @@
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "clock.h"
+#include "trace.h"
+
+#define TRACE_MAX_PATH  1024
+
+_Static_assert((TRACE_RING_SIZE & (TRACE_RING_SIZE - 1)) == 0, "The ring is indexed with a mask.");
+_Static_assert(ATOMIC_BOOL_LOCK_FREE == 2, "The signal handler sets is_dump_requested.");
+
+// Every field is atomic so write_trace can copy a ring while its thread keeps recording, and tell which slots it raced with.
+typedef struct {
+    atomic_ullong time;                     // Nanoseconds, get_monotonic_nanoseconds.
+    atomic_uintptr_t name;
+    atomic_uint phase;
+} TraceSlot;
+
+typedef struct TraceRing {
+    TraceSlot slots[TRACE_RING_SIZE];
+    atomic_ullong head;                     // Events ever recorded. Only the owning thread writes it.
+    atomic_uintptr_t thread_name;
+    uint32_t thread_id;
+    struct TraceRing* next;                 // Set before the ring is published, never after.
+} TraceRing;
+
+typedef struct {
+    uint64_t time;
+    const char* name;
+    TracePhase phase;
+} TraceEvent;
+
+atomic_bool trace_enabled;
+static _Atomic(TraceRing*) trace_rings;     // Every ring ever made. They outlive their threads so a trace still shows them.
+static atomic_uint trace_thread_count;
+static atomic_ullong trace_epoch;           // When tracing was first turned on. Timestamps are written from here.
+static atomic_bool is_dump_requested;       // Lock free, so the signal handler can set it, and exchanged so one poller of many writes.
+static char trace_path[TRACE_MAX_PATH];
+static _Thread_local TraceRing* thread_ring;
+static _Thread_local const char* thread_name;
+
+// Made on a thread's first event instead of in set_trace_thread_name, so threads that never record cost nothing.
+static TraceRing* get_thread_ring(void)
+{
+    if (thread_ring) return thread_ring;
+    TraceRing* ring = calloc(1, sizeof(TraceRing));
+    if (!ring) return 0;
+    ring->thread_id = atomic_fetch_add_explicit(&trace_thread_count, 1, memory_order_relaxed) + 1;
+    atomic_init(&ring->thread_name, (uintptr_t)thread_name);
+    ring->next = atomic_load_explicit(&trace_rings, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&trace_rings, &ring->next, ring, memory_order_release, memory_order_relaxed));
+    thread_ring = ring;
+    return ring;
+}
+
+void record_trace_event(const char* name, TracePhase phase)
+{
+    TraceRing* ring = get_thread_ring();
+    if (!ring) return;
+    const uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    TraceSlot* slot = &ring->slots[head & (TRACE_RING_SIZE - 1)];
+    // A reader that sees any of the stores below also sees the head published for the previous event, so it knows the slot is being reused.
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&slot->time, get_monotonic_nanoseconds(), memory_order_relaxed);
+    atomic_store_explicit(&slot->name, (uintptr_t)name, memory_order_relaxed);
+    atomic_store_explicit(&slot->phase, (unsigned int)phase, memory_order_relaxed);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+void set_trace_enabled(bool is_enabled)
+{
+    uint64_t no_epoch = 0;
+    if (is_enabled) atomic_compare_exchange_strong(&trace_epoch, &no_epoch, get_monotonic_nanoseconds());
+    atomic_store_explicit(&trace_enabled, is_enabled, memory_order_relaxed);
+}
+
+void set_trace_thread_name(const char* name)
+{
+    thread_name = name;
+    if (thread_ring) atomic_store_explicit(&thread_ring->thread_name, (uintptr_t)name, memory_order_relaxed);
+}
+
+// Copies the events of a ring that are still whole, oldest first. Returns how many.
+static uint32_t copy_trace_ring(TraceRing* ring, TraceEvent* out_events)
+{
+    const uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    const uint64_t first = (head > TRACE_RING_SIZE) ? head - TRACE_RING_SIZE : 0;
+    for (uint64_t i = first; i < head; i++)
+    {
+        const TraceSlot* slot = &ring->slots[i & (TRACE_RING_SIZE - 1)];
+        TraceEvent* event = &out_events[i - first];
+        event->time = atomic_load_explicit(&slot->time, memory_order_relaxed);
+        event->name = (const char*)atomic_load_explicit(&slot->name, memory_order_relaxed);
+        event->phase = (TracePhase)atomic_load_explicit(&slot->phase, memory_order_relaxed);
+    }
+    atomic_thread_fence(memory_order_acquire);
+    // The slot of the event being recorded now is the oldest one, so it and everything recorded during the copy are dropped.
+    const uint64_t now_head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    const uint64_t whole_from = (now_head >= TRACE_RING_SIZE) ? now_head - TRACE_RING_SIZE + 1 : 0;
+    const uint64_t skipped = (whole_from > first) ? whole_from - first : 0;
+    if (skipped >= head - first) return 0;
+    memmove(out_events, &out_events[skipped], (head - first - skipped) * sizeof(TraceEvent));
+    return (uint32_t)(head - first - skipped);
+}
+
+bool write_trace(const char* path)
+{
+    TraceEvent* events = malloc(TRACE_RING_SIZE * sizeof(TraceEvent));
+    FILE* file = fopen(path, "w");
+    if (!events || !file)
+    {
+        free(events);
+        if (file) fclose(file);
+        return false;
+    }
+    const uint64_t epoch = atomic_load_explicit(&trace_epoch, memory_order_relaxed);
+    bool is_first = true;
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    for (TraceRing* ring = atomic_load_explicit(&trace_rings, memory_order_acquire); ring; ring = ring->next)
+    {
+        const char* name = (const char*)atomic_load_explicit(&ring->thread_name, memory_order_relaxed);
+        if (name)
+        {
+            fprintf(file, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}", is_first ? "" : ",", ring->thread_id, name);
+            is_first = false;
+        }
+        const uint32_t count = copy_trace_ring(ring, events);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const double timestamp = (events[i].time > epoch) ? (events[i].time - epoch) / 1e3 : 0.0; // Microseconds.
+            fprintf(file, "%s\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%u%s}", is_first ? "" : ",",
+                events[i].name, (char)events[i].phase, timestamp, ring->thread_id, (events[i].phase == TRACE_PHASE_INSTANT) ? ",\"s\":\"t\"" : "");
+            is_first = false;
+        }
+    }
+    fprintf(file, "\n]}\n");
+    free(events);
+    return fclose(file) == 0;
+}
+
+static void handle_trace_signal(int signal_number)
+{
+    atomic_store_explicit(&is_dump_requested, true, memory_order_relaxed);
+    signal(signal_number, handle_trace_signal); // Some platforms reset the handler once it runs.
+}
+
+static void write_trace_at_exit(void)
+{
+    if (atomic_load_explicit(&trace_rings, memory_order_acquire)) write_trace(trace_path);
+}
+
+bool install_trace_dumps(const char* optional_default_path)
+{
+    const char* environment_path = getenv(TRACE_ENVIRONMENT_VARIABLE);
+    const bool is_from_environment = environment_path && environment_path[0];
+    const char* path = is_from_environment ? environment_path : optional_default_path;
+    if (trace_path[0] || !path || !path[0] || strlen(path) >= TRACE_MAX_PATH) return false;
+    strcpy(trace_path, path);
+#if defined(SIGUSR1)
+    signal(SIGUSR1, handle_trace_signal);
+#elif defined(SIGBREAK)
+    signal(SIGBREAK, handle_trace_signal);
+#endif // SIGUSR1
+    atexit(write_trace_at_exit);
+    if (is_from_environment) set_trace_enabled(true);
+    return is_from_environment;
+}
+
+void request_trace_dump(void)
+{
+    atomic_store_explicit(&is_dump_requested, true, memory_order_relaxed);
+}
+
+bool poll_trace_dump(void)
+{
+    if (!atomic_load_explicit(&is_dump_requested, memory_order_relaxed) ||
+        !atomic_exchange_explicit(&is_dump_requested, false, memory_order_relaxed))
+    {
+        return false;
+    }
+    return trace_path[0] && write_trace(trace_path);
+}
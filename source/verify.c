@@ -0,0 +1,350 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+#include "bot.h"
+#include "clock.h"
+#include "mapped_file.h"
+#include "replay.h"
+#include "trace.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <unistd.h>
+#endif // _WIN32
+
+#define VERIFY_QUEUE_CAPACITY   1024    // Jobs waiting for a worker. Only offsets into mapped files, so memory stays flat however many replays there are.
+#define VERIFY_MAX_THREADS      256
+#define VERIFY_MAX_PATH         4096
+
+// A mapped replay file, unmapped once its last replay is verified.
+typedef struct {
+    MappedFile mapping;
+    atomic_uint references;
+    char* path;
+} VerifyFile;
+
+typedef struct {
+    VerifyFile* file;
+    size_t offset;
+    size_t size;
+    uint32_t index;     // Replay number within the file.
+} VerifyJob;
+
+typedef struct {
+    VerifyJob jobs[VERIFY_QUEUE_CAPACITY];
+    uint32_t head;
+    uint32_t count;
+    bool closed;
+    mtx_t mutex;
+    cnd_t not_empty;
+    cnd_t not_full;
+    mtx_t output_mutex;
+    atomic_ullong replay_count;
+    atomic_ullong invalid_count;
+    atomic_ullong tick_count;
+} VerifyQueue;
+
+static uint32_t get_processor_count(void)
+{
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (uint32_t)info.dwNumberOfProcessors;
+#else
+    const long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return (count > 0) ? (uint32_t)count : 1;
+#endif // _WIN32
+}
+
+static VerifyFile* open_verify_file(const char* path)
+{
+    VerifyFile* file = calloc(1, sizeof(VerifyFile));
+    if (file) file->path = malloc(strlen(path) + 1);
+    if (!file || !file->path || !map_file(path, true, &file->mapping))
+    {
+        fprintf(stderr, "zetris-verify: can't map %s\n", path);
+        if (file) free(file->path);
+        free(file);
+        return 0;
+    }
+    strcpy(file->path, path);
+    atomic_init(&file->references, 1);
+    return file;
+}
+
+static void release_file(VerifyFile* file)
+{
+    if (atomic_fetch_sub_explicit(&file->references, 1, memory_order_acq_rel) != 1) return;
+    unmap_file(&file->mapping);
+    free(file->path);
+    free(file);
+}
+
+static void push_job(VerifyQueue* queue, VerifyJob job)
+{
+    mtx_lock(&queue->mutex);
+    while (queue->count == VERIFY_QUEUE_CAPACITY)
+    {
+        cnd_wait(&queue->not_full, &queue->mutex);
+    }
+    queue->jobs[(queue->head + queue->count++) % VERIFY_QUEUE_CAPACITY] = job;
+    cnd_signal(&queue->not_empty);
+    mtx_unlock(&queue->mutex);
+}
+
+static bool pop_job(VerifyQueue* queue, VerifyJob* out_job)
+{
+    mtx_lock(&queue->mutex);
+    while (!queue->count && !queue->closed)
+    {
+        cnd_wait(&queue->not_empty, &queue->mutex);
+    }
+    if (!queue->count)
+    {
+        mtx_unlock(&queue->mutex);
+        return false;
+    }
+    *out_job = queue->jobs[queue->head];
+    queue->head = (queue->head + 1) % VERIFY_QUEUE_CAPACITY;
+    queue->count--;
+    cnd_signal(&queue->not_full);
+    mtx_unlock(&queue->mutex);
+    return true;
+}
+
+static int run_verify_worker(void* arg)
+{
+    VerifyQueue* queue = arg;
+    VerifyJob job;
+    set_trace_thread_name("verify worker");
+    while (pop_job(queue, &job))
+    {
+        poll_trace_dump(); // The main thread is feeding the queue or joining, so a SIGUSR1 is answered here.
+        const ReplayVerification result = verify_replay(&job.file->mapping.data[job.offset], job.size);
+        atomic_fetch_add_explicit(&queue->replay_count, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&queue->tick_count, result.simulated_ticks, memory_order_relaxed);
+        if (result.verdict != REPLAY_VALID)
+        {
+            ReplayHeader header;
+            read_replay_header(&job.file->mapping.data[job.offset], job.size, &header);
+            atomic_fetch_add_explicit(&queue->invalid_count, 1, memory_order_relaxed);
+            mtx_lock(&queue->output_mutex);
+            printf("%s#%u (offset %zu): %s at tick %u, claimed score %llu lines %u level %u, simulated score %llu lines %u level %u\n",
+                job.file->path, job.index, job.offset, get_replay_verdict_name(result.verdict), result.divergence_tick,
+                (unsigned long long)header.score, header.lines_cleared, header.level_index + 1,
+                (unsigned long long)result.score, result.lines_cleared, result.level_index + 1);
+            mtx_unlock(&queue->output_mutex);
+        }
+        release_file(job.file);
+    }
+    return 0;
+}
+
+// Splits a file into replays by their headers and queues them. A bad header ends the file, since nothing after it can be found.
+static void queue_file(VerifyQueue* queue, const char* path)
+{
+    TRACE_BEGIN("replay map");
+    VerifyFile* file = open_verify_file(path);
+    TRACE_END("replay map");
+    if (!file) return;
+    const uint8_t* data = file->mapping.data;
+    const size_t file_size = file->mapping.size;
+    size_t offset = 0;
+    uint32_t index = 0;
+    while (offset < file_size)
+    {
+        ReplayHeader header;
+        if (!read_replay_header(&data[offset], file_size - offset, &header) || get_replay_size(&header) > file_size - offset)
+        {
+            mtx_lock(&queue->output_mutex);
+            printf("%s#%u (offset %zu): %s, skipping the rest of the file\n", path, index, offset,
+                get_replay_verdict_name(verify_replay(&data[offset], file_size - offset).verdict));
+            mtx_unlock(&queue->output_mutex);
+            atomic_fetch_add_explicit(&queue->replay_count, 1, memory_order_relaxed);
+            atomic_fetch_add_explicit(&queue->invalid_count, 1, memory_order_relaxed);
+            break;
+        }
+        const size_t size = get_replay_size(&header);
+        atomic_fetch_add_explicit(&file->references, 1, memory_order_relaxed);
+        push_job(queue, (VerifyJob){ file, offset, size, index++ });
+        offset += size;
+    }
+    release_file(file);
+}
+
+static void queue_path(VerifyQueue* queue, const char* path)
+{
+    char child[VERIFY_MAX_PATH];
+#if defined(_WIN32)
+    const DWORD attributes = GetFileAttributesA(path);
+    if (attributes == INVALID_FILE_ATTRIBUTES || !(attributes & FILE_ATTRIBUTE_DIRECTORY))
+    {
+        queue_file(queue, path);
+        return;
+    }
+    snprintf(child, sizeof(child), "%s\\*", path);
+    WIN32_FIND_DATAA entry;
+    HANDLE find = FindFirstFileA(child, &entry);
+    if (find == INVALID_HANDLE_VALUE) return;
+    do
+    {
+        if (strcmp(entry.cFileName, ".") == 0 || strcmp(entry.cFileName, "..") == 0) continue;
+        snprintf(child, sizeof(child), "%s\\%s", path, entry.cFileName);
+        queue_path(queue, child);
+    } while (FindNextFileA(find, &entry));
+    FindClose(find);
+#else
+    DIR* directory = opendir(path);
+    if (!directory)
+    {
+        queue_file(queue, path);
+        return;
+    }
+    struct dirent* entry;
+    while ((entry = readdir(directory)))
+    {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+        snprintf(child, sizeof(child), "%s/%s", path, entry->d_name);
+        queue_path(queue, child);
+    }
+    closedir(directory);
+#endif // _WIN32
+}
+
+static int verify_paths(char** paths, int path_count, uint32_t thread_count)
+{
+    static VerifyQueue queue; // Too big for the stack.
+    if (mtx_init(&queue.mutex, mtx_plain) != thrd_success || mtx_init(&queue.output_mutex, mtx_plain) != thrd_success ||
+        cnd_init(&queue.not_empty) != thrd_success || cnd_init(&queue.not_full) != thrd_success)
+    {
+        fprintf(stderr, "zetris-verify: couldn't create the job queue\n");
+        return 1;
+    }
+    thrd_t threads[VERIFY_MAX_THREADS];
+    uint32_t started_count = 0;
+    while (started_count < thread_count && thrd_create(&threads[started_count], run_verify_worker, &queue) == thrd_success)
+    {
+        started_count++;
+    }
+    const bool is_running = started_count == thread_count;
+    if (!is_running)
+    {
+        fprintf(stderr, "zetris-verify: couldn't start %u of %u worker threads\n", thread_count - started_count, thread_count);
+    }
+
+    const uint64_t start = get_monotonic_nanoseconds();
+    for (int i = 0; i < path_count && is_running; i++)
+    {
+        queue_path(&queue, paths[i]);
+    }
+    mtx_lock(&queue.mutex);
+    queue.closed = true;
+    cnd_broadcast(&queue.not_empty);
+    mtx_unlock(&queue.mutex);
+    for (uint32_t i = 0; i < started_count; i++)
+    {
+        thrd_join(threads[i], 0);
+    }
+    if (!is_running)
+    {
+        cnd_destroy(&queue.not_full);
+        cnd_destroy(&queue.not_empty);
+        mtx_destroy(&queue.output_mutex);
+        mtx_destroy(&queue.mutex);
+        return 1;
+    }
+    const double seconds = (double)(get_monotonic_nanoseconds() - start) / NANOSECONDS_PER_SECOND;
+
+    const unsigned long long replays = atomic_load(&queue.replay_count);
+    const unsigned long long invalid = atomic_load(&queue.invalid_count);
+    printf("zetris-verify: %llu replays, %llu valid, %llu invalid, %u threads, %.2f s, %.0f replays/min, %.0f ticks/s\n",
+        replays, replays - invalid, invalid, thread_count, seconds,
+        replays * 60.0 / seconds, atomic_load(&queue.tick_count) / seconds);
+    cnd_destroy(&queue.not_full);
+    cnd_destroy(&queue.not_empty);
+    mtx_destroy(&queue.output_mutex);
+    mtx_destroy(&queue.mutex);
+    return invalid ? 1 : 0;
+}
+
+// Writes bot played replays back to back into one file. Every tamper_every-th one gets a flipped input halfway, to see the mismatch reporting work.
+static int generate_replays(const char* path, uint32_t count, uint32_t max_ticks, uint32_t tamper_every)
+{
+    FILE* file = fopen(path, "wb");
+    BotSettings settings = get_default_bot_settings();
+    settings.beam_width = 16;
+    settings.depth = 2;
+    settings.thread_count = 1;
+    Bot* bot = create_bot(settings);
+    if (!file || !bot)
+    {
+        fprintf(stderr, "zetris-verify: can't write %s\n", path);
+        if (file) fclose(file);
+        destroy_bot(bot);
+        return 1;
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        ReplayRecorder recorder;
+        BotController controller = { 0 };
+        if (!begin_replay_recording(&recorder, i + 1, SETTINGS_DEFAULT, get_default_handling(), REPLAY_DEFAULT_TICK_RATE)) break;
+        while (recorder.header.tick_count < max_ticks)
+        {
+            if (needs_bot_controller_target(&controller, &recorder.game))
+            {
+                Placement placement;
+                if (search_bot_placement(bot, &recorder.game, &placement, 0)) set_bot_controller_target(&controller, &recorder.game, placement);
+            }
+            if (!tick_replay_recording(&recorder, get_bot_controller_action_bit_flags(&controller, &recorder.game))) break;
+        }
+        if (tamper_every && i % tamper_every == tamper_every - 1 && recorder.header.tick_count)
+        {
+            recorder.actions[recorder.header.tick_count / 2] ^= ACTION_HARD_DROP | ACTION_MOVE_LEFT;
+        }
+        const bool written = write_replay(&recorder, file);
+        end_replay_recording(&recorder);
+        if (!written)
+        {
+            fprintf(stderr, "zetris-verify: can't write %s\n", path);
+            break;
+        }
+    }
+    destroy_bot(bot);
+    return fclose(file) == 0 ? 0 : 1;
+}
+
+int main(int argc, char* argv[])
+{
+    install_trace_dumps(0);
+    if (argc > 2 && strcmp(argv[1], "--generate") == 0)
+    {
+        const uint32_t count = (argc > 3) ? (uint32_t)strtoul(argv[3], 0, 10) : 100;
+        const uint32_t max_ticks = (argc > 4) ? (uint32_t)strtoul(argv[4], 0, 10) : 60 * REPLAY_DEFAULT_TICK_RATE;
+        const uint32_t tamper_every = (argc > 5) ? (uint32_t)strtoul(argv[5], 0, 10) : 0;
+        return generate_replays(argv[2], count, max_ticks, tamper_every);
+    }
+
+    int first_path = 1;
+    uint32_t thread_count = get_processor_count();
+    if (argc > 2 && strcmp(argv[1], "--threads") == 0)
+    {
+        thread_count = (uint32_t)strtoul(argv[2], 0, 10);
+        first_path = 3;
+    }
+    if (thread_count == 0) thread_count = 1;
+    if (thread_count > VERIFY_MAX_THREADS) thread_count = VERIFY_MAX_THREADS;
+    if (first_path >= argc)
+    {
+        printf("usage: zetris-verify [--threads count] <replay file or directory>...\n");
+        printf("       zetris-verify --generate <file> [count] [ticks per replay] [tamper every]\n");
+        return 1;
+    }
+    return verify_paths(&argv[first_path], argc - first_path, thread_count);
+}
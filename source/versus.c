@@ -0,0 +1,196 @@
+#include <string.h>
+
+#include "util.h"
+#include "versus.h"
+
+// Lines sent by cleared line count, and the bonus by how many clears came right before (Game.combo_count - 1).
+static const uint8_t LINE_CLEAR_ATTACK[PIECE_MAX_SIZE + 1] = { 0, 0, 1, 2, 4 };
+static const uint8_t COMBO_ATTACK[] = { 0, 1, 1, 2, 2, 3, 3, 4, 4, 4, 5 };
+#define COMBO_ATTACK_COUNT (sizeof(COMBO_ATTACK) / sizeof(COMBO_ATTACK[0]))
+
+void init_versus_match(VersusMatch* match, uint64_t seed)
+{
+    memset(match, 0, sizeof(VersusMatch));
+    uint64_t random_state = seed;
+    // Each player gets their own bags. With the same ones, two copies of a deterministic bot play the same moves and never win.
+    for (uint8_t i = 0; i < VERSUS_PLAYER_COUNT; i++)
+    {
+        match->players[i].game = get_seeded_initialized_game(next_random(&random_state));
+    }
+    match->random_state = next_random(&random_state);
+    match->winner = VERSUS_NO_WINNER;
+}
+
+uint8_t get_garbage_attack(uint8_t cleared_lines, uint8_t combo_count, bool is_perfect_clear)
+{
+    if (!cleared_lines) return 0;
+    uint8_t attack = LINE_CLEAR_ATTACK[(cleared_lines > PIECE_MAX_SIZE) ? PIECE_MAX_SIZE : cleared_lines];
+    const uint8_t previous_clears = (combo_count) ? combo_count - 1 : 0;
+    attack += COMBO_ATTACK[(previous_clears < COMBO_ATTACK_COUNT) ? previous_clears : COMBO_ATTACK_COUNT - 1];
+    if (is_perfect_clear) attack += GARBAGE_PERFECT_CLEAR_BONUS;
+    return attack;
+}
+
+void push_garbage(GarbageQueue* queue, uint8_t lines, uint8_t hole_x)
+{
+    if (!lines) return;
+    queue->pending_lines += lines;
+    if (queue->count == GARBAGE_QUEUE_CAPACITY)
+    {
+        GarbageBatch* newest = &queue->batches[(queue->head + queue->count - 1) % GARBAGE_QUEUE_CAPACITY];
+        newest->lines = (newest->lines + lines > UINT8_MAX) ? UINT8_MAX : newest->lines + lines;
+        return;
+    }
+    queue->batches[(queue->head + queue->count++) % GARBAGE_QUEUE_CAPACITY] = (GarbageBatch){ lines, hole_x };
+}
+
+uint8_t cancel_garbage(GarbageQueue* queue, uint8_t lines)
+{
+    while (lines && queue->count)
+    {
+        GarbageBatch* oldest = &queue->batches[queue->head];
+        const uint8_t cancelled = (oldest->lines < lines) ? oldest->lines : lines;
+        oldest->lines -= cancelled;
+        queue->pending_lines -= cancelled;
+        lines -= cancelled;
+        if (!oldest->lines)
+        {
+            queue->head = (queue->head + 1) % GARBAGE_QUEUE_CAPACITY;
+            queue->count--;
+        }
+    }
+    return lines;
+}
+
+bool insert_garbage_rows(Playfield* playfield, uint8_t lines, uint8_t hole_x)
+{
+    if (!lines) return true;
+    if (lines > playfield->row_count) lines = playfield->row_count;
+    // Whatever is in the top rows is about to be pushed out.
+    PlayfieldRow pushed_out = 0;
+    for (uint8_t y = 0; y < lines; y++)
+    {
+        pushed_out |= playfield->cells[y];
+    }
+    const size_t kept_size = (size_t)(playfield->row_count - lines) * sizeof(PlayfieldRow);
+    memmove(&playfield->cells[0], &playfield->cells[lines], kept_size);
+    for (uint8_t i = 0; i < CELL_TYPE_PLANE_COUNT; i++)
+    {
+        memmove(&playfield->type_planes[i][0], &playfield->type_planes[i][lines], kept_size);
+    }
+    // Garbage is not a piece, so its cells keep type 0.
+    const PlayfieldRow garbage_row = get_playfield_full_row(playfield) & ~((PlayfieldRow)1 << hole_x);
+    for (uint8_t y = playfield->row_count - lines; y < playfield->row_count; y++)
+    {
+        playfield->cells[y] = garbage_row;
+        for (uint8_t i = 0; i < CELL_TYPE_PLANE_COUNT; i++)
+        {
+            playfield->type_planes[i][y] = 0;
+        }
+    }
+    return !pushed_out;
+}
+
+// Lands up to GARBAGE_MAX_LINES_PER_PIECE waiting rows, oldest first.
+static void land_garbage(VersusPlayer* player)
+{
+    Game* game = &player->game;
+    GarbageQueue* queue = &player->incoming;
+    uint8_t budget = GARBAGE_MAX_LINES_PER_PIECE;
+    while (budget && queue->count)
+    {
+        GarbageBatch* oldest = &queue->batches[queue->head];
+        const uint8_t lines = (oldest->lines < budget) ? oldest->lines : budget;
+        player->topped_out |= !insert_garbage_rows(&game->playfield, lines, oldest->hole_x);
+        player->lines_received += lines;
+        budget -= lines;
+        cancel_garbage(queue, lines);
+    }
+    // The next piece already spawned, so the stack may have come up into it.
+    Piece* piece = &game->controlled_piece;
+    player->topped_out |= are_playfield_piece_cells_colliding(&game->playfield, piece->cells, piece->size, piece->pos_x, piece->pos_y);
+    game->controlled_piece_ground_y = get_playfield_piece_cells_hard_drop_y(&game->playfield, piece->cells, piece->size, piece->pos_x, piece->pos_y);
+}
+
+// Runs after both players moved. Every lock sends (after cancelling its own queue) or takes garbage,
+// and attacks are only delivered after garbage landed, so they wait at least one piece and the player order doesn't matter.
+static void settle_versus_match(VersusMatch* match)
+{
+    uint8_t outgoing[VERSUS_PLAYER_COUNT] = { 0 };
+    for (uint8_t i = 0; i < VERSUS_PLAYER_COUNT; i++)
+    {
+        VersusPlayer* player = &match->players[i];
+        Game* game = &player->game;
+        if (game->placed_piece_count == player->last_placed_piece_count) continue;
+        player->last_placed_piece_count = game->placed_piece_count;
+        const uint8_t cleared_lines = (uint8_t)(game->playfield.lines_cleared - player->last_lines_cleared);
+        player->last_lines_cleared = game->playfield.lines_cleared;
+        if (cleared_lines)
+        {
+            // Rows only ever shift down, so an empty bottom row means an empty playfield.
+            const bool is_perfect_clear = !game->playfield.cells[game->playfield.row_count - 1];
+            outgoing[i] = cancel_garbage(&player->incoming, get_garbage_attack(cleared_lines, game->combo_count, is_perfect_clear));
+        }
+        else if (player->incoming.count)
+        {
+            land_garbage(player);
+        }
+    }
+
+    uint8_t lost_count = 0;
+    uint8_t survivor = VERSUS_NO_WINNER;
+    for (uint8_t i = 0; i < VERSUS_PLAYER_COUNT; i++)
+    {
+        VersusPlayer* player = &match->players[i];
+        if (outgoing[i])
+        {
+            const uint8_t hole_x = (uint8_t)(next_random(&match->random_state) % player->game.playfield.column_count);
+            push_garbage(&match->players[(i + 1) % VERSUS_PLAYER_COUNT].incoming, outgoing[i], hole_x);
+            player->lines_sent += outgoing[i];
+        }
+        if (player->topped_out || is_game_over(&player->game))
+        {
+            lost_count++;
+        }
+        else
+        {
+            survivor = i;
+        }
+    }
+    match->step_count++;
+    if (lost_count)
+    {
+        match->is_over = true;
+        match->winner = (lost_count == VERSUS_PLAYER_COUNT - 1) ? survivor : VERSUS_NO_WINNER;
+    }
+}
+
+void step_versus_match(VersusMatch* match, const ACTION_BIT_FLAGS action_bit_flags[VERSUS_PLAYER_COUNT], double delta_time)
+{
+    if (match->is_over) return;
+    for (uint8_t i = 0; i < VERSUS_PLAYER_COUNT; i++)
+    {
+        tick(&match->players[i].game, delta_time, action_bit_flags[i]);
+    }
+    settle_versus_match(match);
+}
+
+bool apply_versus_placement(VersusMatch* match, uint8_t player_index, Placement placement)
+{
+    if (match->is_over || player_index >= VERSUS_PLAYER_COUNT) return false;
+    if (!attempt_apply_placement(&match->players[player_index].game, placement)) return false;
+    settle_versus_match(match);
+    return true;
+}
+
+uint32_t step_versus_matches(VersusMatch* matches, uint32_t match_count, const ACTION_BIT_FLAGS* action_bit_flags, double delta_time)
+{
+    uint32_t running_count = 0;
+    for (uint32_t m = 0; m < match_count; m++)
+    {
+        if (matches[m].is_over) continue;
+        step_versus_match(&matches[m], &action_bit_flags[(size_t)m * VERSUS_PLAYER_COUNT], delta_time);
+        running_count += !matches[m].is_over;
+    }
+    return running_count;
+}